@@ -0,0 +1,583 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Comparison of the hot paths of the wrapper against the same calls made
+	directly to the C interface of SQLite, on in-memory and on-disk
+	databases, reported as JSON or CSV to track regressions.
+
+Build:
+	There is no build target; compile with optimisation and without
+	USE_VIEW_CHECKS:
+	g++ -std=c++11 -O2 -Iinclude bench/SQLiteWrappedBenchmark.cpp
+		src/SQLiteWrapped.cpp -lsqlite3 -o SQLiteWrappedBenchmark
+
+Usage:
+	SQLiteWrappedBenchmark [--format json|csv] [--repetitions N]
+		[--min-time MS] [--filter TEXT] [--dir PATH] [--max-overhead RATIO]
+	--max-overhead fails the run if the median of any "wrapped"
+	implementation exceeds RATIO times the median of "raw". Variants such as
+	"wrapped_string", which do more work by design, are reported but never
+	fail the run.
+*/
+
+#include "SQLiteWrapped.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const int table_rows = 1000;
+	const std::size_t text_bytes = 32;
+	const std::size_t blob_bytes = 256;
+
+	// Keeps a value alive without a store to memory.
+	template <typename T>
+	inline void keep(const T& value)
+	{
+#if defined(__GNUC__)
+		asm volatile("" : : "g"(&value) : "memory");
+#else
+		static volatile const void* sink;
+		sink = &value;
+#endif// defined(__GNUC__)
+	}
+
+	struct options
+	{
+		bool csv = false;
+		int repetitions = 9;
+		double minTimeMs = 50;
+		std::string filter;
+		std::string dir = ".";
+		double maxOverhead = 0;
+	};
+
+	// One way of doing the work of a case; run performs the operation the
+	// given number of times.
+	struct implementation
+	{
+		const char* name;
+		std::function<void(std::size_t)> run;
+	};
+
+	struct benchmark_case
+	{
+		std::string name;
+		// Operations performed by each call of run with a count of one.
+		std::size_t operations;
+		std::vector<implementation> implementations;
+	};
+
+	struct result
+	{
+		std::string caseName;
+		std::string database;
+		std::string implementation;
+		std::size_t iterations;
+		double medianNs;
+		double minNs;
+		double maxNs;
+		double ratio;
+	};
+
+	double seconds_of(const std::function<void(std::size_t)>& run,
+					  std::size_t iterations)
+	{
+		ALIAS_TYPE(std::chrono::steady_clock, clock);
+		auto start = clock::now();
+		run(iterations);
+		return std::chrono::duration<double>(clock::now() - start).count();
+	}
+
+	double median_of(std::vector<double> v)
+	{
+		std::sort(v.begin(), v.end());
+		auto n = v.size();
+		return n % 2 == 1 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+	}
+
+	void measure(const benchmark_case& c, const std::string& database,
+				 const options& o, std::vector<result>& results)
+	{
+		// Calibrate on the raw implementation, so every implementation runs
+		// the same number of operations.
+		auto& raw = c.implementations.front().run;
+		raw(1);
+		std::size_t iterations = 1;
+		while(seconds_of(raw, iterations) * 1000 < o.minTimeMs &&
+			  iterations < (std::size_t(1) << 30)) {
+			iterations *= 2;
+		}
+
+		auto count = c.implementations.size();
+		std::vector<std::vector<double>> samples(count);
+		for(int r = 0; r < o.repetitions; ++r) {
+			// Rotate the order so drift in clock speed affects each
+			// implementation alike.
+			for(std::size_t k = 0; k < count; ++k) {
+				auto i = (k + static_cast<std::size_t>(r)) % count;
+				auto s = seconds_of(c.implementations[i].run, iterations);
+				samples[i].push_back(s * 1e9 / static_cast<double>(
+												   iterations * c.operations));
+			}
+		}
+
+		auto rawMedian = median_of(samples.front());
+		for(std::size_t i = 0; i < count; ++i) {
+			result x;
+			x.caseName = c.name;
+			x.database = database;
+			x.implementation = c.implementations[i].name;
+			x.iterations = iterations;
+			x.medianNs = median_of(samples[i]);
+			x.minNs = *std::min_element(samples[i].begin(), samples[i].end());
+			x.maxNs = *std::max_element(samples[i].begin(), samples[i].end());
+			x.ratio = rawMedian > 0 ? x.medianNs / rawMedian : 1;
+			results.push_back(x);
+		}
+	}
+
+	int count_rows(void* data, int, char**, char**)
+	{
+		++*static_cast<int*>(data);
+		return 0;
+	}
+
+	// A database holding the table the cases read, with the statements
+	// they use prepared up front.
+	class fixture
+	{
+	public:
+		Sqlt3::unique_connection connection;
+		Sqlt3::unique_connection backupTarget;
+		Sqlt3::unique_statement insert;
+		Sqlt3::unique_statement selectInteger;
+		Sqlt3::unique_statement selectText;
+		Sqlt3::unique_statement selectBlob;
+		std::string text;
+		std::vector<unsigned char> blob;
+
+		explicit fixture(const std::string& path)
+			: text(text_bytes, 'x'), blob(blob_bytes, 0x5a)
+		{
+			connection = Sqlt3::sqlite3_open_v2(
+				path.c_str(),
+				Sqlt3::sqlite_open_readwrite | Sqlt3::sqlite_open_create,
+				nullptr);
+			backupTarget = Sqlt3::sqlite3_open_v2(
+				":memory:",
+				Sqlt3::sqlite_open_readwrite | Sqlt3::sqlite_open_create,
+				nullptr);
+			auto c = connection.get();
+			Sqlt3::sqlite3_exec(c,
+								"PRAGMA journal_mode = WAL;"
+								"PRAGMA synchronous = NORMAL;"
+								"DROP TABLE IF EXISTS t;"
+								"DROP TABLE IF EXISTS sink;"
+								"CREATE TABLE t(id INTEGER PRIMARY KEY, "
+								"i INTEGER, txt TEXT, b BLOB);"
+								"CREATE TABLE sink(v);",
+								nullptr, nullptr);
+
+			Sqlt3::sqlite3_exec(c, "BEGIN", nullptr, nullptr);
+			auto fill = std::move(std::get<0>(Sqlt3::sqlite3_prepare_v2(
+				c, "INSERT INTO t(i, txt, b) VALUES(?1, ?2, ?3)")));
+			for(int r = 0; r < table_rows; ++r) {
+				Sqlt3::sqlite3_bind(fill.get(), 1, r * 7);
+				Sqlt3::sqlite3_bind_text(
+					fill.get(), 2,
+					Sqlt3::utf8_string_view_t(text.data(), text.size()),
+					Sqlt3::sqlite_static);
+				Sqlt3::sqlite3_bind(
+					fill.get(), 3,
+					Sqlt3::blob_view_t(blob.data(), blob.size()),
+					Sqlt3::sqlite_static);
+				Sqlt3::sqlite3_step(fill.get());
+				Sqlt3::sqlite3_reset(fill.get());
+			}
+			fill.reset();
+			Sqlt3::sqlite3_exec(c, "COMMIT", nullptr, nullptr);
+
+			insert = prepare("INSERT INTO sink VALUES(?1)");
+			selectInteger = prepare("SELECT i FROM t");
+			selectText = prepare("SELECT txt FROM t");
+			selectBlob = prepare("SELECT b FROM t");
+		}
+
+		Sqlt3::unique_statement prepare(Sqlt3::utf8_string_in_t sql)
+		{
+			return std::move(std::get<0>(
+				Sqlt3::sqlite3_prepare_v2(connection.get(), sql)));
+		}
+	};
+
+	std::vector<benchmark_case> make_cases(fixture& f)
+	{
+		static const char select_sql[] =
+			"SELECT i, txt, b FROM t WHERE id = ?1";
+		static const char exec_sql[] = "SELECT id FROM t WHERE id <= 10";
+		auto c = f.connection.get();
+		auto insert = f.insert.get();
+		auto text = f.text.data();
+		auto textSize = static_cast<int>(f.text.size());
+		auto blob = f.blob.data();
+		auto blobSize = static_cast<int>(f.blob.size());
+		std::vector<benchmark_case> cases;
+
+		cases.push_back({"prepare_v2", 1, {
+			{"raw", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					sqlite3_stmt* s = nullptr;
+					::sqlite3_prepare_v2(c, select_sql, -1, &s, nullptr);
+					keep(s);
+					::sqlite3_finalize(s);
+				}
+			}},
+			{"wrapped", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					auto s = Sqlt3::sqlite3_prepare_v2(c, select_sql);
+					keep(s);
+				}
+			}},
+			{"wrapped_nothrow", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					auto s = Sqlt3::sqlite3_prepare_v2(c, select_sql,
+													   std::nothrow);
+					keep(s);
+				}
+			}}}});
+
+		cases.push_back({"bind_int", 1, {
+			{"raw", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					::sqlite3_bind_int(insert, 1, static_cast<int>(i));
+				}
+			}},
+			{"wrapped", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					Sqlt3::sqlite3_bind(insert, 1, static_cast<int>(i));
+				}
+			}}}});
+
+		cases.push_back({"bind_int64", 1, {
+			{"raw", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					::sqlite3_bind_int64(insert, 1,
+										 static_cast<sqlite3_int64>(i) << 33);
+				}
+			}},
+			{"wrapped", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					Sqlt3::sqlite3_bind(
+						insert, 1,
+						static_cast<Sqlt3::sqlite3_int64_t>(i) << 33);
+				}
+			}}}});
+
+		cases.push_back({"bind_text", 1, {
+			{"raw", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					::sqlite3_bind_text(insert, 1, text, textSize,
+										SQLITE_STATIC);
+				}
+			}},
+			{"wrapped", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					Sqlt3::sqlite3_bind_text(
+						insert, 1,
+						Sqlt3::utf8_string_view_t(
+							text, static_cast<std::size_t>(textSize)),
+						Sqlt3::sqlite_static);
+				}
+			}}}});
+
+		cases.push_back({"bind_blob", 1, {
+			{"raw", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					::sqlite3_bind_blob(insert, 1, blob, blobSize,
+										SQLITE_STATIC);
+				}
+			}},
+			{"wrapped", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					Sqlt3::sqlite3_bind(
+						insert, 1,
+						Sqlt3::blob_view_t(
+							blob, static_cast<std::size_t>(blobSize)),
+						Sqlt3::sqlite_static);
+				}
+			}}}});
+
+		// Each iteration steps through every row of the table.
+		auto integers = f.selectInteger.get();
+		cases.push_back({"step", table_rows, {
+			{"raw", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					::sqlite3_reset(integers);
+					while(::sqlite3_step(integers) == SQLITE_ROW) {
+					}
+				}
+			}},
+			{"wrapped", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					Sqlt3::sqlite3_reset(integers);
+					while(Sqlt3::sqlite3_step(integers) == Sqlt3::sqlite_row) {
+					}
+				}
+			}},
+			{"wrapped_nothrow", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					Sqlt3::sqlite3_reset(integers, std::nothrow);
+					while(*Sqlt3::sqlite3_step(integers, std::nothrow) ==
+						  Sqlt3::sqlite_row) {
+					}
+				}
+			}}}});
+
+		// The text and blob cases read one column of every row; the cost
+		// of stepping is included and matches that of the step case.
+		auto texts = f.selectText.get();
+		cases.push_back({"column_text", table_rows, {
+			{"raw", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					::sqlite3_reset(texts);
+					while(::sqlite3_step(texts) == SQLITE_ROW) {
+						auto t = ::sqlite3_column_text(texts, 0);
+						auto b = ::sqlite3_column_bytes(texts, 0);
+						keep(t);
+						keep(b);
+					}
+				}
+			}},
+			{"wrapped", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					Sqlt3::sqlite3_reset(texts);
+					while(Sqlt3::sqlite3_step(texts) == Sqlt3::sqlite_row) {
+						auto t = Sqlt3::sqlite3_column_text_view(texts, 0);
+						keep(t);
+					}
+				}
+			}},
+			{"wrapped_string", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					Sqlt3::sqlite3_reset(texts);
+					while(Sqlt3::sqlite3_step(texts) == Sqlt3::sqlite_row) {
+						auto t = Sqlt3::sqlite3_column_text(texts, 0);
+						keep(t);
+					}
+				}
+			}}}});
+
+		auto blobs = f.selectBlob.get();
+		cases.push_back({"column_blob", table_rows, {
+			{"raw", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					::sqlite3_reset(blobs);
+					while(::sqlite3_step(blobs) == SQLITE_ROW) {
+						auto p = ::sqlite3_column_blob(blobs, 0);
+						auto b = ::sqlite3_column_bytes(blobs, 0);
+						keep(p);
+						keep(b);
+					}
+				}
+			}},
+			{"wrapped", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					Sqlt3::sqlite3_reset(blobs);
+					while(Sqlt3::sqlite3_step(blobs) == Sqlt3::sqlite_row) {
+						auto p = Sqlt3::sqlite3_column_blob(blobs, 0);
+						auto b = Sqlt3::sqlite3_column_bytes(blobs, 0);
+						keep(p);
+						keep(b);
+					}
+				}
+			}},
+			{"wrapped_view", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					Sqlt3::sqlite3_reset(blobs);
+					while(Sqlt3::sqlite3_step(blobs) == Sqlt3::sqlite_row) {
+						auto v = Sqlt3::sqlite3_column_blob_view(blobs, 0);
+						keep(v);
+					}
+				}
+			}}}});
+
+		cases.push_back({"exec", 1, {
+			{"raw", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					int rows = 0;
+					::sqlite3_exec(c, exec_sql, &count_rows, &rows, nullptr);
+					keep(rows);
+				}
+			}},
+			{"wrapped", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					int rows = 0;
+					Sqlt3::sqlite3_exec(c, exec_sql, &count_rows, &rows);
+					keep(rows);
+				}
+			}}}});
+
+		// Copies the whole database, a step of a few pages at a time.
+		auto target = f.backupTarget.get();
+		cases.push_back({"backup_step", 1, {
+			{"raw", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					auto b = ::sqlite3_backup_init(target, "main", c, "main");
+					while(::sqlite3_backup_step(b, 16) == SQLITE_OK) {
+					}
+					::sqlite3_backup_finish(b);
+				}
+			}},
+			{"wrapped", [=](std::size_t n) {
+				for(std::size_t i = 0; i < n; ++i) {
+					auto b =
+						Sqlt3::sqlite3_backup_init(target, "main", c, "main");
+					while(Sqlt3::sqlite3_backup_step(b.get(), 16) ==
+						  Sqlt3::sqlite_ok) {
+					}
+					Sqlt3::sqlite3_backup_finish(std::move(b));
+				}
+			}}}});
+
+		return cases;
+	}
+
+	void print_json(const std::vector<result>& results)
+	{
+		std::printf("{\n  \"sqlite_version\": \"%s\",\n  \"results\": [",
+					::sqlite3_libversion());
+		for(std::size_t i = 0; i < results.size(); ++i) {
+			auto& r = results[i];
+			std::printf("%s\n    {\"case\": \"%s\", \"database\": \"%s\", "
+						"\"implementation\": \"%s\", \"iterations\": %zu, "
+						"\"median_ns\": %.3f, \"min_ns\": %.3f, "
+						"\"max_ns\": %.3f, \"ratio_to_raw\": %.4f}",
+						i == 0 ? "" : ",", r.caseName.c_str(),
+						r.database.c_str(), r.implementation.c_str(),
+						r.iterations, r.medianNs, r.minNs, r.maxNs, r.ratio);
+		}
+		std::printf("\n  ]\n}\n");
+	}
+	void print_csv(const std::vector<result>& results)
+	{
+		std::printf("case,database,implementation,iterations,median_ns,"
+					"min_ns,max_ns,ratio_to_raw\n");
+		for(auto& r : results) {
+			std::printf("%s,%s,%s,%zu,%.3f,%.3f,%.3f,%.4f\n",
+						r.caseName.c_str(), r.database.c_str(),
+						r.implementation.c_str(), r.iterations, r.medianNs,
+						r.minNs, r.maxNs, r.ratio);
+		}
+	}
+
+	bool parse(int argc, char** argv, options& o)
+	{
+		for(int i = 1; i < argc; ++i) {
+			std::string a = argv[i];
+			if(i + 1 >= argc) return false;
+			std::string v = argv[++i];
+			if(a == "--format") {
+				if(v != "json" && v != "csv") return false;
+				o.csv = v == "csv";
+			}
+			else if(a == "--repetitions") {
+				o.repetitions = std::max(1, std::atoi(v.c_str()));
+			}
+			else if(a == "--min-time") {
+				o.minTimeMs = std::atof(v.c_str());
+			}
+			else if(a == "--filter") {
+				o.filter = v;
+			}
+			else if(a == "--dir") {
+				o.dir = v;
+			}
+			else if(a == "--max-overhead") {
+				o.maxOverhead = std::atof(v.c_str());
+			}
+			else {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	options o;
+	if(!parse(argc, argv, o)) {
+		std::fprintf(stderr,
+					 "usage: %s [--format json|csv] [--repetitions N] "
+					 "[--min-time MS] [--filter TEXT] [--dir PATH] "
+					 "[--max-overhead RATIO]\n",
+					 argv[0]);
+		return 2;
+	}
+
+	auto diskPath = o.dir + "/SQLiteWrappedBenchmark.db";
+	std::vector<result> results;
+	auto exitCode = 0;
+	try {
+		const std::pair<const char*, std::string> databases[] = {
+			{"memory", ":memory:"}, {"disk", diskPath}};
+		for(auto& d : databases) {
+			fixture f(d.second);
+			for(auto& c : make_cases(f)) {
+				if(c.name.find(o.filter) == std::string::npos) continue;
+				std::fprintf(stderr, "%s/%s\n", c.name.c_str(), d.first);
+				measure(c, d.first, o, results);
+			}
+		}
+	}
+	catch(const std::exception& e) {
+		std::fprintf(stderr, "error: %s\n", e.what());
+		exitCode = 1;
+	}
+	for(auto suffix : {"", "-wal", "-shm"}) {
+		std::remove((diskPath + suffix).c_str());
+	}
+
+	if(o.csv) print_csv(results);
+	else print_json(results);
+
+	for(auto& r : results) {
+		std::fprintf(stderr, "%-12s %-7s %-16s %10.2f ns  x%.3f\n",
+					 r.caseName.c_str(), r.database.c_str(),
+					 r.implementation.c_str(), r.medianNs, r.ratio);
+		if(o.maxOverhead > 0 && r.implementation == "wrapped" &&
+		   r.ratio > o.maxOverhead) {
+			exitCode = 1;
+		}
+	}
+	return exitCode;
+}
@@ -0,0 +1,385 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Execution of statements on a thread dedicated to a connection, with
+	C++20 awaitables that suspend a coroutine until the work is done instead
+	of blocking the thread it runs on.
+*/
+
+#if !defined(SQLITEASYNC_HPP)
+#include "SQLiteRows.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if __cplusplus >= 202002L
+#include <version>
+#endif// __cplusplus >= 202002L
+
+#if defined(__cpp_impl_coroutine) && defined(__cpp_lib_jthread)
+#define USE_COROUTINES
+#include <coroutine>
+#include <stop_token>
+#endif// defined(__cpp_impl_coroutine) && defined(__cpp_lib_jthread)
+
+namespace Sqlt3
+{
+	///<summary>
+	/// Configuration of a <see cref="connection_executor"/>.
+	///</summary>
+	struct connection_executor_options
+	{
+		///<summary>Most tasks that may be queued at once.</summary>
+		std::size_t capacity = 64;
+		///<summary>Invoked on the executor thread with the continuation of
+		/// each completed task, to run it elsewhere, such as on the thread of
+		/// an event loop. If empty, continuations run on the executor thread.
+		///</summary>
+		std::function<void(std::function<void()>)> dispatch;
+	};
+
+	///<summary>
+	/// Owns a connection and a thread that executes queued tasks with it, one
+	/// at a time, in the order they are posted.
+	///</summary>
+	///<remarks>The queue is bounded so that a stalled connection pushes back
+	/// on its callers rather than accumulating work. Tasks still queued on
+	/// destruction are executed before the thread exits.</remarks>
+	class connection_executor
+	{
+		unique_connection db;
+		connection_executor_options options;
+
+		std::mutex queueMutex;
+		std::condition_variable queued;
+		std::deque<std::function<void()>> tasks;
+		bool stopping = false;
+
+		std::thread worker;
+
+		void run() NOEXCEPT_SPEC;
+
+	public:
+		///<summary>
+		/// Starts the executor thread.
+		///</summary>
+		///<param name="connection">The connection to execute tasks with. It
+		/// is only used by the executor thread from then on.</param>
+		///<param name="options">Queue size and continuation dispatch.</param>
+		///<exception name="std::runtime_error"/>
+		explicit connection_executor(
+			unique_connection connection,
+			const connection_executor_options& options = {});
+		connection_executor(const connection_executor&) = delete;
+		connection_executor& operator=(const connection_executor&) = delete;
+		~connection_executor() NOEXCEPT_SPEC;
+
+		///<summary>The connection tasks are executed with.</summary>
+		sqlite3_t connection() const NOEXCEPT_SPEC;
+
+		///<summary>
+		/// Queues a task, unless the queue is full.
+		///</summary>
+		///<param name="task">Function to execute on the executor thread.
+		/// Must not throw.</param>
+		///<returns>Whether the task was queued.</returns>
+		bool try_post(std::function<void()> task);
+		///<summary>
+		/// Queues a task.
+		///</summary>
+		///<param name="task">Function to execute on the executor thread.
+		/// Must not throw.</param>
+		///<exception name="std::runtime_error">The queue is full, reported
+		/// as <see cref="SQLITE_BUSY"/>.</exception>
+		void post(std::function<void()> task);
+		///<summary>
+		/// Runs a continuation through the configured dispatch function, or
+		/// immediately if there is none.
+		///</summary>
+		void complete(std::function<void()> continuation) NOEXCEPT_SPEC;
+		///<summary>
+		/// Calls <see cref="sqlite3_interrupt"/> on the connection, aborting
+		/// the statement being executed, if any. May be called from any
+		/// thread.
+		///</summary>
+		void interrupt() NOEXCEPT_SPEC;
+	};
+
+#if defined(USE_COROUTINES)
+	namespace detail
+	{
+		///<summary>
+		/// Common implementation of the awaitables of a
+		///<see cref="connection_executor"/>. <typeparamref name="Derived"/>
+		/// provides <c>void run(sqlite3_t)</c>, which is executed on the
+		/// executor thread and stores its outcome in <c>result</c>.
+		///</summary>
+		template <typename Derived, typename Result>
+		class async_operation
+		{
+			connection_executor* executor;
+			std::stop_token token;
+			std::exception_ptr error;
+
+		protected:
+			Result result{};
+
+			void rethrow_error() const
+			{
+				if(error) std::rethrow_exception(error);
+			}
+
+		public:
+			async_operation(connection_executor& executor,
+							std::stop_token token) NOEXCEPT_SPEC
+				: executor(&executor),
+				  token(std::move(token))
+			{
+			}
+
+			bool await_ready() const NOEXCEPT_SPEC
+			{
+				return false;
+			}
+			void await_suspend(std::coroutine_handle<> caller)
+			{
+				executor->post([this, caller] {
+					auto db = executor->connection();
+					try {
+						if(token.stop_requested()) {
+							throw_result_error(SQLITE_INTERRUPT, nullptr);
+						}
+						// Stopping while the work runs aborts it.
+						std::stop_callback interrupt(
+							token, [db] { ::sqlite3_interrupt(db); });
+						static_cast<Derived*>(this)->run(db);
+					}
+					catch(...) {
+						error = std::current_exception();
+					}
+					executor->complete([caller] { caller.resume(); });
+				});
+			}
+			Result await_resume()
+			{
+				rethrow_error();
+				return std::move(result);
+			}
+		};
+
+		class step_operation
+			: public async_operation<step_operation, step_result_t>
+		{
+			sqlite3_stmt_t stmt;
+
+		public:
+			step_operation(connection_executor& executor, sqlite3_stmt_t stmt,
+						   std::stop_token token) NOEXCEPT_SPEC
+				: async_operation(executor, std::move(token)),
+				  stmt(stmt)
+			{
+			}
+
+			void run(sqlite3_t)
+			{
+				result = Sqlt3::sqlite3_step(stmt);
+			}
+		};
+
+		template <typename... Ts>
+		class fetch_operation
+			: public async_operation<fetch_operation<Ts...>,
+									 std::vector<std::tuple<Ts...>>>
+		{
+			sqlite3_stmt_t stmt;
+			std::size_t count;
+
+		public:
+			fetch_operation(connection_executor& executor,
+							sqlite3_stmt_t stmt, std::size_t count,
+							std::stop_token token) NOEXCEPT_SPEC
+				: fetch_operation::async_operation(executor, std::move(token)),
+				  stmt(stmt),
+				  count(count)
+			{
+			}
+
+			void run(sqlite3_t)
+			{
+				ALIAS_TYPE(WRAP_TEMPLATE(typename detail::make_index_sequence<
+											 sizeof...(Ts)>::type),
+						   indices);
+				this->result.reserve(count);
+				while(this->result.size() < count &&
+					  Sqlt3::sqlite3_step(stmt) == sqlite_row) {
+					this->result.push_back(
+						read_row<std::tuple<Ts...>, Ts...>(stmt, indices()));
+				}
+			}
+		};
+
+		class exec_operation : public async_operation<exec_operation, int>
+		{
+			utf8_string_in_t sql;
+
+		public:
+			exec_operation(connection_executor& executor, utf8_string_in_t sql,
+						   std::stop_token token) NOEXCEPT_SPEC
+				: async_operation(executor, std::move(token)),
+				  sql(sql)
+			{
+			}
+
+			void run(sqlite3_t db)
+			{
+				Sqlt3::sqlite3_exec(db, sql, nullptr, nullptr);
+			}
+			void await_resume()
+			{
+				rethrow_error();
+			}
+		};
+
+		class backup_step_operation
+			: public async_operation<backup_step_operation, step_result_t>
+		{
+			sqlite3_backup_t backup;
+			int pages;
+
+		public:
+			backup_step_operation(connection_executor& executor,
+								  sqlite3_backup_t backup, int pages,
+								  std::stop_token token) NOEXCEPT_SPEC
+				: async_operation(executor, std::move(token)),
+				  backup(backup),
+				  pages(pages)
+			{
+			}
+
+			void run(sqlite3_t)
+			{
+				result = Sqlt3::sqlite3_backup_step(backup, pages);
+			}
+		};
+	}
+
+	///<summary>
+	/// Steps a prepared statement on the executor thread.
+	///</summary>
+	///<param name="executor">Executor owning the connection the statement
+	/// was prepared on.</param>
+	///<param name="stmt">Prepared statement.</param>
+	///<param name="token">Requesting a stop interrupts the statement.
+	///</param>
+	///<returns>An awaitable resulting in <see cref="sqlite_row"/> or
+	///<see cref="sqlite_done"/>. Errors, including a full queue and
+	/// interruption, are thrown from <c>co_await</c>.</returns>
+	///<remarks>The awaitable must be awaited immediately. The statement must
+	/// not be used by another thread until the coroutine resumes.</remarks>
+	inline detail::step_operation async_step(connection_executor& executor,
+											 sqlite3_stmt_t stmt,
+											 std::stop_token token = {})
+	{
+		return {executor, stmt, std::move(token)};
+	}
+
+	///<summary>
+	/// Steps a prepared statement on the executor thread until up to
+	///<paramref name="count"/> rows have been read into tuples of
+	///<typeparamref name="Ts"/>.
+	///</summary>
+	///<param name="executor">Executor owning the connection the statement
+	/// was prepared on.</param>
+	///<param name="stmt">Prepared statement.</param>
+	///<param name="count">Most rows to read.</param>
+	///<param name="token">Requesting a stop interrupts the statement.
+	///</param>
+	///<returns>An awaitable resulting in the rows read. Fewer than
+	///<paramref name="count"/> rows means the statement is done.</returns>
+	///<remarks>Only owning types may be read; views do not survive the next
+	/// step.</remarks>
+	///<example><code>
+	/// for(;;) {
+	///     auto batch = co_await Sqlt3::async_fetch&lt;sqlite3_int64_t&gt;(
+	///         executor, stmt, 256);
+	///     consume(batch);
+	///     if(batch.size() &lt; 256) break;
+	/// }
+	///</code></example>
+	template <typename... Ts>
+	detail::fetch_operation<Ts...> async_fetch(connection_executor& executor,
+											   sqlite3_stmt_t stmt,
+											   std::size_t count,
+											   std::stop_token token = {})
+	{
+		return {executor, stmt, count, std::move(token)};
+	}
+
+	///<summary>
+	/// Executes SQL with <see cref="sqlite3_exec"/> on the executor thread.
+	///</summary>
+	///<param name="executor">Executor owning the connection.</param>
+	///<param name="sql">SQL statement(s). Must remain valid until the
+	/// coroutine resumes.</param>
+	///<param name="token">Requesting a stop interrupts the statement.
+	///</param>
+	///<returns>An awaitable that throws any error from
+	///<c>co_await</c>.</returns>
+	inline detail::exec_operation async_exec(connection_executor& executor,
+											 utf8_string_in_t sql,
+											 std::stop_token token = {})
+	{
+		return {executor, sql, std::move(token)};
+	}
+
+	///<summary>
+	/// Copies up to <paramref name="pages"/> pages of a backup process on the
+	/// executor thread.
+	///</summary>
+	///<param name="executor">Executor owning the destination connection of
+	/// the backup process.</param>
+	///<param name="backup">Backup process.</param>
+	///<param name="pages">Number of pages to copy. If negative, all
+	/// remaining pages are copied.</param>
+	///<param name="token">Requesting a stop before the step begins cancels
+	/// it.</param>
+	///<returns>An awaitable resulting in <see cref="sqlite_ok"/> or
+	///<see cref="sqlite_done"/>.</returns>
+	inline detail::backup_step_operation async_backup_step(
+		connection_executor& executor, sqlite3_backup_t backup, int pages,
+		std::stop_token token = {})
+	{
+		return {executor, backup, pages, std::move(token)};
+	}
+#endif// defined(USE_COROUTINES)
+}
+
+#define SQLITEASYNC_HPP
+#endif// SQLITEASYNC_HPP
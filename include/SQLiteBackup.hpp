@@ -0,0 +1,186 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Online backup of a live database on a background thread, copying pages
+	in batches sized to keep each step short and backing off while other
+	connections are writing.
+*/
+
+#if !defined(SQLITEBACKUP_HPP)
+#include "SQLiteWrapped.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace Sqlt3
+{
+	///<summary>
+	/// The state of a <see cref="backup_scheduler"/>.
+	///</summary>
+	struct backup_progress
+	{
+		///<summary>Pages in the source database, as of the last step.
+		///</summary>
+		int pageCount = 0;
+		///<summary>Pages still to be copied, as of the last step.</summary>
+		int remaining = 0;
+		///<summary>Pages copied so far.</summary>
+		unsigned long long pagesCopied = 0;
+		///<summary>Pages that will be copied by the next step.</summary>
+		int batchPages = 0;
+		///<summary>Steps that failed with <see cref="SQLITE_BUSY"/> or
+		///<see cref="SQLITE_LOCKED"/> and were retried.</summary>
+		unsigned long long retries = 0;
+		///<summary>Times the backup backed off because another connection
+		/// had written to the source database.</summary>
+		unsigned long long yields = 0;
+		///<summary>Time since the backup started.</summary>
+		std::chrono::milliseconds elapsed{0};
+		///<summary>Whether the backup has finished, successfully or not.
+		///</summary>
+		bool finished = false;
+
+		///<summary>Average pages copied per second.</summary>
+		double pages_per_second() const NOEXCEPT_SPEC;
+	};
+
+	///<summary>
+	/// Configuration of a <see cref="backup_scheduler"/>.
+	///</summary>
+	struct backup_options
+	{
+		///<summary>Pages copied by the first step.</summary>
+		int initialPages = 64;
+		///<summary>Fewest pages copied by a step.</summary>
+		int minPages = 8;
+		///<summary>Most pages copied by a step.</summary>
+		int maxPages = 4096;
+		///<summary>Duration each step should take. The number of pages per
+		/// step grows while steps are faster than this and shrinks while they
+		/// are slower.</summary>
+		std::chrono::microseconds targetStepTime{2000};
+		///<summary>Time between steps, during which the source database is
+		/// not locked by the backup.</summary>
+		std::chrono::milliseconds pause{5};
+		///<summary>Time to wait after a busy or locked step, or after
+		/// another connection has written to the source database.</summary>
+		std::chrono::milliseconds backoff{50};
+		///<summary>Most share of the elapsed time, between 0 and 1, spent
+		/// backing off because other connections are writing, so that a
+		/// continuously written database is still backed up.</summary>
+		double maxYieldShare = 0.5;
+		///<summary>Whether to hold a read transaction on the source database
+		/// for the duration of the backup, when it is in WAL mode. The backup
+		/// is then a consistent snapshot that is not restarted by concurrent
+		/// writes, but the WAL cannot be checkpointed past the snapshot until
+		/// the backup finishes.</summary>
+		bool holdSnapshot = true;
+		///<summary>Invoked on the backup thread after every step. Must not
+		/// throw.</summary>
+		std::function<void(const backup_progress&)> progress;
+	};
+
+	///<summary>
+	/// Copies a database to another file on a background thread with
+	///<see cref="sqlite3_backup_step"/>, in batches that adapt to the time
+	/// each step takes.
+	///</summary>
+	///<remarks>Between steps, <c>PRAGMA data_version</c> is polled on a
+	/// separate connection to the source; when it changes, other connections
+	/// are writing and the backup halves its batch and waits before the next
+	/// step, within <see cref="backup_options::maxYieldShare"/>. Steps that
+	/// fail with <see cref="SQLITE_BUSY"/> or <see cref="SQLITE_LOCKED"/> are
+	/// retried. Without a held snapshot, which is only taken in WAL mode, the
+	/// library restarts the backup whenever another connection writes to the
+	/// source, so a source in rollback journal mode that is written
+	/// continuously may never finish.</remarks>
+	///<example><code>
+	/// Sqlt3::backup_scheduler backup("live.db", "nightly.db");
+	/// backup.wait();
+	///</code></example>
+	class backup_scheduler
+	{
+		ALIAS_TYPE(std::chrono::steady_clock, clock);
+
+		unique_connection source;
+		unique_connection monitor;
+		unique_connection destination;
+		backup_options options;
+
+		mutable std::mutex stateMutex;
+		std::condition_variable changed;
+		backup_progress state;
+		bool cancelled = false;
+		std::exception_ptr error;
+
+		std::thread worker;
+
+		void run() NOEXCEPT_SPEC;
+		void copy();
+		int data_version();
+		// Waits for the provided time, returning false if cancelled.
+		bool sleep(std::chrono::milliseconds time);
+		void publish(const backup_progress& progress);
+
+	public:
+		///<summary>
+		/// Opens the source and destination databases and starts the backup.
+		///</summary>
+		///<param name="source">Name of the database file to copy.</param>
+		///<param name="destination">Name of the file to copy to. Its
+		/// content is replaced.</param>
+		///<param name="options">Pacing of the backup.</param>
+		///<exception name="std::runtime_error"/>
+		backup_scheduler(utf8_string_in_t source,
+						 utf8_string_in_t destination,
+						 const backup_options& options = {});
+		backup_scheduler(const backup_scheduler&) = delete;
+		backup_scheduler& operator=(const backup_scheduler&) = delete;
+		///<summary>
+		/// Cancels the backup if it has not finished.
+		///</summary>
+		~backup_scheduler() NOEXCEPT_SPEC;
+
+		///<summary>
+		/// Stops the backup after the current step. The destination is left
+		/// incomplete.
+		///</summary>
+		void cancel() NOEXCEPT_SPEC;
+		///<summary>
+		/// Waits for the backup to finish.
+		///</summary>
+		///<exception name="std::runtime_error">The backup failed.
+		///</exception>
+		void wait();
+		///<summary>Retrieves the current state of the backup.</summary>
+		backup_progress progress() const;
+	};
+}
+
+#define SQLITEBACKUP_HPP
+#endif// SQLITEBACKUP_HPP
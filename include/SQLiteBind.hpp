@@ -0,0 +1,388 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Binding of whole parameter packs to a prepared statement in one call.
+	The sqlite3_bind_* function used for each argument is chosen at compile
+	time and errors are checked once, after all arguments are bound.
+*/
+
+#if !defined(SQLITEBIND_HPP)
+#include "SQLiteWrapped.hpp"
+#include <cstddef>
+#include <initializer_list>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace Sqlt3
+{
+	namespace detail
+	{
+		///<summary>
+		/// Maps a C++ type onto the sqlite3_bind_* function that binds it.
+		/// Specialise to bind additional types. <c>bind</c> returns the result
+		/// code of the library call.
+		///</summary>
+		template <typename T, typename Enable = void>
+		struct bind_traits;
+
+		///<summary>
+		/// Whether <typeparamref name="T"/> is a character type, which is
+		/// integral but holds text. <c>signed char</c> and
+		///<c>unsigned char</c>, as used by <c>std::int8_t</c> and
+		///<c>std::uint8_t</c>, are numbers.
+		///</summary>
+		template <typename T>
+		struct is_character
+			: std::integral_constant<bool,
+									 std::is_same<T, char>::value ||
+										 std::is_same<T, wchar_t>::value ||
+										 std::is_same<T, char16_t>::value ||
+										 std::is_same<T, char32_t>::value
+#if defined(__cpp_char8_t)
+										 || std::is_same<T, char8_t>::value
+#endif// defined(__cpp_char8_t)
+									 >
+		{
+		};
+
+		// A single character is ambiguous: it could be meant as text or as
+		// its code. Bind a string or cast to an integer instead.
+		template <typename T>
+		struct bind_traits<
+			T, typename std::enable_if<is_character<T>::value>::type>
+		{
+			static_assert(sizeof(T) == 0,
+						  "Characters are not bound; bind a string of one "
+						  "character or cast to an integer type.");
+		};
+
+		template <typename T>
+		struct bind_traits<
+			T, typename std::enable_if<std::is_integral<T>::value &&
+									   !is_character<T>::value &&
+									   (sizeof(T) < sizeof(int) ||
+										(sizeof(T) == sizeof(int) &&
+										 std::is_signed<T>::value))>::type>
+		{
+			static int bind(sqlite3_stmt_t s, int i, T v) NOEXCEPT_SPEC
+			{
+				return ::sqlite3_bind_int(s, i, static_cast<int>(v));
+			}
+		};
+		template <typename T>
+		struct bind_traits<
+			T, typename std::enable_if<std::is_integral<T>::value &&
+									   !is_character<T>::value &&
+									   (sizeof(T) > sizeof(int) ||
+										(sizeof(T) == sizeof(int) &&
+										 std::is_unsigned<T>::value))>::type>
+		{
+			// Unsigned values above the largest 64-bit signed integer have
+			// no INTEGER representation and are rejected with
+			// SQLITE_MISMATCH rather than wrapped to negative values.
+			static int bind(sqlite3_stmt_t s, int i, T v) NOEXCEPT_SPEC
+			{
+				if(std::is_unsigned<T>::value &&
+				   sizeof(T) >= sizeof(sqlite3_int64_t) &&
+				   static_cast<unsigned long long>(v) >
+					   static_cast<unsigned long long>(
+						   std::numeric_limits<sqlite3_int64_t>::max())) {
+					return SQLITE_MISMATCH;
+				}
+				return ::sqlite3_bind_int64(s, i,
+											static_cast<sqlite3_int64_t>(v));
+			}
+		};
+		template <typename T>
+		struct bind_traits<
+			T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+		{
+			static int bind(sqlite3_stmt_t s, int i, T v) NOEXCEPT_SPEC
+			{
+				return ::sqlite3_bind_double(s, i, static_cast<double>(v));
+			}
+		};
+		template <>
+		struct bind_traits<std::nullptr_t>
+		{
+			static int bind(sqlite3_stmt_t s, int i,
+							std::nullptr_t) NOEXCEPT_SPEC
+			{
+				return ::sqlite3_bind_null(s, i);
+			}
+		};
+		template <>
+		struct bind_traits<sqlite3_value_t>
+		{
+			static int bind(sqlite3_stmt_t s, int i,
+							sqlite3_value_t v) NOEXCEPT_SPEC
+			{
+				return ::sqlite3_bind_value(s, i, v);
+			}
+		};
+		// Owning strings and C strings are copied by SQLite; views are bound
+		// without a copy.
+		template <>
+		struct bind_traits<const char*>
+		{
+			static int bind(sqlite3_stmt_t s, int i,
+							const char* v) NOEXCEPT_SPEC
+			{
+				return ::sqlite3_bind_text(s, i, v, -1, sqlite_transient);
+			}
+		};
+		template <>
+		struct bind_traits<char*> : bind_traits<const char*>
+		{
+		};
+		template <>
+		struct bind_traits<utf8_string_out_t>
+		{
+			static int bind(sqlite3_stmt_t s, int i,
+							const utf8_string_out_t& v) NOEXCEPT_SPEC
+			{
+				return ::sqlite3_bind_text64(
+					s, i, v.data(), static_cast<sqlite3_uint64_t>(v.size()),
+					sqlite_transient, SQLITE_UTF8);
+			}
+		};
+		template <>
+		struct bind_traits<utf16_string_out_t>
+		{
+			static int bind(sqlite3_stmt_t s, int i,
+							const utf16_string_out_t& v) NOEXCEPT_SPEC
+			{
+				return ::sqlite3_bind_text64(
+					s, i, reinterpret_cast<const char*>(v.data()),
+					static_cast<sqlite3_uint64_t>(v.size() * sizeof(char16_t)),
+					sqlite_transient, SQLITE_UTF16);
+			}
+		};
+		template <>
+		struct bind_traits<utf8_string_view_t>
+		{
+			static int bind(sqlite3_stmt_t s, int i,
+							utf8_string_view_t v) NOEXCEPT_SPEC
+			{
+				return ::sqlite3_bind_text64(
+					s, i,
+					static_cast<const char*>(bind_data(v.data(), v.size())),
+					static_cast<sqlite3_uint64_t>(v.size()), sqlite_static,
+					SQLITE_UTF8);
+			}
+		};
+		template <>
+		struct bind_traits<utf16_string_view_t>
+		{
+			static int bind(sqlite3_stmt_t s, int i,
+							utf16_string_view_t v) NOEXCEPT_SPEC
+			{
+				return ::sqlite3_bind_text64(
+					s, i,
+					static_cast<const char*>(bind_data(v.data(), v.size())),
+					static_cast<sqlite3_uint64_t>(v.size() * sizeof(char16_t)),
+					sqlite_static, SQLITE_UTF16);
+			}
+		};
+#if defined(__cpp_lib_string_view)
+		template <typename Traits>
+		struct bind_traits<std::basic_string_view<char, Traits>>
+			: bind_traits<utf8_string_view_t>
+		{
+		};
+		template <typename Traits>
+		struct bind_traits<std::basic_string_view<char16_t, Traits>>
+			: bind_traits<utf16_string_view_t>
+		{
+		};
+#endif// defined(__cpp_lib_string_view)
+		template <>
+		struct bind_traits<blob_view_t>
+		{
+			static int bind(sqlite3_stmt_t s, int i,
+							blob_view_t v) NOEXCEPT_SPEC
+			{
+				return ::sqlite3_bind_blob64(
+					s, i, bind_data(v.data(), v.size()),
+					static_cast<sqlite3_uint64_t>(v.size()), sqlite_static);
+			}
+		};
+
+		inline int bind_pack(sqlite3_stmt_t, int) NOEXCEPT_SPEC
+		{
+			return SQLITE_OK;
+		}
+		///<summary>
+		/// Binds each argument to consecutive bind points, starting at
+		///<paramref name="index"/>. Stops at, and returns, the first failed
+		/// result code.
+		///</summary>
+		template <typename T, typename... Rest>
+		int bind_pack(sqlite3_stmt_t s, int index, const T& v,
+					  const Rest&... rest) NOEXCEPT_SPEC
+		{
+			ALIAS_TYPE(typename std::decay<T>::type, value_t);
+			auto code = bind_traits<value_t>::bind(s, index, v);
+			if(code != SQLITE_OK) return code;
+			return bind_pack(s, index + 1, rest...);
+		}
+
+		inline int bind_indexed(sqlite3_stmt_t, const int*) NOEXCEPT_SPEC
+		{
+			return SQLITE_OK;
+		}
+		///<summary>
+		/// Binds each argument to the bind point at the matching position in
+		///<paramref name="indices"/>. Stops at, and returns, the first failed
+		/// result code.
+		///</summary>
+		template <typename T, typename... Rest>
+		int bind_indexed(sqlite3_stmt_t s, const int* indices, const T& v,
+						 const Rest&... rest) NOEXCEPT_SPEC
+		{
+			ALIAS_TYPE(typename std::decay<T>::type, value_t);
+			auto code = bind_traits<value_t>::bind(s, *indices, v);
+			if(code != SQLITE_OK) return code;
+			return bind_indexed(s, indices + 1, rest...);
+		}
+
+		///<summary>
+		/// Throws if <paramref name="given"/> does not match
+		///<paramref name="expected"/>.
+		///</summary>
+		///<exception name="std::runtime_error"/>
+		void check_bind_count(std::size_t expected, std::size_t given);
+		///<summary>
+		/// Throws if <paramref name="given"/> does not match the number of
+		/// bind points in the prepared statement.
+		///</summary>
+		///<exception name="std::runtime_error"/>
+		void check_bind_count(sqlite3_stmt_t stmt, std::size_t given);
+		///<summary>
+		/// Throws if <paramref name="code"/> is a failed result code.
+		///</summary>
+		///<exception name="std::runtime_error"/>
+		void check_bind_result(sqlite3_stmt_t stmt, int code);
+
+		template <typename... Ts, std::size_t... I>
+		void bind_tuple(sqlite3_stmt_t s, const std::tuple<Ts...>& values,
+						index_sequence<I...>)
+		{
+			check_bind_result(s, bind_pack(s, 1, std::get<I>(values)...));
+		}
+	}
+
+	///<summary>
+	/// Binds each argument to the bind points 1 to N of a prepared statement,
+	/// where N is the number of arguments. The bind function for each
+	/// argument is chosen at compile time.
+	///</summary>
+	///<param name="stmt">Prepared statement.</param>
+	///<param name="args">Values to bind. Integral, floating point, null,
+	/// string, view and <see cref="sqlite3_value_t"/> arguments are
+	/// supported. Character types do not compile, and unsigned values above
+	/// the largest 64-bit signed integer are rejected with
+	///<see cref="SQLITE_MISMATCH"/>. Owning strings are copied; views are
+	/// bound without copying and must outlive the bindings.</param>
+	///<exception name="std::runtime_error"/>
+	///<remarks>The argument count is checked against
+	///<see cref="sqlite3_bind_parameter_count"/> before binding, and the result
+	/// codes are checked once after binding. To bind a struct, pass
+	///<c>std::tie</c> of its members.</remarks>
+	template <typename... Args>
+	void bind_all(sqlite3_stmt_t stmt, const Args&... args)
+	{
+		detail::check_bind_count(stmt, sizeof...(Args));
+		detail::check_bind_result(stmt, detail::bind_pack(stmt, 1, args...));
+	}
+	///<summary>
+	/// Binds each element of a tuple to the bind points 1 to N of a prepared
+	/// statement, where N is the size of the tuple.
+	///</summary>
+	///<param name="stmt">Prepared statement.</param>
+	///<param name="values">Values to bind.</param>
+	///<exception name="std::runtime_error"/>
+	template <typename... Ts>
+	void bind_all(sqlite3_stmt_t stmt, const std::tuple<Ts...>& values)
+	{
+		ALIAS_TYPE(WRAP_TEMPLATE(typename detail::make_index_sequence<
+								 sizeof...(Ts)>::type),
+				   indices);
+		detail::check_bind_count(stmt, sizeof...(Ts));
+		detail::bind_tuple(stmt, values, indices());
+	}
+
+	///<summary>
+	/// The bind point indices of a set of named parameters of a prepared
+	/// statement, resolved once with <see cref="sqlite3_bind_parameter_index"/>
+	/// and reused for every subsequent bind.
+	///</summary>
+	///<remarks>Must not outlive the prepared statement.</remarks>
+	class named_parameters
+	{
+		sqlite3_stmt_t stmt;
+		std::vector<int> indices;
+
+	public:
+		///<summary>
+		/// Resolves the index of each of the provided parameter names.
+		///</summary>
+		///<param name="stmt">Prepared statement.</param>
+		///<param name="names">Parameter names, including their prefix
+		/// character, such as ":id".</param>
+		///<exception name="std::runtime_error">A name does not match a
+		/// bind point in the prepared statement; the message names it.
+		///</exception>
+		named_parameters(sqlite3_stmt_t stmt,
+						 std::initializer_list<utf8_string_in_t> names);
+
+		///<summary>
+		/// Binds each argument to the parameter at the same position in the
+		/// list of names the object was constructed with.
+		///</summary>
+		///<param name="args">Values to bind; see <see cref="bind_all"/>.
+		///</param>
+		///<exception name="std::runtime_error"/>
+		template <typename... Args>
+		void bind(const Args&... args) const
+		{
+			detail::check_bind_count(indices.size(), sizeof...(Args));
+			detail::check_bind_result(
+				stmt, detail::bind_indexed(stmt, indices.data(), args...));
+		}
+
+		///<summary>Number of resolved parameters.</summary>
+		std::size_t size() const NOEXCEPT_SPEC;
+		///<summary>Bind point index of the parameter at the provided
+		/// position.</summary>
+		int index(std::size_t position) const NOEXCEPT_SPEC;
+	};
+}
+
+#define SQLITEBIND_HPP
+#endif// SQLITEBIND_HPP
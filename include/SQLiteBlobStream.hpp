@@ -0,0 +1,143 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Standard stream buffers over incremental blob I/O handles, so that blobs
+	too large to hold in memory can be read and written with the iostream
+	library a buffer at a time.
+*/
+
+#if !defined(SQLITEBLOBSTREAM_HPP)
+#include "SQLiteWrapped.hpp"
+#include <cstddef>
+#include <istream>
+#include <streambuf>
+#include <vector>
+
+namespace Sqlt3
+{
+	///<summary>
+	/// A stream buffer over a blob handle, reading and writing through a
+	/// fixed buffer. Reads and writes at least as large as the buffer go
+	/// directly between the caller and the blob.
+	///</summary>
+	///<remarks>
+	/// The size of the blob is fixed when the row is written, so writing
+	/// past the end fails; reserve the space first with
+	///<see cref="sqlite3_bind_zeroblob64"/>. Errors of SQLite, such as
+	///<c>SQLITE_ABORT</c> after the row was changed by another statement, are
+	/// thrown as <see cref="sqlite3_error"/>, which the standard streams turn
+	/// into <c>badbit</c> unless their exception mask includes it.
+	///</remarks>
+	class blob_streambuf : public std::streambuf
+	{
+		unique_blob handle;
+		std::vector<char> buffer;
+		// Offset in the blob of the start of the get or put area, or the
+		// position when neither is in use.
+		sqlite3_int64_t bufferOffset = 0;
+		int size = 0;
+
+		sqlite3_int64_t position() const NOEXCEPT_SPEC;
+		void flush();
+		void discard(sqlite3_int64_t offset) NOEXCEPT_SPEC;
+
+	protected:
+		int_type underflow() override;
+		int_type overflow(int_type c) override;
+		int sync() override;
+		std::streamsize showmanyc() override;
+		std::streamsize xsgetn(char_type* s, std::streamsize n) override;
+		std::streamsize xsputn(const char_type* s, std::streamsize n) override;
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+						 std::ios_base::openmode which) override;
+		pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+	public:
+		///<summary>
+		/// Takes ownership of a blob handle, positioned at its start.
+		///</summary>
+		///<param name="blob">Blob handle from
+		///<see cref="sqlite3_blob_open"/>.</param>
+		///<param name="bufferSize">Bytes buffered between calls to
+		/// SQLite.</param>
+		explicit blob_streambuf(unique_blob blob,
+								std::size_t bufferSize = 64 * 1024);
+		blob_streambuf(const blob_streambuf&) = delete;
+		blob_streambuf& operator=(const blob_streambuf&) = delete;
+		///<summary>Writes buffered bytes and closes the handle. Errors are
+		/// not thrown.</summary>
+		~blob_streambuf();
+
+		///<summary>
+		/// Writes buffered bytes and moves the handle to another row, with
+		/// the position at its start.
+		///</summary>
+		///<param name="row">Rowid of the row.</param>
+		///<exception name="std::runtime_error"/>
+		void reopen(sqlite3_int64_t row);
+		///<summary>
+		/// Writes buffered bytes and closes the handle, reporting errors
+		/// that the destructor would ignore.
+		///</summary>
+		///<exception name="std::runtime_error"/>
+		void close();
+		///<summary>Retrieves the blob handle, or nullptr once closed.
+		///</summary>
+		sqlite3_blob_t blob() const NOEXCEPT_SPEC;
+		///<summary>Size of the blob in bytes.</summary>
+		int bytes() const NOEXCEPT_SPEC;
+	};
+
+	///<summary>
+	/// An input and output stream over a blob handle.
+	///</summary>
+	///<example><code>
+	/// Sqlt3::blob_stream out(Sqlt3::sqlite3_blob_open(
+	///     db, "main", "files", "data", row, true));
+	/// out &lt;&lt; file.rdbuf();
+	/// out.flush();
+	///</code></example>
+	class blob_stream : public std::iostream
+	{
+		blob_streambuf buf;
+
+	public:
+		///<summary>
+		/// Takes ownership of a blob handle, positioned at its start.
+		///</summary>
+		///<param name="blob">Blob handle from
+		///<see cref="sqlite3_blob_open"/>.</param>
+		///<param name="bufferSize">Bytes buffered between calls to
+		/// SQLite.</param>
+		explicit blob_stream(unique_blob blob,
+							 std::size_t bufferSize = 64 * 1024);
+
+		///<summary>Retrieves the stream buffer.</summary>
+		blob_streambuf* rdbuf() NOEXCEPT_SPEC;
+	};
+}
+
+#define SQLITEBLOBSTREAM_HPP
+#endif// SQLITEBLOBSTREAM_HPP
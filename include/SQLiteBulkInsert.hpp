@@ -0,0 +1,376 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Bulk insertion of rows through reused prepared statements. Rows are
+	written in transactions of a configurable size and may be packed into
+	multi-row VALUES statements.
+*/
+
+#if !defined(SQLITEBULKINSERT_HPP)
+#include "SQLiteBind.hpp"
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace Sqlt3
+{
+	///<summary>
+	/// Controls how a <see cref="bulk_inserter"/> groups rows into statements
+	/// and transactions. A limit of zero is disabled. A transaction is
+	/// committed as soon as any enabled limit is reached.
+	///</summary>
+	struct bulk_insert_options
+	{
+		///<summary>Rows written per transaction.</summary>
+		std::size_t rowsPerTransaction = 10000;
+		///<summary>Approximate bytes of bound data written per transaction.
+		///</summary>
+		std::size_t bytesPerTransaction = 0;
+		///<summary>Time a transaction is kept open for.</summary>
+		std::chrono::milliseconds timePerTransaction{0};
+		///<summary>Rows packed into each INSERT statement, as a multi-row
+		/// VALUES list. Reduced to fit within
+		///<see cref="sqlite_limit_variable_number"/>.</summary>
+		std::size_t rowsPerStatement = 1;
+	};
+
+	namespace detail
+	{
+		inline std::size_t bound_size(std::nullptr_t) NOEXCEPT_SPEC
+		{
+			return 0;
+		}
+		inline std::size_t bound_size(const char* v) NOEXCEPT_SPEC
+		{
+			return v == nullptr ? 0 : std::char_traits<char>::length(v);
+		}
+		template <typename CharT, typename Traits, typename Alloc>
+		std::size_t bound_size(
+			const std::basic_string<CharT, Traits, Alloc>& v) NOEXCEPT_SPEC
+		{
+			return v.size() * sizeof(CharT);
+		}
+		template <typename CharT>
+		std::size_t bound_size(const text_view_t<CharT>& v) NOEXCEPT_SPEC
+		{
+			return v.size() * sizeof(CharT);
+		}
+		inline std::size_t bound_size(const blob_view_t& v) NOEXCEPT_SPEC
+		{
+			return v.size();
+		}
+		///<summary>
+		/// Approximate number of bytes a bound value contributes to a row.
+		///</summary>
+		template <typename T>
+		std::size_t bound_size(const T&) NOEXCEPT_SPEC
+		{
+			return sizeof(T);
+		}
+
+		inline std::size_t row_size() NOEXCEPT_SPEC
+		{
+			return 0;
+		}
+		template <typename T, typename... Rest>
+		std::size_t row_size(const T& v, const Rest&... rest) NOEXCEPT_SPEC
+		{
+			return bound_size(v) + row_size(rest...);
+		}
+
+		///<summary>
+		/// Storage for a value of a row that waits for a multi-row statement
+		/// to fill. Values are kept as they are; views and C strings are
+		/// copied so that the caller's buffers need not outlive
+		///<see cref="bulk_inserter::insert"/>.
+		///</summary>
+		template <typename T>
+		class pending_value
+		{
+			T value;
+
+		public:
+			explicit pending_value(const T& v) : value(v)
+			{
+			}
+			const T& get() const NOEXCEPT_SPEC
+			{
+				return value;
+			}
+		};
+		template <typename CharT>
+		class pending_value<text_view_t<CharT>>
+		{
+			std::basic_string<CharT> text;
+
+		public:
+			explicit pending_value(const text_view_t<CharT>& v)
+				: text(v.str())
+			{
+			}
+			text_view_t<CharT> get() const NOEXCEPT_SPEC
+			{
+				return text_view_t<CharT>(text.data(), text.size());
+			}
+		};
+		template <>
+		class pending_value<const char*>
+		{
+			std::string text;
+			bool null;
+
+		public:
+			explicit pending_value(const char* v)
+				: text(v == nullptr ? "" : v),
+				  null(v == nullptr)
+			{
+			}
+			const char* get() const NOEXCEPT_SPEC
+			{
+				return null ? nullptr : text.c_str();
+			}
+		};
+		template <>
+		class pending_value<char*> : public pending_value<const char*>
+		{
+		public:
+			explicit pending_value(const char* v)
+				: pending_value<const char*>(v)
+			{
+			}
+		};
+		template <>
+		class pending_value<blob_view_t>
+		{
+			std::vector<unsigned char> bytes;
+
+		public:
+			explicit pending_value(const blob_view_t& v)
+				: bytes(v.begin(), v.end())
+			{
+			}
+			blob_view_t get() const NOEXCEPT_SPEC
+			{
+				return blob_view_t(bytes.data(), bytes.size());
+			}
+		};
+
+		///<summary>
+		/// The parts of <see cref="bulk_inserter"/> that do not depend on the
+		/// types of the columns: statement preparation, transactions and
+		/// statistics.
+		///</summary>
+		class bulk_insert_base
+		{
+			ALIAS_TYPE(std::chrono::steady_clock, clock);
+
+			sqlite3_t connection;
+			std::string table;
+			std::vector<std::string> columns;
+			bulk_insert_options options;
+			std::size_t batchRows = 1;
+			// Statements indexed by the number of rows they insert.
+			std::vector<unique_statement> statements;
+
+			bool inTransaction = false;
+			std::size_t transactionRows = 0;
+			std::size_t transactionBytes = 0;
+			clock::time_point transactionStart;
+			clock::time_point firstRow;
+			bool started = false;
+			unsigned long long rowCount = 0;
+			unsigned long long commitCount = 0;
+			clock::duration writeTime = clock::duration::zero();
+
+		protected:
+			bulk_insert_base(sqlite3_t connection, utf8_string_in_t table,
+							 std::vector<std::string> columns,
+							 const bulk_insert_options& options,
+							 std::size_t columnCount);
+			~bulk_insert_base() NOEXCEPT_SPEC;
+
+			std::size_t rows_per_statement() const NOEXCEPT_SPEC;
+			std::size_t column_count() const NOEXCEPT_SPEC;
+			///<summary>Whether bytes are counted towards a transaction limit.
+			///</summary>
+			bool counts_bytes() const NOEXCEPT_SPEC;
+			///<summary>
+			/// Retrieves the reset statement that inserts the provided number
+			/// of rows, beginning a transaction if none is open.
+			///</summary>
+			sqlite3_stmt_t statement(std::size_t rows);
+			///<summary>
+			/// Steps the statement returned by <see cref="statement"/> after
+			/// its bind points have been bound and commits if a limit is
+			/// reached.
+			///</summary>
+			void execute(sqlite3_stmt_t stmt, int bindResult, std::size_t rows,
+						 std::size_t bytes);
+			void commit_transaction();
+
+		public:
+			bulk_insert_base(const bulk_insert_base&) = delete;
+			bulk_insert_base& operator=(const bulk_insert_base&) = delete;
+
+			///<summary>Total rows written to the database.</summary>
+			unsigned long long rows() const NOEXCEPT_SPEC;
+			///<summary>Number of transactions committed.</summary>
+			unsigned long long transactions() const NOEXCEPT_SPEC;
+			///<summary>Seconds since the first row was written.</summary>
+			double seconds() const NOEXCEPT_SPEC;
+			///<summary>Average throughput since the first row was written.
+			///</summary>
+			double rows_per_second() const NOEXCEPT_SPEC;
+		};
+	}
+
+	///<summary>
+	/// Inserts rows of the types <typeparamref name="Ts"/> into the columns
+	/// of a table. Rows are written through reused prepared statements inside
+	/// transactions that are committed according to the
+	///<see cref="bulk_insert_options"/>.
+	///</summary>
+	///<remarks>Call <see cref="commit"/> once all rows have been inserted; on
+	/// destruction any open transaction is rolled back. When more than one row
+	/// is packed per statement, pending rows are copied, including the text
+	/// and bytes of views and C strings, until the statement is full. The
+	/// table and column names are used in the SQL text as given.
+	///</remarks>
+	///<example><code>
+	/// Sqlt3::bulk_inserter&lt;sqlite3_int64_t, std::string&gt; ins(
+	///     db, "t", {"id", "name"}, options);
+	/// for(auto&amp; r : input) ins.insert(r.id, r.name);
+	/// ins.commit();
+	///</code></example>
+	template <typename... Ts>
+	class bulk_inserter : public detail::bulk_insert_base
+	{
+		ALIAS_TYPE(std::tuple<Ts...>, row_t);
+		ALIAS_TYPE(std::tuple<detail::pending_value<Ts>...>, pending_row_t);
+		ALIAS_TYPE(WRAP_TEMPLATE(typename detail::make_index_sequence<
+								 sizeof...(Ts)>::type),
+				   indices);
+
+		std::vector<pending_row_t> pending;
+		std::size_t pendingBytes = 0;
+
+		template <std::size_t... I>
+		static int bind_row(sqlite3_stmt_t s, int first,
+							const pending_row_t& row,
+							detail::index_sequence<I...>) NOEXCEPT_SPEC
+		{
+			return detail::bind_pack(s, first, std::get<I>(row).get()...);
+		}
+		template <std::size_t... I>
+		void insert_row(const row_t& row, detail::index_sequence<I...>)
+		{
+			insert(std::get<I>(row)...);
+		}
+
+		void write_pending()
+		{
+			auto s = statement(pending.size());
+			auto code = SQLITE_OK;
+			auto first = 1;
+			for(auto& row : pending) {
+				code = bind_row(s, first, row, indices());
+				if(code != SQLITE_OK) break;
+				first += static_cast<int>(sizeof...(Ts));
+			}
+			// The copies are bound without a further copy, so they are kept
+			// until the statement has been stepped.
+			std::vector<pending_row_t> rows;
+			rows.swap(pending);
+			auto bytes = pendingBytes;
+			pendingBytes = 0;
+			execute(s, code, rows.size(), bytes);
+			rows.clear();
+			pending.swap(rows);
+		}
+
+	public:
+		///<summary>
+		/// Prepares to insert into the provided columns of a table.
+		///</summary>
+		///<param name="connection">Database connection.</param>
+		///<param name="table">Name of the table.</param>
+		///<param name="columns">Names of the columns, one for each of
+		///<typeparamref name="Ts"/>.</param>
+		///<param name="options">Statement and transaction limits.</param>
+		///<exception name="std::runtime_error"/>
+		bulk_inserter(sqlite3_t connection, utf8_string_in_t table,
+					  std::vector<std::string> columns,
+					  const bulk_insert_options& options = {})
+			: bulk_insert_base(connection, table, std::move(columns), options,
+							   sizeof...(Ts))
+		{
+			pending.reserve(rows_per_statement());
+		}
+
+		///<summary>
+		/// Inserts a single row.
+		///</summary>
+		///<param name="values">Value of each column.</param>
+		///<exception name="std::runtime_error"/>
+		void insert(const Ts&... values)
+		{
+			auto bytes = counts_bytes() ? detail::row_size(values...) : 0;
+			if(rows_per_statement() == 1) {
+				auto s = statement(1);
+				execute(s, detail::bind_pack(s, 1, values...), 1, bytes);
+				return;
+			}
+			pending.emplace_back(detail::pending_value<Ts>(values)...);
+			pendingBytes += bytes;
+			if(pending.size() == rows_per_statement()) write_pending();
+		}
+		///<summary>
+		/// Inserts every row of a range of <c>std::tuple&lt;Ts...&gt;</c>.
+		///</summary>
+		///<param name="rows">Range of rows.</param>
+		///<exception name="std::runtime_error"/>
+		template <typename Range>
+		void insert_rows(const Range& rows)
+		{
+			for(auto& row : rows) {
+				insert_row(row, indices());
+			}
+		}
+		///<summary>
+		/// Writes any pending rows and commits the open transaction.
+		///</summary>
+		///<exception name="std::runtime_error"/>
+		void commit()
+		{
+			if(!pending.empty()) write_pending();
+			commit_transaction();
+		}
+	};
+}
+
+#define SQLITEBULKINSERT_HPP
+#endif// SQLITEBULKINSERT_HPP
@@ -0,0 +1,204 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Batched fetching of result rows into one contiguous, typed array per
+	column, with a null bitmap per column and the bytes of text and blobs
+	in an arena shared by the columns.
+*/
+
+#if !defined(SQLITECOLUMNBATCH_HPP)
+#include "SQLiteWrapped.hpp"
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
+namespace Sqlt3
+{
+	///<summary>
+	/// The array a column of a <see cref="column_batch"/> is decoded into.
+	///</summary>
+	enum class batch_column_type
+	{
+		///<summary>64-bit integers.</summary>
+		integer,
+		///<summary>Doubles.</summary>
+		real,
+		///<summary>UTF-8 text in the arena of the batch.</summary>
+		text,
+		///<summary>Bytes in the arena of the batch.</summary>
+		blob
+	};
+
+	class column_batch;
+
+	///<summary>
+	/// One column of a <see cref="column_batch"/>. Only the array matching
+	/// its type is filled; the value of a null is 0, 0.0 or empty.
+	///</summary>
+	class batch_column
+	{
+		friend class column_batch;
+
+		batch_column_type kind;
+		utf8_string_out_t label;
+		std::vector<sqlite3_int64_t> integerValues;
+		std::vector<double> realValues;
+		std::vector<std::size_t> offsets;
+		std::vector<std::size_t> sizes;
+		std::vector<unsigned long long> nulls;
+		std::size_t nullCount = 0;
+
+		batch_column(batch_column_type type, utf8_string_out_t name);
+
+	public:
+		///<summary>The array the column is decoded into.</summary>
+		batch_column_type type() const NOEXCEPT_SPEC;
+		///<summary>The name of the column in the result.</summary>
+		utf8_string_in_t name() const NOEXCEPT_SPEC;
+
+		///<summary>Values of an integer column, one per row.</summary>
+		const sqlite3_int64_t* integers() const NOEXCEPT_SPEC;
+		///<summary>Values of a real column, one per row.</summary>
+		const double* reals() const NOEXCEPT_SPEC;
+		///<summary>Offsets into the arena of the batch of the values of a
+		/// text or blob column, one per row.</summary>
+		const std::size_t* value_offsets() const NOEXCEPT_SPEC;
+		///<summary>Sizes in bytes of the values of a text or blob column,
+		/// one per row.</summary>
+		const std::size_t* value_sizes() const NOEXCEPT_SPEC;
+
+		///<summary>
+		/// The null bitmap: bit <c>row % 64</c> of word <c>row / 64</c> is
+		/// set when the value of the row is null.
+		///</summary>
+		const unsigned long long* null_mask() const NOEXCEPT_SPEC;
+		///<summary>Whether the value of a row is null.</summary>
+		bool is_null(std::size_t row) const NOEXCEPT_SPEC;
+		///<summary>Number of null values.</summary>
+		std::size_t null_count() const NOEXCEPT_SPEC;
+	};
+
+	///<summary>
+	/// Result rows of a prepared statement decoded column by column into
+	/// contiguous arrays, so that they can be processed without a call per
+	/// value. A batch is refilled by each call to <see cref="fetch"/>,
+	/// reusing its memory.
+	///</summary>
+	///<remarks>
+	/// Values are converted by SQLite to the type of their column, as the
+	/// sqlite3_column_* functions do. The types are either given on
+	/// construction or taken from the first row fetched from each
+	/// statement: the storage class of each value, or for a null the
+	/// affinity of the declared type of the column. Types taken from a row
+	/// are forgotten when the batch moves to another statement or is reset.
+	/// Pointers and views into a batch are invalidated by the next fetch.
+	///</remarks>
+	///<example><code>
+	/// Sqlt3::column_batch batch;
+	/// while(batch.fetch(stmt, 4096) != 0) {
+	///     auto& prices = batch.column(1);
+	///     for(std::size_t i = 0; i != batch.rows(); ++i)
+	///         total += prices.reals()[i];
+	/// }
+	///</code></example>
+	class column_batch
+	{
+		std::vector<batch_column_type> types;
+		// Whether types were given on construction rather than taken from
+		// the first row.
+		bool givenTypes = false;
+		std::vector<batch_column> columns;
+		std::vector<char> arena;
+		std::size_t rowCount = 0;
+		sqlite3_stmt_t source = nullptr;
+		bool finished = false;
+
+		void forget_columns() NOEXCEPT_SPEC;
+		void prepare_columns(sqlite3_stmt_t stmt, std::size_t maxRows);
+		void append_row(sqlite3_stmt_t stmt);
+
+	public:
+		///<summary>
+		/// Creates a batch taking the types of its columns from the first
+		/// row fetched.
+		///</summary>
+		column_batch() = default;
+		///<summary>
+		/// Creates a batch decoding its columns into the given types.
+		///</summary>
+		///<param name="types">A type per column of the result.</param>
+		column_batch(std::initializer_list<batch_column_type> types);
+		///<summary>
+		/// Creates a batch decoding its columns into the given types.
+		///</summary>
+		///<param name="types">A type per column of the result.</param>
+		explicit column_batch(std::vector<batch_column_type> types);
+
+		///<summary>
+		/// Steps a statement until it has decoded the given number of rows
+		/// or the statement is done, replacing the rows held.
+		///</summary>
+		///<param name="stmt">Prepared statement.</param>
+		///<param name="maxRows">Most rows to decode.</param>
+		///<returns>Number of rows decoded. Once the statement is done,
+		/// further calls with it return 0 until <see cref="reset"/> is
+		/// called, rather than restarting it.</returns>
+		///<exception name="std::runtime_error">An error stepping the
+		/// statement, or the number of types does not match its columns
+		/// (SQLITE_RANGE).</exception>
+		std::size_t fetch(sqlite3_stmt_t stmt, std::size_t maxRows);
+		///<summary>Discards the rows held, the columns and any types taken
+		/// from a row, and forgets that a statement was done, to fetch from
+		/// it again after resetting it.</summary>
+		void reset() NOEXCEPT_SPEC;
+
+		///<summary>Number of rows held.</summary>
+		std::size_t rows() const NOEXCEPT_SPEC;
+		///<summary>Number of columns, once the first row was fetched.
+		///</summary>
+		std::size_t column_count() const NOEXCEPT_SPEC;
+		///<summary>Accesses a column by its index.</summary>
+		const batch_column& column(std::size_t i) const NOEXCEPT_SPEC;
+		///<summary>Whether the last fetch reached the end of the
+		/// statement.</summary>
+		bool done() const NOEXCEPT_SPEC;
+
+		///<summary>The bytes of every text and blob value held.</summary>
+		const char* arena_data() const NOEXCEPT_SPEC;
+		///<summary>Text of a row of a text column.</summary>
+		///<param name="column">Index of the column.</param>
+		///<param name="row">Index of the row.</param>
+		utf8_string_view_t text(std::size_t column,
+								std::size_t row) const NOEXCEPT_SPEC;
+		///<summary>Bytes of a row of a blob column.</summary>
+		///<param name="column">Index of the column.</param>
+		///<param name="row">Index of the row.</param>
+		blob_view_t blob(std::size_t column,
+						 std::size_t row) const NOEXCEPT_SPEC;
+	};
+}
+
+#define SQLITECOLUMNBATCH_HPP
+#endif// SQLITECOLUMNBATCH_HPP
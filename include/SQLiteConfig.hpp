@@ -0,0 +1,230 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Configuration of the SQLite3 library before it is initialised: the
+	threading mode, memory statistics, a pooled memory allocator, a page
+	cache module and fixed page cache and lookaside memory.
+*/
+
+#if !defined(SQLITECONFIG_HPP)
+#include "SQLitePageCache.hpp"
+#include "SQLiteWrapped.hpp"
+#include <cstddef>
+#include <memory>
+
+namespace Sqlt3
+{
+	namespace detail
+	{
+		class pool_allocator;
+	}
+
+	///<summary>
+	/// Configuration of the allocator installed by
+	///<see cref="config_builder::use_pool_allocator"/>.
+	///</summary>
+	struct pool_allocator_options
+	{
+		///<summary>Largest allocation, in bytes, served from the pool.
+		/// Larger allocations go to <c>std::malloc</c>.</summary>
+		std::size_t maxBlockSize = 4096;
+		///<summary>Number of blocks moved at once between the cache of a
+		/// thread and the free lists shared by all threads. Reduced for
+		/// large blocks.</summary>
+		std::size_t batch = 32;
+	};
+
+	///<summary>
+	/// Counters of the allocator installed by
+	///<see cref="config_builder::use_pool_allocator"/>. Only the slow paths
+	/// are counted.
+	///</summary>
+	struct pool_allocator_stats
+	{
+		///<summary>Slabs of blocks obtained from <c>std::malloc</c>.
+		///</summary>
+		unsigned long long slabs = 0;
+		///<summary>Total size of the slabs, in bytes.</summary>
+		unsigned long long slabBytes = 0;
+		///<summary>Times a thread refilled its cache from the shared free
+		/// lists.</summary>
+		unsigned long long refills = 0;
+		///<summary>Times a thread returned blocks from its cache to the
+		/// shared free lists.</summary>
+		unsigned long long flushes = 0;
+		///<summary>Allocations larger than the largest block.</summary>
+		unsigned long long largeAllocations = 0;
+	};
+
+	///<summary>
+	/// The SQLite3 library, configured and initialised by
+	///<see cref="config_builder::initialize"/>. Upon destruction, the library
+	/// is shut down and the configured memory is released.
+	///</summary>
+	///<remarks>Every connection must be closed before destruction.
+	///</remarks>
+	class configured_library
+	{
+		std::unique_ptr<detail::pool_allocator> allocator;
+		std::unique_ptr<unsigned char[]> pagecache;
+		std::unique_ptr<detail::sharded_pcache> pcacheModule;
+		sqlite3_mem_methods previousMethods;
+		sqlite3_pcache_methods2 previousPcache;
+		bool initialized = false;
+
+		friend class config_builder;
+		configured_library() NOEXCEPT_SPEC;
+		void release() NOEXCEPT_SPEC;
+
+	public:
+		configured_library(const configured_library&) = delete;
+		configured_library(configured_library&& x) NOEXCEPT_SPEC;
+		configured_library& operator=(const configured_library&) = delete;
+		configured_library& operator=(configured_library&& x) NOEXCEPT_SPEC;
+		~configured_library() NOEXCEPT_SPEC;
+
+		///<summary>
+		/// Reads the counters of the pooled allocator, if one is installed.
+		///</summary>
+		pool_allocator_stats allocator_stats() const NOEXCEPT_SPEC;
+		///<summary>
+		/// Reads the counters of the sharded page cache, if one is
+		/// installed.
+		///</summary>
+		pcache_stats page_cache_stats() const;
+	};
+
+	///<summary>
+	/// Collects <see cref="https://www.sqlite.org/c3ref/config.html"/>
+	/// options and applies them before initialising the library. Options
+	/// that are not set keep the compile-time defaults of SQLite.
+	///</summary>
+	///<remarks>The library can only be configured before it is initialised,
+	/// which many functions, including <see cref="sqlite3_open"/>, do
+	/// implicitly. Call <see cref="initialize"/> first, before any other
+	/// thread uses SQLite.</remarks>
+	///<example><code>
+	/// auto library = Sqlt3::config_builder()
+	///     .multi_thread()
+	///     .use_pool_allocator()
+	///     .pagecache(4096, 2000)
+	///     .lookaside(128, 256)
+	///     .initialize();
+	///</code></example>
+	class config_builder
+	{
+		int threading = 0;
+		int memoryStatus = -1;
+		int uriFilenames = -1;
+		sqlite3_int64_t mmapDefault = -1;
+		sqlite3_int64_t mmapMax = -1;
+		int lookasideSize = -1;
+		int lookasideCount = -1;
+		int pagecacheSize = 0;
+		int pagecacheCount = 0;
+		bool usePool = false;
+		pool_allocator_options poolOptions;
+		bool useShardedPcache = false;
+		sharded_pcache_options pcacheOptions;
+
+	public:
+		///<summary>Selects <c>SQLITE_CONFIG_SINGLETHREAD</c>.</summary>
+		config_builder& single_thread() NOEXCEPT_SPEC;
+		///<summary>Selects <c>SQLITE_CONFIG_MULTITHREAD</c>: connections
+		/// may be used by one thread at a time without locking.</summary>
+		config_builder& multi_thread() NOEXCEPT_SPEC;
+		///<summary>Selects <c>SQLITE_CONFIG_SERIALIZED</c>.</summary>
+		config_builder& serialized() NOEXCEPT_SPEC;
+		///<summary>
+		/// Enables or disables the collection of memory statistics,
+		///<c>SQLITE_CONFIG_MEMSTATUS</c>. Disabling them removes a global
+		/// mutex from every allocation.
+		///</summary>
+		config_builder& memory_status(bool enable) NOEXCEPT_SPEC;
+		///<summary>Enables or disables URI filenames,
+		///<c>SQLITE_CONFIG_URI</c>.</summary>
+		config_builder& uri(bool enable) NOEXCEPT_SPEC;
+		///<summary>
+		/// Sets the default and maximum memory-mapped I/O sizes,
+		///<c>SQLITE_CONFIG_MMAP_SIZE</c>.
+		///</summary>
+		config_builder& mmap_size(sqlite3_int64_t defaultSize,
+								  sqlite3_int64_t maxSize) NOEXCEPT_SPEC;
+		///<summary>
+		/// Sets the default lookaside memory of each connection,
+		///<c>SQLITE_CONFIG_LOOKASIDE</c>.
+		///</summary>
+		///<param name="slotSize">Size of each slot, in bytes.</param>
+		///<param name="slots">Number of slots per connection.</param>
+		config_builder& lookaside(int slotSize, int slots) NOEXCEPT_SPEC;
+		///<summary>
+		/// Gives the page cache a fixed buffer,
+		///<c>SQLITE_CONFIG_PAGECACHE</c>, owned by the returned
+		///<see cref="configured_library"/>. Pages that do not fit overflow
+		/// to the general allocator.
+		///</summary>
+		///<param name="pageSize">Database page size, in bytes. The header
+		/// size reported by <c>SQLITE_CONFIG_PCACHE_HDRSZ</c> is added.
+		///</param>
+		///<param name="pages">Number of pages in the buffer.</param>
+		config_builder& pagecache(int pageSize, int pages) NOEXCEPT_SPEC;
+		///<summary>
+		/// Installs a size-class pool allocator with
+		///<c>SQLITE_CONFIG_MALLOC</c>. Each thread keeps a cache of free
+		/// blocks of each size, so most allocations and frees take no lock
+		/// and touch no memory shared with other threads.
+		///</summary>
+		///<remarks>Only one pooled allocator can be installed at a time.
+		/// Memory freed on a thread is cached by that thread, whichever
+		/// thread allocated it. Slabs of blocks are only returned to the
+		/// system when the library is shut down.</remarks>
+		config_builder&
+			use_pool_allocator(const pool_allocator_options& options = {});
+		///<summary>
+		/// Installs a page cache module with <c>SQLITE_CONFIG_PCACHE2</c>
+		/// that evicts pages with the CLOCK algorithm and takes page memory
+		/// from arenas on the NUMA node of the thread that first loads each
+		/// page, sharded by CPU.
+		///</summary>
+		///<remarks>The buffer of <see cref="pagecache"/> is only used by the
+		/// built-in page cache, so the two should not be combined. Only one
+		/// sharded page cache can be installed at a time.</remarks>
+		config_builder&
+			use_sharded_pcache(const sharded_pcache_options& options = {});
+
+		///<summary>
+		/// Applies the options and initialises the library with
+		///<see cref="sqlite3_initialize"/>.
+		///</summary>
+		///<returns>The library, which is shut down upon destruction.
+		///</returns>
+		///<exception name="std::runtime_error">The library is already
+		/// initialised, or an option is not supported.</exception>
+		configured_library initialize() const;
+	};
+}
+
+#define SQLITECONFIG_HPP
+#endif// SQLITECONFIG_HPP
@@ -0,0 +1,207 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	A thread-safe pool of connections to a single database file, made up of
+	a number of read-only connections and one writer connection, for use
+	with databases in WAL mode.
+*/
+
+#if !defined(SQLITECONNECTIONPOOL_HPP)
+#include "SQLiteWrapped.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+namespace Sqlt3
+{
+	class connection_pool;
+
+	namespace detail
+	{
+		struct PooledConnectionDeleter
+		{
+			ALIAS_TYPE(sqlite3_t, pointer);
+
+			connection_pool* pool = nullptr;
+			std::size_t slot = 0;
+
+			PooledConnectionDeleter() NOEXCEPT_SPEC = default;
+			PooledConnectionDeleter(connection_pool* pool,
+									std::size_t slot) NOEXCEPT_SPEC
+				: pool(pool),
+				  slot(slot)
+			{
+			}
+
+			void operator()(pointer p) const NOEXCEPT_SPEC;
+		};
+	}
+
+	///<summary>
+	/// RAII wrapper of a connection checked out of a
+	///<see cref="connection_pool"/>. Upon destruction, the connection is
+	/// returned to the pool rather than closed.
+	///</summary>
+	ALIAS_TYPE(WRAP_TEMPLATE(std::unique_ptr<sqlite3,
+											 detail::PooledConnectionDeleter>),
+			   pooled_connection);
+
+	///<summary>
+	/// Configuration of a <see cref="connection_pool"/>.
+	///</summary>
+	struct connection_pool_options
+	{
+		///<summary>Number of read-only connections.</summary>
+		std::size_t readers = 4;
+		///<summary>How long a checkout waits for a free connection before
+		/// failing. Zero fails immediately.</summary>
+		std::chrono::milliseconds timeout{1000};
+		///<summary>Passed to <see cref="sqlite3_busy_timeout"/> for every
+		/// connection.</summary>
+		int busyTimeout = 5000;
+		///<summary>Whether to switch the database to WAL mode when the
+		/// pool is created.</summary>
+		bool enableWal = true;
+		///<summary>Name of the Virtual File System to open connections
+		/// with, or nullptr for the default.</summary>
+		utf8_string_in_t vfs = nullptr;
+	};
+
+	///<summary>
+	/// A snapshot of the counters of a <see cref="connection_pool"/>.
+	///</summary>
+	struct connection_pool_metrics
+	{
+		///<summary>Successful checkouts.</summary>
+		unsigned long long checkouts = 0;
+		///<summary>Checkouts that had to wait for a connection.</summary>
+		unsigned long long waits = 0;
+		///<summary>Checkouts that timed out.</summary>
+		unsigned long long timeouts = 0;
+		///<summary>Total time spent waiting by checkouts.</summary>
+		std::chrono::nanoseconds waitTime{0};
+		///<summary>Longest time spent waiting by a single checkout.
+		///</summary>
+		std::chrono::nanoseconds maxWaitTime{0};
+		///<summary>Total time connections have been checked out for.
+		///</summary>
+		std::chrono::nanoseconds busyTime{0};
+		///<summary>Age of the pool.</summary>
+		std::chrono::nanoseconds lifetime{0};
+		///<summary>Read-only connections currently checked out.</summary>
+		std::size_t readersInUse = 0;
+		///<summary>Whether the writer connection is checked out.</summary>
+		bool writerInUse = false;
+		///<summary>Number of connections in the pool.</summary>
+		std::size_t connections = 0;
+
+		///<summary>Fraction of the lifetime of the pool that its
+		/// connections have spent checked out, between 0 and 1.</summary>
+		double utilization() const NOEXCEPT_SPEC;
+	};
+
+	///<summary>
+	/// A pool of connections to one database file: a number of read-only
+	/// connections and a single writer, opened with
+	///<see cref="sqlite_open_nomutex"/>. Each connection is only ever used by
+	/// the thread that has checked it out.
+	///</summary>
+	///<remarks>Checkouts claim a free connection with a single atomic
+	/// operation and only take a lock when every connection is in use. Every
+	///<see cref="pooled_connection"/> must be destroyed before the pool.
+	///</remarks>
+	class connection_pool
+	{
+		struct slot
+		{
+			unique_connection connection;
+			std::atomic<bool> busy;
+			std::atomic<long long> acquiredAt;
+		};
+		ALIAS_TYPE(std::chrono::steady_clock, clock);
+
+		// Readers occupy [0, readerCount); the writer is last.
+		std::unique_ptr<slot[]> slots;
+		std::size_t readerCount;
+		connection_pool_options options;
+		clock::time_point created;
+
+		std::mutex waitMutex;
+		std::condition_variable released;
+		std::atomic<int> waiters;
+
+		std::atomic<unsigned long long> checkoutCount;
+		std::atomic<unsigned long long> waitCount;
+		std::atomic<unsigned long long> timeoutCount;
+		std::atomic<long long> waitNanos;
+		std::atomic<long long> maxWaitNanos;
+		std::atomic<long long> busyNanos;
+
+		friend struct detail::PooledConnectionDeleter;
+		void release(std::size_t slot) NOEXCEPT_SPEC;
+		bool try_claim(std::size_t first, std::size_t count,
+					   std::size_t& claimed) NOEXCEPT_SPEC;
+		pooled_connection checkout(std::size_t first, std::size_t count);
+
+	public:
+		///<summary>
+		/// Opens every connection of the pool.
+		///</summary>
+		///<param name="filename">Name of the database file.</param>
+		///<param name="options">Size and behaviour of the pool.</param>
+		///<exception name="std::runtime_error"/>
+		connection_pool(utf8_string_in_t filename,
+						const connection_pool_options& options = {});
+		connection_pool(const connection_pool&) = delete;
+		connection_pool& operator=(const connection_pool&) = delete;
+		~connection_pool() NOEXCEPT_SPEC;
+
+		///<summary>
+		/// Checks out a read-only connection, waiting up to the configured
+		/// timeout for one to become free.
+		///</summary>
+		///<returns>The connection.</returns>
+		///<exception name="std::runtime_error">No connection became free in
+		/// time.</exception>
+		pooled_connection acquire_reader();
+		///<summary>
+		/// Checks out the writer connection, waiting up to the configured
+		/// timeout for it to become free.
+		///</summary>
+		///<returns>The connection.</returns>
+		///<exception name="std::runtime_error">The connection did not
+		/// become free in time.</exception>
+		pooled_connection acquire_writer();
+
+		///<summary>Retrieves the current counters of the pool.</summary>
+		connection_pool_metrics metrics() const NOEXCEPT_SPEC;
+	};
+}
+
+#define SQLITECONNECTIONPOOL_HPP
+#endif// SQLITECONNECTIONPOOL_HPP
@@ -0,0 +1,603 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Registration of C++ callables as scalar, aggregate and window SQL
+	functions. The number and types of the arguments are taken from the
+	signature of the callable at compile time, so each argument is read
+	with the matching sqlite3_value_* function.
+*/
+
+#if !defined(SQLITEFUNCTIONS_HPP)
+#include "SQLiteWrapped.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Sqlt3
+{
+	///<summary>
+	/// The default flags of functions registered through this header: UTF-8
+	/// arguments and not deterministic. Combine with
+	///<c>SQLITE_DETERMINISTIC</c>, <c>SQLITE_DIRECTONLY</c> or
+	///<c>SQLITE_INNOCUOUS</c> where they apply.
+	///</summary>
+	const CONSTEXPR_SPEC int sqlite_utf8_function = SQLITE_UTF8;
+
+	namespace detail
+	{
+		///<summary>
+		/// Maps a C++ parameter type onto the sqlite3_value_* function that
+		/// reads it. Specialise to read additional types.
+		///</summary>
+		template <typename T, typename Enable = void>
+		struct value_traits;
+
+		template <typename T>
+		struct value_traits<
+			T, typename std::enable_if<std::is_integral<T>::value &&
+									   !std::is_same<T, bool>::value>::type>
+		{
+			static T get(sqlite3_value_t v) NOEXCEPT_SPEC
+			{
+				return static_cast<T>(::sqlite3_value_int64(v));
+			}
+		};
+		template <>
+		struct value_traits<bool>
+		{
+			static bool get(sqlite3_value_t v) NOEXCEPT_SPEC
+			{
+				return ::sqlite3_value_int64(v) != 0;
+			}
+		};
+		template <typename T>
+		struct value_traits<
+			T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+		{
+			static T get(sqlite3_value_t v) NOEXCEPT_SPEC
+			{
+				return static_cast<T>(::sqlite3_value_double(v));
+			}
+		};
+		// The value itself, for functions that inspect its type.
+		template <>
+		struct value_traits<sqlite3_value_t>
+		{
+			static sqlite3_value_t get(sqlite3_value_t v) NOEXCEPT_SPEC
+			{
+				return v;
+			}
+		};
+		template <>
+		struct value_traits<utf8_string_out_t>
+		{
+			static utf8_string_out_t get(sqlite3_value_t v)
+			{
+				auto text = reinterpret_cast<const char*>(
+					::sqlite3_value_text(v));
+				if(text == nullptr) return utf8_string_out_t();
+				return utf8_string_out_t(
+					text, static_cast<std::size_t>(::sqlite3_value_bytes(v)));
+			}
+		};
+		// Views are valid for the duration of the call.
+		template <>
+		struct value_traits<utf8_string_view_t>
+		{
+			static utf8_string_view_t get(sqlite3_value_t v) NOEXCEPT_SPEC
+			{
+				auto text = reinterpret_cast<const char*>(
+					::sqlite3_value_text(v));
+				return utf8_string_view_t(
+					text, static_cast<std::size_t>(::sqlite3_value_bytes(v)));
+			}
+		};
+		template <>
+		struct value_traits<blob_view_t>
+		{
+			static blob_view_t get(sqlite3_value_t v) NOEXCEPT_SPEC
+			{
+				auto blob = ::sqlite3_value_blob(v);
+				return blob_view_t(
+					blob, static_cast<std::size_t>(::sqlite3_value_bytes(v)));
+			}
+		};
+
+		///<summary>
+		/// Maps a C++ return type onto the sqlite3_result_* function that
+		/// returns it. Specialise to return additional types.
+		///</summary>
+		template <typename T, typename Enable = void>
+		struct result_traits;
+
+		template <typename T>
+		struct result_traits<
+			T, typename std::enable_if<std::is_integral<T>::value>::type>
+		{
+			static void set(sqlite3_context* c, T v) NOEXCEPT_SPEC
+			{
+				::sqlite3_result_int64(c, static_cast<sqlite3_int64_t>(v));
+			}
+		};
+		// NaN is returned as NULL.
+		template <typename T>
+		struct result_traits<
+			T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+		{
+			static void set(sqlite3_context* c, T v) NOEXCEPT_SPEC
+			{
+				::sqlite3_result_double(c, static_cast<double>(v));
+			}
+		};
+		template <>
+		struct result_traits<std::nullptr_t>
+		{
+			static void set(sqlite3_context* c, std::nullptr_t) NOEXCEPT_SPEC
+			{
+				::sqlite3_result_null(c);
+			}
+		};
+		template <>
+		struct result_traits<sqlite3_value_t>
+		{
+			static void set(sqlite3_context* c,
+							sqlite3_value_t v) NOEXCEPT_SPEC
+			{
+				::sqlite3_result_value(c, v);
+			}
+		};
+		template <>
+		struct result_traits<const char*>
+		{
+			static void set(sqlite3_context* c, const char* v) NOEXCEPT_SPEC
+			{
+				::sqlite3_result_text(c, v, -1, sqlite_transient);
+			}
+		};
+		template <>
+		struct result_traits<utf8_string_out_t>
+		{
+			static void set(sqlite3_context* c,
+							const utf8_string_out_t& v) NOEXCEPT_SPEC
+			{
+				::sqlite3_result_text64(
+					c, v.data(), static_cast<sqlite3_uint64_t>(v.size()),
+					sqlite_transient, SQLITE_UTF8);
+			}
+		};
+		template <>
+		struct result_traits<utf8_string_view_t>
+		{
+			static void set(sqlite3_context* c,
+							utf8_string_view_t v) NOEXCEPT_SPEC
+			{
+				::sqlite3_result_text64(
+					c, v.data(), static_cast<sqlite3_uint64_t>(v.size()),
+					sqlite_transient, SQLITE_UTF8);
+			}
+		};
+		template <>
+		struct result_traits<blob_view_t>
+		{
+			static void set(sqlite3_context* c, blob_view_t v) NOEXCEPT_SPEC
+			{
+				::sqlite3_result_blob64(
+					c, v.data(), static_cast<sqlite3_uint64_t>(v.size()),
+					sqlite_transient);
+			}
+		};
+		// Vectors of numbers are returned as blobs of their elements, as
+		// read by the vec_* functions.
+		template <typename T>
+		struct result_traits<
+			std::vector<T>,
+			typename std::enable_if<std::is_arithmetic<T>::value>::type>
+		{
+			static void set(sqlite3_context* c,
+							const std::vector<T>& v) NOEXCEPT_SPEC
+			{
+				::sqlite3_result_blob64(
+					c, v.data(),
+					static_cast<sqlite3_uint64_t>(v.size() * sizeof(T)),
+					sqlite_transient);
+			}
+		};
+
+		template <typename... Ts>
+		struct type_list
+		{
+			static const std::size_t size = sizeof...(Ts);
+		};
+
+		///<summary>
+		/// The result and decayed parameter types of a function pointer,
+		/// member function pointer or class with a single call operator.
+		///</summary>
+		template <typename F>
+		struct callable_traits
+			: callable_traits<decltype(&std::decay<F>::type::operator())>
+		{
+		};
+		template <typename R, typename... A>
+		struct callable_traits<R (*)(A...)>
+		{
+			ALIAS_TYPE(R, result_type);
+			ALIAS_TYPE(type_list<typename std::decay<A>::type...>,
+					   arguments);
+		};
+		template <typename R, typename... A>
+		struct callable_traits<R(A...)> : callable_traits<R (*)(A...)>
+		{
+		};
+		template <typename C, typename R, typename... A>
+		struct callable_traits<R (C::*)(A...)> : callable_traits<R (*)(A...)>
+		{
+		};
+		template <typename C, typename R, typename... A>
+		struct callable_traits<R (C::*)(A...) const>
+			: callable_traits<R (*)(A...)>
+		{
+		};
+#if defined(__cpp_noexcept_function_type)
+		// Since C++17, noexcept is part of the type of a function.
+		template <typename R, typename... A>
+		struct callable_traits<R (*)(A...) noexcept>
+			: callable_traits<R (*)(A...)>
+		{
+		};
+		template <typename C, typename R, typename... A>
+		struct callable_traits<R (C::*)(A...) noexcept>
+			: callable_traits<R (*)(A...)>
+		{
+		};
+		template <typename C, typename R, typename... A>
+		struct callable_traits<R (C::*)(A...) const noexcept>
+			: callable_traits<R (*)(A...)>
+		{
+		};
+#endif// defined(__cpp_noexcept_function_type)
+
+		///<summary>
+		/// Calls a callable with the arguments of a function, decoded by
+		/// their declared types, and returns its result to SQLite.
+		///</summary>
+		template <typename R>
+		struct invoker
+		{
+			template <typename F, typename... A, std::size_t... I>
+			static void call(sqlite3_context* c, F& f, sqlite3_value_t* argv,
+							 type_list<A...>, index_sequence<I...>)
+			{
+				result_traits<typename std::decay<R>::type>::set(
+					c, f(value_traits<A>::get(argv[I])...));
+			}
+		};
+		template <>
+		struct invoker<void>
+		{
+			template <typename F, typename... A, std::size_t... I>
+			static void call(sqlite3_context*, F& f, sqlite3_value_t* argv,
+							 type_list<A...>, index_sequence<I...>)
+			{
+				f(value_traits<A>::get(argv[I])...);
+			}
+		};
+
+		///<summary>
+		/// Reports the exception being handled as the error of a function.
+		/// Must be called from a catch block.
+		///</summary>
+		void report_function_error(sqlite3_context* context) NOEXCEPT_SPEC;
+
+		template <typename F>
+		struct scalar_function
+		{
+			ALIAS_TYPE(callable_traits<F>, traits);
+			ALIAS_TYPE(typename traits::arguments, arguments);
+
+			static void call(sqlite3_context* c, int, sqlite3_value_t* argv)
+			{
+				ALIAS_TYPE(WRAP_TEMPLATE(typename make_index_sequence<
+											 arguments::size>::type),
+						   indices);
+				try {
+					auto& f = *static_cast<F*>(::sqlite3_user_data(c));
+					invoker<typename traits::result_type>::call(
+						c, f, argv, arguments(), indices());
+				}
+				catch(...) {
+					report_function_error(c);
+				}
+			}
+			static void destroy(void* p)
+			{
+				delete static_cast<F*>(p);
+			}
+		};
+
+		///<summary>
+		/// Adapts a class with step and final member functions, and value
+		/// and inverse for window functions, to the callbacks of SQLite.
+		/// A copy of the prototype is made for each group of rows.
+		///</summary>
+		template <typename A>
+		struct aggregate_function
+		{
+			ALIAS_TYPE(callable_traits<decltype(&A::step)>, step_traits);
+			ALIAS_TYPE(typename step_traits::arguments, arguments);
+			ALIAS_TYPE(WRAP_TEMPLATE(typename make_index_sequence<
+										 arguments::size>::type),
+					   indices);
+
+			struct step_call
+			{
+				A& a;
+				template <typename... X>
+				void operator()(X&&... x)
+				{
+					a.step(std::forward<X>(x)...);
+				}
+			};
+			struct inverse_call
+			{
+				A& a;
+				template <typename... X>
+				void operator()(X&&... x)
+				{
+					a.inverse(std::forward<X>(x)...);
+				}
+			};
+			struct final_call
+			{
+				A& a;
+				auto operator()() -> decltype(a.final())
+				{
+					return a.final();
+				}
+			};
+			struct value_call
+			{
+				A& a;
+				auto operator()() -> decltype(a.value())
+				{
+					return a.value();
+				}
+			};
+
+			// The aggregate context holds a pointer to the state, which is
+			// created by the first step.
+			static A* state(sqlite3_context* c, bool create)
+			{
+				auto slot = static_cast<A**>(::sqlite3_aggregate_context(
+					c, create ? static_cast<int>(sizeof(A*)) : 0));
+				if(slot == nullptr) {
+					if(create) throw std::bad_alloc();
+					return nullptr;
+				}
+				if(*slot == nullptr && create) {
+					*slot = new A(*static_cast<A*>(::sqlite3_user_data(c)));
+				}
+				return *slot;
+			}
+
+			static void step(sqlite3_context* c, int, sqlite3_value_t* argv)
+			{
+				try {
+					step_call f{*state(c, true)};
+					invoker<void>::call(c, f, argv, arguments(), indices());
+				}
+				catch(...) {
+					report_function_error(c);
+				}
+			}
+			static void inverse(sqlite3_context* c, int,
+								sqlite3_value_t* argv)
+			{
+				try {
+					inverse_call f{*state(c, true)};
+					invoker<void>::call(c, f, argv, arguments(), indices());
+				}
+				catch(...) {
+					report_function_error(c);
+				}
+			}
+			static void final(sqlite3_context* c)
+			{
+				try {
+					// No rows: the result of an untouched prototype.
+					std::unique_ptr<A> a(state(c, false));
+					if(!a) {
+						auto prototype = ::sqlite3_user_data(c);
+						a.reset(new A(*static_cast<A*>(prototype)));
+					}
+					final_call f{*a};
+					invoker<decltype(f())>::call(c, f, nullptr, type_list<>(),
+												 index_sequence<>());
+				}
+				catch(...) {
+					report_function_error(c);
+				}
+			}
+			static void value(sqlite3_context* c)
+			{
+				try {
+					auto a = state(c, true);
+					value_call f{*a};
+					invoker<decltype(f())>::call(c, f, nullptr, type_list<>(),
+												 index_sequence<>());
+				}
+				catch(...) {
+					report_function_error(c);
+				}
+			}
+			static void destroy(void* p)
+			{
+				delete static_cast<A*>(p);
+			}
+		};
+	}
+
+	///<summary>
+	///<see cref="https://www.sqlite.org/c3ref/create_function.html"/>.
+	/// Registers a callable as a scalar SQL function taking as many
+	/// arguments as the callable, each converted to its parameter type.
+	///</summary>
+	///<param name="connection">Connection to register the function on.
+	///</param>
+	///<param name="name">Name of the function.</param>
+	///<param name="function">Callable, moved into a copy owned by SQLite.
+	/// Exceptions it throws are reported as errors of the statement.</param>
+	///<param name="flags">The text encoding, with
+	///<c>SQLITE_DETERMINISTIC</c> and other function flags.</param>
+	///<exception name="std::runtime_error"/>
+	///<example><code>
+	/// Sqlt3::sqlite3_create_function_v2(
+	///     db, "clamp", [](double x, double lo, double hi) {
+	///         return std::min(std::max(x, lo), hi);
+	///     }, SQLITE_UTF8 | SQLITE_DETERMINISTIC);
+	///</code></example>
+	template <typename F>
+	void sqlite3_create_function_v2(sqlite3_t connection, utf8_string_in_t name,
+									F function,
+									int flags = sqlite_utf8_function)
+	{
+		ALIAS_TYPE(WRAP_TEMPLATE(typename std::decay<F>::type), function_type);
+		ALIAS_TYPE(detail::scalar_function<function_type>, adapter);
+		std::unique_ptr<function_type> f(
+			new function_type(std::move(function)));
+		// SQLite calls destroy itself if the registration fails.
+		auto code = ::sqlite3_create_function_v2(
+			connection, name,
+			static_cast<int>(adapter::arguments::size), flags, f.release(),
+			&adapter::call, nullptr, nullptr, &adapter::destroy);
+		if(code != SQLITE_OK) detail::throw_result_error(code, connection);
+	}
+
+	///<summary>
+	///<see cref="https://www.sqlite.org/c3ref/create_function.html"/>.
+	/// Registers a class as an aggregate SQL function. Each group of rows
+	/// gets a copy of the prototype, whose <c>step</c> member function is
+	/// called with the arguments of each row and whose <c>final</c> member
+	/// function returns the result.
+	///</summary>
+	///<param name="connection">Connection to register the function on.
+	///</param>
+	///<param name="name">Name of the function.</param>
+	///<param name="prototype">Initial state of each group.</param>
+	///<param name="flags">The text encoding, with function flags.</param>
+	///<exception name="std::runtime_error"/>
+	template <typename A>
+	void sqlite3_create_aggregate_function(sqlite3_t connection,
+										   utf8_string_in_t name,
+										   A prototype = A(),
+										   int flags = sqlite_utf8_function)
+	{
+		ALIAS_TYPE(detail::aggregate_function<A>, adapter);
+		std::unique_ptr<A> p(new A(std::move(prototype)));
+		auto code = ::sqlite3_create_function_v2(
+			connection, name,
+			static_cast<int>(adapter::arguments::size), flags, p.release(),
+			nullptr, &adapter::step, &adapter::final, &adapter::destroy);
+		if(code != SQLITE_OK) detail::throw_result_error(code, connection);
+	}
+
+	///<summary>
+	///<see cref="https://www.sqlite.org/c3ref/create_function.html"/>.
+	/// Registers a class as an aggregate window function. As well as
+	///<c>step</c> and <c>final</c>, the class has an <c>inverse</c>
+	/// member function, called with the arguments of a row leaving the
+	/// window, and a <c>value</c> member function returning the current
+	/// result.
+	///</summary>
+	///<param name="connection">Connection to register the function on.
+	///</param>
+	///<param name="name">Name of the function.</param>
+	///<param name="prototype">Initial state of each partition.</param>
+	///<param name="flags">The text encoding, with function flags.</param>
+	///<exception name="std::runtime_error"/>
+	///<example><code>
+	/// struct moving_sum
+	/// {
+	///     sqlite3_int64_t total = 0;
+	///     void step(sqlite3_int64_t x) { total += x; }
+	///     void inverse(sqlite3_int64_t x) { total -= x; }
+	///     sqlite3_int64_t value() const { return total; }
+	///     sqlite3_int64_t final() const { return total; }
+	/// };
+	/// Sqlt3::sqlite3_create_window_function&lt;moving_sum&gt;(db, "msum");
+	///</code></example>
+	template <typename A>
+	void sqlite3_create_window_function(sqlite3_t connection,
+										utf8_string_in_t name,
+										A prototype = A(),
+										int flags = sqlite_utf8_function)
+	{
+		ALIAS_TYPE(detail::aggregate_function<A>, adapter);
+		std::unique_ptr<A> p(new A(std::move(prototype)));
+		auto code = ::sqlite3_create_window_function(
+			connection, name,
+			static_cast<int>(adapter::arguments::size), flags, p.release(),
+			&adapter::step, &adapter::final, &adapter::value,
+			&adapter::inverse, &adapter::destroy);
+		if(code != SQLITE_OK) detail::throw_result_error(code, connection);
+	}
+
+	///<summary>
+	/// Registers the built-in vector and hashing functions on a
+	/// connection. Vectors are blobs of native 32-bit floats.
+	///</summary>
+	///<remarks>
+	///<list type="bullet">
+	///<item><c>vec_sum(v)</c>, <c>vec_min(v)</c>, <c>vec_max(v)</c>,
+	///<c>vec_mean(v)</c> and <c>vec_variance(v)</c>, the population
+	/// variance, of the elements of a vector. NULL for a NULL or, except
+	/// for the sum, an empty vector.</item>
+	///<item><c>vec_dot(a, b)</c>: the dot product of two vectors of the
+	/// same length.</item>
+	///<item><c>hash64(x)</c>: a 64-bit hash of the bytes of a value, or
+	/// of the 8 bytes of an integer or real, as a signed integer. NULL for
+	/// NULL.</item>
+	///<item><c>variance(x)</c>: the sample variance of the non-NULL
+	/// values of a group, usable as a window function.</item>
+	///</list>
+	/// The kernels keep eight independent partial results, so that the
+	/// compiler can use SIMD instructions without reordering the
+	/// arithmetic. A blob whose size is not a multiple of 4 is an error.
+	///</remarks>
+	///<param name="connection">Connection to register the functions on.
+	///</param>
+	///<exception name="std::runtime_error"/>
+	///<example><code>
+	/// Sqlt3::register_vector_functions(db);
+	/// // SELECT id FROM items ORDER BY vec_dot(embedding, ?1) DESC LIMIT 10
+	///</code></example>
+	void register_vector_functions(sqlite3_t connection);
+}
+
+#define SQLITEFUNCTIONS_HPP
+#endif// SQLITEFUNCTIONS_HPP
@@ -0,0 +1,227 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Periodic sampling of the global memory status of SQLite and of the
+	memory status of a set of connections, publishing the readings and
+	their changes since the previous sample as a time series.
+*/
+
+#if !defined(SQLITEMEMORYSAMPLER_HPP)
+#include "SQLiteWrapped.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Sqlt3
+{
+	///<summary>
+	/// The memory status of one connection. Counts of events are the number
+	/// that occurred since the previous sample. A counter that went backwards,
+	/// because it wrapped or another user of <see cref="sqlite3_db_status"/>
+	/// reset it, is treated as having restarted from zero.
+	///</summary>
+	struct connection_memory_sample
+	{
+		///<summary>The connection.</summary>
+		sqlite3_t connection = nullptr;
+		///<summary>The name the connection was registered with.</summary>
+		utf8_string_out_t name;
+		///<summary>Lookaside slots in use.</summary>
+		int lookasideUsed = 0;
+		///<summary>Bytes of heap used by the page cache.</summary>
+		int cacheUsed = 0;
+		///<summary>Bytes of heap used by the page cache, with the memory of
+		/// caches shared between connections divided evenly among them.
+		///</summary>
+		int cacheUsedShared = 0;
+		///<summary>Bytes of heap used by schemas.</summary>
+		int schemaUsed = 0;
+		///<summary>Bytes of heap used by prepared statements.</summary>
+		int stmtUsed = 0;
+		///<summary>Page cache hits.</summary>
+		long long cacheHits = 0;
+		///<summary>Page cache misses.</summary>
+		long long cacheMisses = 0;
+		///<summary>Dirty pages written to disk.</summary>
+		long long cacheWrites = 0;
+		///<summary>Dirty pages written to disk in the middle of a
+		/// transaction because the cache was full.</summary>
+		long long cacheSpills = 0;
+		///<summary>Allocations served from lookaside.</summary>
+		long long lookasideHits = 0;
+		///<summary>Allocations too large for lookaside.</summary>
+		long long lookasideMissSize = 0;
+		///<summary>Allocations that found lookaside full.</summary>
+		long long lookasideMissFull = 0;
+		///<summary>Whether deferred foreign key constraints are violated in
+		/// the open transaction.</summary>
+		bool deferredForeignKeys = false;
+
+		///<summary>Fraction of page reads served from the cache since the
+		/// previous sample, or 1 if there were none.</summary>
+		double cache_hit_ratio() const NOEXCEPT_SPEC;
+		///<summary>Fraction of allocations that missed lookaside since the
+		/// previous sample, or 0 if there were none.</summary>
+		double lookaside_miss_rate() const NOEXCEPT_SPEC;
+	};
+
+	///<summary>
+	/// The global memory status of SQLite and that of every registered
+	/// connection at one point in time.
+	///</summary>
+	struct memory_sample
+	{
+		///<summary>When the sample was taken.</summary>
+		std::chrono::steady_clock::time_point time;
+		///<summary>Time since the previous sample.</summary>
+		std::chrono::nanoseconds interval{0};
+		///<summary>Bytes of heap in use.</summary>
+		sqlite3_int64_t memoryUsed = 0;
+		///<summary>Most bytes of heap ever in use.</summary>
+		sqlite3_int64_t memoryHighwater = 0;
+		///<summary>Outstanding allocations.</summary>
+		sqlite3_int64_t mallocCount = 0;
+		///<summary>Change in outstanding allocations since the previous
+		/// sample.</summary>
+		sqlite3_int64_t mallocCountGrowth = 0;
+		///<summary>Largest allocation requested.</summary>
+		sqlite3_int64_t mallocSizeHighwater = 0;
+		///<summary>Pages in use from the configured page cache memory.
+		///</summary>
+		sqlite3_int64_t pagecacheUsed = 0;
+		///<summary>Bytes of page cache allocated from the heap because the
+		/// configured memory was exhausted.</summary>
+		sqlite3_int64_t pagecacheOverflow = 0;
+		///<summary>Change in page cache overflow since the previous sample.
+		///</summary>
+		sqlite3_int64_t pagecacheOverflowGrowth = 0;
+		///<summary>Largest page cache allocation requested.</summary>
+		sqlite3_int64_t pagecacheSizeHighwater = 0;
+		///<summary>Deepest parser stack used, if SQLite was compiled with
+		///<c>YYTRACKMAXSTACKDEPTH</c>, otherwise 0.</summary>
+		sqlite3_int64_t parserStackHighwater = 0;
+		///<summary>The status of each registered connection.</summary>
+		std::vector<connection_memory_sample> connections;
+	};
+
+	///<summary>
+	/// Samples the memory status of SQLite and of registered connections on
+	/// a background thread at a fixed interval, keeping the most recent
+	/// samples in a ring buffer and optionally passing each to a callback.
+	///</summary>
+	///<remarks>The counters are read without resetting them, so other users
+	/// of <see cref="sqlite3_db_status"/> are unaffected. Connections are
+	/// read from the sampling thread, so they should be opened in serialized
+	/// mode, and must be removed before they are closed.</remarks>
+	class memory_sampler
+	{
+	public:
+		ALIAS_TYPE(std::function<void(const memory_sample&)>, callback_t);
+
+	private:
+		// Cumulative counters of a connection as of the previous sample.
+		struct tracked
+		{
+			sqlite3_t connection;
+			utf8_string_out_t name;
+			int cacheHits = 0;
+			int cacheMisses = 0;
+			int cacheWrites = 0;
+			int cacheSpills = 0;
+			int lookasideHits = 0;
+			int lookasideMissSize = 0;
+			int lookasideMissFull = 0;
+		};
+		ALIAS_TYPE(std::chrono::steady_clock, clock);
+
+		std::chrono::milliseconds interval;
+		callback_t callback;
+
+		// Serialises samples, and so callbacks; guards the previous values.
+		std::mutex sampleMutex;
+		clock::time_point previousTime;
+		sqlite3_int64_t previousMallocCount = 0;
+		sqlite3_int64_t previousOverflow = 0;
+
+		std::mutex connectionsMutex;
+		std::vector<tracked> connections;
+
+		mutable std::mutex historyMutex;
+		std::vector<memory_sample> ring;
+		std::size_t capacity;
+		std::size_t next = 0;
+
+		std::mutex stopMutex;
+		std::condition_variable stopped;
+		bool stopping = false;
+		std::thread worker;
+
+		void run() NOEXCEPT_SPEC;
+
+	public:
+		///<summary>
+		/// Starts sampling.
+		///</summary>
+		///<param name="interval">Time between samples.</param>
+		///<param name="history">Number of samples kept.</param>
+		///<param name="callback">Invoked with each sample, one sample at a
+		/// time and in order. Must not throw or call <see cref="sample"/>.
+		///</param>
+		explicit memory_sampler(std::chrono::milliseconds interval,
+								std::size_t history = 256,
+								callback_t callback = callback_t());
+		memory_sampler(const memory_sampler&) = delete;
+		memory_sampler& operator=(const memory_sampler&) = delete;
+		///<summary>Stops sampling.</summary>
+		~memory_sampler() NOEXCEPT_SPEC;
+
+		///<summary>
+		/// Includes a connection in subsequent samples.
+		///</summary>
+		///<param name="connection">The connection.</param>
+		///<param name="name">Name to report the connection under.</param>
+		void add(sqlite3_t connection, utf8_string_in_t name);
+		///<summary>
+		/// Excludes a connection from subsequent samples. Once this returns,
+		/// the connection is no longer read by the sampler.
+		///</summary>
+		void remove(sqlite3_t connection);
+
+		///<summary>
+		/// Takes a sample immediately, in addition to the periodic samples.
+		///</summary>
+		///<returns>The sample, which is also added to the history.</returns>
+		memory_sample sample();
+		///<summary>Retrieves the samples kept, oldest first.</summary>
+		std::vector<memory_sample> history() const;
+	};
+}
+
+#define SQLITEMEMORYSAMPLER_HPP
+#endif// SQLITEMEMORYSAMPLER_HPP
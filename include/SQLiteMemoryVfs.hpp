@@ -0,0 +1,222 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	A Virtual File System keeping databases in memory as reference-counted
+	pages, so that a database can be captured as a snapshot and forked into
+	others that share its pages until they are written.
+*/
+
+#if !defined(SQLITEMEMORYVFS_HPP)
+#include "SQLiteWrapped.hpp"
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace Sqlt3
+{
+	namespace detail
+	{
+		struct memory_pages;
+	}
+
+	///<summary>
+	/// Configuration of a <see cref="memory_vfs"/>.
+	///</summary>
+	struct memory_vfs_options
+	{
+		///<summary>Name the VFS is registered under.</summary>
+		utf8_string_in_t name = "cow-memory";
+		///<summary>Name of the VFS used for randomness, sleeping and the
+		/// time, or nullptr for the default.</summary>
+		utf8_string_in_t base = nullptr;
+		///<summary>Whether to make the VFS the default.</summary>
+		bool makeDefault = false;
+	};
+
+	///<summary>
+	/// Counters of a <see cref="memory_vfs"/>.
+	///</summary>
+	struct memory_vfs_stats
+	{
+		///<summary>Files held, including journals.</summary>
+		std::size_t files = 0;
+		///<summary>Distinct pages held by the files; pages shared by forks
+		/// are counted once.</summary>
+		std::size_t pages = 0;
+		///<summary>Bytes of the distinct pages.</summary>
+		std::size_t bytes = 0;
+		///<summary>Pages copied because they were written while shared.
+		///</summary>
+		unsigned long long pagesCopied = 0;
+	};
+
+	///<summary>
+	/// The content of a file of a <see cref="memory_vfs"/> at one point in
+	/// time. Holds the pages it refers to, but does not copy them.
+	///</summary>
+	class memory_snapshot
+	{
+		friend class memory_vfs;
+		std::shared_ptr<const detail::memory_pages> pages;
+
+	public:
+		///<summary>Size in bytes of the captured file.</summary>
+		sqlite3_int64_t size() const NOEXCEPT_SPEC;
+		///<summary>Whether the snapshot holds a file.</summary>
+		explicit operator bool() const NOEXCEPT_SPEC;
+	};
+
+	///<summary>
+	/// Registers a VFS storing every file in memory, in pages of 4096 bytes
+	/// shared between a file and its snapshots and forks. A page is copied
+	/// only when it is written while shared. Unregistered upon destruction,
+	/// which discards its files.
+	///</summary>
+	///<remarks>
+	/// Unlike <c>:memory:</c> databases, the files are named, persist while
+	/// the VFS exists after their connections close and may be opened by
+	/// several connections of the process at once, with the usual locking.
+	/// Names are used as given, without resolving them against the current
+	/// directory. Shared memory is not provided, so WAL mode needs
+	///<c>PRAGMA locking_mode=EXCLUSIVE</c>; any other journal mode works.
+	///
+	/// Forking a database copies a pointer per page, so a template of a few
+	/// megabytes forks in microseconds. The page size of the databases is
+	/// best left at 4096 bytes, so that each write of a page copies at most
+	/// one shared page.
+	///</remarks>
+	///<example><code>
+	/// Sqlt3::memory_vfs vfs;
+	/// {
+	///     auto db = Sqlt3::sqlite3_open_v2(
+	///         "template", Sqlt3::sqlite_open_readwrite |
+	///                         Sqlt3::sqlite_open_create, vfs.name());
+	///     // ... populate ...
+	/// }
+	/// vfs.fork("template", "request-1");
+	/// auto scratch = Sqlt3::sqlite3_open_v2(
+	///     "request-1", Sqlt3::sqlite_open_readwrite, vfs.name());
+	///</code></example>
+	class memory_vfs
+	{
+		struct file;
+		struct image;
+
+		memory_vfs_options options;
+		utf8_string_out_t vfsName;
+		sqlite3_vfs* baseVfs;
+		std::unique_ptr<sqlite3_vfs> vfs;
+		std::unique_ptr<sqlite3_io_methods> methods;
+
+		mutable std::mutex imagesMutex;
+		std::map<utf8_string_out_t, std::shared_ptr<image>> images;
+		std::atomic<unsigned long long> copiedPages;
+
+		std::shared_ptr<image> find(utf8_string_in_t name) const;
+
+		static int x_open(sqlite3_vfs* vfs, utf8_string_in_t name,
+						  sqlite3_file* file, int flags, int* outFlags);
+		static int x_delete(sqlite3_vfs* vfs, utf8_string_in_t name,
+							int syncDirectory);
+		static int x_access(sqlite3_vfs* vfs, utf8_string_in_t name,
+							int flags, int* result);
+		static int x_full_pathname(sqlite3_vfs* vfs, utf8_string_in_t name,
+								   int size, char* out);
+		static int x_close(sqlite3_file* file);
+		static int x_read(sqlite3_file* file, void* buffer, int amount,
+						  sqlite3_int64 offset);
+		static int x_write(sqlite3_file* file, const void* buffer, int amount,
+						   sqlite3_int64 offset);
+		static int x_truncate(sqlite3_file* file, sqlite3_int64 size);
+		static int x_sync(sqlite3_file* file, int flags);
+		static int x_file_size(sqlite3_file* file, sqlite3_int64* size);
+		static int x_lock(sqlite3_file* file, int level);
+		static int x_unlock(sqlite3_file* file, int level);
+		static int x_check_reserved_lock(sqlite3_file* file, int* result);
+		static int x_file_control(sqlite3_file* file, int op, void* arg);
+		static int x_sector_size(sqlite3_file* file);
+		static int x_device_characteristics(sqlite3_file* file);
+
+	public:
+		///<summary>
+		/// Registers the VFS.
+		///</summary>
+		///<param name="options">Name and base VFS.</param>
+		///<exception name="std::runtime_error">The base VFS does not
+		/// exist.</exception>
+		explicit memory_vfs(const memory_vfs_options& options = {});
+		memory_vfs(const memory_vfs&) = delete;
+		memory_vfs& operator=(const memory_vfs&) = delete;
+		///<summary>Unregisters the VFS. Every connection using the VFS
+		/// must be closed first.</summary>
+		~memory_vfs() NOEXCEPT_SPEC;
+
+		///<summary>Retrieves the name the VFS is registered under.
+		///</summary>
+		utf8_string_in_t name() const NOEXCEPT_SPEC;
+
+		///<summary>
+		/// Captures the current content of a file.
+		///</summary>
+		///<param name="file">Name of the file.</param>
+		///<returns>The snapshot, sharing the pages of the file.</returns>
+		///<exception name="std::runtime_error">The file does not exist
+		/// (SQLITE_CANTOPEN), or a connection is writing to it
+		/// (SQLITE_BUSY).</exception>
+		memory_snapshot snapshot(utf8_string_in_t file) const;
+		///<summary>
+		/// Creates or replaces a file with the content of a snapshot.
+		///</summary>
+		///<param name="file">Name of the file.</param>
+		///<param name="snapshot">Content of the file.</param>
+		///<exception name="std::runtime_error">The snapshot is empty
+		/// (SQLITE_MISUSE), or the file is open (SQLITE_BUSY).</exception>
+		void restore(utf8_string_in_t file, const memory_snapshot& snapshot);
+		///<summary>
+		/// Creates or replaces a file with the current content of another.
+		/// Equivalent to restoring a snapshot of the source.
+		///</summary>
+		///<param name="from">Name of the file to copy.</param>
+		///<param name="to">Name of the new file.</param>
+		///<exception name="std::runtime_error">See <see cref="snapshot"/>
+		/// and <see cref="restore"/>.</exception>
+		void fork(utf8_string_in_t from, utf8_string_in_t to);
+		///<summary>Whether a file exists.</summary>
+		bool exists(utf8_string_in_t file) const;
+		///<summary>
+		/// Deletes a file. Connections that have it open keep its content
+		/// until they close it.
+		///</summary>
+		///<returns>Whether the file existed.</returns>
+		bool remove(utf8_string_in_t file);
+		///<summary>Reads the counters of the VFS.</summary>
+		memory_vfs_stats stats() const;
+	};
+}
+
+#define SQLITEMEMORYVFS_HPP
+#endif// SQLITEMEMORYVFS_HPP
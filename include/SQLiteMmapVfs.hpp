@@ -0,0 +1,218 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	A Virtual File System that wraps another, normally "unix", and serves
+	reads of main database files from a read-only memory mapping, with
+	madvise hints and pre-faulting chosen per database through URI
+	parameters. Requires a POSIX system.
+*/
+
+#if !defined(SQLITEMMAPVFS_HPP)
+#include "SQLiteWrapped.hpp"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+namespace Sqlt3
+{
+	///<summary>
+	/// Access pattern advice passed to <c>madvise</c> for a mapped database.
+	///</summary>
+	enum class mmap_advice
+	{
+		///<summary><c>MADV_NORMAL</c>.</summary>
+		normal,
+		///<summary><c>MADV_SEQUENTIAL</c>: aggressive read-ahead.
+		///</summary>
+		sequential,
+		///<summary><c>MADV_RANDOM</c>: no read-ahead.</summary>
+		random,
+		///<summary><c>MADV_WILLNEED</c>: read the whole mapping ahead.
+		///</summary>
+		willneed
+	};
+
+	///<summary>
+	/// Configuration of an <see cref="mmap_vfs"/>.
+	///</summary>
+	struct mmap_vfs_options
+	{
+		///<summary>Name the VFS is registered under.</summary>
+		utf8_string_in_t name = "mmap";
+		///<summary>Name of the VFS to wrap, or nullptr for the default.
+		///</summary>
+		utf8_string_in_t base = nullptr;
+		///<summary>Whether to make the VFS the default.</summary>
+		bool makeDefault = false;
+		///<summary>Most bytes of a database mapped. Reads beyond are passed
+		/// to the wrapped VFS. Overridden by the <c>mmap_limit</c> URI
+		/// parameter.</summary>
+		sqlite3_int64_t maxMapSize = sqlite3_int64_t(1) << 32;
+		///<summary>Advice for databases that do not set the
+		///<c>madvise</c> URI parameter.</summary>
+		mmap_advice advice = mmap_advice::normal;
+	};
+
+	///<summary>
+	/// Counters of an <see cref="mmap_vfs"/>.
+	///</summary>
+	struct mmap_vfs_stats
+	{
+		///<summary>Reads served by copying from a mapping.</summary>
+		unsigned long long mappedReads = 0;
+		///<summary>Bytes copied from mappings.</summary>
+		unsigned long long mappedBytes = 0;
+		///<summary>Reads passed to the wrapped VFS.</summary>
+		unsigned long long fallbackReads = 0;
+		///<summary>Times a mapping was created or resized.</summary>
+		unsigned long long remaps = 0;
+		///<summary>Pages touched by pre-faulting.</summary>
+		unsigned long long prefaultedPages = 0;
+		///<summary>Minor page faults of the whole process since the VFS
+		/// was created.</summary>
+		long long minorFaults = 0;
+		///<summary>Major page faults, which needed disk I/O, of the whole
+		/// process since the VFS was created.</summary>
+		long long majorFaults = 0;
+	};
+
+	///<summary>
+	/// Registers a VFS that wraps another and copies reads of main database
+	/// files from a shared, read-only mapping of the file instead of calling
+	///<c>pread</c>. All other operations, including writes, which the
+	/// mapping observes, are passed to the wrapped VFS. Unregistered upon
+	/// destruction.
+	///</summary>
+	///<remarks>
+	/// Databases opened with a URI filename may set these parameters:
+	///<list type="bullet">
+	///<item><c>madvise</c>: normal, sequential, random or willneed.</item>
+	///<item><c>prefault</c>: "all", or comma-separated byte ranges such as
+	/// "0-1048576,8388608-9437184", touched at open.</item>
+	///<item><c>mmap_limit</c>: most bytes mapped; zero disables mapping.
+	///</item>
+	///</list>
+	/// The mapping is made through a second, read-only descriptor per file.
+	/// Closing any descriptor of a file releases every POSIX advisory lock
+	/// the process holds on it, so descriptors are shared between
+	/// connections to the same file and only closed when the VFS is
+	/// destroyed, after every connection using it has been closed. Other
+	/// connections in the process to the same files through another VFS
+	/// lose their locks at that point. As with the memory-mapped I/O of
+	/// SQLite itself, a file truncated by another process while mapped may
+	/// raise <c>SIGBUS</c> on access.
+	///</remarks>
+	///<example><code>
+	/// Sqlt3::mmap_vfs vfs;
+	/// auto db = Sqlt3::sqlite3_open_v2(
+	///     "file:lookup.db?madvise=random&amp;prefault=all",
+	///     Sqlt3::sqlite_open_readonly | Sqlt3::sqlite_open_uri, vfs.name());
+	///</code></example>
+	class mmap_vfs
+	{
+		struct file;
+		struct shared_descriptor
+		{
+			int fd = -1;
+			int users = 0;
+		};
+
+		mmap_vfs_options options;
+		utf8_string_out_t vfsName;
+		sqlite3_vfs* baseVfs;
+		std::unique_ptr<sqlite3_vfs> vfs;
+		std::unique_ptr<sqlite3_io_methods> methods;
+
+		std::mutex descriptorsMutex;
+		std::map<std::pair<unsigned long long, unsigned long long>,
+				 shared_descriptor>
+			descriptors;
+
+		mutable std::mutex filesMutex;
+		file* files = nullptr;
+		std::atomic<unsigned long long> retiredMappedReads;
+		std::atomic<unsigned long long> retiredMappedBytes;
+		std::atomic<unsigned long long> retiredFallbackReads;
+		std::atomic<unsigned long long> remapCount;
+		std::atomic<unsigned long long> prefaultCount;
+		long long initialMinorFaults = 0;
+		long long initialMajorFaults = 0;
+
+		int acquire_descriptor(file& f, utf8_string_in_t path) NOEXCEPT_SPEC;
+		void release_descriptor(file& f) NOEXCEPT_SPEC;
+		void remap(file& f, sqlite3_int64_t fileSize) NOEXCEPT_SPEC;
+		void prefault(file& f, utf8_string_in_t ranges) NOEXCEPT_SPEC;
+
+		static int x_open(sqlite3_vfs* vfs, utf8_string_in_t name,
+						  sqlite3_file* file, int flags, int* outFlags);
+		static int x_close(sqlite3_file* file);
+		static int x_read(sqlite3_file* file, void* buffer, int amount,
+						  sqlite3_int64 offset);
+		static int x_write(sqlite3_file* file, const void* buffer, int amount,
+						   sqlite3_int64 offset);
+		static int x_truncate(sqlite3_file* file, sqlite3_int64 size);
+		static int x_sync(sqlite3_file* file, int flags);
+		static int x_file_size(sqlite3_file* file, sqlite3_int64* size);
+		static int x_lock(sqlite3_file* file, int level);
+		static int x_unlock(sqlite3_file* file, int level);
+		static int x_check_reserved_lock(sqlite3_file* file, int* result);
+		static int x_file_control(sqlite3_file* file, int op, void* arg);
+		static int x_sector_size(sqlite3_file* file);
+		static int x_device_characteristics(sqlite3_file* file);
+		static int x_shm_map(sqlite3_file* file, int region, int size,
+							 int extend, void volatile** memory);
+		static int x_shm_lock(sqlite3_file* file, int offset, int n,
+							  int flags);
+		static void x_shm_barrier(sqlite3_file* file);
+		static int x_shm_unmap(sqlite3_file* file, int deleteFlag);
+
+	public:
+		///<summary>
+		/// Registers the VFS.
+		///</summary>
+		///<param name="options">Name, wrapped VFS and defaults.</param>
+		///<exception name="std::runtime_error">The wrapped VFS does not
+		/// exist.</exception>
+		explicit mmap_vfs(const mmap_vfs_options& options = {});
+		mmap_vfs(const mmap_vfs&) = delete;
+		mmap_vfs& operator=(const mmap_vfs&) = delete;
+		///<summary>Unregisters the VFS and closes its descriptors. Every
+		/// connection using the VFS must be closed first.</summary>
+		~mmap_vfs() NOEXCEPT_SPEC;
+
+		///<summary>Retrieves the name the VFS is registered under.
+		///</summary>
+		utf8_string_in_t name() const NOEXCEPT_SPEC;
+		///<summary>Reads the counters of the VFS.</summary>
+		mmap_vfs_stats stats() const;
+	};
+}
+#endif// defined(__unix__) || defined(__APPLE__)
+
+#define SQLITEMMAPVFS_HPP
+#endif// SQLITEMMAPVFS_HPP
@@ -0,0 +1,144 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	A page cache module for SQLite3, installed through
+	SQLITE_CONFIG_PCACHE2, that replaces least-recently-used pages with the
+	CLOCK algorithm and allocates page memory from arenas local to the NUMA
+	node of the calling thread.
+*/
+
+#if !defined(SQLITEPAGECACHE_HPP)
+#include "SQLiteWrapped.hpp"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Sqlt3
+{
+	///<summary>
+	/// Configuration of the page cache installed by
+	///<see cref="config_builder::use_sharded_pcache"/>.
+	///</summary>
+	struct sharded_pcache_options
+	{
+		///<summary>Number of NUMA nodes, or zero to read it from
+		///<c>/sys/devices/system/node/online</c>.</summary>
+		std::size_t nodes = 0;
+		///<summary>Arenas per node, each with its own lock. A thread uses
+		/// the arena chosen by the CPU it runs on.</summary>
+		std::size_t shardsPerNode = 4;
+		///<summary>Size of the slabs page memory is carved from, in bytes.
+		///</summary>
+		std::size_t slabBytes = 256 * 1024;
+	};
+
+	///<summary>
+	/// Counters of the page cache installed by
+	///<see cref="config_builder::use_sharded_pcache"/>.
+	///</summary>
+	struct pcache_stats
+	{
+		///<summary>Fetches of pages that were in the cache.</summary>
+		unsigned long long hits = 0;
+		///<summary>Fetches of pages that were not in the cache.</summary>
+		unsigned long long misses = 0;
+		///<summary>Unpinned pages recycled to make room for others.
+		///</summary>
+		unsigned long long evictions = 0;
+		///<summary>Pages currently held by all caches.</summary>
+		unsigned long long pages = 0;
+		///<summary>Bytes of slab memory allocated on each node.</summary>
+		std::vector<unsigned long long> nodeBytes;
+
+		///<summary>Fraction of fetches that were hits, or 1 if there were
+		/// none.</summary>
+		double hit_ratio() const NOEXCEPT_SPEC;
+	};
+
+	namespace detail
+	{
+		///<summary>
+		/// The page cache module. SQLite passes no context to most of the
+		/// methods of a module, so only one can be installed at a time.
+		///</summary>
+		///<remarks>SQLite never calls the methods of one cache instance
+		/// concurrently, so instances take no locks; only the arenas page
+		/// memory comes from are shared between threads.</remarks>
+		class sharded_pcache
+		{
+			struct arena;
+			struct cache;
+
+			std::size_t nodeCount;
+			std::size_t shardsPerNode;
+			std::size_t slabBytes;
+			std::unique_ptr<arena[]> arenas;
+
+			mutable std::mutex cachesMutex;
+			cache* caches = nullptr;
+			std::atomic<unsigned long long> retiredHits;
+			std::atomic<unsigned long long> retiredMisses;
+			std::atomic<unsigned long long> retiredEvictions;
+
+			void* allocate(std::size_t size, unsigned short& shard);
+			void deallocate(void* block, std::size_t size,
+							unsigned short shard) NOEXCEPT_SPEC;
+
+			static int x_init(void*);
+			static void x_shutdown(void*);
+			static sqlite3_pcache* x_create(int pageSize, int extraSize,
+											int purgeable);
+			static void x_cachesize(sqlite3_pcache* c, int pages);
+			static int x_pagecount(sqlite3_pcache* c);
+			static sqlite3_pcache_page* x_fetch(sqlite3_pcache* c,
+												unsigned key, int create);
+			static void x_unpin(sqlite3_pcache* c, sqlite3_pcache_page* p,
+								int discard);
+			static void x_rekey(sqlite3_pcache* c, sqlite3_pcache_page* p,
+								unsigned oldKey, unsigned newKey);
+			static void x_truncate(sqlite3_pcache* c, unsigned limit);
+			static void x_destroy(sqlite3_pcache* c);
+			static void x_shrink(sqlite3_pcache* c);
+
+		public:
+			///<exception name="std::runtime_error">Another module is
+			/// installed.</exception>
+			explicit sharded_pcache(const sharded_pcache_options& options);
+			sharded_pcache(const sharded_pcache&) = delete;
+			sharded_pcache& operator=(const sharded_pcache&) = delete;
+			~sharded_pcache() NOEXCEPT_SPEC;
+
+			///<summary>The methods to pass to
+			///<c>SQLITE_CONFIG_PCACHE2</c>.</summary>
+			sqlite3_pcache_methods2 methods() NOEXCEPT_SPEC;
+			pcache_stats stats() const;
+		};
+	}
+}
+
+#define SQLITEPAGECACHE_HPP
+#endif// SQLITEPAGECACHE_HPP
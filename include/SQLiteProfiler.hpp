@@ -0,0 +1,202 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Aggregation of the execution time of each distinct SQL text run on one
+	or more connections, as reported by the profiling hooks of SQLite, into
+	log-linear histograms from which percentiles can be read.
+*/
+
+#if !defined(SQLITEPROFILER_HPP)
+#include "SQLiteWrapped.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Sqlt3
+{
+	///<summary>
+	/// Aggregated execution times of one SQL text.
+	///</summary>
+	struct statement_profile
+	{
+		///<summary>The SQL text, or "(other)" for texts beyond the limit of
+		/// the profiler.</summary>
+		utf8_string_out_t sql;
+		///<summary>Number of executions.</summary>
+		unsigned long long count = 0;
+		///<summary>Sum of the execution times.</summary>
+		std::chrono::nanoseconds total{0};
+		///<summary>Longest execution time.</summary>
+		std::chrono::nanoseconds max{0};
+		///<summary>Median execution time.</summary>
+		std::chrono::nanoseconds p50{0};
+		///<summary>99th percentile of execution time.</summary>
+		std::chrono::nanoseconds p99{0};
+		///<summary>99.9th percentile of execution time.</summary>
+		std::chrono::nanoseconds p999{0};
+	};
+
+	namespace detail
+	{
+		///<summary>
+		/// A histogram of durations with 16 buckets per power of two, so
+		/// values read back are within about 3% of those recorded. Recording
+		/// is wait-free.
+		///</summary>
+		class latency_histogram
+		{
+		public:
+			static const std::size_t sub_buckets = 16;
+			static const std::size_t bucket_count = 44 * sub_buckets;
+
+			latency_histogram() NOEXCEPT_SPEC;
+
+			void record(unsigned long long nanos) NOEXCEPT_SPEC;
+			///<summary>Adds the counts of another histogram to this one.
+			///</summary>
+			void merge(const latency_histogram& other) NOEXCEPT_SPEC;
+			void reset() NOEXCEPT_SPEC;
+			///<summary>Adds the counts of each bucket to
+			///<paramref name="counts"/>, which has <see cref="bucket_count"/>
+			/// elements.</summary>
+			void add_to(unsigned long long* counts) const NOEXCEPT_SPEC;
+			unsigned long long count() const NOEXCEPT_SPEC;
+			unsigned long long total() const NOEXCEPT_SPEC;
+			unsigned long long max() const NOEXCEPT_SPEC;
+
+			static std::size_t bucket_of(unsigned long long nanos)
+				NOEXCEPT_SPEC;
+			///<summary>The midpoint of the values held by a bucket.</summary>
+			static unsigned long long value_of(std::size_t bucket)
+				NOEXCEPT_SPEC;
+
+		private:
+			std::atomic<unsigned long long> buckets[bucket_count];
+			std::atomic<unsigned long long> recorded;
+			std::atomic<unsigned long long> sum;
+			std::atomic<unsigned long long> longest;
+		};
+	}
+
+	///<summary>
+	/// Collects the execution time of every statement run on the connections
+	/// it is attached to, per SQL text.
+	///</summary>
+	///<remarks>Statements are grouped by their SQL text as prepared, so
+	/// statements that differ only in bound values share a histogram. Each
+	/// thread records into histograms of its own, keyed by the statement,
+	/// which are merged by SQL text when read, so recording takes no shared
+	/// lock and does not hash the text. Detach the profiler, or close the
+	/// connection, before destroying the profiler.</remarks>
+	///<example><code>
+	/// Sqlt3::statement_profiler profiler;
+	/// profiler.attach(db);
+	/// ...
+	/// for(auto&amp; s : profiler.snapshot())
+	///     export_metric(s.sql, s.p99);
+	///</code></example>
+	class statement_profiler
+	{
+		// The histograms recorded by one thread, defined in the source.
+		struct thread_state;
+
+		std::size_t maxStatements;
+		// Distinguishes this profiler in the thread local lists of states,
+		// which may outlive it.
+		unsigned long long id;
+		// Incremented by reset, after which states of earlier generations
+		// are cleared by their threads and not read.
+		std::atomic<unsigned long long> generation;
+		mutable std::mutex threadsMutex;
+		mutable std::vector<std::shared_ptr<thread_state>> threads;
+		// The histograms of threads that have exited.
+		std::unique_ptr<thread_state> exited;
+
+		thread_state& local();
+		void record(thread_state& state, sqlite3_stmt_t stmt,
+					std::chrono::nanoseconds time);
+		// Tells the other threads that a statement they started has
+		// finished.
+		void finished(const thread_state& state, sqlite3_stmt_t stmt);
+		void collect_exited() const;
+
+		static int trace(unsigned event, void* profiler, void* stmt,
+						 void* detail);
+
+	public:
+		///<summary>
+		/// Creates an empty profiler.
+		///</summary>
+		///<param name="maxStatements">Most distinct statements and SQL
+		/// texts tracked by each thread. Further texts are counted as
+		/// "(other)".</param>
+		explicit statement_profiler(std::size_t maxStatements = 1000);
+		~statement_profiler();
+		statement_profiler(const statement_profiler&) = delete;
+		statement_profiler& operator=(const statement_profiler&) = delete;
+
+		///<summary>
+		/// Installs the profiler as the statement and profile callback of
+		///<c>sqlite3_trace_v2</c> for a connection, replacing any existing
+		/// trace or <see cref="sqlite3_profile"/> callback.
+		///</summary>
+		///<remarks>Statements are timed from their first step to their
+		/// completion or reset with a monotonic clock. The time reported by
+		/// SQLite itself, which has the resolution of the clock of the VFS,
+		/// usually a millisecond, is used when a statement finishes on a
+		/// different thread to the one it started on, and the starting
+		/// thread is told to forget the statement.</remarks>
+		void attach(sqlite3_t connection) NOEXCEPT_SPEC;
+		///<summary>
+		/// Removes the trace callbacks of a connection.
+		///</summary>
+		void detach(sqlite3_t connection) NOEXCEPT_SPEC;
+
+		///<summary>
+		/// Records one execution of a SQL text, for times measured outside
+		/// of the trace callbacks.
+		///</summary>
+		///<param name="sql">SQL text.</param>
+		///<param name="time">Execution time.</param>
+		void record(utf8_string_in_t sql, std::chrono::nanoseconds time);
+
+		///<summary>
+		/// Reads the aggregated times of every SQL text recorded so far.
+		///</summary>
+		///<returns>The profiles, in decreasing order of total time.</returns>
+		std::vector<statement_profile> snapshot() const;
+		///<summary>
+		/// Discards all recorded times.
+		///</summary>
+		void reset();
+	};
+}
+
+#define SQLITEPROFILER_HPP
+#endif// SQLITEPROFILER_HPP
@@ -0,0 +1,126 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Collection of the measured and estimated row counts of every loop of a
+	prepared statement, reported by sqlite3_stmt_scanstatus, into a plan
+	tree in which badly estimated loops are flagged. Requires SQLite to be
+	compiled with SQLITE_ENABLE_STMT_SCANSTATUS.
+*/
+
+#if !defined(SQLITEQUERYPLAN_HPP)
+#include "SQLiteWrapped.hpp"
+#include <vector>
+
+#if defined(SQLITE_ENABLE_STMT_SCANSTATUS)
+namespace Sqlt3
+{
+	///<summary>
+	/// The measured and estimated performance of one loop of a statement.
+	///</summary>
+	struct plan_loop
+	{
+		///<summary>Index of the loop, as passed to
+		///<see cref="sqlite3_stmt_scanstatus"/>.</summary>
+		int index = 0;
+		///<summary>Number of times the loop was run.</summary>
+		sqlite3_int64_t loops = 0;
+		///<summary>Number of rows visited over all runs of the loop.
+		///</summary>
+		sqlite3_int64_t visits = 0;
+		///<summary>Rows the query planner estimated each run of the loop
+		/// would visit.</summary>
+		double estimate = 0.0;
+		///<summary>Name of the table or index the loop reads.</summary>
+		utf8_string_out_t name;
+		///<summary>The loop as described by EXPLAIN QUERY PLAN.</summary>
+		utf8_string_out_t explain;
+		///<summary>Whether the rows visited per run differ from the
+		/// estimate by more than the factor passed to
+		///<see cref="sqlite3_stmt_plan"/>.</summary>
+		bool misestimated = false;
+		///<summary>Whether the loop scans a whole table rather than
+		/// searching an index, which suggests a missing index.</summary>
+		bool fullScan = false;
+
+		///<summary>Rows actually visited per run of the loop.</summary>
+		double visits_per_loop() const NOEXCEPT_SPEC;
+	};
+
+	///<summary>
+	/// The loops of one SELECT of a statement, outermost first.
+	///</summary>
+	struct plan_select
+	{
+		///<summary>Identifier of the SELECT, as reported by
+		///<see cref="sqlite_scanstat_selectid"/>.</summary>
+		int selectId = 0;
+		///<summary>The loops, in nesting order.</summary>
+		std::vector<plan_loop> loops;
+	};
+
+	///<summary>
+	/// The loops of a statement, grouped by the SELECT they belong to.
+	///</summary>
+	struct query_plan
+	{
+		///<summary>The SQL text of the statement.</summary>
+		utf8_string_out_t sql;
+		///<summary>The SELECTs, in the order their first loop appears.
+		///</summary>
+		std::vector<plan_select> selects;
+
+		///<summary>The loops flagged as misestimated or full scans.
+		///</summary>
+		std::vector<plan_loop> flagged() const;
+		///<summary>
+		/// Describes the plan as indented text, one loop per line, with
+		/// flagged loops marked.
+		///</summary>
+		utf8_string_out_t str() const;
+	};
+
+	///<summary>
+	/// Collects the scan status of every loop of a prepared statement, which
+	/// should have been run to completion.
+	///</summary>
+	///<param name="stmt">Prepared statement.</param>
+	///<param name="factor">Loops visiting more than <paramref name="factor"/>
+	/// times, or less than 1 / <paramref name="factor"/> times, the estimated
+	/// rows per run are flagged as misestimated.</param>
+	///<param name="reset">Whether to reset the counters afterwards with
+	///<see cref="sqlite3_stmt_scanstatus_reset"/>.</param>
+	///<returns>The plan.</returns>
+	///<example><code>
+	/// while(Sqlt3::sqlite3_step(stmt) == sqlite_row) {}
+	/// auto plan = Sqlt3::sqlite3_stmt_plan(stmt);
+	/// if(!plan.flagged().empty()) report(plan.str());
+	///</code></example>
+	query_plan sqlite3_stmt_plan(sqlite3_stmt_t stmt, double factor = 10.0,
+								 bool reset = false);
+}
+#endif// defined(SQLITE_ENABLE_STMT_SCANSTATUS)
+
+#define SQLITEQUERYPLAN_HPP
+#endif// SQLITEQUERYPLAN_HPP
@@ -0,0 +1,250 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Typed input ranges over the result rows of a prepared statement. The type
+	of each column is fixed at compile time, so reading a row is a direct
+	call to the matching sqlite3_column_* function for each column.
+*/
+
+#if !defined(SQLITEROWS_HPP)
+#include "SQLiteWrapped.hpp"
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+
+namespace Sqlt3
+{
+	namespace detail
+	{
+		///<summary>
+		/// Maps a C++ type onto the sqlite3_column_* function that reads it.
+		/// Specialise to read additional types.
+		///</summary>
+		template <typename T, typename Enable = void>
+		struct column_traits;
+
+		// Integers that fit in an int are read with sqlite3_column_int, and
+		// wider or unsigned ones with sqlite3_column_int64.
+		template <typename T>
+		struct column_traits<
+			T, typename std::enable_if<std::is_integral<T>::value &&
+									   !std::is_same<T, bool>::value &&
+									   (sizeof(T) < sizeof(int) ||
+										(sizeof(T) == sizeof(int) &&
+										 std::is_signed<T>::value))>::type>
+		{
+			static T get(sqlite3_stmt_t s, int i) NOEXCEPT_SPEC
+			{
+				return static_cast<T>(::sqlite3_column_int(s, i));
+			}
+		};
+		template <typename T>
+		struct column_traits<
+			T, typename std::enable_if<std::is_integral<T>::value &&
+									   (sizeof(T) > sizeof(int) ||
+										(sizeof(T) == sizeof(int) &&
+										 std::is_unsigned<T>::value))>::type>
+		{
+			static T get(sqlite3_stmt_t s, int i) NOEXCEPT_SPEC
+			{
+				return static_cast<T>(::sqlite3_column_int64(s, i));
+			}
+		};
+		template <typename T>
+		struct column_traits<
+			T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+		{
+			static T get(sqlite3_stmt_t s, int i) NOEXCEPT_SPEC
+			{
+				return static_cast<T>(::sqlite3_column_double(s, i));
+			}
+		};
+		template <>
+		struct column_traits<bool>
+		{
+			static bool get(sqlite3_stmt_t s, int i) NOEXCEPT_SPEC
+			{
+				return ::sqlite3_column_int64(s, i) != 0;
+			}
+		};
+		template <>
+		struct column_traits<utf8_string_out_t>
+		{
+			static utf8_string_out_t get(sqlite3_stmt_t s, int i)
+			{
+				return Sqlt3::sqlite3_column_text(s, i);
+			}
+		};
+		template <>
+		struct column_traits<utf16_string_out_t>
+		{
+			static utf16_string_out_t get(sqlite3_stmt_t s, int i)
+			{
+				return Sqlt3::sqlite3_column_text16(s, i);
+			}
+		};
+		template <>
+		struct column_traits<utf8_string_view_t>
+		{
+			static utf8_string_view_t get(sqlite3_stmt_t s,
+										  int i) NOEXCEPT_SPEC
+			{
+				return Sqlt3::sqlite3_column_text_view(s, i);
+			}
+		};
+		template <>
+		struct column_traits<utf16_string_view_t>
+		{
+			static utf16_string_view_t get(sqlite3_stmt_t s,
+										   int i) NOEXCEPT_SPEC
+			{
+				return Sqlt3::sqlite3_column_text16_view(s, i);
+			}
+		};
+		template <>
+		struct column_traits<blob_view_t>
+		{
+			static blob_view_t get(sqlite3_stmt_t s, int i) NOEXCEPT_SPEC
+			{
+				return Sqlt3::sqlite3_column_blob_view(s, i);
+			}
+		};
+
+		template <typename Row, typename... Ts, std::size_t... I>
+		Row read_row(sqlite3_stmt_t s, index_sequence<I...>)
+		{
+			return Row{column_traits<Ts>::get(s, static_cast<int>(I))...};
+		}
+	}
+
+	///<summary>
+	/// An input range over the remaining result rows of a prepared statement.
+	/// Each row is read into a <typeparamref name="Row"/>, which is brace
+	/// initialised from the columns read as <typeparamref name="Ts"/>, in
+	/// order, starting from the leftmost column.
+	///</summary>
+	///<remarks>Obtaining the begin iterator steps the statement. The range
+	/// can be traversed once. Views read from a row are invalidated by
+	/// advancing the iterator. Errors from <see cref="sqlite3_step"/> are
+	/// thrown.</remarks>
+	template <typename Row, typename... Ts>
+	class row_range
+	{
+		sqlite3_stmt_t stmt;
+
+	public:
+		class iterator
+		{
+			// nullptr once the statement has no more rows.
+			sqlite3_stmt_t stmt = nullptr;
+
+		public:
+			ALIAS_TYPE(std::input_iterator_tag, iterator_category);
+			ALIAS_TYPE(Row, value_type);
+			ALIAS_TYPE(std::ptrdiff_t, difference_type);
+			ALIAS_TYPE(const Row*, pointer);
+			ALIAS_TYPE(Row, reference);
+
+			iterator() NOEXCEPT_SPEC = default;
+			explicit iterator(sqlite3_stmt_t stmt) : stmt(stmt)
+			{
+				++*this;
+			}
+
+			Row operator*() const
+			{
+				ALIAS_TYPE(WRAP_TEMPLATE(typename detail::make_index_sequence<
+											 sizeof...(Ts)>::type),
+						   indices);
+				return detail::read_row<Row, Ts...>(stmt, indices());
+			}
+			iterator& operator++()
+			{
+				if(Sqlt3::sqlite3_step(stmt) != sqlite_row) stmt = nullptr;
+				return *this;
+			}
+			void operator++(int)
+			{
+				++*this;
+			}
+
+			inline friend bool operator==(const iterator& x,
+										  const iterator& y) NOEXCEPT_SPEC
+			{
+				return x.stmt == y.stmt;
+			}
+			inline friend bool operator!=(const iterator& x,
+										  const iterator& y) NOEXCEPT_SPEC
+			{
+				return !(x == y);
+			}
+		};
+
+		explicit row_range(sqlite3_stmt_t stmt) NOEXCEPT_SPEC : stmt(stmt)
+		{
+		}
+
+		iterator begin()
+		{
+			return iterator{stmt};
+		}
+		iterator end() const NOEXCEPT_SPEC
+		{
+			return iterator{};
+		}
+	};
+
+	///<summary>
+	/// Creates a range over the remaining result rows of a prepared
+	/// statement, reading each row into a <c>std::tuple&lt;Ts...&gt;</c>.
+	///</summary>
+	///<param name="stmt">Prepared statement.</param>
+	///<returns>The range of rows.</returns>
+	///<example><code>
+	/// for(auto row : Sqlt3::rows&lt;sqlite3_int64_t, double&gt;(stmt))
+	///     total += std::get&lt;1&gt;(row);
+	///</code></example>
+	template <typename... Ts>
+	row_range<std::tuple<Ts...>, Ts...> rows(sqlite3_stmt_t stmt)
+		NOEXCEPT_SPEC
+	{
+		return row_range<std::tuple<Ts...>, Ts...>{stmt};
+	}
+	///<summary>
+	/// Creates a range over the remaining result rows of a prepared
+	/// statement, reading each row into an aggregate or other type that can
+	/// be brace initialised from the columns.
+	///</summary>
+	///<param name="stmt">Prepared statement.</param>
+	///<returns>The range of rows.</returns>
+	template <typename Row, typename... Ts>
+	row_range<Row, Ts...> rows_as(sqlite3_stmt_t stmt) NOEXCEPT_SPEC
+	{
+		return row_range<Row, Ts...>{stmt};
+	}
+}
+
+#define SQLITEROWS_HPP
+#endif// SQLITEROWS_HPP
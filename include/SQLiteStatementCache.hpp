@@ -0,0 +1,177 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	A per-connection cache of prepared statements, keyed on SQL text.
+	Statements handed out by the cache are reset and returned to it when
+	their handle is destroyed, rather than being finalized.
+*/
+
+#if !defined(SQLITESTATEMENTCACHE_HPP)
+#include "SQLiteWrapped.hpp"
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+namespace Sqlt3
+{
+	class statement_cache;
+
+	namespace detail
+	{
+		struct CachedStatementDeleter
+		{
+			ALIAS_TYPE(sqlite3_stmt_t, pointer);
+
+			statement_cache* cache = nullptr;
+
+			CachedStatementDeleter() NOEXCEPT_SPEC = default;
+			CachedStatementDeleter(statement_cache* cache) NOEXCEPT_SPEC
+				: cache(cache)
+			{
+			}
+
+			void operator()(pointer p) const NOEXCEPT_SPEC;
+		};
+
+		// Hash and equality of NUL-terminated SQL text, so that a lookup
+		// by the caller's pointer needs no std::string.
+		struct sql_text_hash
+		{
+			std::size_t operator()(utf8_string_in_t sql) const NOEXCEPT_SPEC;
+		};
+		struct sql_text_equal
+		{
+			bool operator()(utf8_string_in_t x,
+							utf8_string_in_t y) const NOEXCEPT_SPEC;
+		};
+	}
+
+	///<summary>
+	/// RAII wrapper of a prepared statement borrowed from a
+	///<see cref="statement_cache"/>. Upon destruction, the statement is reset,
+	/// its bindings are cleared and it is returned to the cache it came from.
+	/// Errors on return are not thrown.
+	///</summary>
+	ALIAS_TYPE(WRAP_TEMPLATE(std::unique_ptr<sqlite3_stmt,
+											 detail::CachedStatementDeleter>),
+			   cached_statement);
+
+	///<summary>
+	/// A least-recently-used cache of prepared statements belonging to a single
+	/// database connection. The cache is bounded both by the number of idle
+	/// statements it holds and by the memory reported through
+	///<see cref="sqlite_dbstatus_stmt_used"/> for the connection.
+	///</summary>
+	///<remarks>The cache does not own the connection and must be destroyed
+	/// before it. Every <see cref="cached_statement"/> handed out must be
+	/// destroyed before the cache. Like the connection it belongs to, the cache
+	/// must not be used from more than one thread at a time.</remarks>
+	class statement_cache
+	{
+		struct entry
+		{
+			std::string sql;
+			unique_statement stmt;
+		};
+		ALIAS_TYPE(std::list<entry>, entry_list);
+		// Keys point into the sql of the entry, which list nodes keep in
+		// place.
+		ALIAS_TYPE(WRAP_TEMPLATE(std::unordered_map<
+								 utf8_string_in_t, entry_list::iterator,
+								 detail::sql_text_hash,
+								 detail::sql_text_equal>),
+				   idle_index);
+		ALIAS_TYPE(WRAP_TEMPLATE(std::unordered_map<sqlite3_stmt_t,
+													entry_list::iterator>),
+				   busy_index);
+
+		sqlite3_t connection;
+		std::size_t maxEntries;
+		int maxBytes;
+		// Idle statements, most recently used at the front.
+		entry_list idle;
+		// Statements currently held by a cached_statement.
+		entry_list busy;
+		idle_index idleLookup;
+		busy_index busyLookup;
+		unsigned long long hitCount = 0;
+		unsigned long long missCount = 0;
+		unsigned long long evictionCount = 0;
+
+		friend struct detail::CachedStatementDeleter;
+		void give_back(sqlite3_stmt_t stmt) NOEXCEPT_SPEC;
+		void evict_lru() NOEXCEPT_SPEC;
+		void trim() NOEXCEPT_SPEC;
+
+	public:
+		///<summary>
+		/// Creates an empty cache for the provided connection.
+		///</summary>
+		///<param name="connection">Database connection the statements are
+		/// prepared on.</param>
+		///<param name="maxEntries">Maximum number of idle statements kept.
+		///</param>
+		///<param name="maxBytes">Idle statements are evicted while the memory
+		/// reported by <see cref="sqlite_dbstatus_stmt_used"/> exceeds this
+		/// number of bytes. A negative value disables the limit.</param>
+		statement_cache(sqlite3_t connection, std::size_t maxEntries,
+						int maxBytes = -1);
+		statement_cache(const statement_cache&) = delete;
+		statement_cache& operator=(const statement_cache&) = delete;
+		~statement_cache() NOEXCEPT_SPEC;
+
+		///<summary>
+		/// Retrieves a reset, ready-to-bind prepared statement for the
+		/// provided SQL text, preparing it with
+		///<see cref="sqlite3_prepare_v2"/> if no idle statement exists.
+		///</summary>
+		///<param name="sql">SQL text of a single statement.</param>
+		///<returns>The prepared statement, or nullptr if the text holds no
+		/// statement, such as when it is empty; that is not cached.</returns>
+		///<exception name="std::runtime_error"/>
+		cached_statement prepare(utf8_string_in_t sql);
+		///<summary>
+		/// Finalizes all idle statements. Statements currently in use are
+		/// unaffected.
+		///</summary>
+		void clear() NOEXCEPT_SPEC;
+
+		///<summary>Number of idle statements held by the cache.</summary>
+		std::size_t size() const NOEXCEPT_SPEC;
+		///<summary>Number of calls to <see cref="prepare"/> that were
+		/// satisfied by an idle statement.</summary>
+		unsigned long long hits() const NOEXCEPT_SPEC;
+		///<summary>Number of calls to <see cref="prepare"/> that had to
+		/// prepare a new statement.</summary>
+		unsigned long long misses() const NOEXCEPT_SPEC;
+		///<summary>Number of idle statements finalized to respect the
+		/// limits of the cache.</summary>
+		unsigned long long evictions() const NOEXCEPT_SPEC;
+	};
+}
+
+#define SQLITESTATEMENTCACHE_HPP
+#endif// SQLITESTATEMENTCACHE_HPP
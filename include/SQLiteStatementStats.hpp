@@ -0,0 +1,274 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Collection of the full scan, sort, automatic index and virtual machine
+	step counters of prepared statements on every reset, aggregated by the
+	fingerprint of their SQL text, with alerts for statements that begin to
+	scan whole tables or to build automatic indexes.
+*/
+
+#if !defined(SQLITESTATEMENTSTATS_HPP)
+#include "SQLiteWrapped.hpp"
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Sqlt3
+{
+	///<summary>
+	/// The counters of a prepared statement reported by
+	///<see cref="sqlite3_stmt_status"/> that indicate a poor query plan.
+	///</summary>
+	struct statement_counters
+	{
+		///<summary>Steps taken through a table in a full scan,
+		///<see cref="sqlite_stmtstatus_fullscan_step"/>.</summary>
+		long long fullscanSteps = 0;
+		///<summary>Sort operations, <see cref="sqlite_stmtstatus_sort"/>.
+		///</summary>
+		long long sorts = 0;
+		///<summary>Rows inserted into automatic indexes,
+		///<see cref="sqlite_stmtstatus_autoindex"/>.</summary>
+		long long autoindexRows = 0;
+		///<summary>Virtual machine operations,
+		///<see cref="sqlite_stmtstatus_vm_step"/>.</summary>
+		long long vmSteps = 0;
+
+		statement_counters& operator+=(const statement_counters& c)
+			NOEXCEPT_SPEC;
+	};
+
+	///<summary>
+	/// Reads the counters of <see cref="statement_counters"/> from a prepared
+	/// statement in one pass.
+	///</summary>
+	///<param name="stmt">Prepared statement.</param>
+	///<param name="reset">Whether the counters should be reset.</param>
+	///<returns>The values of the counters.</returns>
+	///<remarks>The counters are only changed by evaluating the statement, so
+	/// the values are consistent provided the statement is not being
+	/// evaluated on another thread.</remarks>
+	statement_counters read_statement_counters(sqlite3_stmt_t stmt,
+											   bool reset) NOEXCEPT_SPEC;
+
+	///<summary>
+	/// Normalises SQL text so that statements differing only in literal
+	/// values, parameter names, comments or whitespace compare equal.
+	///</summary>
+	///<param name="sql">SQL text.</param>
+	///<returns>The tokens of the text separated by single spaces, with
+	/// comments removed and literals and parameters replaced by "?". Lists
+	/// of consecutive "?" collapse into one.</returns>
+	///<example><code>
+	/// // "SELECT * FROM t WHERE a = ? AND b IN ( ? )"
+	/// Sqlt3::sql_fingerprint("SELECT * FROM t WHERE a='x' AND b IN (1,2)");
+	///</code></example>
+	utf8_string_out_t sql_fingerprint(utf8_string_in_t sql);
+
+	///<summary>
+	/// The counters accumulated for one SQL fingerprint.
+	///</summary>
+	struct statement_stats
+	{
+		///<summary>The fingerprint, or "(other)" for fingerprints beyond
+		/// the limit of the registry.</summary>
+		utf8_string_out_t fingerprint;
+		///<summary>Number of executions recorded.</summary>
+		unsigned long long executions = 0;
+		///<summary>Executions that stepped through a full scan.</summary>
+		unsigned long long fullscanExecutions = 0;
+		///<summary>Executions that sorted.</summary>
+		unsigned long long sortExecutions = 0;
+		///<summary>Executions that built an automatic index.</summary>
+		unsigned long long autoindexExecutions = 0;
+		///<summary>Sum of the counters over all executions.</summary>
+		statement_counters totals;
+	};
+
+	///<summary>
+	/// Raised by a <see cref="statement_registry"/> when an execution of a
+	/// statement does a full scan or builds an automatic index, having not
+	/// done so before.
+	///</summary>
+	struct statement_alert
+	{
+		///<summary>The fingerprint of the statement.</summary>
+		utf8_string_out_t fingerprint;
+		///<summary>The SQL text of the execution.</summary>
+		utf8_string_out_t sql;
+		///<summary>Whether the execution began doing full scans.</summary>
+		bool fullscan = false;
+		///<summary>Whether the execution began building automatic indexes.
+		///</summary>
+		bool autoindex = false;
+		///<summary>Number of earlier executions of the fingerprint.
+		///</summary>
+		unsigned long long previousExecutions = 0;
+		///<summary>The counters of the execution.</summary>
+		statement_counters counters;
+	};
+
+	///<summary>
+	/// Configuration of a <see cref="statement_registry"/>.
+	///</summary>
+	struct statement_registry_options
+	{
+		///<summary>Most distinct fingerprints tracked. Further
+		/// fingerprints are counted as "(other)" and raise no alerts.
+		///</summary>
+		std::size_t maxStatements = 1000;
+		///<summary>Whether to alert when the first execution of a
+		/// fingerprint does a full scan or builds an automatic index. When
+		/// false, only statements that change behaviour are reported.
+		///</summary>
+		bool alertOnFirstExecution = false;
+		///<summary>Invoked with each alert, on the thread that recorded the
+		/// execution and without any lock held. Must not throw.</summary>
+		std::function<void(const statement_alert&)> alert;
+	};
+
+	///<summary>
+	/// Accumulates the <see cref="statement_counters"/> of executions by SQL
+	/// fingerprint. Thread-safe.
+	///</summary>
+	///<remarks>Once a fingerprint has executed without doing a full scan or
+	/// building an automatic index, the first execution that does raises an
+	/// alert: the usual sign that a schema change has removed or broken an
+	/// index the statement relied on. Each kind is reported once per
+	/// fingerprint until <see cref="reset"/>.</remarks>
+	class statement_registry
+	{
+		struct entry
+		{
+			statement_stats stats;
+			bool fullscanSeen = false;
+			bool autoindexSeen = false;
+		};
+
+		statement_registry_options options;
+		mutable std::mutex mutex;
+		std::unordered_map<utf8_string_out_t, entry> entries;
+		statement_stats other;
+
+	public:
+		///<summary>
+		/// Creates an empty registry.
+		///</summary>
+		///<param name="options">Limits and the alert callback.</param>
+		explicit statement_registry(statement_registry_options options = {});
+		statement_registry(const statement_registry&) = delete;
+		statement_registry& operator=(const statement_registry&) = delete;
+
+		///<summary>
+		/// Records one execution of a statement.
+		///</summary>
+		///<param name="fingerprint">Fingerprint of the SQL text, as returned
+		/// by <see cref="sql_fingerprint"/>.</param>
+		///<param name="sql">SQL text of the execution, for alerts.</param>
+		///<param name="counters">Counters of the execution.</param>
+		void record(const utf8_string_out_t& fingerprint, utf8_string_in_t sql,
+					const statement_counters& counters);
+
+		///<summary>
+		/// Reads the accumulated counters of every fingerprint.
+		///</summary>
+		///<returns>The statistics, in decreasing order of total full scan
+		/// steps and then of virtual machine steps.</returns>
+		std::vector<statement_stats> snapshot() const;
+		///<summary>
+		/// Discards all recorded counters and alert state.
+		///</summary>
+		void reset();
+	};
+
+	///<summary>
+	/// A prepared statement whose counters are read, reset and recorded in a
+	///<see cref="statement_registry"/> every time it is reset.
+	///</summary>
+	///<remarks>An execution is recorded when the statement is reset or
+	/// destroyed after being stepped. The registry must outlive the
+	/// statement.</remarks>
+	///<example><code>
+	/// Sqlt3::instrumented_statement s(registry, db, "SELECT ...");
+	/// Sqlt3::sqlite3_bind(s.get(), 1, id);
+	/// while(s.step() == Sqlt3::sqlite_row) { ... }
+	/// s.reset();
+	///</code></example>
+	class instrumented_statement
+	{
+		unique_statement stmt;
+		statement_registry* registry;
+		utf8_string_out_t fingerprint;
+
+		void record() NOEXCEPT_SPEC;
+
+	public:
+		///<summary>
+		/// Takes ownership of a prepared statement.
+		///</summary>
+		///<param name="registry">Registry to record executions in.</param>
+		///<param name="stmt">Prepared statement.</param>
+		instrumented_statement(statement_registry& registry,
+							   unique_statement stmt);
+		///<summary>
+		/// Prepares a statement with <see cref="sqlite3_prepare_v2"/>.
+		///</summary>
+		///<param name="registry">Registry to record executions in.</param>
+		///<param name="connection">Database connection.</param>
+		///<param name="sql">SQL text of a single statement.</param>
+		///<exception name="std::runtime_error"/>
+		instrumented_statement(statement_registry& registry,
+							   sqlite3_t connection, utf8_string_in_t sql);
+		instrumented_statement(instrumented_statement&& other) NOEXCEPT_SPEC;
+		instrumented_statement&
+			operator=(instrumented_statement&& other) NOEXCEPT_SPEC;
+		///<summary>Records any pending execution and finalizes the
+		/// statement.</summary>
+		~instrumented_statement() NOEXCEPT_SPEC;
+
+		///<summary>Retrieves the prepared statement.</summary>
+		sqlite3_stmt_t get() const NOEXCEPT_SPEC;
+		///<summary>Retrieves the fingerprint of the statement.</summary>
+		const utf8_string_out_t& sql_fingerprint() const NOEXCEPT_SPEC;
+
+		///<summary>
+		/// Evaluates the statement with <see cref="sqlite3_step"/>.
+		///</summary>
+		///<exception name="std::runtime_error"/>
+		step_result_t step();
+		///<summary>
+		/// Records the counters of the execution, if the statement has been
+		/// stepped, and resets it with <see cref="sqlite3_reset"/>.
+		///</summary>
+		///<exception name="std::runtime_error">The most recent step
+		/// failed.</exception>
+		void reset();
+	};
+}
+
+#define SQLITESTATEMENTSTATS_HPP
+#endif// SQLITESTATEMENTSTATS_HPP
@@ -0,0 +1,198 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	A Virtual File System that wraps another, normally "unix", and submits
+	the page writes and syncs of databases through io_uring on Linux. Writes
+	to a main database file are queued and submitted together, and syncs
+	are queued behind them. Without kernel support every operation is passed
+	to the wrapped VFS.
+*/
+
+#if !defined(SQLITEURINGVFS_HPP)
+#include "SQLiteWrapped.hpp"
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace Sqlt3
+{
+	///<summary>
+	/// Configuration of a <see cref="uring_vfs"/>.
+	///</summary>
+	struct uring_vfs_options
+	{
+		///<summary>Name the VFS is registered under.</summary>
+		utf8_string_in_t name = "uring";
+		///<summary>Name of the VFS to wrap, or nullptr for the default.
+		///</summary>
+		utf8_string_in_t base = nullptr;
+		///<summary>Whether to make the VFS the default.</summary>
+		bool makeDefault = false;
+		///<summary>Entries of the submission queue of each file, which is
+		/// also the most writes queued before they are submitted.</summary>
+		unsigned queueDepth = 128;
+	};
+
+	///<summary>
+	/// Counters of a <see cref="uring_vfs"/>.
+	///</summary>
+	struct uring_vfs_stats
+	{
+		///<summary>Writes queued by SQLite.</summary>
+		unsigned long long writesQueued = 0;
+		///<summary>Write operations submitted, after adjacent writes were
+		/// merged.</summary>
+		unsigned long long writesSubmitted = 0;
+		///<summary>Syncs submitted through io_uring.</summary>
+		unsigned long long syncs = 0;
+		///<summary>Calls to <c>io_uring_enter</c>.</summary>
+		unsigned long long submissions = 0;
+		///<summary>Files that could not use io_uring and were passed to
+		/// the wrapped VFS.</summary>
+		unsigned long long fallbackFiles = 0;
+	};
+
+	///<summary>
+	/// Registers a VFS that wraps another and, for main database and WAL
+	/// files, submits writes and syncs through an io_uring instance per
+	/// file. Unregistered upon destruction.
+	///</summary>
+	///<remarks>
+	/// Writes to a main database file are copied into a queue, merged when
+	/// adjacent and submitted together once the queue is full, before a
+	/// read of queued data and before any operation other than a read, so
+	/// a checkpoint or the commit of a rollback journal becomes a few
+	/// submissions rather than a <c>pwrite</c> per page. Syncs are
+	/// submitted after the queued writes with <c>IOSQE_IO_DRAIN</c>.
+	/// Reads, locks and all I/O on journals go to the wrapped VFS. Writes
+	/// to WAL files are not deferred, as other connections find new frames
+	/// through shared memory rather than through the file.
+	///
+	/// The first sync of each file is passed to the wrapped VFS, which may
+	/// also sync the directory of a new file.
+	///
+	/// io_uring needs a descriptor of its own for each file, so, as with
+	///<see cref="mmap_vfs"/>, descriptors of main database files are shared
+	/// by inode and only closed when the VFS is destroyed, to keep the POSIX
+	/// locks of the process. WAL files are not locked, so their descriptors
+	/// are closed once no file uses them, which lets the space of a deleted
+	/// WAL file be freed. On systems or kernels without io_uring, or where
+	/// it is forbidden, <see cref="supported"/> is false and the VFS
+	/// behaves exactly like the one it wraps.
+	///</remarks>
+	///<example><code>
+	/// Sqlt3::uring_vfs vfs;
+	/// auto db = Sqlt3::sqlite3_open_v2(
+	///     "data.db", Sqlt3::sqlite_open_readwrite, vfs.name());
+	///</code></example>
+	class uring_vfs
+	{
+		struct file;
+		struct ring;
+		struct shared_descriptor
+		{
+			int fd = -1;
+			int users = 0;
+			// Whether the descriptor is closed once it has no users.
+			bool closeUnused = false;
+		};
+
+		uring_vfs_options options;
+		utf8_string_out_t vfsName;
+		sqlite3_vfs* baseVfs;
+		bool available;
+		std::unique_ptr<sqlite3_vfs> vfs;
+		std::unique_ptr<sqlite3_io_methods> methods;
+
+		std::mutex descriptorsMutex;
+		std::map<std::pair<unsigned long long, unsigned long long>,
+				 shared_descriptor>
+			descriptors;
+
+		mutable std::mutex filesMutex;
+		file* files = nullptr;
+		std::atomic<unsigned long long> retiredWritesQueued;
+		std::atomic<unsigned long long> retiredWritesSubmitted;
+		std::atomic<unsigned long long> retiredSyncs;
+		std::atomic<unsigned long long> retiredSubmissions;
+		std::atomic<unsigned long long> fallbackCount;
+
+		int acquire_descriptor(file& f, utf8_string_in_t path,
+							   bool closeUnused) NOEXCEPT_SPEC;
+		void release_descriptor(file& f) NOEXCEPT_SPEC;
+
+		static int x_open(sqlite3_vfs* vfs, utf8_string_in_t name,
+						  sqlite3_file* file, int flags, int* outFlags);
+		static int x_close(sqlite3_file* file);
+		static int x_read(sqlite3_file* file, void* buffer, int amount,
+						  sqlite3_int64 offset);
+		static int x_write(sqlite3_file* file, const void* buffer, int amount,
+						   sqlite3_int64 offset);
+		static int x_truncate(sqlite3_file* file, sqlite3_int64 size);
+		static int x_sync(sqlite3_file* file, int flags);
+		static int x_file_size(sqlite3_file* file, sqlite3_int64* size);
+		static int x_lock(sqlite3_file* file, int level);
+		static int x_unlock(sqlite3_file* file, int level);
+		static int x_check_reserved_lock(sqlite3_file* file, int* result);
+		static int x_file_control(sqlite3_file* file, int op, void* arg);
+		static int x_sector_size(sqlite3_file* file);
+		static int x_device_characteristics(sqlite3_file* file);
+		static int x_shm_map(sqlite3_file* file, int region, int size,
+							 int extend, void volatile** memory);
+		static int x_shm_lock(sqlite3_file* file, int offset, int n,
+							  int flags);
+		static void x_shm_barrier(sqlite3_file* file);
+		static int x_shm_unmap(sqlite3_file* file, int deleteFlag);
+
+	public:
+		///<summary>
+		/// Registers the VFS, probing whether io_uring can be used.
+		///</summary>
+		///<param name="options">Name, wrapped VFS and queue depth.</param>
+		///<exception name="std::runtime_error">The wrapped VFS does not
+		/// exist.</exception>
+		explicit uring_vfs(const uring_vfs_options& options = {});
+		uring_vfs(const uring_vfs&) = delete;
+		uring_vfs& operator=(const uring_vfs&) = delete;
+		///<summary>Unregisters the VFS and closes its descriptors. Every
+		/// connection using the VFS must be closed first.</summary>
+		~uring_vfs() NOEXCEPT_SPEC;
+
+		///<summary>Retrieves the name the VFS is registered under.
+		///</summary>
+		utf8_string_in_t name() const NOEXCEPT_SPEC;
+		///<summary>Whether io_uring is used, rather than only the wrapped
+		/// VFS.</summary>
+		bool supported() const NOEXCEPT_SPEC;
+		///<summary>Reads the counters of the VFS.</summary>
+		uring_vfs_stats stats() const;
+	};
+}
+
+#define SQLITEURINGVFS_HPP
+#endif// SQLITEURINGVFS_HPP
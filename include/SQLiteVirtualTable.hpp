@@ -0,0 +1,782 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Exposure of in-process data, such as sorted vectors, hash maps and
+	memory-mapped arrays of records, as read-only virtual tables, with
+	equality and range constraints on a key column answered by the
+	container.
+*/
+
+#if !defined(SQLITEVIRTUALTABLE_HPP)
+#include "SQLiteFunctions.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Sqlt3
+{
+	///<summary>
+	/// How the rows of a <see cref="virtual_table_source"/> can be found by
+	/// their key, the first column.
+	///</summary>
+	enum class key_access
+	{
+		///<summary>Only by visiting every row.</summary>
+		scan,
+		///<summary>By equality, as in a hash map.</summary>
+		equality,
+		///<summary>By equality or range, in ascending key order, as in a
+		/// sorted vector.</summary>
+		ordered
+	};
+
+	///<summary>
+	/// The constraints on the key column passed to a cursor. Each bound is
+	/// nullptr when absent.
+	///</summary>
+	struct key_constraint
+	{
+		///<summary>Value the key must equal.</summary>
+		sqlite3_value_t equal = nullptr;
+		///<summary>Value the key must be greater than.</summary>
+		sqlite3_value_t lower = nullptr;
+		///<summary>Whether the key may also equal the lower bound.</summary>
+		bool lowerInclusive = false;
+		///<summary>Value the key must be less than.</summary>
+		sqlite3_value_t upper = nullptr;
+		///<summary>Whether the key may also equal the upper bound.</summary>
+		bool upperInclusive = false;
+	};
+
+	///<summary>
+	/// A traversal of the rows of a <see cref="virtual_table_source"/>.
+	///</summary>
+	class virtual_table_cursor
+	{
+	public:
+		virtual ~virtual_table_cursor();
+
+		///<summary>
+		/// Positions the cursor on the first row that may satisfy the
+		/// constraints. Rows that do not satisfy them may also be visited,
+		/// as SQLite checks every row again.
+		///</summary>
+		virtual void filter(const key_constraint& constraint) = 0;
+		///<summary>Whether the cursor is past the last row.</summary>
+		virtual bool eof() const = 0;
+		///<summary>Moves to the next row.</summary>
+		virtual void next() = 0;
+		///<summary>Returns a column of the current row to SQLite.</summary>
+		virtual void column(sqlite3_context* context, int column) const = 0;
+		///<summary>An integer identifying the current row.</summary>
+		virtual sqlite3_int64_t rowid() const = 0;
+	};
+
+	///<summary>
+	/// Data exposed as a read-only virtual table by
+	///<see cref="sqlite3_create_module_v2"/>. The first column is the key.
+	///</summary>
+	class virtual_table_source
+	{
+	public:
+		virtual ~virtual_table_source();
+
+		///<summary>The columns, as in a CREATE TABLE statement, such as
+		/// "id INTEGER, name TEXT".</summary>
+		virtual utf8_string_out_t columns() const = 0;
+		///<summary>Number of rows, used to estimate costs.</summary>
+		virtual std::size_t row_count() const = 0;
+		///<summary>How rows can be found by their key.</summary>
+		virtual key_access access() const = 0;
+		///<summary>Whether no two rows have the same key.</summary>
+		virtual bool unique_keys() const = 0;
+		///<summary>Creates a cursor over the rows.</summary>
+		virtual std::unique_ptr<virtual_table_cursor> open() const = 0;
+	};
+
+	namespace detail
+	{
+		///<summary>
+		/// The declared type of a column read as <typeparamref name="T"/>.
+		///</summary>
+		template <typename T, typename Enable = void>
+		struct column_affinity
+		{
+			static utf8_string_in_t name() NOEXCEPT_SPEC
+			{
+				return "";
+			}
+		};
+		template <typename T>
+		struct column_affinity<
+			T, typename std::enable_if<std::is_integral<T>::value>::type>
+		{
+			static utf8_string_in_t name() NOEXCEPT_SPEC
+			{
+				return "INTEGER";
+			}
+		};
+		template <typename T>
+		struct column_affinity<
+			T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+		{
+			static utf8_string_in_t name() NOEXCEPT_SPEC
+			{
+				return "REAL";
+			}
+		};
+		template <typename T>
+		struct column_affinity<
+			T, typename std::enable_if<
+				   std::is_same<T, utf8_string_out_t>::value ||
+				   std::is_same<T, utf8_string_view_t>::value ||
+				   std::is_same<T, const char*>::value>::type>
+		{
+			static utf8_string_in_t name() NOEXCEPT_SPEC
+			{
+				return "TEXT";
+			}
+		};
+		template <>
+		struct column_affinity<blob_view_t>
+		{
+			static utf8_string_in_t name() NOEXCEPT_SPEC
+			{
+				return "BLOB";
+			}
+		};
+
+		///<summary>
+		/// What a constraint value means for a key of type
+		///<typeparamref name="Key"/>.
+		///</summary>
+		enum class key_bound
+		{
+			///<summary>No row can match, as for a NULL value.</summary>
+			empty,
+			///<summary>The converted value bounds the key.</summary>
+			value,
+			///<summary>The value cannot be converted; every row is
+			/// visited.</summary>
+			ignored
+		};
+
+		///<summary>
+		/// Converts constraint values to keys. The bound may be widened,
+		/// never narrowed, as SQLite checks the rows again.
+		///</summary>
+		template <typename Key, typename Enable = void>
+		struct key_traits
+		{
+			static key_bound read(sqlite3_value_t v, bool, Key& out)
+			{
+				if(::sqlite3_value_type(v) == SQLITE_NULL) {
+					return key_bound::empty;
+				}
+				out = value_traits<Key>::get(v);
+				return key_bound::value;
+			}
+		};
+		template <typename Key>
+		struct key_traits<
+			Key, typename std::enable_if<std::is_arithmetic<Key>::value>::type>
+		{
+			// isLower selects rounding down, for lower bounds, or up.
+			static key_bound read(sqlite3_value_t v, bool isLower, Key& out)
+			{
+				switch(::sqlite3_value_numeric_type(v)) {
+				case SQLITE_NULL:
+					return key_bound::empty;
+				case SQLITE_INTEGER:
+					if(!std::is_integral<Key>::value) break;
+					return from_integer(::sqlite3_value_int64(v), isLower, out);
+				case SQLITE_FLOAT:
+					break;
+				default:
+					// Text compares greater than any number.
+					return key_bound::ignored;
+				}
+				return from_real(::sqlite3_value_double(v), isLower, out,
+								 std::is_integral<Key>());
+			}
+
+		private:
+			// A bound beyond the keys on its own side excludes nothing; one
+			// beyond the other side excludes everything.
+			static key_bound outside(bool below, bool isLower) NOEXCEPT_SPEC
+			{
+				return below == isLower ? key_bound::ignored
+										: key_bound::empty;
+			}
+			static key_bound from_integer(sqlite3_int64_t i, bool isLower,
+										  Key& out) NOEXCEPT_SPEC
+			{
+				ALIAS_TYPE(std::numeric_limits<Key>, limits);
+				if(i < 0 &&
+				   (std::is_unsigned<Key>::value ||
+					i < static_cast<sqlite3_int64_t>(limits::min()))) {
+					return outside(true, isLower);
+				}
+				if(i > 0 &&
+				   static_cast<unsigned long long>(i) >
+					   static_cast<unsigned long long>(limits::max())) {
+					return outside(false, isLower);
+				}
+				out = static_cast<Key>(i);
+				return key_bound::value;
+			}
+			static key_bound from_real(double d, bool isLower, Key& out,
+									   std::true_type) NOEXCEPT_SPEC
+			{
+				if(std::isnan(d)) return key_bound::ignored;
+				d = isLower ? std::floor(d) : std::ceil(d);
+				// -2^63 and 2^63 are exact, unlike the limits of the key.
+				const auto two63 = 9223372036854775808.0;
+				if(d < -two63) return outside(true, isLower);
+				if(d < two63) {
+					return from_integer(static_cast<sqlite3_int64_t>(d),
+										isLower, out);
+				}
+				if(sizeof(Key) < sizeof(unsigned long long) ||
+				   std::is_signed<Key>::value || d >= 2 * two63) {
+					return outside(false, isLower);
+				}
+				out = static_cast<Key>(d);
+				return key_bound::value;
+			}
+			static key_bound from_real(double d, bool isLower, Key& out,
+									   std::false_type) NOEXCEPT_SPEC
+			{
+				ALIAS_TYPE(std::numeric_limits<Key>, limits);
+				if(std::isnan(d)) return key_bound::ignored;
+				// Only infinite keys lie beyond the finite limits, so a
+				// bound beyond them is clamped when it keeps those keys.
+				if(d > static_cast<double>(limits::max())) {
+					if(!isLower) return key_bound::ignored;
+					out = limits::max();
+					return key_bound::value;
+				}
+				if(d < static_cast<double>(limits::lowest())) {
+					if(isLower) return key_bound::ignored;
+					out = limits::lowest();
+					return key_bound::value;
+				}
+				out = static_cast<Key>(d);
+				// A narrower key rounds to nearest; step outwards instead.
+				if(isLower ? static_cast<double>(out) > d
+						   : static_cast<double>(out) < d) {
+					out = std::nextafter(out, isLower ? -limits::infinity()
+													  : limits::infinity());
+				}
+				return key_bound::value;
+			}
+		};
+		// Text bounds are compared as bytes, so only constraints with the
+		// BINARY collation are passed to cursors.
+		template <>
+		struct key_traits<utf8_string_out_t>
+		{
+			static key_bound read(sqlite3_value_t v, bool,
+								  utf8_string_out_t& out)
+			{
+				switch(::sqlite3_value_type(v)) {
+				case SQLITE_NULL:
+					return key_bound::empty;
+				case SQLITE_BLOB:
+					// Blobs compare greater than any text.
+					return key_bound::ignored;
+				default:
+					out = value_traits<utf8_string_out_t>::get(v);
+					return key_bound::value;
+				}
+			}
+		};
+
+		template <typename Row>
+		struct column_definition
+		{
+			utf8_string_out_t declaration;
+			std::function<void(sqlite3_context*, const Row&)> get;
+		};
+
+		template <typename Getter, typename Row>
+		struct column_reader
+		{
+			Getter getter;
+			void operator()(sqlite3_context* c, const Row& row) const
+			{
+				ALIAS_TYPE(WRAP_TEMPLATE(typename std::decay<decltype(
+										   getter(row))>::type),
+						   value_type);
+				result_traits<value_type>::set(c, getter(row));
+			}
+		};
+
+		template <typename Key, typename KeyOf>
+		struct key_less
+		{
+			KeyOf keyOf;
+			template <typename Row>
+			bool operator()(const Row& row, const Key& key) const
+			{
+				return keyOf(row) < key;
+			}
+			template <typename Row>
+			bool operator()(const Key& key, const Row& row) const
+			{
+				return key < keyOf(row);
+			}
+		};
+
+		utf8_string_out_t join_columns(
+			const utf8_string_out_t& key,
+			const std::vector<utf8_string_out_t>& others);
+	}
+
+	///<summary>
+	/// The columns of a virtual table over rows of type
+	///<typeparamref name="Row"/>, each read by a member pointer or a
+	/// callable taking a row.
+	///</summary>
+	///<example><code>
+	/// Sqlt3::table_columns&lt;trade&gt; columns;
+	/// columns.add("price", &amp;trade::price)
+	///     .add("notional",
+	///          [](const trade&amp; t) { return t.price * t.size; });
+	///</code></example>
+	template <typename Row>
+	class table_columns
+	{
+		std::vector<detail::column_definition<Row>> definitions;
+
+	public:
+		///<summary>Adds a column read from a data member.</summary>
+		///<param name="name">Name of the column.</param>
+		///<param name="member">The data member.</param>
+		template <typename T>
+		table_columns& add(utf8_string_in_t name, T Row::*member)
+		{
+			return add(name, [member](const Row& r) -> const T& {
+				return r.*member;
+			});
+		}
+		///<summary>Adds a column computed from a row.</summary>
+		///<param name="name">Name of the column.</param>
+		///<param name="getter">Callable taking a row and returning a
+		/// value of a type supported by <c>result_traits</c>.</param>
+		template <typename F>
+		table_columns& add(utf8_string_in_t name, F getter)
+		{
+			ALIAS_TYPE(WRAP_TEMPLATE(typename std::decay<decltype(getter(
+									   std::declval<const Row&>()))>::type),
+					   value_type);
+			detail::column_definition<Row> d;
+			d.declaration = name;
+			auto type = detail::column_affinity<value_type>::name();
+			if(*type != '\0') {
+				d.declaration += ' ';
+				d.declaration += type;
+			}
+			d.get = detail::column_reader<F, Row>{std::move(getter)};
+			definitions.push_back(std::move(d));
+			return *this;
+		}
+
+		///<summary>Number of columns.</summary>
+		std::size_t size() const NOEXCEPT_SPEC
+		{
+			return definitions.size();
+		}
+		///<summary>Accesses a column by its index.</summary>
+		const detail::column_definition<Row>& operator[](
+			std::size_t i) const NOEXCEPT_SPEC
+		{
+			return definitions[i];
+		}
+	};
+
+	///<summary>
+	/// A virtual table over a range of rows sorted by key, such as a sorted
+	///<c>std::vector</c> or a memory-mapped array of records. Equality and
+	/// range constraints on the key are answered by binary search, and
+	/// ORDER BY on the key needs no sort.
+	///</summary>
+	///<remarks>The range must outlive every connection using the table
+	/// and must not change while a statement reads it.</remarks>
+	template <typename Iterator, typename KeyOf>
+	class sorted_table : public virtual_table_source
+	{
+		ALIAS_TYPE(WRAP_TEMPLATE(typename std::iterator_traits<
+								 Iterator>::value_type),
+				   row_type);
+		ALIAS_TYPE(WRAP_TEMPLATE(typename std::decay<decltype(
+								 std::declval<KeyOf>()(
+									 std::declval<const row_type&>()))>::type),
+				   key_type);
+		ALIAS_TYPE(WRAP_TEMPLATE(detail::key_less<key_type, KeyOf>), less);
+
+		Iterator first;
+		Iterator last;
+		utf8_string_out_t keyName;
+		KeyOf keyOf;
+		table_columns<row_type> others;
+
+		class cursor : public virtual_table_cursor
+		{
+			const sorted_table& table;
+			Iterator current;
+			Iterator end;
+
+		public:
+			explicit cursor(const sorted_table& t)
+				: table(t), current(t.first), end(t.first)
+			{
+			}
+
+			void filter(const key_constraint& k) override
+			{
+				less compare{table.keyOf};
+				current = table.first;
+				end = table.last;
+				key_type key;
+				if(k.equal != nullptr) {
+					switch(detail::key_traits<key_type>::read(k.equal, true,
+															  key)) {
+					case detail::key_bound::empty:
+						end = current;
+						return;
+					case detail::key_bound::value: {
+						auto range = std::equal_range(current, end, key,
+													  compare);
+						current = range.first;
+						end = range.second;
+						return;
+					}
+					default:
+						return;
+					}
+				}
+				if(k.lower != nullptr) {
+					switch(detail::key_traits<key_type>::read(k.lower, true,
+															  key)) {
+					case detail::key_bound::empty:
+						end = current;
+						return;
+					case detail::key_bound::value:
+						current = k.lowerInclusive
+									  ? std::lower_bound(current, end, key,
+														 compare)
+									  : std::upper_bound(current, end, key,
+														 compare);
+						break;
+					default:
+						break;
+					}
+				}
+				if(k.upper != nullptr) {
+					switch(detail::key_traits<key_type>::read(k.upper, false,
+															  key)) {
+					case detail::key_bound::empty:
+						end = current;
+						return;
+					case detail::key_bound::value:
+						end = k.upperInclusive
+								  ? std::upper_bound(current, end, key,
+													 compare)
+								  : std::lower_bound(current, end, key,
+													 compare);
+						break;
+					default:
+						break;
+					}
+				}
+			}
+			bool eof() const override
+			{
+				return current == end;
+			}
+			void next() override
+			{
+				++current;
+			}
+			void column(sqlite3_context* c, int i) const override
+			{
+				if(i == 0) {
+					detail::result_traits<key_type>::set(c,
+														 table.keyOf(*current));
+				}
+				else {
+					table.others[static_cast<std::size_t>(i - 1)].get(c,
+																	  *current);
+				}
+			}
+			sqlite3_int64_t rowid() const override
+			{
+				return static_cast<sqlite3_int64_t>(
+					std::distance(table.first, current));
+			}
+		};
+
+	public:
+		///<summary>
+		/// Exposes a range of rows sorted in ascending order of key.
+		///</summary>
+		///<param name="first">First row.</param>
+		///<param name="last">Past the last row.</param>
+		///<param name="keyName">Name of the key column.</param>
+		///<param name="keyOf">Callable reading the key of a row.</param>
+		///<param name="columns">The other columns.</param>
+		sorted_table(Iterator first, Iterator last, utf8_string_in_t keyName,
+					 KeyOf keyOf, table_columns<row_type> columns)
+			: first(first), last(last), keyName(keyName),
+			  keyOf(std::move(keyOf)), others(std::move(columns))
+		{
+		}
+
+		utf8_string_out_t columns() const override
+		{
+			std::vector<utf8_string_out_t> declarations;
+			for(std::size_t i = 0; i < others.size(); ++i) {
+				declarations.push_back(others[i].declaration);
+			}
+			auto key = keyName;
+			auto type = detail::column_affinity<key_type>::name();
+			if(*type != '\0') key = key + ' ' + type;
+			return detail::join_columns(key, declarations);
+		}
+		std::size_t row_count() const override
+		{
+			return static_cast<std::size_t>(std::distance(first, last));
+		}
+		key_access access() const override
+		{
+			return key_access::ordered;
+		}
+		bool unique_keys() const override
+		{
+			return false;
+		}
+		std::unique_ptr<virtual_table_cursor> open() const override
+		{
+			return std::unique_ptr<virtual_table_cursor>(new cursor(*this));
+		}
+	};
+
+	///<summary>
+	/// A virtual table over a hash map, such as a
+	///<c>std::unordered_map</c>, whose key is the first column. Equality
+	/// constraints on the key are answered by lookup.
+	///</summary>
+	///<remarks>The map must outlive every connection using the table and
+	/// must not change while a statement reads it.</remarks>
+	template <typename Map>
+	class hash_map_table : public virtual_table_source
+	{
+		ALIAS_TYPE(typename Map::value_type, row_type);
+		ALIAS_TYPE(typename Map::key_type, key_type);
+		ALIAS_TYPE(typename Map::const_iterator, iterator);
+
+		const Map& map;
+		utf8_string_out_t keyName;
+		table_columns<row_type> others;
+
+		class cursor : public virtual_table_cursor
+		{
+			const hash_map_table& table;
+			iterator current;
+			iterator end;
+			sqlite3_int64_t position = 0;
+
+		public:
+			explicit cursor(const hash_map_table& t)
+				: table(t), current(t.map.end()), end(t.map.end())
+			{
+			}
+
+			void filter(const key_constraint& k) override
+			{
+				current = table.map.begin();
+				end = table.map.end();
+				position = 0;
+				key_type key;
+				if(k.equal == nullptr) return;
+				switch(detail::key_traits<key_type>::read(k.equal, true, key)) {
+				case detail::key_bound::empty:
+					current = end;
+					return;
+				case detail::key_bound::value: {
+					auto range = table.map.equal_range(key);
+					current = range.first;
+					end = range.second;
+					return;
+				}
+				default:
+					return;
+				}
+			}
+			bool eof() const override
+			{
+				return current == end;
+			}
+			void next() override
+			{
+				++current;
+				++position;
+			}
+			void column(sqlite3_context* c, int i) const override
+			{
+				if(i == 0) {
+					detail::result_traits<key_type>::set(c, current->first);
+				}
+				else {
+					table.others[static_cast<std::size_t>(i - 1)].get(c,
+																	  *current);
+				}
+			}
+			sqlite3_int64_t rowid() const override
+			{
+				return position;
+			}
+		};
+
+	public:
+		///<summary>
+		/// Exposes a hash map.
+		///</summary>
+		///<param name="map">The map.</param>
+		///<param name="keyName">Name of the key column.</param>
+		///<param name="columns">The other columns, read from the entries
+		/// of the map.</param>
+		hash_map_table(const Map& map, utf8_string_in_t keyName,
+					   table_columns<row_type> columns)
+			: map(map), keyName(keyName), others(std::move(columns))
+		{
+		}
+
+		utf8_string_out_t columns() const override
+		{
+			std::vector<utf8_string_out_t> declarations;
+			for(std::size_t i = 0; i < others.size(); ++i) {
+				declarations.push_back(others[i].declaration);
+			}
+			auto key = keyName;
+			auto type = detail::column_affinity<key_type>::name();
+			if(*type != '\0') key = key + ' ' + type;
+			return detail::join_columns(key, declarations);
+		}
+		std::size_t row_count() const override
+		{
+			return map.size();
+		}
+		key_access access() const override
+		{
+			return key_access::equality;
+		}
+		bool unique_keys() const override
+		{
+			// Only maps with unique keys report whether an insert
+			// happened.
+			return !std::is_same<decltype(std::declval<Map&>().insert(
+									 std::declval<const row_type&>())),
+								 iterator>::value &&
+				   !std::is_same<decltype(std::declval<Map&>().insert(
+									 std::declval<const row_type&>())),
+								 typename Map::iterator>::value;
+		}
+		std::unique_ptr<virtual_table_cursor> open() const override
+		{
+			return std::unique_ptr<virtual_table_cursor>(new cursor(*this));
+		}
+	};
+
+	///<summary>
+	/// Creates a <see cref="sorted_table"/> over a range of rows sorted by
+	/// key.
+	///</summary>
+	template <typename Iterator, typename KeyOf>
+	std::shared_ptr<sorted_table<Iterator, KeyOf>> make_sorted_table(
+		Iterator first, Iterator last, utf8_string_in_t keyName, KeyOf keyOf,
+		table_columns<typename std::iterator_traits<Iterator>::value_type>
+			columns)
+	{
+		return std::make_shared<sorted_table<Iterator, KeyOf>>(
+			first, last, keyName, std::move(keyOf), std::move(columns));
+	}
+	///<summary>
+	/// Creates a <see cref="hash_map_table"/> over a map.
+	///</summary>
+	template <typename Map>
+	std::shared_ptr<hash_map_table<Map>> make_hash_map_table(
+		const Map& map, utf8_string_in_t keyName,
+		table_columns<typename Map::value_type> columns)
+	{
+		return std::make_shared<hash_map_table<Map>>(map, keyName,
+													 std::move(columns));
+	}
+
+	///<summary>
+	///<see cref="https://www.sqlite.org/c3ref/create_module.html"/>.
+	/// Registers a source as an eponymous, read-only virtual table, which
+	/// can be queried by the given name without CREATE VIRTUAL TABLE.
+	///</summary>
+	///<remarks>
+	/// The best index for a query is chosen from the key constraints:
+	/// a lookup for equality, costing a constant for a hash map or the
+	/// logarithm of the row count for a sorted source; a binary search for
+	/// a range, of which each bound is assumed to keep a quarter of the
+	/// rows; or a scan of every row. Constraints are not omitted, so
+	/// SQLite checks each row visited again and converts values exactly as
+	/// for a real table.
+	///</remarks>
+	///<param name="connection">Connection to register the table on.</param>
+	///<param name="name">Name of the table.</param>
+	///<param name="source">The data, shared with the connection.</param>
+	///<exception name="std::runtime_error"/>
+	///<example><code>
+	/// std::vector&lt;trade&gt; trades = load(); // sorted by id
+	/// Sqlt3::table_columns&lt;trade&gt; columns;
+	/// columns.add("price", &amp;trade::price);
+	/// Sqlt3::sqlite3_create_module_v2(
+	///     db, "trades",
+	///     Sqlt3::make_sorted_table(trades.begin(), trades.end(), "id",
+	///                              [](const trade&amp; t) { return t.id; },
+	///                              columns));
+	/// // SELECT price FROM trades WHERE id BETWEEN ?1 AND ?2
+	///</code></example>
+	void sqlite3_create_module_v2(
+		sqlite3_t connection, utf8_string_in_t name,
+		std::shared_ptr<const virtual_table_source> source);
+}
+
+#define SQLITEVIRTUALTABLE_HPP
+#endif// SQLITEVIRTUALTABLE_HPP
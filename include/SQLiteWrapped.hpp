@@ -32,7 +32,10 @@ Purpose:
 
 #if !defined(SQLITEWRAPPED_HPP)
 #include "sqlite3.h"
+#include <cstddef>
 #include <memory>
+#include <new>
+#include <stdexcept>
 #include <string>
 #include <tuple>
 
@@ -66,11 +69,20 @@ Purpose:
 #endif// defined(USE_CONSTEXPR)
 #endif//!defined(CONSTEXPR_SPEC)
 
+#if defined(USE_VIEW_CHECKS)
+#include <cassert>
+#endif// defined(USE_VIEW_CHECKS)
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif// __cplusplus >= 201703L
+
 namespace Sqlt3
 {
 	ALIAS_TYPE(::sqlite3*, sqlite3_t);
 	ALIAS_TYPE(::sqlite3_stmt*, sqlite3_stmt_t);
 	ALIAS_TYPE(::sqlite3_backup*, sqlite3_backup_t);
+	ALIAS_TYPE(::sqlite3_blob*, sqlite3_blob_t);
 	ALIAS_TYPE(::sqlite3_value*, sqlite3_value_t);
 	ALIAS_TYPE(::sqlite3_int64, sqlite3_int64_t);
 	ALIAS_TYPE(::sqlite3_uint64, sqlite3_uint64_t);
@@ -175,6 +187,11 @@ namespace Sqlt3
 			ALIAS_TYPE(sqlite3_backup_t, pointer);
 			void operator()(pointer p) const NOEXCEPT_SPEC;
 		};
+		struct BlobDeleter
+		{
+			ALIAS_TYPE(sqlite3_blob_t, pointer);
+			void operator()(pointer p) const NOEXCEPT_SPEC;
+		};
 		struct ConnectionDeleter
 		{
 			ALIAS_TYPE(sqlite3_t, pointer);
@@ -281,6 +298,13 @@ namespace Sqlt3
 		WRAP_TEMPLATE(std::unique_ptr<sqlite3_backup_t, detail::BackupDeleter>),
 		unique_backup);
 	///<summary>
+	/// RAII wrapper of an incremental blob I/O handle. Upon destruction,
+	/// automatically closes the handle. Errors on closure are not thrown.
+	///</summary>
+	ALIAS_TYPE(
+		WRAP_TEMPLATE(std::unique_ptr<sqlite3_blob_t, detail::BlobDeleter>),
+		unique_blob);
+	///<summary>
 	/// RAII wrapper of a database connection. Upon destruction, automatically
 	/// closes the connection. Errors on closure are not thrown.
 	///</summary>
@@ -311,6 +335,498 @@ namespace Sqlt3
 	///</summary>
 	ALIAS_TYPE(std::u16string, utf16_string_out_t);
 
+	namespace detail
+	{
+		///<summary>
+		/// Retrieves a value that changes whenever the provided prepared
+		/// statement is stepped, reset or finalized through this wrapper,
+		/// starting to track the statement if it is not yet tracked.
+		///</summary>
+		unsigned long long statement_generation(sqlite3_stmt_t stmt)
+			NOEXCEPT_SPEC;
+		///<summary>
+		/// Marks all views into the results of the provided prepared statement
+		/// as invalid. Statements no view was taken of are not tracked.
+		///</summary>
+		void invalidate_views(sqlite3_stmt_t stmt) NOEXCEPT_SPEC;
+
+		///<summary>
+		/// Records which prepared statement a view points into, so that
+		/// checked builds can detect use of the view after the statement has
+		/// moved on. Checks are enabled by defining <c>USE_VIEW_CHECKS</c>
+		/// when building both the library and its users; the layout is the
+		/// same either way.
+		///</summary>
+		class view_origin_t
+		{
+			sqlite3_stmt_t owner = nullptr;
+			unsigned long long generation = 0;
+
+		public:
+			view_origin_t() NOEXCEPT_SPEC = default;
+#if defined(USE_VIEW_CHECKS)
+			explicit view_origin_t(sqlite3_stmt_t owner) NOEXCEPT_SPEC
+				: owner(owner),
+				  generation(statement_generation(owner))
+			{
+			}
+#else
+			explicit view_origin_t(sqlite3_stmt_t owner) NOEXCEPT_SPEC
+				: owner(owner)
+			{
+			}
+#endif// defined(USE_VIEW_CHECKS)
+
+			void check() const NOEXCEPT_SPEC
+			{
+#if defined(USE_VIEW_CHECKS)
+				assert((owner == nullptr ||
+						statement_generation(owner) == generation) &&
+					   "View used after sqlite3_step, sqlite3_reset or "
+					   "sqlite3_finalize");
+#endif// defined(USE_VIEW_CHECKS)
+			}
+		};
+
+		template <typename CharT>
+		class text_view_t
+		{
+		public:
+			ALIAS_TYPE(CharT, value_type);
+			ALIAS_TYPE(std::size_t, size_type);
+			ALIAS_TYPE(const CharT*, const_pointer);
+			ALIAS_TYPE(const CharT*, const_iterator);
+			ALIAS_TYPE(std::char_traits<CharT>, traits_type);
+
+		private:
+			const_pointer first = nullptr;
+			size_type count = 0;
+			view_origin_t origin;
+
+		public:
+			text_view_t() NOEXCEPT_SPEC = default;
+			text_view_t(const_pointer str) NOEXCEPT_SPEC
+				: first(str),
+				  count(str == nullptr ? 0 : traits_type::length(str))
+			{
+			}
+			text_view_t(const_pointer str, size_type length) NOEXCEPT_SPEC
+				: first(str),
+				  count(length)
+			{
+			}
+			text_view_t(const_pointer str, size_type length,
+						view_origin_t origin) NOEXCEPT_SPEC : first(str),
+															  count(length),
+															  origin(origin)
+			{
+			}
+			template <typename Traits, typename Alloc>
+			text_view_t(const std::basic_string<CharT, Traits, Alloc>& str)
+				NOEXCEPT_SPEC : first(str.data()),
+								count(str.size())
+			{
+			}
+#if defined(__cpp_lib_string_view)
+			template <typename Traits>
+			text_view_t(std::basic_string_view<CharT, Traits> str)
+				NOEXCEPT_SPEC : first(str.data()),
+								count(str.size())
+			{
+			}
+#endif// defined(__cpp_lib_string_view)
+
+			const_pointer data() const NOEXCEPT_SPEC
+			{
+				origin.check();
+				return first;
+			}
+			size_type size() const NOEXCEPT_SPEC
+			{
+				return count;
+			}
+			size_type length() const NOEXCEPT_SPEC
+			{
+				return count;
+			}
+			bool empty() const NOEXCEPT_SPEC
+			{
+				return count == 0;
+			}
+			const_iterator begin() const NOEXCEPT_SPEC
+			{
+				return data();
+			}
+			const_iterator end() const NOEXCEPT_SPEC
+			{
+				return data() + count;
+			}
+			const value_type& operator[](size_type i) const NOEXCEPT_SPEC
+			{
+				return data()[i];
+			}
+
+			///<summary>Copies the viewed text into an owning string.
+			///</summary>
+			std::basic_string<CharT> str() const
+			{
+				if(count == 0) return std::basic_string<CharT>();
+				return std::basic_string<CharT>(data(), count);
+			}
+#if __cplusplus >= 201703L
+			operator std::basic_string_view<CharT>() const NOEXCEPT_SPEC
+			{
+				return std::basic_string_view<CharT>(data(), count);
+			}
+#endif// __cplusplus >= 201703L
+		};
+
+		///<summary>
+		/// Whether <typeparamref name="T"/> is a string type, whose
+		/// characters are text rather than bytes of a blob.
+		///</summary>
+		template <typename T>
+		struct is_string_type : std::false_type
+		{
+		};
+		template <typename CharT, typename Traits, typename Alloc>
+		struct is_string_type<std::basic_string<CharT, Traits, Alloc>>
+			: std::true_type
+		{
+		};
+		template <typename CharT>
+		struct is_string_type<text_view_t<CharT>> : std::true_type
+		{
+		};
+#if __cplusplus >= 201703L
+		template <typename CharT, typename Traits>
+		struct is_string_type<std::basic_string_view<CharT, Traits>>
+			: std::true_type
+		{
+		};
+#endif// __cplusplus >= 201703L
+
+		class blob_view_t
+		{
+		public:
+			ALIAS_TYPE(unsigned char, value_type);
+			ALIAS_TYPE(std::size_t, size_type);
+			ALIAS_TYPE(const unsigned char*, const_iterator);
+
+		private:
+			const void* first = nullptr;
+			size_type count = 0;
+			view_origin_t origin;
+
+		public:
+			blob_view_t() NOEXCEPT_SPEC = default;
+			blob_view_t(const void* blob, size_type bytes) NOEXCEPT_SPEC
+				: first(blob),
+				  count(bytes)
+			{
+			}
+			blob_view_t(const void* blob, size_type bytes,
+						view_origin_t origin) NOEXCEPT_SPEC : first(blob),
+															  count(bytes),
+															  origin(origin)
+			{
+			}
+			// Contiguous containers of trivially copyable values, other
+			// than strings.
+			template <typename Container,
+					  typename Element = typename std::decay<decltype(
+						  *std::declval<const Container&>().data())>::type,
+					  typename Size = decltype(
+						  std::declval<const Container&>().size()),
+					  typename = typename std::enable_if<
+						  std::is_trivially_copyable<Element>::value &&
+						  std::is_integral<Size>::value &&
+						  !is_string_type<Container>::value>::type>
+			blob_view_t(const Container& bytes) NOEXCEPT_SPEC
+				: first(bytes.data()),
+				  count(bytes.size() * sizeof(Element))
+			{
+			}
+
+			const void* data() const NOEXCEPT_SPEC
+			{
+				origin.check();
+				return first;
+			}
+			size_type size() const NOEXCEPT_SPEC
+			{
+				return count;
+			}
+			bool empty() const NOEXCEPT_SPEC
+			{
+				return count == 0;
+			}
+			const_iterator begin() const NOEXCEPT_SPEC
+			{
+				return static_cast<const_iterator>(data());
+			}
+			const_iterator end() const NOEXCEPT_SPEC
+			{
+				return begin() + count;
+			}
+			value_type operator[](size_type i) const NOEXCEPT_SPEC
+			{
+				return begin()[i];
+			}
+		};
+	}
+
+	///<summary>
+	/// A non-owning view of UTF-8 text. Views produced by
+	///<see cref="sqlite3_column_text_view"/> point into memory owned by SQLite.
+	///</summary>
+	ALIAS_TYPE(detail::text_view_t<char>, utf8_string_view_t);
+	///<summary>
+	/// A non-owning view of UTF-16 text. Views produced by
+	///<see cref="sqlite3_column_text16_view"/> point into memory owned by
+	/// SQLite.
+	///</summary>
+	ALIAS_TYPE(detail::text_view_t<char16_t>, utf16_string_view_t);
+	///<summary>
+	/// A non-owning view of a blob of bytes. Views produced by
+	///<see cref="sqlite3_column_blob_view"/> point into memory owned by SQLite.
+	///</summary>
+	ALIAS_TYPE(detail::blob_view_t, blob_view_t);
+
+	namespace detail
+	{
+		///<summary>
+		/// The pointer to bind for viewed data. Views of nothing may hold
+		/// nullptr, which SQLite would bind as NULL rather than as an empty
+		/// value.
+		///</summary>
+		inline const void* bind_data(const void* data,
+									 std::size_t bytes) NOEXCEPT_SPEC
+		{
+			return bytes == 0 ? "" : data;
+		}
+		///<summary>
+		/// The pointer to bind for viewed data released by
+		///<paramref name="destructor"/>. Only data that the destructor does
+		/// not own is replaced, in which case the destructor becomes
+		///<see cref="SQLITE_STATIC"/>, so that SQLite never passes the
+		/// replacement to it and the caller's buffer is still released.
+		///</summary>
+		inline const void* bind_data(
+			const void* data, std::size_t bytes,
+			sqlite3_destructor_type_t& destructor) NOEXCEPT_SPEC
+		{
+			if(bytes != 0) return data;
+			if(data != nullptr && destructor != SQLITE_STATIC &&
+			   destructor != SQLITE_TRANSIENT) {
+				return data;
+			}
+			destructor = SQLITE_STATIC;
+			return "";
+		}
+	}
+
+	///<summary>
+	/// The exception thrown for failed result codes. Carries the result code
+	/// of the failed call and the extended result code of the connection.
+	/// The message is formatted when the exception is constructed, so
+	///<see cref="what"/> only reads it and may be called concurrently, as
+	/// when one <c>std::exception_ptr</c> is shared between threads.
+	///</summary>
+	///<remarks>Constructing the exception does not allocate; the message of
+	/// the connection, if any, is copied into a fixed size buffer and
+	/// truncated if necessary. To branch on expected failures such as
+	///<see cref="SQLITE_BUSY"/> without throwing at all, use the overloads
+	/// taking <c>std::nothrow</c>.</remarks>
+	class sqlite3_error : public std::runtime_error
+	{
+		int resultCode;
+		int extendedCode;
+		// "SQLite error(code): description", with the description starting
+		// at descriptionOffset.
+		char text[288];
+		std::size_t descriptionOffset;
+
+		void format(utf8_string_in_t description) NOEXCEPT_SPEC;
+
+	public:
+		///<summary>
+		/// Describes a result code with <see cref="sqlite3_errstr"/>.
+		///</summary>
+		///<param name="code">Result code of the failed call.</param>
+		explicit sqlite3_error(int code);
+		///<summary>
+		/// Describes a result code with the current error message and
+		/// extended result code of a connection.
+		///</summary>
+		///<param name="code">Result code of the failed call.</param>
+		///<param name="connection">Connection the call failed on.</param>
+		sqlite3_error(int code, sqlite3_t connection);
+		///<summary>
+		/// Describes a result code with the provided message.
+		///</summary>
+		///<param name="code">Result code of the failed call.</param>
+		///<param name="message">Error message, which is copied.</param>
+		sqlite3_error(int code, utf8_string_in_t message);
+		///<summary>
+		/// Describes a result code with the provided extended result code
+		/// and message, as captured from a connection when the call failed.
+		///</summary>
+		///<param name="code">Result code of the failed call.</param>
+		///<param name="extended">Extended result code of the failure.
+		///</param>
+		///<param name="message">Error message, which is copied.</param>
+		sqlite3_error(int code, int extended, utf8_string_in_t message);
+
+		///<summary>The result code returned by the failed call.</summary>
+		int code() const NOEXCEPT_SPEC;
+		///<summary>The primary result code, such as
+		///<see cref="SQLITE_BUSY"/>.</summary>
+		int primary_code() const NOEXCEPT_SPEC;
+		///<summary>The extended result code, such as
+		///<see cref="SQLITE_BUSY_SNAPSHOT"/>, if known, otherwise the
+		/// result code.</summary>
+		int extended_code() const NOEXCEPT_SPEC;
+		///<summary>The description of the error, without the code.
+		///</summary>
+		const char* description() const NOEXCEPT_SPEC;
+		///<summary>
+		/// The message, of the form "SQLite error(code): description".
+		///</summary>
+		const char* what() const noexcept override;
+	};
+
+	namespace detail
+	{
+		class result_base_t
+		{
+		protected:
+			int resultCode;
+			int extendedCode;
+			// The message of the connection when the call failed, truncated
+			// to fit; empty if the call succeeded or no connection was
+			// available. Kept in place so that failures do not allocate.
+			char message[256];
+
+			explicit result_base_t(int code) NOEXCEPT_SPEC
+				: resultCode(code),
+				  extendedCode(code)
+			{
+				message[0] = '\0';
+			}
+			///<summary>
+			/// Captures the extended result code and message of the
+			/// connection if the call failed, as the connection may have
+			/// moved on by the time the result is checked.
+			///</summary>
+			result_base_t(int code, sqlite3_t connection) NOEXCEPT_SPEC;
+
+		public:
+			///<summary>Whether the call succeeded.</summary>
+			bool ok() const NOEXCEPT_SPEC
+			{
+				return primary_code() == SQLITE_OK ||
+					   primary_code() == SQLITE_ROW ||
+					   primary_code() == SQLITE_DONE;
+			}
+			explicit operator bool() const NOEXCEPT_SPEC
+			{
+				return ok();
+			}
+			///<summary>The result code returned by the call.</summary>
+			int code() const NOEXCEPT_SPEC
+			{
+				return resultCode;
+			}
+			///<summary>The primary result code.</summary>
+			int primary_code() const NOEXCEPT_SPEC
+			{
+				return resultCode & 0xff;
+			}
+			///<summary>The extended result code, if captured from the
+			/// connection, otherwise the result code.</summary>
+			int extended_code() const NOEXCEPT_SPEC
+			{
+				return extendedCode;
+			}
+			///<summary>
+			/// Throws a <see cref="sqlite3_error"/> if the call failed.
+			///</summary>
+			///<exception name="sqlite3_error"/>
+			void check() const;
+		};
+
+		///<summary>
+		/// The outcome of a call that does not throw: a result code and, if
+		/// the call succeeded, a value.
+		///</summary>
+		template <typename T>
+		class result_t : public result_base_t
+		{
+			T result;
+
+		public:
+			explicit result_t(int code) : result_base_t(code), result()
+			{
+			}
+			result_t(int code, sqlite3_t connection)
+				: result_base_t(code, connection),
+				  result()
+			{
+			}
+			result_t(int code, T value)
+				: result_base_t(code),
+				  result(std::move(value))
+			{
+			}
+
+			///<summary>The value, if the call succeeded.</summary>
+			///<exception name="sqlite3_error">The call failed.</exception>
+			T& value()
+			{
+				check();
+				return result;
+			}
+			///<summary>The value, if the call succeeded.</summary>
+			///<exception name="sqlite3_error">The call failed.</exception>
+			const T& value() const
+			{
+				check();
+				return result;
+			}
+			///<summary>The value, which is default constructed if the call
+			/// failed.</summary>
+			T& operator*() NOEXCEPT_SPEC
+			{
+				return result;
+			}
+			const T& operator*() const NOEXCEPT_SPEC
+			{
+				return result;
+			}
+			T* operator->() NOEXCEPT_SPEC
+			{
+				return &result;
+			}
+			const T* operator->() const NOEXCEPT_SPEC
+			{
+				return &result;
+			}
+		};
+		template <>
+		class result_t<void> : public result_base_t
+		{
+		public:
+			explicit result_t(int code) NOEXCEPT_SPEC : result_base_t(code)
+			{
+			}
+			result_t(int code, sqlite3_t connection) NOEXCEPT_SPEC
+				: result_base_t(code, connection)
+			{
+			}
+		};
+	}
+
 	const CONSTEXPR_SPEC auto sqlite_dbstatus_lookaside_used =
 		db_status_t(SQLITE_DBSTATUS_LOOKASIDE_USED);
 	const CONSTEXPR_SPEC auto sqlite_dbstatus_cache_used =
@@ -528,6 +1044,24 @@ namespace Sqlt3
 			ALIAS_TYPE(int, result_type);
 			ALIAS_TYPE(result_type, param_type);
 		};
+
+		template <std::size_t... I>
+		struct index_sequence
+		{
+		};
+		///<summary>
+		/// Compile-time sequence of the indices 0 to N - 1, for expanding
+		/// parameter packs and tuples. The sequence is the nested type.
+		///</summary>
+		template <std::size_t N, std::size_t... I>
+		struct make_index_sequence : make_index_sequence<N - 1, N - 1, I...>
+		{
+		};
+		template <std::size_t... I>
+		struct make_index_sequence<0, I...>
+		{
+			ALIAS_TYPE(index_sequence<I...>, type);
+		};
 	}
 
 	///<summary>
@@ -584,6 +1118,19 @@ namespace Sqlt3
 	///</returns>
 	///<exception name="std::runtime_error"/>
 	step_result_t sqlite3_backup_step(sqlite3_backup_t backup, int numPages);
+	///<summary>
+	/// Copies up to <paramref name="numPages"/> pages from the source database
+	/// to the destination, reporting errors through the result rather than
+	/// throwing.
+	///</summary>
+	///<param name="backup">Backup process.</param>
+	///<param name="numPages">Number of pages to copy. If negative, all
+	/// remaining pages are copied.</param>
+	///<returns>The result code and, on success, <see cref="sqlite_ok"/> or
+	///<see cref="sqlite_done"/>.</returns>
+	detail::result_t<step_result_t>
+		sqlite3_backup_step(sqlite3_backup_t backup, int numPages,
+							const std::nothrow_t&) NOEXCEPT_SPEC;
 
 	///<summary>
 	///<see cref="https://www.sqlite.org/c3ref/bind_blob.html"/>.
@@ -652,6 +1199,24 @@ namespace Sqlt3
 					  const sqlite3_value_t data);
 	///<summary>
 	///<see cref="https://www.sqlite.org/c3ref/bind_blob.html"/>.
+	/// Binds a blob of data to a specified bind point in a prepared statement.
+	///</summary>
+	///<param name="stmt">Prepared statement with bind points.</param>
+	///<param name="index">Index of a bind point to bind the data to.</param>
+	///<param name="blob">View of the bytes to bind. Any contiguous container
+	/// of trivially copyable values, other than a string, converts to a view.
+	/// An empty view binds a zero-length blob.</param>
+	///<param name="destruct">A destructor function for the viewed data,
+	///<see cref="sqlite_static"/> to bind the data without copying it or
+	///<see cref="sqlite_transient"/> to have SQLite copy it.</param>
+	///<exception name="std::runtime_error"/>
+	///<remarks>With <see cref="sqlite_static"/>, the viewed data must remain
+	/// valid until the bind point is rebound or the statement is finalized.
+	///</remarks>
+	void sqlite3_bind(sqlite3_stmt_t stmt, int index, blob_view_t blob,
+					  sqlite3_destructor_type_t destruct);
+	///<summary>
+	///<see cref="https://www.sqlite.org/c3ref/bind_blob.html"/>.
 	/// Binds null to a specified bind point in a prepared statement.
 	///</summary>
 	///<param name="stmt">Prepared statement with bind points.</param>
@@ -698,6 +1263,8 @@ namespace Sqlt3
 	///<param name="index">Index of a bind point.</param>
 	///<param name="text">Text to bind.</param>
 	///<exception name="std::runtime_error"/>
+	///<remarks>The length of the text is measured and SQLite makes a private
+	/// copy of it.</remarks>
 	void sqlite3_bind_text(sqlite3_stmt_t stmt, int index,
 						   utf8_string_in_t text);
 	///<summary>
@@ -708,10 +1275,48 @@ namespace Sqlt3
 	///<param name="index">Index of a bind point.</param>
 	///<param name="text">Text to bind.</param>
 	///<exception name="std::runtime_error"/>
+	///<remarks>The length of the text is measured and SQLite makes a private
+	/// copy of it.</remarks>
 	void sqlite3_bind_text(sqlite3_stmt_t stmt, int index,
 						   utf16_string_in_t text);
 	///<summary>
 	///<see cref="https://www.sqlite.org/c3ref/bind_blob.html"/>.
+	/// Binds a UTF-8 string of known length to a specified bind point in a
+	/// prepared statement.
+	///</summary>
+	///<param name="stmt">Prepared statement.</param>
+	///<param name="index">Index of a bind point.</param>
+	///<param name="text">View of the text to bind.</param>
+	///<param name="destruct">A destructor function for the viewed text,
+	///<see cref="sqlite_static"/> to bind the text without copying it or
+	///<see cref="sqlite_transient"/> to have SQLite copy it.</param>
+	///<exception name="std::runtime_error"/>
+	///<remarks>With <see cref="sqlite_static"/>, the viewed text must remain
+	/// valid until the bind point is rebound or the statement is finalized.
+	///</remarks>
+	void sqlite3_bind_text(sqlite3_stmt_t stmt, int index,
+						   utf8_string_view_t text,
+						   sqlite3_destructor_type_t destruct);
+	///<summary>
+	///<see cref="https://www.sqlite.org/c3ref/bind_blob.html"/>.
+	/// Binds a UTF-16 string of known length to a specified bind point in a
+	/// prepared statement.
+	///</summary>
+	///<param name="stmt">Prepared statement.</param>
+	///<param name="index">Index of a bind point.</param>
+	///<param name="text">View of the text to bind.</param>
+	///<param name="destruct">A destructor function for the viewed text,
+	///<see cref="sqlite_static"/> to bind the text without copying it or
+	///<see cref="sqlite_transient"/> to have SQLite copy it.</param>
+	///<exception name="std::runtime_error"/>
+	///<remarks>With <see cref="sqlite_static"/>, the viewed text must remain
+	/// valid until the bind point is rebound or the statement is finalized.
+	///</remarks>
+	void sqlite3_bind_text(sqlite3_stmt_t stmt, int index,
+						   utf16_string_view_t text,
+						   sqlite3_destructor_type_t destruct);
+	///<summary>
+	///<see cref="https://www.sqlite.org/c3ref/bind_blob.html"/>.
 	/// Binds a string with some encoding to a specified bind point in a
 	/// prepared statement.
 	///</summary>
@@ -733,6 +1338,101 @@ namespace Sqlt3
 	///<param name="bytes">Number of zeroed bytes to bind.</param>
 	///<exception name="std::runtime_error"/>
 	void sqlite3_bind_zeroblob(sqlite3_stmt_t stmt, int index, int bytes);
+	///<summary>
+	///<see cref="https://www.sqlite.org/c3ref/bind_blob.html"/>.
+	/// Binds a zero-initialised blob to a specified bind point in a prepared
+	/// statement, reserving space for a blob too large to hold in memory,
+	/// which is then written with <see cref="sqlite3_blob_write"/>.
+	///</summary>
+	///<param name="stmt">Prepared statement.</param>
+	///<param name="index">Index of a bind point.</param>
+	///<param name="bytes">Number of zeroed bytes to bind.</param>
+	///<exception name="std::runtime_error"/>
+	void sqlite3_bind_zeroblob64(sqlite3_stmt_t stmt, int index,
+								 sqlite3_uint64_t bytes);
+
+	///<summary>
+	///<see cref="https://www.sqlite.org/c3ref/blob_bytes.html"/>.
+	/// Retrieves the size of the blob an incremental blob I/O handle is open
+	/// on. The size cannot be changed through the handle.
+	///</summary>
+	///<param name="blob">Blob handle.</param>
+	///<returns>Size of the blob in bytes.</returns>
+	int sqlite3_blob_bytes(sqlite3_blob_t blob) NOEXCEPT_SPEC;
+	///<summary>
+	///<see cref="https://www.sqlite.org/c3ref/blob_close.html"/>.
+	/// Closes an incremental blob I/O handle, committing the implicit
+	/// transaction of its writes if no other statement is active.
+	///</summary>
+	///<param name="blob">RAII wrapper of a blob handle. The handle is
+	/// closed even if an error is thrown.</param>
+	///<exception name="std::runtime_error"/>
+	void sqlite3_blob_close(unique_blob&& blob);
+	///<summary>
+	///<see cref="https://www.sqlite.org/c3ref/blob_open.html"/>.
+	/// Opens a handle to read and write a blob in place, a range of bytes at
+	/// a time, without loading the whole value into memory.
+	///</summary>
+	///<param name="connection">Database connection.</param>
+	///<param name="dbName">Name of the database, such as "main".</param>
+	///<param name="table">Name of the table.</param>
+	///<param name="column">Name of the column.</param>
+	///<param name="row">Rowid of the row.</param>
+	///<param name="writable">Whether the handle may write.</param>
+	///<returns>RAII wrapper around the new blob handle.</returns>
+	///<exception name="std::runtime_error"/>
+	///<example><code>
+	/// auto insert = Sqlt3::sqlite3_prepare_v2(
+	///     db, "INSERT INTO files(data) VALUES(?1)");
+	/// Sqlt3::sqlite3_bind_zeroblob64(
+	///     std::get&lt;0&gt;(insert).get(), 1, size);
+	/// Sqlt3::sqlite3_step(std::get&lt;0&gt;(insert).get());
+	/// auto blob = Sqlt3::sqlite3_blob_open(
+	///     db, "main", "files", "data", ::sqlite3_last_insert_rowid(db),
+	///     true);
+	/// for(int offset = 0; offset &lt; size; offset += chunk) {
+	///     // Fill buffer with the next chunk.
+	///     Sqlt3::sqlite3_blob_write(blob.get(), buffer, chunk, offset);
+	/// }
+	///</code></example>
+	unique_blob sqlite3_blob_open(sqlite3_t connection, utf8_string_in_t dbName,
+								  utf8_string_in_t table,
+								  utf8_string_in_t column, sqlite3_int64_t row,
+								  bool writable);
+	///<summary>
+	///<see cref="https://www.sqlite.org/c3ref/blob_read.html"/>.
+	/// Reads a range of bytes of a blob.
+	///</summary>
+	///<param name="blob">Blob handle.</param>
+	///<param name="buffer">Destination of the bytes.</param>
+	///<param name="bytes">Number of bytes to read.</param>
+	///<param name="offset">Offset in the blob of the first byte.</param>
+	///<exception name="std::runtime_error">The range extends beyond the
+	/// blob, or the row was changed, which aborts the handle.</exception>
+	void sqlite3_blob_read(sqlite3_blob_t blob, void* buffer, int bytes,
+						   int offset);
+	///<summary>
+	///<see cref="https://www.sqlite.org/c3ref/blob_reopen.html"/>.
+	/// Moves a blob handle to the same column of another row, which is
+	/// faster than opening a new handle.
+	///</summary>
+	///<param name="blob">Blob handle.</param>
+	///<param name="row">Rowid of the row.</param>
+	///<exception name="std::runtime_error"/>
+	void sqlite3_blob_reopen(sqlite3_blob_t blob, sqlite3_int64_t row);
+	///<summary>
+	///<see cref="https://www.sqlite.org/c3ref/blob_write.html"/>.
+	/// Overwrites a range of bytes of a blob.
+	///</summary>
+	///<param name="blob">Blob handle, opened writable.</param>
+	///<param name="buffer">The bytes to write.</param>
+	///<param name="bytes">Number of bytes to write.</param>
+	///<param name="offset">Offset in the blob of the first byte.</param>
+	///<exception name="std::runtime_error">The range extends beyond the
+	/// blob, the handle is read-only, or the row was changed, which aborts
+	/// the handle.</exception>
+	void sqlite3_blob_write(sqlite3_blob_t blob, const void* buffer, int bytes,
+							int offset);
 
 	///<summary>
 	///<see cref="https://www.sqlite.org/c3ref/busy_handler.html"/>.
@@ -821,6 +1521,23 @@ namespace Sqlt3
 									int column) NOEXCEPT_SPEC;
 	///<summary>
 	///<see cref="https://www.sqlite.org/c3ref/column_blob.html"/>.
+	/// Retrieves a view of the blob result from the provided column of a
+	/// prepared statement, without copying it.
+	///</summary>
+	///<param name="stmt">Prepared statement.</param>
+	///<param name="column">Index of a column to retrieve the result
+	/// from.</param>
+	///<returns>A view of the blob of data.</returns>
+	///<remarks>The view is valid until the next call to
+	///<see cref="sqlite3_step"/>, <see cref="sqlite3_reset"/> or
+	///<see cref="sqlite3_finalize"/> on <paramref name="stmt"/>. When
+	///<c>USE_VIEW_CHECKS</c> is defined, using the view after that point
+	/// through this wrapper is asserted on.
+	///</remarks>
+	blob_view_t sqlite3_column_blob_view(sqlite3_stmt_t stmt,
+										 int column) NOEXCEPT_SPEC;
+	///<summary>
+	///<see cref="https://www.sqlite.org/c3ref/column_blob.html"/>.
 	/// Retrieves the number of bytes in a generic blob or UTF-8 string result
 	/// from the provided column of a prepared statement.
 	///</summary>
@@ -999,6 +1716,35 @@ namespace Sqlt3
 	utf16_string_out_t sqlite3_column_text16(sqlite3_stmt_t stmt, int column);
 	///<summary>
 	///<see cref="https://www.sqlite.org/c3ref/column_blob.html"/>.
+	/// Retrieves a view of the UTF-8 string result from the provided column of
+	/// a prepared statement, without copying it.
+	///</summary>
+	///<param name="stmt">Prepared statement.</param>
+	///<param name="column">Index of a column to retrieve the result from.
+	///</param>
+	///<returns>A view of the UTF-8 string from the provided column.</returns>
+	///<remarks>The view has the same validity as one returned by
+	///<see cref="sqlite3_column_blob_view"/>. Retrieving the UTF-16 view of the
+	/// same column invalidates the result of this function.</remarks>
+	utf8_string_view_t sqlite3_column_text_view(sqlite3_stmt_t stmt,
+												int column) NOEXCEPT_SPEC;
+	///<summary>
+	///<see cref="https://www.sqlite.org/c3ref/column_blob.html"/>.
+	/// Retrieves a view of the UTF-16 string result from the provided column
+	/// of a prepared statement, without copying it.
+	///</summary>
+	///<param name="stmt">Prepared statement.</param>
+	///<param name="column">Index of a column to retrieve the result from.
+	///</param>
+	///<returns>A view of the UTF-16 string from the provided column.
+	///</returns>
+	///<remarks>The view has the same validity as one returned by
+	///<see cref="sqlite3_column_blob_view"/>. Retrieving the UTF-8 view of the
+	/// same column invalidates the result of this function.</remarks>
+	utf16_string_view_t sqlite3_column_text16_view(sqlite3_stmt_t stmt,
+												   int column) NOEXCEPT_SPEC;
+	///<summary>
+	///<see cref="https://www.sqlite.org/c3ref/column_blob.html"/>.
 	/// Retrieves the type of the indicated column of a prepared statement.
 	///</summary>
 	///<param name="stmt">Prepared statement.</param>
@@ -1088,6 +1834,21 @@ namespace Sqlt3
 	///<exception name="std::runtime_error"/>
 	void sqlite3_exec(sqlite3_t connection, utf8_string_in_t sql,
 					  int (*callback)(void*, int, char**, char**), void* data);
+	///<summary>
+	/// Executes SQL statement(s), reporting errors through the result rather
+	/// than throwing. The error message remains available from
+	///<see cref="sqlite3_errmsg"/>.
+	///</summary>
+	///<param name="connection">Database connection.</param>
+	///<param name="sql">SQL statement(s).</param>
+	///<param name="callback">See the overload without
+	///<c>std::nothrow</c>.</param>
+	///<param name="data">Data to pass to the callback.</param>
+	///<returns>The result code.</returns>
+	detail::result_t<void>
+		sqlite3_exec(sqlite3_t connection, utf8_string_in_t sql,
+					 int (*callback)(void*, int, char**, char**), void* data,
+					 const std::nothrow_t&) NOEXCEPT_SPEC;
 
 	///<summary>
 	///<see cref="https://www.sqlite.org/c3ref/finalize.html"/>.
@@ -1194,6 +1955,17 @@ namespace Sqlt3
 	std::tuple<unique_statement, utf8_string_in_t>
 		sqlite3_prepare_v2(sqlite3_t connection, utf8_string_in_t sql);
 	///<summary>
+	/// Generates a prepared statement from SQL text, reporting errors through
+	/// the result rather than throwing.
+	///</summary>
+	///<param name="connection">Database connection.</param>
+	///<param name="sql">SQL text.</param>
+	///<returns>The result code and, on success, the prepared statement and
+	/// the position in the SQL text that has been parsed upto.</returns>
+	detail::result_t<std::tuple<unique_statement, utf8_string_in_t>>
+		sqlite3_prepare_v2(sqlite3_t connection, utf8_string_in_t sql,
+						   const std::nothrow_t&) NOEXCEPT_SPEC;
+	///<summary>
 	///<see cref="https://www.sqlite.org/c3ref/prepare.html"/>.
 	/// Generates a prepared statement from SQL text.
 	///</summary>
@@ -1262,6 +2034,15 @@ namespace Sqlt3
 	///<param name="stmt">Prepared statement.</param>
 	///<exception name="std::runtime_error"/>
 	void sqlite3_reset(sqlite3_stmt_t stmt);
+	///<summary>
+	/// Resets a prepared statement to its initial state, reporting errors
+	/// through the result rather than throwing.
+	///</summary>
+	///<param name="stmt">Prepared statement.</param>
+	///<returns>The result code of the most recent evaluation of the
+	/// statement.</returns>
+	detail::result_t<void> sqlite3_reset(sqlite3_stmt_t stmt,
+										 const std::nothrow_t&) NOEXCEPT_SPEC;
 
 	///<summary>
 	///<see cref="https://www.sqlite.org/c3ref/commit_hook.html"/>.
@@ -1321,6 +2102,19 @@ namespace Sqlt3
 	///<remarks>See the constants defined above for the possible values returned
 	/// by this function.</remarks>
 	step_result_t sqlite3_step(sqlite3_stmt_t stmt);
+	///<summary>
+	/// Evaluates a prepared statement, reporting errors through the result
+	/// rather than throwing.
+	///</summary>
+	///<param name="stmt">Prepared statement.</param>
+	///<returns>The result code and, on success, the result of this
+	/// evaluation.</returns>
+	///<example><code>
+	/// auto r = Sqlt3::sqlite3_step(stmt, std::nothrow);
+	/// if(r.primary_code() == SQLITE_BUSY) return retry_later();
+	///</code></example>
+	detail::result_t<step_result_t>
+		sqlite3_step(sqlite3_stmt_t stmt, const std::nothrow_t&) NOEXCEPT_SPEC;
 
 	///<summary>
 	///<see cref="https://www.sqlite.org/c3ref/stmt_busy.html"/>.
@@ -1364,6 +2158,16 @@ namespace Sqlt3
 		///<exception name="std::runtime_error"/>
 		void get_scanstatus(sqlite3_stmt_t statement, int index,
 							scan_status_t status, void* data);
+		///<summary>
+		/// Helper function for reporting a failed result code in the same way
+		/// as the wrapped functions, for use by templates that call the
+		/// library directly.
+		///</summary>
+		///<param name="code">The failed result code.</param>
+		///<param name="connection">Connection the error occurred on, or
+		/// nullptr to report the generic description of the code.</param>
+		///<exception name="std::runtime_error"/>
+		void throw_result_error(int code, sqlite3_t connection);
 	}
 
 	///<summary>
@@ -0,0 +1,155 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	A queue of write jobs executed in order by a dedicated thread that owns
+	the only writing connection to a database. Queued jobs are grouped into
+	shared transactions so that they are committed together.
+*/
+
+#if !defined(SQLITEWRITEQUEUE_HPP)
+#include "SQLiteWrapped.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+namespace Sqlt3
+{
+	///<summary>
+	/// Configuration of a <see cref="write_queue"/>.
+	///</summary>
+	struct write_queue_options
+	{
+		///<summary>Most jobs committed in a single transaction.</summary>
+		std::size_t jobsPerTransaction = 1000;
+		///<summary>Passed to <see cref="sqlite3_busy_timeout"/> for the
+		/// connection, for when other processes write to the database.
+		///</summary>
+		int busyTimeout = 5000;
+	};
+
+	///<summary>
+	/// Executes write jobs on a single connection owned by a dedicated thread.
+	/// Jobs are executed in the order they are submitted; those that are
+	/// waiting when the thread becomes free are executed in one transaction,
+	/// each inside its own savepoint.
+	///</summary>
+	///<remarks>Submission does not take a lock unless the thread is asleep.
+	/// A job that throws has its changes rolled back to its savepoint and the
+	/// exception is delivered to its submitter; other jobs in the transaction
+	/// are unaffected. A job is only reported as complete once its
+	/// transaction has been committed. Jobs must not begin or end
+	/// transactions themselves. Jobs still queued on destruction are
+	/// executed before the thread exits.</remarks>
+	///<example><code>
+	/// Sqlt3::write_queue queue(Sqlt3::sqlite3_open("data.db"));
+	/// auto done = queue.submit([&amp;](sqlite3_t db) {
+	///     Sqlt3::sqlite3_exec(db, "INSERT INTO t VALUES(1)", nullptr,
+	///         nullptr);
+	/// });
+	/// done.get();
+	///</code></example>
+	class write_queue
+	{
+	public:
+		ALIAS_TYPE(std::function<void(sqlite3_t)>, job_t);
+		ALIAS_TYPE(std::function<void(std::exception_ptr)>, callback_t);
+
+	private:
+		struct node;
+
+		unique_connection connection;
+		write_queue_options options;
+
+		// Submitters push onto the head of an intrusive stack, which the
+		// writer thread takes whole and reverses.
+		std::atomic<node*> head;
+		std::atomic<bool> sleeping;
+		std::mutex wakeMutex;
+		std::condition_variable wake;
+		bool stopping = false;
+
+		std::atomic<unsigned long long> jobCount;
+		std::atomic<unsigned long long> failureCount;
+		std::atomic<unsigned long long> transactionCount;
+
+		std::thread writer;
+
+		void push(node* n);
+		void run() NOEXCEPT_SPEC;
+		void execute(node* batch) NOEXCEPT_SPEC;
+
+	public:
+		///<summary>
+		/// Starts the writer thread.
+		///</summary>
+		///<param name="connection">The connection to write with. It is
+		/// only used by the writer thread from then on.</param>
+		///<param name="options">Batching behaviour.</param>
+		///<exception name="std::runtime_error"/>
+		explicit write_queue(unique_connection connection,
+							 const write_queue_options& options = {});
+		write_queue(const write_queue&) = delete;
+		write_queue& operator=(const write_queue&) = delete;
+		///<summary>
+		/// Executes the jobs still queued and stops the writer thread.
+		///</summary>
+		~write_queue() NOEXCEPT_SPEC;
+
+		///<summary>
+		/// Queues a job.
+		///</summary>
+		///<param name="job">Function to execute on the writer thread with the
+		/// connection.</param>
+		///<returns>A future that becomes ready once the changes of the job
+		/// have been committed, or holds the exception that caused them to be
+		/// rolled back.</returns>
+		std::future<void> submit(job_t job);
+		///<summary>
+		/// Queues a job, with a callback to be invoked on completion.
+		///</summary>
+		///<param name="job">Function to execute on the writer thread with the
+		/// connection.</param>
+		///<param name="done">Invoked on the writer thread once the changes of
+		/// the job have been committed, with nullptr, or rolled back, with
+		/// the exception that caused it. Must not throw.</param>
+		void submit(job_t job, callback_t done);
+
+		///<summary>Number of jobs completed, including failures.</summary>
+		unsigned long long jobs() const NOEXCEPT_SPEC;
+		///<summary>Number of jobs that were rolled back.</summary>
+		unsigned long long failures() const NOEXCEPT_SPEC;
+		///<summary>Number of transactions committed or rolled back.
+		///</summary>
+		unsigned long long transactions() const NOEXCEPT_SPEC;
+	};
+}
+
+#define SQLITEWRITEQUEUE_HPP
+#endif// SQLITEWRITEQUEUE_HPP
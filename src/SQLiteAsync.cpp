@@ -0,0 +1,107 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Execution of statements on a thread dedicated to a connection, with
+	C++20 awaitables that suspend a coroutine until the work is done instead
+	of blocking the thread it runs on.
+*/
+
+#include "SQLiteAsync.hpp"
+
+namespace Sqlt3
+{
+	connection_executor::connection_executor(
+		unique_connection c, const connection_executor_options& o)
+		: db(std::move(c)), options(o)
+	{
+		if(!db) {
+			detail::throw_result_error(SQLITE_MISUSE, nullptr);
+		}
+		if(options.capacity == 0) {
+			options.capacity = 1;
+		}
+		worker = std::thread(&connection_executor::run, this);
+	}
+	connection_executor::~connection_executor() NOEXCEPT_SPEC
+	{
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+		}
+		queued.notify_one();
+		worker.join();
+	}
+
+	sqlite3_t connection_executor::connection() const NOEXCEPT_SPEC
+	{
+		return db.get();
+	}
+
+	bool connection_executor::try_post(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			if(tasks.size() >= options.capacity) return false;
+			tasks.push_back(std::move(task));
+		}
+		queued.notify_one();
+		return true;
+	}
+	void connection_executor::post(std::function<void()> task)
+	{
+		if(!try_post(std::move(task))) {
+			detail::throw_result_error(SQLITE_BUSY, nullptr);
+		}
+	}
+	void connection_executor::complete(
+		std::function<void()> continuation) NOEXCEPT_SPEC
+	{
+		if(options.dispatch) {
+			options.dispatch(std::move(continuation));
+		}
+		else {
+			continuation();
+		}
+	}
+	void connection_executor::interrupt() NOEXCEPT_SPEC
+	{
+		::sqlite3_interrupt(db.get());
+	}
+
+	void connection_executor::run() NOEXCEPT_SPEC
+	{
+		for(;;) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				queued.wait(lock, [this] { return stopping || !tasks.empty(); });
+				if(tasks.empty()) return;
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			task();
+		}
+	}
+}
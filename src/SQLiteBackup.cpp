@@ -0,0 +1,259 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Online backup of a live database on a background thread, copying pages
+	in batches sized to keep each step short and backing off while other
+	connections are writing.
+*/
+
+#include "SQLiteBackup.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace Sqlt3
+{
+	namespace
+	{
+		// Keeps a read transaction open so the backup copies one snapshot.
+		class read_transaction
+		{
+			sqlite3_t connection = nullptr;
+
+		public:
+			read_transaction() NOEXCEPT_SPEC = default;
+			read_transaction(const read_transaction&) = delete;
+			read_transaction& operator=(const read_transaction&) = delete;
+			~read_transaction() NOEXCEPT_SPEC
+			{
+				if(connection) {
+					::sqlite3_exec(connection, "COMMIT", nullptr, nullptr,
+								   nullptr);
+				}
+			}
+
+			void begin(sqlite3_t c)
+			{
+				Sqlt3::sqlite3_exec(
+					c, "BEGIN; SELECT 1 FROM sqlite_master LIMIT 1", nullptr,
+					nullptr);
+				connection = c;
+			}
+		};
+
+		bool in_wal_mode(sqlite3_t c) NOEXCEPT_SPEC
+		{
+			auto r = Sqlt3::sqlite3_prepare_v2(c, "PRAGMA journal_mode",
+											   std::nothrow);
+			if(!r) return false;
+			auto s = std::get<0>(*r).get();
+			if(::sqlite3_step(s) != SQLITE_ROW) return false;
+			auto mode = ::sqlite3_column_text(s, 0);
+			return mode &&
+				   std::strcmp(reinterpret_cast<const char*>(mode), "wal") == 0;
+		}
+	}
+
+	double backup_progress::pages_per_second() const NOEXCEPT_SPEC
+	{
+		if(elapsed.count() <= 0) return 0.0;
+		return static_cast<double>(pagesCopied) * 1000.0 /
+			   static_cast<double>(elapsed.count());
+	}
+
+	backup_scheduler::backup_scheduler(utf8_string_in_t src,
+									   utf8_string_in_t dest,
+									   const backup_options& o)
+		: options(o)
+	{
+		options.minPages = std::max(1, options.minPages);
+		options.maxPages = std::max(options.minPages, options.maxPages);
+		state.batchPages = std::min(
+			options.maxPages, std::max(options.minPages, options.initialPages));
+
+		auto readFlags = sqlite_open_readonly | sqlite_open_nomutex |
+						 sqlite_open_uri;
+		source = Sqlt3::sqlite3_open_v2(src, readFlags, nullptr);
+		monitor = Sqlt3::sqlite3_open_v2(src, readFlags, nullptr);
+		destination = Sqlt3::sqlite3_open_v2(
+			dest, sqlite_open_readwrite | sqlite_open_create |
+					  sqlite_open_nomutex | sqlite_open_uri,
+			nullptr);
+		Sqlt3::sqlite3_busy_timeout(
+			monitor.get(), static_cast<int>(options.backoff.count()));
+
+		worker = std::thread(&backup_scheduler::run, this);
+	}
+	backup_scheduler::~backup_scheduler() NOEXCEPT_SPEC
+	{
+		cancel();
+		worker.join();
+	}
+
+	void backup_scheduler::cancel() NOEXCEPT_SPEC
+	{
+		{
+			std::lock_guard<std::mutex> lock(stateMutex);
+			cancelled = true;
+		}
+		changed.notify_all();
+	}
+	void backup_scheduler::wait()
+	{
+		std::unique_lock<std::mutex> lock(stateMutex);
+		changed.wait(lock, [this] { return state.finished; });
+		if(error) std::rethrow_exception(error);
+	}
+	backup_progress backup_scheduler::progress() const
+	{
+		std::lock_guard<std::mutex> lock(stateMutex);
+		return state;
+	}
+
+	void backup_scheduler::run() NOEXCEPT_SPEC
+	{
+		std::exception_ptr failure;
+		try {
+			copy();
+		}
+		catch(...) {
+			failure = std::current_exception();
+		}
+
+		// Waiters are released only after the final report.
+		auto last = progress();
+		last.finished = true;
+		if(options.progress) options.progress(last);
+		{
+			std::lock_guard<std::mutex> lock(stateMutex);
+			error = failure;
+			state.finished = true;
+		}
+		changed.notify_all();
+	}
+
+	void backup_scheduler::copy()
+	{
+		auto start = clock::now();
+		auto backup = Sqlt3::sqlite3_backup_init(destination.get(), "main",
+												 source.get(), "main");
+		read_transaction snapshot;
+		if(options.holdSnapshot && in_wal_mode(source.get())) {
+			snapshot.begin(source.get());
+		}
+
+		auto p = progress();
+		auto version = data_version();
+		auto first = true;
+		auto yielded = clock::duration::zero();
+		for(;;) {
+			auto begun = clock::now();
+			auto result = Sqlt3::sqlite3_backup_step(backup.get(), p.batchPages,
+													 std::nothrow);
+			auto took = std::chrono::duration_cast<std::chrono::microseconds>(
+				clock::now() - begun);
+			p.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+				clock::now() - start);
+
+			if(!result) {
+				if(result.primary_code() != SQLITE_BUSY &&
+				   result.primary_code() != SQLITE_LOCKED) {
+					throw sqlite3_error(result.code(), destination.get());
+				}
+				// The step can simply be repeated once the lock is released.
+				++p.retries;
+				p.batchPages = std::max(options.minPages, p.batchPages / 2);
+				publish(p);
+				if(!sleep(options.backoff)) return;
+				continue;
+			}
+
+			auto remaining = ::sqlite3_backup_remaining(backup.get());
+			p.pageCount = ::sqlite3_backup_pagecount(backup.get());
+			// A restarted backup has more pages remaining than before.
+			auto copied = (first ? p.pageCount : p.remaining) - remaining;
+			p.pagesCopied += static_cast<unsigned long long>(
+				std::max(0, copied));
+			p.remaining = remaining;
+			first = false;
+			if(*result == sqlite_done) {
+				publish(p);
+				return;
+			}
+
+			auto target = options.targetStepTime.count();
+			if(took.count() > target) {
+				p.batchPages = std::max(
+					options.minPages,
+					static_cast<int>(p.batchPages * target / took.count()));
+			}
+			else if(took.count() * 2 < target) {
+				p.batchPages = std::min(options.maxPages, p.batchPages * 2);
+			}
+
+			auto current = data_version();
+			auto writing = current != version;
+			version = current;
+			if(writing && yielded < (clock::now() - start) *
+										 options.maxYieldShare) {
+				++p.yields;
+				p.batchPages = std::max(options.minPages, p.batchPages / 2);
+				yielded += options.backoff;
+				publish(p);
+				if(!sleep(options.backoff)) return;
+				continue;
+			}
+
+			publish(p);
+			if(!sleep(options.pause)) return;
+		}
+	}
+
+	int backup_scheduler::data_version()
+	{
+		auto r = Sqlt3::sqlite3_prepare_v2(monitor.get(), "PRAGMA data_version",
+										   std::nothrow);
+		if(!r) return -1;
+		auto s = std::get<0>(*r).get();
+		if(::sqlite3_step(s) != SQLITE_ROW) return -1;
+		return ::sqlite3_column_int(s, 0);
+	}
+
+	bool backup_scheduler::sleep(std::chrono::milliseconds time)
+	{
+		std::unique_lock<std::mutex> lock(stateMutex);
+		return !changed.wait_for(lock, time, [this] { return cancelled; });
+	}
+
+	void backup_scheduler::publish(const backup_progress& p)
+	{
+		{
+			std::lock_guard<std::mutex> lock(stateMutex);
+			auto finished = state.finished;
+			state = p;
+			state.finished = finished;
+		}
+		if(options.progress) options.progress(p);
+	}
+}
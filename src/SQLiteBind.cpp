@@ -0,0 +1,90 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Binding of whole parameter packs to a prepared statement in one call.
+	The sqlite3_bind_* function used for each argument is chosen at compile
+	time and errors are checked once, after all arguments are bound.
+*/
+
+#include "SQLiteBind.hpp"
+#include <cstdio>
+
+namespace Sqlt3
+{
+	named_parameters::named_parameters(
+		sqlite3_stmt_t s, std::initializer_list<utf8_string_in_t> names)
+		: stmt(s)
+	{
+		indices.reserve(names.size());
+		for(auto name : names) {
+			auto i = ::sqlite3_bind_parameter_index(s, name);
+			if(i == 0) {
+				char message[256];
+				std::snprintf(message, sizeof(message),
+							  "no parameter named %s in: %s", name,
+							  ::sqlite3_sql(s));
+				throw sqlite3_error(SQLITE_RANGE, message);
+			}
+			indices.push_back(i);
+		}
+	}
+
+	std::size_t named_parameters::size() const NOEXCEPT_SPEC
+	{
+		return indices.size();
+	}
+	int named_parameters::index(std::size_t position) const NOEXCEPT_SPEC
+	{
+		return indices[position];
+	}
+
+	namespace detail
+	{
+		void check_bind_count(std::size_t expected, std::size_t given)
+		{
+			if(expected != given) {
+				throw_result_error(SQLITE_RANGE, nullptr);
+			}
+		}
+		void check_bind_count(sqlite3_stmt_t s, std::size_t given)
+		{
+			auto expected = ::sqlite3_bind_parameter_count(s);
+			check_bind_count(static_cast<std::size_t>(expected), given);
+		}
+		void check_bind_result(sqlite3_stmt_t s, int code)
+		{
+			// No sqlite3_bind_* function returns SQLITE_MISMATCH; it comes
+			// from the range check of bind_traits, which leaves no message
+			// on the connection.
+			if(code == SQLITE_MISMATCH) {
+				throw sqlite3_error(code, "unsigned integer too large to "
+										  "bind as a 64-bit signed integer");
+			}
+			if(code != SQLITE_OK) {
+				throw_result_error(code, ::sqlite3_db_handle(s));
+			}
+		}
+	}
+}
@@ -0,0 +1,222 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Standard stream buffers over incremental blob I/O handles, so that blobs
+	too large to hold in memory can be read and written with the iostream
+	library a buffer at a time.
+*/
+
+#include "SQLiteBlobStream.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace Sqlt3
+{
+	blob_streambuf::blob_streambuf(unique_blob b, std::size_t bufferSize)
+		: handle(std::move(b)),
+		  buffer(std::max<std::size_t>(
+			  1, std::min<std::size_t>(bufferSize, 1u << 30)))
+	{
+		size = Sqlt3::sqlite3_blob_bytes(handle.get());
+	}
+	blob_streambuf::~blob_streambuf()
+	{
+		try {
+			flush();
+		}
+		catch(...) {
+		}
+	}
+
+	sqlite3_int64_t blob_streambuf::position() const NOEXCEPT_SPEC
+	{
+		if(gptr() != nullptr) return bufferOffset + (gptr() - eback());
+		if(pptr() != nullptr) return bufferOffset + (pptr() - pbase());
+		return bufferOffset;
+	}
+	void blob_streambuf::flush()
+	{
+		if(pptr() != nullptr && pptr() != pbase()) {
+			auto n = static_cast<int>(pptr() - pbase());
+			Sqlt3::sqlite3_blob_write(handle.get(), pbase(), n,
+									  static_cast<int>(bufferOffset));
+		}
+		discard(position());
+	}
+	void blob_streambuf::discard(sqlite3_int64_t offset) NOEXCEPT_SPEC
+	{
+		setg(nullptr, nullptr, nullptr);
+		setp(nullptr, nullptr);
+		bufferOffset = offset;
+	}
+
+	blob_streambuf::int_type blob_streambuf::underflow()
+	{
+		if(gptr() != nullptr && gptr() < egptr()) {
+			return traits_type::to_int_type(*gptr());
+		}
+		flush();
+		auto pos = bufferOffset;
+		if(pos >= size) return traits_type::eof();
+		auto n = static_cast<int>(
+			std::min<sqlite3_int64_t>(buffer.size(), size - pos));
+		auto b = buffer.data();
+		Sqlt3::sqlite3_blob_read(handle.get(), b, n, static_cast<int>(pos));
+		setg(b, b, b + n);
+		return traits_type::to_int_type(*gptr());
+	}
+	blob_streambuf::int_type blob_streambuf::overflow(int_type c)
+	{
+		if(gptr() != nullptr) discard(position());
+		if(pptr() != nullptr && pptr() == epptr()) flush();
+		if(pptr() == nullptr) {
+			auto n = std::min<sqlite3_int64_t>(buffer.size(),
+											   size - bufferOffset);
+			// The blob cannot grow.
+			if(n <= 0) return traits_type::eof();
+			setp(buffer.data(), buffer.data() + n);
+		}
+		if(traits_type::eq_int_type(c, traits_type::eof())) {
+			return traits_type::not_eof(c);
+		}
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+		return c;
+	}
+	int blob_streambuf::sync()
+	{
+		flush();
+		return 0;
+	}
+	std::streamsize blob_streambuf::showmanyc()
+	{
+		auto remaining = size - position();
+		return remaining > 0 ? static_cast<std::streamsize>(remaining) : -1;
+	}
+
+	std::streamsize blob_streambuf::xsgetn(char_type* s, std::streamsize n)
+	{
+		std::streamsize copied = 0;
+		if(gptr() != nullptr) {
+			copied = std::min<std::streamsize>(n, egptr() - gptr());
+			std::memcpy(s, gptr(), static_cast<std::size_t>(copied));
+			gbump(static_cast<int>(copied));
+		}
+		auto wanted = n - copied;
+		if(wanted < static_cast<std::streamsize>(buffer.size())) {
+			return copied + std::streambuf::xsgetn(s + copied, wanted);
+		}
+		// Large reads bypass the buffer.
+		flush();
+		auto pos = bufferOffset;
+		auto direct = static_cast<int>(std::max<sqlite3_int64_t>(
+			0, std::min<sqlite3_int64_t>(wanted, size - pos)));
+		if(direct > 0) {
+			Sqlt3::sqlite3_blob_read(handle.get(), s + copied, direct,
+									 static_cast<int>(pos));
+		}
+		discard(pos + direct);
+		return copied + direct;
+	}
+	std::streamsize blob_streambuf::xsputn(const char_type* s,
+										   std::streamsize n)
+	{
+		if(n < static_cast<std::streamsize>(buffer.size())) {
+			return std::streambuf::xsputn(s, n);
+		}
+		// Large writes bypass the buffer.
+		flush();
+		auto pos = bufferOffset;
+		auto direct = static_cast<int>(std::max<sqlite3_int64_t>(
+			0, std::min<sqlite3_int64_t>(n, size - pos)));
+		if(direct > 0) {
+			Sqlt3::sqlite3_blob_write(handle.get(), s, direct,
+									  static_cast<int>(pos));
+		}
+		discard(pos + direct);
+		return direct;
+	}
+
+	blob_streambuf::pos_type blob_streambuf::seekoff(
+		off_type off, std::ios_base::seekdir dir, std::ios_base::openmode)
+	{
+		// tellg and tellp need no flush.
+		if(dir == std::ios_base::cur && off == 0) return position();
+		auto target = static_cast<sqlite3_int64_t>(off);
+		if(dir == std::ios_base::cur) target += position();
+		else if(dir == std::ios_base::end) target += size;
+		if(target < 0 || target > size) return pos_type(off_type(-1));
+		flush();
+		discard(target);
+		return target;
+	}
+	blob_streambuf::pos_type blob_streambuf::seekpos(
+		pos_type pos, std::ios_base::openmode which)
+	{
+		return seekoff(off_type(pos), std::ios_base::beg, which);
+	}
+
+	void blob_streambuf::reopen(sqlite3_int64_t row)
+	{
+		flush();
+		Sqlt3::sqlite3_blob_reopen(handle.get(), row);
+		size = Sqlt3::sqlite3_blob_bytes(handle.get());
+		discard(0);
+	}
+	void blob_streambuf::close()
+	{
+		if(!handle) return;
+		try {
+			flush();
+		}
+		catch(...) {
+			discard(0);
+			size = 0;
+			handle.reset();
+			throw;
+		}
+		discard(0);
+		size = 0;
+		Sqlt3::sqlite3_blob_close(std::move(handle));
+	}
+	sqlite3_blob_t blob_streambuf::blob() const NOEXCEPT_SPEC
+	{
+		return handle.get();
+	}
+	int blob_streambuf::bytes() const NOEXCEPT_SPEC
+	{
+		return size;
+	}
+
+	blob_stream::blob_stream(unique_blob b, std::size_t bufferSize)
+		: std::iostream(nullptr), buf(std::move(b), bufferSize)
+	{
+		init(&buf);
+	}
+	blob_streambuf* blob_stream::rdbuf() NOEXCEPT_SPEC
+	{
+		return &buf;
+	}
+}
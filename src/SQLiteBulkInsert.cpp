@@ -0,0 +1,165 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Bulk insertion of rows through reused prepared statements. Rows are
+	written in transactions of a configurable size and may be packed into
+	multi-row VALUES statements.
+*/
+
+#include "SQLiteBulkInsert.hpp"
+#include <algorithm>
+
+namespace Sqlt3
+{
+	namespace detail
+	{
+		bulk_insert_base::bulk_insert_base(sqlite3_t c, utf8_string_in_t t,
+										   std::vector<std::string> cols,
+										   const bulk_insert_options& o,
+										   std::size_t n)
+			: connection(c), table(t), columns(std::move(cols)), options(o)
+		{
+			if(columns.size() != n || n == 0) {
+				throw_result_error(SQLITE_RANGE, nullptr);
+			}
+			auto variables = static_cast<std::size_t>(
+				::sqlite3_limit(c, SQLITE_LIMIT_VARIABLE_NUMBER, -1));
+			batchRows = std::max<std::size_t>(
+				1, std::min(options.rowsPerStatement, variables / n));
+			statements.resize(batchRows + 1);
+		}
+		bulk_insert_base::~bulk_insert_base() NOEXCEPT_SPEC
+		{
+			if(inTransaction) {
+				::sqlite3_exec(connection, "ROLLBACK", nullptr, nullptr,
+							   nullptr);
+			}
+		}
+
+		std::size_t bulk_insert_base::rows_per_statement() const NOEXCEPT_SPEC
+		{
+			return batchRows;
+		}
+		std::size_t bulk_insert_base::column_count() const NOEXCEPT_SPEC
+		{
+			return columns.size();
+		}
+		bool bulk_insert_base::counts_bytes() const NOEXCEPT_SPEC
+		{
+			return options.bytesPerTransaction != 0;
+		}
+
+		sqlite3_stmt_t bulk_insert_base::statement(std::size_t rows)
+		{
+			auto& stmt = statements[rows];
+			if(!stmt) {
+				std::string sql = "INSERT INTO " + table + "(";
+				std::string values = "(";
+				for(std::size_t i = 0; i < columns.size(); ++i) {
+					if(i != 0) {
+						sql += ",";
+						values += ",";
+					}
+					sql += columns[i];
+					values += "?";
+				}
+				sql += ") VALUES";
+				values += ")";
+				for(std::size_t r = 0; r < rows; ++r) {
+					if(r != 0) sql += ",";
+					sql += values;
+				}
+				stmt = std::get<0>(sqlite3_prepare_v2(connection, sql.c_str()));
+			}
+
+			if(!inTransaction) {
+				sqlite3_exec(connection, "BEGIN IMMEDIATE", nullptr, nullptr);
+				inTransaction = true;
+				transactionRows = 0;
+				transactionBytes = 0;
+				transactionStart = clock::now();
+				if(!started) {
+					firstRow = transactionStart;
+					started = true;
+				}
+			}
+			return stmt.get();
+		}
+		void bulk_insert_base::execute(sqlite3_stmt_t s, int bindResult,
+									   std::size_t rows, std::size_t bytes)
+		{
+			if(bindResult != SQLITE_OK) {
+				::sqlite3_reset(s);
+				throw_result_error(bindResult, connection);
+			}
+			auto code = ::sqlite3_step(s);
+			::sqlite3_reset(s);
+			if(code != SQLITE_DONE) {
+				throw_result_error(code, connection);
+			}
+
+			rowCount += rows;
+			transactionRows += rows;
+			transactionBytes += bytes;
+
+			auto full =
+				(options.rowsPerTransaction != 0 &&
+				 transactionRows >= options.rowsPerTransaction) ||
+				(options.bytesPerTransaction != 0 &&
+				 transactionBytes >= options.bytesPerTransaction) ||
+				(options.timePerTransaction.count() != 0 &&
+				 clock::now() - transactionStart >= options.timePerTransaction);
+			if(full) commit_transaction();
+		}
+		void bulk_insert_base::commit_transaction()
+		{
+			if(!inTransaction) return;
+			sqlite3_exec(connection, "COMMIT", nullptr, nullptr);
+			inTransaction = false;
+			++commitCount;
+			writeTime = clock::now() - firstRow;
+		}
+
+		unsigned long long bulk_insert_base::rows() const NOEXCEPT_SPEC
+		{
+			return rowCount;
+		}
+		unsigned long long bulk_insert_base::transactions() const NOEXCEPT_SPEC
+		{
+			return commitCount;
+		}
+		double bulk_insert_base::seconds() const NOEXCEPT_SPEC
+		{
+			if(!started) return 0.0;
+			auto elapsed = inTransaction ? clock::now() - firstRow : writeTime;
+			return std::chrono::duration<double>(elapsed).count();
+		}
+		double bulk_insert_base::rows_per_second() const NOEXCEPT_SPEC
+		{
+			auto s = seconds();
+			return s > 0.0 ? static_cast<double>(rowCount) / s : 0.0;
+		}
+	}
+}
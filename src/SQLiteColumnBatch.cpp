@@ -0,0 +1,314 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Batched fetching of result rows into one contiguous, typed array per
+	column, with a null bitmap per column and the bytes of text and blobs
+	in an arena shared by the columns.
+*/
+
+#include "SQLiteColumnBatch.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace Sqlt3
+{
+	namespace
+	{
+		// Rows reserved up front; more are allocated as they arrive.
+		const std::size_t reserved_rows = 1 << 16;
+
+		bool contains(const char* text, const char* part) NOEXCEPT_SPEC
+		{
+			// Declared types are ASCII, matched case-insensitively as
+			// SQLite does for affinity.
+			auto n = std::strlen(part);
+			for(; *text; ++text) {
+				if(::sqlite3_strnicmp(text, part, static_cast<int>(n)) == 0) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// The rules of section 3.1 of "Datatypes In SQLite", with numeric
+		// affinity read as real.
+		batch_column_type affinity(const char* declared) NOEXCEPT_SPEC
+		{
+			if(declared == nullptr) return batch_column_type::blob;
+			if(contains(declared, "INT")) return batch_column_type::integer;
+			if(contains(declared, "CHAR") || contains(declared, "CLOB") ||
+			   contains(declared, "TEXT")) {
+				return batch_column_type::text;
+			}
+			if(contains(declared, "BLOB") || *declared == '\0') {
+				return batch_column_type::blob;
+			}
+			return batch_column_type::real;
+		}
+	}
+
+	batch_column::batch_column(batch_column_type type, utf8_string_out_t name)
+		: kind(type), label(std::move(name))
+	{
+	}
+
+	batch_column_type batch_column::type() const NOEXCEPT_SPEC
+	{
+		return kind;
+	}
+	utf8_string_in_t batch_column::name() const NOEXCEPT_SPEC
+	{
+		return label.c_str();
+	}
+	const sqlite3_int64_t* batch_column::integers() const NOEXCEPT_SPEC
+	{
+		return integerValues.data();
+	}
+	const double* batch_column::reals() const NOEXCEPT_SPEC
+	{
+		return realValues.data();
+	}
+	const std::size_t* batch_column::value_offsets() const NOEXCEPT_SPEC
+	{
+		return offsets.data();
+	}
+	const std::size_t* batch_column::value_sizes() const NOEXCEPT_SPEC
+	{
+		return sizes.data();
+	}
+	const unsigned long long* batch_column::null_mask() const NOEXCEPT_SPEC
+	{
+		return nulls.data();
+	}
+	bool batch_column::is_null(std::size_t row) const NOEXCEPT_SPEC
+	{
+		return (nulls[row / 64] >> (row % 64) & 1) != 0;
+	}
+	std::size_t batch_column::null_count() const NOEXCEPT_SPEC
+	{
+		return nullCount;
+	}
+
+	column_batch::column_batch(std::initializer_list<batch_column_type> t)
+		: types(t), givenTypes(true)
+	{
+	}
+	column_batch::column_batch(std::vector<batch_column_type> t)
+		: types(std::move(t)), givenTypes(true)
+	{
+	}
+
+	std::size_t column_batch::fetch(sqlite3_stmt_t stmt, std::size_t maxRows)
+	{
+		if(stmt != source) {
+			forget_columns();
+			source = stmt;
+			finished = false;
+		}
+		rowCount = 0;
+		arena.clear();
+		for(auto& c : columns) {
+			c.integerValues.clear();
+			c.realValues.clear();
+			c.offsets.clear();
+			c.sizes.clear();
+			c.nulls.clear();
+			c.nullCount = 0;
+		}
+		if(finished) return 0;
+
+		while(rowCount < maxRows) {
+			if(Sqlt3::sqlite3_step(stmt) != sqlite_row) {
+				finished = true;
+				break;
+			}
+			if(rowCount == 0) prepare_columns(stmt, maxRows);
+			append_row(stmt);
+			++rowCount;
+		}
+		return rowCount;
+	}
+	void column_batch::reset() NOEXCEPT_SPEC
+	{
+		forget_columns();
+		rowCount = 0;
+		arena.clear();
+		source = nullptr;
+		finished = false;
+	}
+
+	void column_batch::forget_columns() NOEXCEPT_SPEC
+	{
+		columns.clear();
+		if(!givenTypes) types.clear();
+	}
+
+	void column_batch::prepare_columns(sqlite3_stmt_t stmt,
+									   std::size_t maxRows)
+	{
+		auto count = static_cast<std::size_t>(::sqlite3_column_count(stmt));
+		if(!types.empty() && types.size() != count) {
+			detail::throw_result_error(SQLITE_RANGE, nullptr);
+		}
+		if(columns.size() != count) {
+			columns.clear();
+			columns.reserve(count);
+			for(std::size_t i = 0; i < count; ++i) {
+				auto index = static_cast<int>(i);
+				auto type = batch_column_type::blob;
+				if(!types.empty()) {
+					type = types[i];
+				}
+				else {
+					switch(::sqlite3_column_type(stmt, index)) {
+					case SQLITE_INTEGER:
+						type = batch_column_type::integer;
+						break;
+					case SQLITE_FLOAT:
+						type = batch_column_type::real;
+						break;
+					case SQLITE_TEXT:
+						type = batch_column_type::text;
+						break;
+					case SQLITE_BLOB:
+						break;
+					default:
+						type = affinity(::sqlite3_column_decltype(stmt, index));
+						break;
+					}
+				}
+				auto name = ::sqlite3_column_name(stmt, index);
+				columns.push_back(batch_column(type, name != nullptr ? name
+																	 : ""));
+			}
+			// Later batches from the statement keep the types of the first.
+			if(types.empty()) {
+				for(auto& c : columns) {
+					types.push_back(c.kind);
+				}
+			}
+		}
+
+		auto reserve = std::min(maxRows, reserved_rows);
+		for(auto& c : columns) {
+			switch(c.kind) {
+			case batch_column_type::integer:
+				c.integerValues.reserve(reserve);
+				break;
+			case batch_column_type::real:
+				c.realValues.reserve(reserve);
+				break;
+			default:
+				c.offsets.reserve(reserve);
+				c.sizes.reserve(reserve);
+				break;
+			}
+		}
+	}
+
+	void column_batch::append_row(sqlite3_stmt_t stmt)
+	{
+		auto word = rowCount / 64;
+		auto bit = 1ull << (rowCount % 64);
+		auto index = 0;
+		for(auto& c : columns) {
+			if(rowCount % 64 == 0) c.nulls.push_back(0);
+			auto null = ::sqlite3_column_type(stmt, index) == SQLITE_NULL;
+			if(null) {
+				c.nulls[word] |= bit;
+				++c.nullCount;
+			}
+			switch(c.kind) {
+			case batch_column_type::integer:
+				c.integerValues.push_back(
+					null ? 0 : ::sqlite3_column_int64(stmt, index));
+				break;
+			case batch_column_type::real:
+				c.realValues.push_back(
+					null ? 0.0 : ::sqlite3_column_double(stmt, index));
+				break;
+			case batch_column_type::text:
+			case batch_column_type::blob: {
+				const void* bytes = nullptr;
+				if(!null) {
+					// The pointer is fetched before the size, as the
+					// conversion to text may change it.
+					bytes = c.kind == batch_column_type::text
+								? static_cast<const void*>(
+									  ::sqlite3_column_text(stmt, index))
+								: ::sqlite3_column_blob(stmt, index);
+				}
+				auto size = bytes != nullptr
+								? static_cast<std::size_t>(
+									  ::sqlite3_column_bytes(stmt, index))
+								: 0;
+				c.offsets.push_back(arena.size());
+				c.sizes.push_back(size);
+				if(size != 0) {
+					auto first = static_cast<const char*>(bytes);
+					arena.insert(arena.end(), first, first + size);
+				}
+				break;
+			}
+			}
+			++index;
+		}
+	}
+
+	std::size_t column_batch::rows() const NOEXCEPT_SPEC
+	{
+		return rowCount;
+	}
+	std::size_t column_batch::column_count() const NOEXCEPT_SPEC
+	{
+		return columns.size();
+	}
+	const batch_column& column_batch::column(std::size_t i) const
+		NOEXCEPT_SPEC
+	{
+		return columns[i];
+	}
+	bool column_batch::done() const NOEXCEPT_SPEC
+	{
+		return finished;
+	}
+
+	const char* column_batch::arena_data() const NOEXCEPT_SPEC
+	{
+		return arena.data();
+	}
+	utf8_string_view_t column_batch::text(std::size_t column,
+										  std::size_t row) const NOEXCEPT_SPEC
+	{
+		auto& c = columns[column];
+		return utf8_string_view_t(arena.data() + c.offsets[row], c.sizes[row]);
+	}
+	blob_view_t column_batch::blob(std::size_t column,
+								   std::size_t row) const NOEXCEPT_SPEC
+	{
+		auto& c = columns[column];
+		return blob_view_t(arena.data() + c.offsets[row], c.sizes[row]);
+	}
+}
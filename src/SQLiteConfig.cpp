@@ -0,0 +1,579 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Configuration of the SQLite3 library before it is initialised: the
+	threading mode, memory statistics, a pooled memory allocator, a page
+	cache module and fixed page cache and lookaside memory.
+*/
+
+#include "SQLiteConfig.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace Sqlt3
+{
+	namespace
+	{
+		// Every block starts with a header, which keeps the 8-byte alignment
+		// SQLite requires of allocations.
+		struct block_header
+		{
+			std::uint32_t sizeClass;
+			std::uint32_t size;
+		};
+		const std::size_t header_size = 8;
+		const std::uint32_t large_class = 0xffffffffu;
+		const std::size_t granularity = 16;
+
+		struct free_block
+		{
+			free_block* next;
+		};
+
+		block_header* header_of(void* p) NOEXCEPT_SPEC
+		{
+			return reinterpret_cast<block_header*>(static_cast<char*>(p) -
+												   header_size);
+		}
+		void* body_of(void* block) NOEXCEPT_SPEC
+		{
+			return static_cast<char*>(block) + header_size;
+		}
+
+		// Only one pool allocator may be installed at a time. Each has a
+		// distinct generation, so the caches of threads can tell whether
+		// the blocks they hold belong to the current allocator.
+		std::mutex active_mutex;
+		detail::pool_allocator* active = nullptr;
+		std::atomic<unsigned long long> next_generation(1);
+
+		struct thread_cache
+		{
+			struct list
+			{
+				free_block* head = nullptr;
+				std::size_t count = 0;
+			};
+			unsigned long long generation = 0;
+			std::vector<list> lists;
+
+			~thread_cache();
+		};
+		thread_local thread_cache local_cache;
+	}
+
+	namespace detail
+	{
+		class pool_allocator
+		{
+			struct size_class
+			{
+				std::size_t blockSize = 0;
+				std::size_t batch = 0;
+				std::atomic<free_block*> shared;
+			};
+
+			std::size_t maxBlock;
+			std::size_t classCount = 0;
+			std::unique_ptr<size_class[]> classes;
+			// Size class of each multiple of the granularity.
+			std::vector<unsigned char> classOf;
+
+			std::mutex slabMutex;
+			std::vector<void*> slabs;
+			std::atomic<unsigned long long> slabCount;
+			std::atomic<unsigned long long> slabByteCount;
+			std::atomic<unsigned long long> refillCount;
+			std::atomic<unsigned long long> flushCount;
+			std::atomic<unsigned long long> largeCount;
+
+			thread_cache& cache() NOEXCEPT_SPEC
+			{
+				auto& c = local_cache;
+				if(c.generation != generation) {
+					// Blocks of an earlier allocator are simply forgotten.
+					c.lists.assign(classCount, thread_cache::list());
+					c.generation = generation;
+				}
+				return c;
+			}
+
+			bool refill(std::size_t i, thread_cache::list& l) NOEXCEPT_SPEC
+			{
+				auto& sc = classes[i];
+				auto chain =
+					sc.shared.exchange(nullptr, std::memory_order_acquire);
+				if(chain != nullptr) {
+					++refillCount;
+					auto count = std::size_t(1);
+					auto last = chain;
+					for(; last->next != nullptr; last = last->next) ++count;
+					last->next = l.head;
+					l.head = chain;
+					l.count += count;
+					return true;
+				}
+
+				auto bytes = sc.blockSize * sc.batch;
+				auto slab = static_cast<char*>(std::malloc(bytes));
+				if(slab == nullptr) return false;
+				try {
+					std::lock_guard<std::mutex> lock(slabMutex);
+					slabs.push_back(slab);
+				}
+				catch(...) {
+					std::free(slab);
+					return false;
+				}
+				++slabCount;
+				slabByteCount += bytes;
+				for(std::size_t b = 0; b < sc.batch; ++b) {
+					auto block = reinterpret_cast<free_block*>(
+						slab + b * sc.blockSize);
+					block->next = l.head;
+					l.head = block;
+				}
+				l.count += sc.batch;
+				return true;
+			}
+			void flush(std::size_t i, thread_cache::list& l,
+					   std::size_t count) NOEXCEPT_SPEC
+			{
+				if(count == 0) return;
+				++flushCount;
+				auto first = l.head;
+				auto last = first;
+				for(std::size_t n = 1; n < count; ++n) last = last->next;
+				l.head = last->next;
+				l.count -= count;
+
+				// Only whole lists are ever taken from the shared list, so
+				// pushing is free of the ABA problem.
+				auto& shared = classes[i].shared;
+				auto head = shared.load(std::memory_order_relaxed);
+				do {
+					last->next = head;
+				} while(!shared.compare_exchange_weak(
+					head, first, std::memory_order_release,
+					std::memory_order_relaxed));
+			}
+
+		public:
+			const unsigned long long generation;
+
+			explicit pool_allocator(const pool_allocator_options& o)
+				: maxBlock(std::max<std::size_t>(
+					  granularity,
+					  (o.maxBlockSize + header_size + granularity - 1) /
+						  granularity * granularity)),
+				  slabCount(0), slabByteCount(0), refillCount(0),
+				  flushCount(0), largeCount(0),
+				  generation(next_generation.fetch_add(1))
+			{
+				// Blocks are multiples of the granularity up to 256 bytes,
+				// then four sizes per power of two.
+				std::vector<std::size_t> sizes;
+				for(auto s = granularity; s < maxBlock && s <= 256;
+					s += granularity) {
+					sizes.push_back(s);
+				}
+				for(std::size_t p = 256;
+					sizes.empty() || sizes.back() < maxBlock; p *= 2) {
+					for(std::size_t q = 1; q <= 4; ++q) {
+						auto s = std::min(p + p * q / 4, maxBlock);
+						if(sizes.empty() || s > sizes.back()) {
+							sizes.push_back(s);
+						}
+					}
+				}
+				if(sizes.size() > 255) {
+					detail::throw_result_error(SQLITE_RANGE, nullptr);
+				}
+
+				classCount = sizes.size();
+				classes.reset(new size_class[classCount]);
+				for(std::size_t i = 0; i < classCount; ++i) {
+					auto& sc = classes[i];
+					sc.blockSize = sizes[i];
+					sc.batch = std::max<std::size_t>(
+						4, std::min(o.batch, 64 * 1024 / sizes[i]));
+					sc.shared.store(nullptr);
+				}
+				classOf.resize(maxBlock / granularity + 1);
+				std::size_t c = 0;
+				for(std::size_t g = 0; g < classOf.size(); ++g) {
+					while(sizes[c] < g * granularity) ++c;
+					classOf[g] = static_cast<unsigned char>(c);
+				}
+
+				std::lock_guard<std::mutex> lock(active_mutex);
+				if(active != nullptr) {
+					detail::throw_result_error(SQLITE_MISUSE, nullptr);
+				}
+				active = this;
+			}
+			~pool_allocator() NOEXCEPT_SPEC
+			{
+				std::lock_guard<std::mutex> lock(active_mutex);
+				active = nullptr;
+				for(auto s : slabs) {
+					std::free(s);
+				}
+			}
+
+			void* allocate(int n) NOEXCEPT_SPEC
+			{
+				auto bytes = static_cast<std::size_t>(std::max(n, 1));
+				auto total = bytes + header_size;
+				if(total > maxBlock) {
+					auto block = std::malloc(total);
+					if(block == nullptr) return nullptr;
+					++largeCount;
+					auto h = static_cast<block_header*>(block);
+					h->sizeClass = large_class;
+					h->size = static_cast<std::uint32_t>(bytes);
+					return body_of(block);
+				}
+
+				auto i = classOf[(total + granularity - 1) / granularity];
+				auto& l = cache().lists[i];
+				if(l.head == nullptr && !refill(i, l)) return nullptr;
+				auto block = l.head;
+				l.head = block->next;
+				--l.count;
+				auto h = reinterpret_cast<block_header*>(block);
+				h->sizeClass = i;
+				h->size = 0;
+				return body_of(block);
+			}
+			void deallocate(void* p) NOEXCEPT_SPEC
+			{
+				if(p == nullptr) return;
+				auto h = header_of(p);
+				if(h->sizeClass == large_class) {
+					std::free(h);
+					return;
+				}
+
+				auto i = static_cast<std::size_t>(h->sizeClass);
+				auto& l = cache().lists[i];
+				auto block = reinterpret_cast<free_block*>(h);
+				block->next = l.head;
+				l.head = block;
+				++l.count;
+				auto batch = classes[i].batch;
+				if(l.count > 2 * batch) flush(i, l, batch);
+			}
+			int size(void* p) const NOEXCEPT_SPEC
+			{
+				if(p == nullptr) return 0;
+				auto h = header_of(p);
+				if(h->sizeClass == large_class) {
+					return static_cast<int>(h->size);
+				}
+				return static_cast<int>(classes[h->sizeClass].blockSize -
+										header_size);
+			}
+			void* reallocate(void* p, int n) NOEXCEPT_SPEC
+			{
+				if(p == nullptr) return allocate(n);
+				auto old = size(p);
+				auto h = header_of(p);
+				if(h->sizeClass != large_class && n <= old &&
+				   n > old / 2) {
+					return p;
+				}
+				auto q = allocate(n);
+				if(q == nullptr) return nullptr;
+				std::memcpy(q, p, static_cast<std::size_t>(std::min(old, n)));
+				deallocate(p);
+				return q;
+			}
+			int roundup(int n) const NOEXCEPT_SPEC
+			{
+				auto total = static_cast<std::size_t>(std::max(n, 1)) +
+							 header_size;
+				if(total > maxBlock) return (n + 7) & ~7;
+				auto i = classOf[(total + granularity - 1) / granularity];
+				return static_cast<int>(classes[i].blockSize - header_size);
+			}
+
+			void flush_all(thread_cache& c) NOEXCEPT_SPEC
+			{
+				for(std::size_t i = 0; i < c.lists.size(); ++i) {
+					flush(i, c.lists[i], c.lists[i].count);
+				}
+			}
+
+			pool_allocator_stats stats() const NOEXCEPT_SPEC
+			{
+				pool_allocator_stats s;
+				s.slabs = slabCount.load();
+				s.slabBytes = slabByteCount.load();
+				s.refills = refillCount.load();
+				s.flushes = flushCount.load();
+				s.largeAllocations = largeCount.load();
+				return s;
+			}
+
+			// Only the initialisation functions are passed the allocator.
+			static void* x_malloc(int n)
+			{
+				return active->allocate(n);
+			}
+			static void x_free(void* p)
+			{
+				active->deallocate(p);
+			}
+			static void* x_realloc(void* p, int n)
+			{
+				return active->reallocate(p, n);
+			}
+			static int x_size(void* p)
+			{
+				return active->size(p);
+			}
+			static int x_roundup(int n)
+			{
+				return active->roundup(n);
+			}
+			static int x_init(void*)
+			{
+				return SQLITE_OK;
+			}
+			static void x_shutdown(void*)
+			{
+			}
+		};
+	}
+
+	namespace
+	{
+		thread_cache::~thread_cache()
+		{
+			// A thread that exits returns its blocks to the shared lists,
+			// unless the allocator they came from is gone.
+			std::lock_guard<std::mutex> lock(active_mutex);
+			if(active != nullptr && active->generation == generation) {
+				active->flush_all(*this);
+			}
+		}
+	}
+
+	configured_library::configured_library() NOEXCEPT_SPEC
+	{
+		std::memset(&previousMethods, 0, sizeof(previousMethods));
+		std::memset(&previousPcache, 0, sizeof(previousPcache));
+	}
+	configured_library::configured_library(configured_library&& x) NOEXCEPT_SPEC
+		: allocator(std::move(x.allocator)),
+		  pagecache(std::move(x.pagecache)),
+		  pcacheModule(std::move(x.pcacheModule)),
+		  previousMethods(x.previousMethods),
+		  previousPcache(x.previousPcache),
+		  initialized(x.initialized)
+	{
+		x.initialized = false;
+	}
+	configured_library& configured_library::
+		operator=(configured_library&& x) NOEXCEPT_SPEC
+	{
+		if(this != &x) {
+			release();
+			allocator = std::move(x.allocator);
+			pagecache = std::move(x.pagecache);
+			pcacheModule = std::move(x.pcacheModule);
+			previousMethods = x.previousMethods;
+			previousPcache = x.previousPcache;
+			initialized = x.initialized;
+			x.initialized = false;
+		}
+		return *this;
+	}
+	configured_library::~configured_library() NOEXCEPT_SPEC
+	{
+		release();
+	}
+
+	void configured_library::release() NOEXCEPT_SPEC
+	{
+		if(initialized) {
+			::sqlite3_shutdown();
+			initialized = false;
+		}
+		// SQLite must stop referring to the memory before it is freed.
+		if(pagecache) {
+			::sqlite3_config(SQLITE_CONFIG_PAGECACHE, nullptr, 0, 0);
+			pagecache.reset();
+		}
+		if(pcacheModule) {
+			::sqlite3_config(SQLITE_CONFIG_PCACHE2, &previousPcache);
+			pcacheModule.reset();
+		}
+		if(allocator) {
+			::sqlite3_config(SQLITE_CONFIG_MALLOC, &previousMethods);
+			allocator.reset();
+		}
+	}
+
+	pool_allocator_stats configured_library::allocator_stats() const
+		NOEXCEPT_SPEC
+	{
+		return allocator ? allocator->stats() : pool_allocator_stats();
+	}
+	pcache_stats configured_library::page_cache_stats() const
+	{
+		return pcacheModule ? pcacheModule->stats() : pcache_stats();
+	}
+
+	config_builder& config_builder::single_thread() NOEXCEPT_SPEC
+	{
+		threading = SQLITE_CONFIG_SINGLETHREAD;
+		return *this;
+	}
+	config_builder& config_builder::multi_thread() NOEXCEPT_SPEC
+	{
+		threading = SQLITE_CONFIG_MULTITHREAD;
+		return *this;
+	}
+	config_builder& config_builder::serialized() NOEXCEPT_SPEC
+	{
+		threading = SQLITE_CONFIG_SERIALIZED;
+		return *this;
+	}
+	config_builder& config_builder::memory_status(bool e) NOEXCEPT_SPEC
+	{
+		memoryStatus = e ? 1 : 0;
+		return *this;
+	}
+	config_builder& config_builder::uri(bool e) NOEXCEPT_SPEC
+	{
+		uriFilenames = e ? 1 : 0;
+		return *this;
+	}
+	config_builder& config_builder::mmap_size(sqlite3_int64_t d,
+											  sqlite3_int64_t m) NOEXCEPT_SPEC
+	{
+		mmapDefault = d;
+		mmapMax = m;
+		return *this;
+	}
+	config_builder& config_builder::lookaside(int size, int count) NOEXCEPT_SPEC
+	{
+		lookasideSize = size;
+		lookasideCount = count;
+		return *this;
+	}
+	config_builder& config_builder::pagecache(int size, int count) NOEXCEPT_SPEC
+	{
+		pagecacheSize = size;
+		pagecacheCount = count;
+		return *this;
+	}
+	config_builder&
+		config_builder::use_pool_allocator(const pool_allocator_options& o)
+	{
+		usePool = true;
+		poolOptions = o;
+		return *this;
+	}
+	config_builder&
+		config_builder::use_sharded_pcache(const sharded_pcache_options& o)
+	{
+		useShardedPcache = true;
+		pcacheOptions = o;
+		return *this;
+	}
+
+	configured_library config_builder::initialize() const
+	{
+		// On failure, the library undoes the configuration that refers to
+		// the memory it owns as it is destroyed.
+		configured_library library;
+		auto check = [](int code) {
+			if(code != SQLITE_OK) detail::throw_result_error(code, nullptr);
+		};
+
+		if(threading != 0) check(::sqlite3_config(threading));
+		if(memoryStatus >= 0) {
+			check(::sqlite3_config(SQLITE_CONFIG_MEMSTATUS, memoryStatus));
+		}
+		if(uriFilenames >= 0) {
+			check(::sqlite3_config(SQLITE_CONFIG_URI, uriFilenames));
+		}
+		if(mmapDefault >= 0) {
+			check(::sqlite3_config(SQLITE_CONFIG_MMAP_SIZE, mmapDefault,
+								   mmapMax));
+		}
+		if(lookasideSize >= 0) {
+			check(::sqlite3_config(SQLITE_CONFIG_LOOKASIDE, lookasideSize,
+								   lookasideCount));
+		}
+		if(pagecacheSize > 0 && pagecacheCount > 0) {
+			auto headerSize = 0;
+			check(::sqlite3_config(SQLITE_CONFIG_PCACHE_HDRSZ, &headerSize));
+			auto slot = (pagecacheSize + headerSize + 7) & ~7;
+			library.pagecache.reset(new unsigned char[
+				static_cast<std::size_t>(slot) *
+				static_cast<std::size_t>(pagecacheCount)]);
+			check(::sqlite3_config(SQLITE_CONFIG_PAGECACHE,
+								   library.pagecache.get(), slot,
+								   pagecacheCount));
+		}
+		if(usePool) {
+			check(::sqlite3_config(SQLITE_CONFIG_GETMALLOC,
+								   &library.previousMethods));
+			library.allocator.reset(new detail::pool_allocator(poolOptions));
+			sqlite3_mem_methods methods = {
+				&detail::pool_allocator::x_malloc,
+				&detail::pool_allocator::x_free,
+				&detail::pool_allocator::x_realloc,
+				&detail::pool_allocator::x_size,
+				&detail::pool_allocator::x_roundup,
+				&detail::pool_allocator::x_init,
+				&detail::pool_allocator::x_shutdown,
+				library.allocator.get()};
+			check(::sqlite3_config(SQLITE_CONFIG_MALLOC, &methods));
+		}
+
+		if(useShardedPcache) {
+			check(::sqlite3_config(SQLITE_CONFIG_GETPCACHE2,
+								   &library.previousPcache));
+			library.pcacheModule.reset(
+				new detail::sharded_pcache(pcacheOptions));
+			auto methods = library.pcacheModule->methods();
+			check(::sqlite3_config(SQLITE_CONFIG_PCACHE2, &methods));
+		}
+
+		check(::sqlite3_initialize());
+		library.initialized = true;
+		return library;
+	}
+}
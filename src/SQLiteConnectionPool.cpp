@@ -0,0 +1,216 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	A thread-safe pool of connections to a single database file, made up of
+	a number of read-only connections and one writer connection, for use
+	with databases in WAL mode.
+*/
+
+#include "SQLiteConnectionPool.hpp"
+#include <functional>
+#include <thread>
+
+namespace Sqlt3
+{
+	namespace
+	{
+		long long now_nanos() NOEXCEPT_SPEC
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(
+					   std::chrono::steady_clock::now().time_since_epoch())
+				.count();
+		}
+		void record_max(std::atomic<long long>& max, long long v) NOEXCEPT_SPEC
+		{
+			auto current = max.load(std::memory_order_relaxed);
+			while(v > current &&
+				  !max.compare_exchange_weak(current, v,
+											 std::memory_order_relaxed)) {
+			}
+		}
+	}
+
+	double connection_pool_metrics::utilization() const NOEXCEPT_SPEC
+	{
+		if(lifetime.count() <= 0 || connections == 0) return 0.0;
+		return static_cast<double>(busyTime.count()) /
+			   (static_cast<double>(lifetime.count()) *
+				static_cast<double>(connections));
+	}
+
+	connection_pool::connection_pool(utf8_string_in_t file,
+									 const connection_pool_options& o)
+		: slots(new slot[o.readers + 1]), readerCount(o.readers), options(o),
+		  created(clock::now()), waiters(0), checkoutCount(0), waitCount(0),
+		  timeoutCount(0), waitNanos(0), maxWaitNanos(0), busyNanos(0)
+	{
+		if(!Sqlt3::sqlite3_threadsafe()) {
+			detail::throw_result_error(SQLITE_MISUSE, nullptr);
+		}
+		for(std::size_t i = 0; i <= readerCount; ++i) {
+			slots[i].busy.store(false);
+			slots[i].acquiredAt.store(0);
+		}
+
+		// The writer is opened first so that it can create the file.
+		auto& writer = slots[readerCount].connection;
+		writer = sqlite3_open_v2(file, sqlite_open_readwrite |
+										   sqlite_open_create |
+										   sqlite_open_nomutex | sqlite_open_uri,
+								 o.vfs);
+		Sqlt3::sqlite3_busy_timeout(writer.get(), o.busyTimeout);
+		if(o.enableWal) {
+			sqlite3_exec(writer.get(), "PRAGMA journal_mode=WAL", nullptr,
+						 nullptr);
+		}
+
+		for(std::size_t i = 0; i < readerCount; ++i) {
+			auto& reader = slots[i].connection;
+			reader = sqlite3_open_v2(file, sqlite_open_readonly |
+											   sqlite_open_nomutex |
+											   sqlite_open_uri,
+									 o.vfs);
+			Sqlt3::sqlite3_busy_timeout(reader.get(), o.busyTimeout);
+		}
+	}
+	connection_pool::~connection_pool() NOEXCEPT_SPEC
+	{
+	}
+
+	pooled_connection connection_pool::acquire_reader()
+	{
+		return checkout(0, readerCount);
+	}
+	pooled_connection connection_pool::acquire_writer()
+	{
+		return checkout(readerCount, 1);
+	}
+
+	connection_pool_metrics connection_pool::metrics() const NOEXCEPT_SPEC
+	{
+		connection_pool_metrics m;
+		m.checkouts = checkoutCount.load();
+		m.waits = waitCount.load();
+		m.timeouts = timeoutCount.load();
+		m.waitTime = std::chrono::nanoseconds(waitNanos.load());
+		m.maxWaitTime = std::chrono::nanoseconds(maxWaitNanos.load());
+		m.connections = readerCount + 1;
+
+		auto now = now_nanos();
+		auto busy = busyNanos.load();
+		for(std::size_t i = 0; i <= readerCount; ++i) {
+			if(!slots[i].busy.load()) continue;
+			busy += now - slots[i].acquiredAt.load();
+			if(i == readerCount) {
+				m.writerInUse = true;
+			}
+			else {
+				++m.readersInUse;
+			}
+		}
+		m.busyTime = std::chrono::nanoseconds(busy);
+		m.lifetime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			clock::now() - created);
+		return m;
+	}
+
+	bool connection_pool::try_claim(std::size_t first, std::size_t count,
+									std::size_t& claimed) NOEXCEPT_SPEC
+	{
+		if(count == 0) return false;
+		// Threads start probing at different slots to spread contention.
+		static thread_local const std::size_t hint =
+			std::hash<std::thread::id>()(std::this_thread::get_id());
+		for(std::size_t n = 0; n < count; ++n) {
+			auto i = first + (hint + n) % count;
+			auto expected = false;
+			if(!slots[i].busy.load(std::memory_order_relaxed) &&
+			   slots[i].busy.compare_exchange_strong(
+				   expected, true, std::memory_order_acquire)) {
+				slots[i].acquiredAt.store(now_nanos(),
+										  std::memory_order_relaxed);
+				claimed = i;
+				return true;
+			}
+		}
+		return false;
+	}
+	pooled_connection connection_pool::checkout(std::size_t first,
+												std::size_t count)
+	{
+		std::size_t claimed = 0;
+		if(!try_claim(first, count, claimed)) {
+			if(options.timeout.count() <= 0) {
+				++timeoutCount;
+				detail::throw_result_error(SQLITE_BUSY, nullptr);
+			}
+
+			auto start = clock::now();
+			++waitCount;
+			++waiters;
+			bool success = false;
+			{
+				std::unique_lock<std::mutex> lock(waitMutex);
+				success = released.wait_until(
+					lock, start + options.timeout,
+					[&] { return try_claim(first, count, claimed); });
+			}
+			--waiters;
+
+			auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(
+							  clock::now() - start)
+							  .count();
+			waitNanos += waited;
+			record_max(maxWaitNanos, waited);
+			if(!success) {
+				++timeoutCount;
+				detail::throw_result_error(SQLITE_BUSY, nullptr);
+			}
+		}
+
+		++checkoutCount;
+		return pooled_connection{slots[claimed].connection.get(),
+								 detail::PooledConnectionDeleter{this, claimed}};
+	}
+	void connection_pool::release(std::size_t i) NOEXCEPT_SPEC
+	{
+		busyNanos += now_nanos() - slots[i].acquiredAt.load();
+		slots[i].busy.store(false);
+		if(waiters.load() > 0) {
+			{
+				std::lock_guard<std::mutex> lock(waitMutex);
+			}
+			released.notify_all();
+		}
+	}
+
+	namespace detail
+	{
+		void PooledConnectionDeleter::operator()(pointer) const NOEXCEPT_SPEC
+		{
+			if(pool != nullptr) pool->release(slot);
+		}
+	}
+}
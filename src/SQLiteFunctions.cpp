@@ -0,0 +1,378 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Reporting of exceptions thrown by SQL functions, and the built-in
+	vector and hashing functions.
+*/
+
+#include "SQLiteFunctions.hpp"
+#include <cstring>
+#include <limits>
+#include <new>
+
+namespace Sqlt3
+{
+	namespace
+	{
+		// Partial results kept by the kernels. Sums are accumulated in
+		// doubles, as float lanes lose precision over long vectors; eight
+		// doubles fill two 256-bit registers.
+		const std::size_t lanes = 8;
+		const double null_result = std::numeric_limits<double>::quiet_NaN();
+
+#if defined(SQLITE_INNOCUOUS)
+		const int builtin_flags =
+			SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS;
+#else
+		const int builtin_flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC;
+#endif// defined(SQLITE_INNOCUOUS)
+
+		// The elements of a vector, read without alignment as blobs have
+		// none.
+		struct float_vector
+		{
+			const unsigned char* bytes;
+			std::size_t count;
+
+			float operator[](std::size_t i) const NOEXCEPT_SPEC
+			{
+				float f;
+				std::memcpy(&f, bytes + i * sizeof(float), sizeof(float));
+				return f;
+			}
+		};
+
+		float_vector vector_of(sqlite3_value_t v, utf8_string_in_t function)
+		{
+			// The pointer first, as converting the value to a blob may
+			// change its size.
+			auto bytes =
+				static_cast<const unsigned char*>(::sqlite3_value_blob(v));
+			auto size = static_cast<std::size_t>(::sqlite3_value_bytes(v));
+			if(size % sizeof(float) != 0) {
+				utf8_string_out_t message(function);
+				message += ": blob size is not a multiple of 4";
+				throw sqlite3_error(SQLITE_MISMATCH, message.c_str());
+			}
+			float_vector f;
+			f.bytes = bytes;
+			f.count = size / sizeof(float);
+			return f;
+		}
+
+		double sum(const float_vector& v) NOEXCEPT_SPEC
+		{
+			double partial[lanes] = {};
+			std::size_t i = 0;
+			for(; i + lanes <= v.count; i += lanes) {
+				for(std::size_t l = 0; l < lanes; ++l) {
+					partial[l] += v[i + l];
+				}
+			}
+			double total = 0.0;
+			for(auto p : partial) {
+				total += p;
+			}
+			for(; i < v.count; ++i) {
+				total += v[i];
+			}
+			return total;
+		}
+		template <typename Better>
+		double extreme(const float_vector& v, Better better) NOEXCEPT_SPEC
+		{
+			if(v.count == 0) return null_result;
+			float partial[lanes];
+			for(std::size_t l = 0; l < lanes; ++l) {
+				partial[l] = v[0];
+			}
+			std::size_t i = 0;
+			for(; i + lanes <= v.count; i += lanes) {
+				for(std::size_t l = 0; l < lanes; ++l) {
+					auto x = v[i + l];
+					partial[l] = better(x, partial[l]) ? x : partial[l];
+				}
+			}
+			auto result = partial[0];
+			for(auto p : partial) {
+				result = better(p, result) ? p : result;
+			}
+			for(; i < v.count; ++i) {
+				result = better(v[i], result) ? v[i] : result;
+			}
+			return result;
+		}
+		double variance(const float_vector& v) NOEXCEPT_SPEC
+		{
+			// Two passes, as the sum of squares loses precision.
+			if(v.count == 0) return null_result;
+			auto mean = sum(v) / v.count;
+			double partial[lanes] = {};
+			std::size_t i = 0;
+			for(; i + lanes <= v.count; i += lanes) {
+				for(std::size_t l = 0; l < lanes; ++l) {
+					auto d = v[i + l] - mean;
+					partial[l] += d * d;
+				}
+			}
+			double total = 0.0;
+			for(auto p : partial) {
+				total += p;
+			}
+			for(; i < v.count; ++i) {
+				double d = v[i] - mean;
+				total += d * d;
+			}
+			return total / v.count;
+		}
+		double dot(const float_vector& a, const float_vector& b) NOEXCEPT_SPEC
+		{
+			double partial[lanes] = {};
+			std::size_t i = 0;
+			for(; i + lanes <= a.count; i += lanes) {
+				for(std::size_t l = 0; l < lanes; ++l) {
+					partial[l] += static_cast<double>(a[i + l]) * b[i + l];
+				}
+			}
+			double total = 0.0;
+			for(auto p : partial) {
+				total += p;
+			}
+			for(; i < a.count; ++i) {
+				total += static_cast<double>(a[i]) * b[i];
+			}
+			return total;
+		}
+
+		// A finaliser of MurmurHash3.
+		unsigned long long mix(unsigned long long h) NOEXCEPT_SPEC
+		{
+			h ^= h >> 33;
+			h *= 0xff51afd7ed558ccdull;
+			h ^= h >> 33;
+			h *= 0xc4ceb9fe1a85ec53ull;
+			h ^= h >> 33;
+			return h;
+		}
+		// Read as little endian, so that hashes are the same everywhere.
+		unsigned long long load64(const unsigned char* p,
+								  std::size_t n) NOEXCEPT_SPEC
+		{
+			unsigned long long k = 0;
+			for(std::size_t i = 0; i < n; ++i) {
+				k |= static_cast<unsigned long long>(p[i]) << (8 * i);
+			}
+			return k;
+		}
+		unsigned long long hash_bytes(const unsigned char* p, std::size_t n,
+									  unsigned long long seed) NOEXCEPT_SPEC
+		{
+			const auto multiplier = 0x9e3779b97f4a7c15ull;
+			auto h = seed ^ (n * multiplier);
+			std::size_t i = 0;
+			for(; i + 8 <= n; i += 8) {
+				h = (h ^ mix(load64(p + i, 8))) * multiplier;
+			}
+			if(i < n) h = (h ^ mix(load64(p + i, n - i))) * multiplier;
+			return mix(h);
+		}
+
+		void hash64(sqlite3_context* c, int, sqlite3_value_t* argv)
+		{
+			auto v = argv[0];
+			auto type = ::sqlite3_value_type(v);
+			// The type is part of the seed, so 1, 1.0 and '1' differ.
+			auto seed = static_cast<unsigned long long>(type);
+			unsigned char bytes[8];
+			unsigned long long h = 0;
+			switch(type) {
+			case SQLITE_NULL:
+				::sqlite3_result_null(c);
+				return;
+			case SQLITE_INTEGER: {
+				auto i =
+					static_cast<sqlite3_uint64_t>(::sqlite3_value_int64(v));
+				for(std::size_t b = 0; b < 8; ++b) {
+					bytes[b] = static_cast<unsigned char>(i >> (8 * b));
+				}
+				h = hash_bytes(bytes, 8, seed);
+				break;
+			}
+			case SQLITE_FLOAT: {
+				auto d = ::sqlite3_value_double(v);
+				sqlite3_uint64_t i;
+				std::memcpy(&i, &d, sizeof(i));
+				for(std::size_t b = 0; b < 8; ++b) {
+					bytes[b] = static_cast<unsigned char>(i >> (8 * b));
+				}
+				h = hash_bytes(bytes, 8, seed);
+				break;
+			}
+			default: {
+				auto p = static_cast<const unsigned char*>(
+					type == SQLITE_TEXT
+						? static_cast<const void*>(::sqlite3_value_text(v))
+						: ::sqlite3_value_blob(v));
+				h = hash_bytes(p, static_cast<std::size_t>(
+									  ::sqlite3_value_bytes(v)),
+							   seed);
+				break;
+			}
+			}
+			::sqlite3_result_int64(c, static_cast<sqlite3_int64_t>(h));
+		}
+
+		// Welford's method, which can also remove values leaving a window.
+		struct sample_variance
+		{
+			sqlite3_int64_t count = 0;
+			double mean = 0.0;
+			double squares = 0.0;
+
+			void step(sqlite3_value_t v) NOEXCEPT_SPEC
+			{
+				if(::sqlite3_value_type(v) == SQLITE_NULL) return;
+				auto x = ::sqlite3_value_double(v);
+				++count;
+				auto d = x - mean;
+				mean += d / static_cast<double>(count);
+				squares += d * (x - mean);
+			}
+			void inverse(sqlite3_value_t v) NOEXCEPT_SPEC
+			{
+				if(::sqlite3_value_type(v) == SQLITE_NULL) return;
+				if(--count == 0) {
+					mean = squares = 0.0;
+					return;
+				}
+				auto x = ::sqlite3_value_double(v);
+				auto d = x - mean;
+				mean -= d / static_cast<double>(count);
+				squares -= d * (x - mean);
+			}
+			double value() const NOEXCEPT_SPEC
+			{
+				if(count < 2) return null_result;
+				return std::max(squares, 0.0) / static_cast<double>(count - 1);
+			}
+			double final() const NOEXCEPT_SPEC
+			{
+				return value();
+			}
+		};
+	}
+
+	namespace detail
+	{
+		void report_function_error(sqlite3_context* c) NOEXCEPT_SPEC
+		{
+			try {
+				throw;
+			}
+			catch(const sqlite3_error& e) {
+				::sqlite3_result_error(c, e.description(), -1);
+				::sqlite3_result_error_code(c, e.code());
+			}
+			catch(const std::bad_alloc&) {
+				::sqlite3_result_error_nomem(c);
+			}
+			catch(const std::exception& e) {
+				::sqlite3_result_error(c, e.what(), -1);
+			}
+			catch(...) {
+				::sqlite3_result_error(c, "unknown exception", -1);
+			}
+		}
+	}
+
+	void register_vector_functions(sqlite3_t c)
+	{
+		sqlite3_create_function_v2(
+			c, "vec_sum",
+			[](sqlite3_value_t v) {
+				if(::sqlite3_value_type(v) == SQLITE_NULL) return null_result;
+				return sum(vector_of(v, "vec_sum"));
+			},
+			builtin_flags);
+		sqlite3_create_function_v2(
+			c, "vec_min",
+			[](sqlite3_value_t v) {
+				if(::sqlite3_value_type(v) == SQLITE_NULL) return null_result;
+				return extreme(vector_of(v, "vec_min"),
+							   [](float x, float y) { return x < y; });
+			},
+			builtin_flags);
+		sqlite3_create_function_v2(
+			c, "vec_max",
+			[](sqlite3_value_t v) {
+				if(::sqlite3_value_type(v) == SQLITE_NULL) return null_result;
+				return extreme(vector_of(v, "vec_max"),
+							   [](float x, float y) { return x > y; });
+			},
+			builtin_flags);
+		sqlite3_create_function_v2(
+			c, "vec_mean",
+			[](sqlite3_value_t v) {
+				if(::sqlite3_value_type(v) == SQLITE_NULL) return null_result;
+				auto f = vector_of(v, "vec_mean");
+				if(f.count == 0) return null_result;
+				return sum(f) / static_cast<double>(f.count);
+			},
+			builtin_flags);
+		sqlite3_create_function_v2(
+			c, "vec_variance",
+			[](sqlite3_value_t v) {
+				if(::sqlite3_value_type(v) == SQLITE_NULL) return null_result;
+				return variance(vector_of(v, "vec_variance"));
+			},
+			builtin_flags);
+		sqlite3_create_function_v2(
+			c, "vec_dot",
+			[](sqlite3_value_t x, sqlite3_value_t y) {
+				if(::sqlite3_value_type(x) == SQLITE_NULL ||
+				   ::sqlite3_value_type(y) == SQLITE_NULL) {
+					return null_result;
+				}
+				auto a = vector_of(x, "vec_dot");
+				auto b = vector_of(y, "vec_dot");
+				if(a.count != b.count) {
+					throw sqlite3_error(SQLITE_MISMATCH,
+										"vec_dot: vectors differ in length");
+				}
+				return dot(a, b);
+			},
+			builtin_flags);
+
+		// Written against the C interface, as its result may be NULL or
+		// an integer.
+		auto code = ::sqlite3_create_function_v2(c, "hash64", 1, builtin_flags,
+												 nullptr, &hash64, nullptr,
+												 nullptr, nullptr);
+		if(code != SQLITE_OK) detail::throw_result_error(code, c);
+
+		sqlite3_create_window_function(c, "variance", sample_variance(),
+									   builtin_flags);
+	}
+}
@@ -0,0 +1,238 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Periodic sampling of the global memory status of SQLite and of the
+	memory status of a set of connections, publishing the readings and
+	their changes since the previous sample as a time series.
+*/
+
+#include "SQLiteMemorySampler.hpp"
+#include <algorithm>
+#include <tuple>
+
+namespace Sqlt3
+{
+	namespace
+	{
+		int db_current(sqlite3_t c, int op) NOEXCEPT_SPEC
+		{
+			int current = 0, highwater = 0;
+			::sqlite3_db_status(c, op, &current, &highwater, 0);
+			return current;
+		}
+		int db_highwater(sqlite3_t c, int op) NOEXCEPT_SPEC
+		{
+			int current = 0, highwater = 0;
+			::sqlite3_db_status(c, op, &current, &highwater, 0);
+			return highwater;
+		}
+		std::tuple<sqlite3_int64_t, sqlite3_int64_t> global_status(int op)
+			NOEXCEPT_SPEC
+		{
+			sqlite3_int64_t current = 0, highwater = 0;
+			::sqlite3_status64(op, &current, &highwater, 0);
+			return std::make_tuple(current, highwater);
+		}
+
+		// The counters only go backwards when they wrap or are reset by
+		// another caller, after which they count up from zero again.
+		long long growth(int now, int& previous) NOEXCEPT_SPEC
+		{
+			auto d = now >= previous ? static_cast<long long>(now) - previous
+									 : static_cast<long long>(now);
+			previous = now;
+			return d < 0 ? 0 : d;
+		}
+	}
+
+	double connection_memory_sample::cache_hit_ratio() const NOEXCEPT_SPEC
+	{
+		auto reads = cacheHits + cacheMisses;
+		if(reads <= 0) return 1.0;
+		return static_cast<double>(cacheHits) / static_cast<double>(reads);
+	}
+	double connection_memory_sample::lookaside_miss_rate() const NOEXCEPT_SPEC
+	{
+		auto misses = lookasideMissSize + lookasideMissFull;
+		auto total = lookasideHits + misses;
+		if(total <= 0) return 0.0;
+		return static_cast<double>(misses) / static_cast<double>(total);
+	}
+
+	memory_sampler::memory_sampler(std::chrono::milliseconds i,
+								   std::size_t history, callback_t c)
+		: interval(i), callback(std::move(c)), previousTime(clock::now()),
+		  capacity(std::max<std::size_t>(1, history))
+	{
+		previousMallocCount =
+			std::get<0>(global_status(SQLITE_STATUS_MALLOC_COUNT));
+		previousOverflow =
+			std::get<0>(global_status(SQLITE_STATUS_PAGECACHE_OVERFLOW));
+		ring.reserve(capacity);
+		worker = std::thread(&memory_sampler::run, this);
+	}
+	memory_sampler::~memory_sampler() NOEXCEPT_SPEC
+	{
+		{
+			std::lock_guard<std::mutex> lock(stopMutex);
+			stopping = true;
+		}
+		stopped.notify_one();
+		worker.join();
+	}
+
+	void memory_sampler::add(sqlite3_t c, utf8_string_in_t name)
+	{
+		tracked t;
+		t.connection = c;
+		t.name = name;
+		t.cacheHits = db_current(c, SQLITE_DBSTATUS_CACHE_HIT);
+		t.cacheMisses = db_current(c, SQLITE_DBSTATUS_CACHE_MISS);
+		t.cacheWrites = db_current(c, SQLITE_DBSTATUS_CACHE_WRITE);
+		t.cacheSpills = db_current(c, SQLITE_DBSTATUS_CACHE_SPILL);
+		t.lookasideHits = db_highwater(c, SQLITE_DBSTATUS_LOOKASIDE_HIT);
+		t.lookasideMissSize =
+			db_highwater(c, SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE);
+		t.lookasideMissFull =
+			db_highwater(c, SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL);
+
+		std::lock_guard<std::mutex> lock(connectionsMutex);
+		connections.push_back(std::move(t));
+	}
+	void memory_sampler::remove(sqlite3_t c)
+	{
+		std::lock_guard<std::mutex> lock(connectionsMutex);
+		connections.erase(
+			std::remove_if(connections.begin(), connections.end(),
+						   [c](const tracked& t) { return t.connection == c; }),
+			connections.end());
+	}
+
+	memory_sample memory_sampler::sample()
+	{
+		memory_sample s;
+		std::lock_guard<std::mutex> sampling(sampleMutex);
+		s.time = clock::now();
+		s.interval = s.time - previousTime;
+		previousTime = s.time;
+
+		std::tie(s.memoryUsed, s.memoryHighwater) =
+			global_status(SQLITE_STATUS_MEMORY_USED);
+		s.mallocCount =
+			std::get<0>(global_status(SQLITE_STATUS_MALLOC_COUNT));
+		s.mallocCountGrowth = s.mallocCount - previousMallocCount;
+		previousMallocCount = s.mallocCount;
+		s.mallocSizeHighwater =
+			std::get<1>(global_status(SQLITE_STATUS_MALLOC_SIZE));
+		s.pagecacheUsed =
+			std::get<0>(global_status(SQLITE_STATUS_PAGECACHE_USED));
+		s.pagecacheOverflow =
+			std::get<0>(global_status(SQLITE_STATUS_PAGECACHE_OVERFLOW));
+		s.pagecacheOverflowGrowth = s.pagecacheOverflow - previousOverflow;
+		previousOverflow = s.pagecacheOverflow;
+		s.pagecacheSizeHighwater =
+			std::get<1>(global_status(SQLITE_STATUS_PAGECACHE_SIZE));
+		s.parserStackHighwater =
+			std::get<1>(global_status(SQLITE_STATUS_PARSER_STACK));
+
+		{
+			std::lock_guard<std::mutex> lock(connectionsMutex);
+			s.connections.reserve(connections.size());
+			for(auto& t : connections) {
+				auto c = t.connection;
+				connection_memory_sample cs;
+				cs.connection = c;
+				cs.name = t.name;
+				cs.lookasideUsed =
+					db_current(c, SQLITE_DBSTATUS_LOOKASIDE_USED);
+				cs.cacheUsed = db_current(c, SQLITE_DBSTATUS_CACHE_USED);
+				cs.cacheUsedShared =
+					db_current(c, SQLITE_DBSTATUS_CACHE_USED_SHARED);
+				cs.schemaUsed = db_current(c, SQLITE_DBSTATUS_SCHEMA_USED);
+				cs.stmtUsed = db_current(c, SQLITE_DBSTATUS_STMT_USED);
+				cs.cacheHits = growth(db_current(c, SQLITE_DBSTATUS_CACHE_HIT),
+									  t.cacheHits);
+				cs.cacheMisses = growth(
+					db_current(c, SQLITE_DBSTATUS_CACHE_MISS), t.cacheMisses);
+				cs.cacheWrites = growth(
+					db_current(c, SQLITE_DBSTATUS_CACHE_WRITE), t.cacheWrites);
+				cs.cacheSpills = growth(
+					db_current(c, SQLITE_DBSTATUS_CACHE_SPILL), t.cacheSpills);
+				// The lookaside counters are reported as highwater values.
+				cs.lookasideHits = growth(
+					db_highwater(c, SQLITE_DBSTATUS_LOOKASIDE_HIT),
+					t.lookasideHits);
+				cs.lookasideMissSize = growth(
+					db_highwater(c, SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE),
+					t.lookasideMissSize);
+				cs.lookasideMissFull = growth(
+					db_highwater(c, SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL),
+					t.lookasideMissFull);
+				cs.deferredForeignKeys =
+					db_current(c, SQLITE_DBSTATUS_DEFERRED_FKS) != 0;
+				s.connections.push_back(std::move(cs));
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(historyMutex);
+			if(ring.size() < capacity) {
+				ring.push_back(s);
+			}
+			else {
+				ring[next] = s;
+			}
+			next = (next + 1) % capacity;
+		}
+		if(callback) callback(s);
+		return s;
+	}
+
+	std::vector<memory_sample> memory_sampler::history() const
+	{
+		std::lock_guard<std::mutex> lock(historyMutex);
+		if(ring.size() < capacity) return ring;
+		std::vector<memory_sample> ordered;
+		ordered.reserve(capacity);
+		ordered.insert(ordered.end(), ring.begin() + next, ring.end());
+		ordered.insert(ordered.end(), ring.begin(), ring.begin() + next);
+		return ordered;
+	}
+
+	void memory_sampler::run() NOEXCEPT_SPEC
+	{
+		std::unique_lock<std::mutex> lock(stopMutex);
+		while(!stopped.wait_for(lock, interval, [this] { return stopping; })) {
+			lock.unlock();
+			try {
+				sample();
+			}
+			catch(...) {
+				// Out of memory; skip this sample.
+			}
+			lock.lock();
+		}
+	}
+}
@@ -0,0 +1,558 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	A Virtual File System keeping databases in memory as reference-counted
+	pages, so that a database can be captured as a snapshot and forked into
+	others that share its pages until they are written.
+*/
+
+#include "SQLiteMemoryVfs.hpp"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <unordered_set>
+#include <vector>
+
+namespace Sqlt3
+{
+	namespace
+	{
+		const std::size_t page_bytes = 4096;
+
+		struct page
+		{
+			char bytes[page_bytes];
+		};
+	}
+
+	namespace detail
+	{
+		// Pages are immutable while shared; a null page reads as zeros.
+		struct memory_pages
+		{
+			std::vector<std::shared_ptr<page>> pages;
+			sqlite3_int64_t size = 0;
+		};
+	}
+
+	sqlite3_int64_t memory_snapshot::size() const NOEXCEPT_SPEC
+	{
+		return pages ? pages->size : 0;
+	}
+	memory_snapshot::operator bool() const NOEXCEPT_SPEC
+	{
+		return pages != nullptr;
+	}
+
+	// A file, shared by every connection that opens it. The locks follow
+	// those of SQLite itself, for connections of this process only.
+	struct memory_vfs::image
+	{
+		std::mutex mutex;
+		detail::memory_pages content;
+		int opened = 0;
+		int readers = 0;
+		const void* writer = nullptr;
+		bool pending = false;
+
+		// Copies a page that is shared with a snapshot or another file,
+		// and allocates one that is missing.
+		char* writable(std::size_t i, bool& copied)
+		{
+			auto& p = content.pages[i];
+			copied = false;
+			if(!p) {
+				p = std::make_shared<page>();
+				std::memset(p->bytes, 0, page_bytes);
+			}
+			else if(p.use_count() > 1) {
+				p = std::make_shared<page>(*p);
+				copied = true;
+			}
+			else {
+				// The last other owner may have just released the page.
+				std::atomic_thread_fence(std::memory_order_acquire);
+			}
+			return p->bytes;
+		}
+		void resize(sqlite3_int64_t size)
+		{
+			auto count = static_cast<std::size_t>(
+				(size + page_bytes - 1) / page_bytes);
+			content.pages.resize(count);
+			// Bytes past the end of a shrunken file must read as zeros if
+			// the file grows again.
+			auto tail = static_cast<std::size_t>(size % page_bytes);
+			if(tail != 0 && content.pages.back()) {
+				bool copied;
+				auto bytes = writable(count - 1, copied);
+				std::memset(bytes + tail, 0, page_bytes - tail);
+			}
+			content.size = size;
+		}
+	};
+
+	struct memory_vfs::file
+	{
+		sqlite3_file base;
+		memory_vfs* owner;
+		std::shared_ptr<image> data;
+		utf8_string_out_t name;
+		bool deleteOnClose = false;
+		int lock = SQLITE_LOCK_NONE;
+
+		explicit file(memory_vfs* o) : owner(o)
+		{
+			base.pMethods = nullptr;
+		}
+
+		static file& of(sqlite3_file* f) NOEXCEPT_SPEC
+		{
+			return *reinterpret_cast<file*>(f);
+		}
+	};
+
+	memory_vfs::memory_vfs(const memory_vfs_options& o)
+		: options(o), vfsName(o.name != nullptr ? o.name : "cow-memory"),
+		  baseVfs(::sqlite3_vfs_find(o.base)), copiedPages(0)
+	{
+		if(baseVfs == nullptr) {
+			detail::throw_result_error(SQLITE_ERROR, nullptr);
+		}
+		options.name = vfsName.c_str();
+
+		methods.reset(new sqlite3_io_methods());
+		auto& m = *methods;
+		m.iVersion = 1;
+		m.xClose = &x_close;
+		m.xRead = &x_read;
+		m.xWrite = &x_write;
+		m.xTruncate = &x_truncate;
+		m.xSync = &x_sync;
+		m.xFileSize = &x_file_size;
+		m.xLock = &x_lock;
+		m.xUnlock = &x_unlock;
+		m.xCheckReservedLock = &x_check_reserved_lock;
+		m.xFileControl = &x_file_control;
+		m.xSectorSize = &x_sector_size;
+		m.xDeviceCharacteristics = &x_device_characteristics;
+
+		// Files are kept here; everything else is passed to the base VFS.
+		vfs.reset(new sqlite3_vfs());
+		auto& v = *vfs;
+		v.iVersion = std::min(baseVfs->iVersion, 2);
+		v.szOsFile = static_cast<int>(sizeof(file));
+		v.mxPathname = std::max(baseVfs->mxPathname, 512);
+		v.zName = vfsName.c_str();
+		v.pAppData = this;
+		v.xOpen = &x_open;
+		v.xDelete = &x_delete;
+		v.xAccess = &x_access;
+		v.xFullPathname = &x_full_pathname;
+		v.xDlOpen = [](sqlite3_vfs* p, const char* n) {
+			auto b = static_cast<memory_vfs*>(p->pAppData)->baseVfs;
+			return b->xDlOpen(b, n);
+		};
+		v.xDlError = [](sqlite3_vfs* p, int size, char* out) {
+			auto b = static_cast<memory_vfs*>(p->pAppData)->baseVfs;
+			b->xDlError(b, size, out);
+		};
+		v.xDlSym = [](sqlite3_vfs* p, void* h, const char* s) {
+			auto b = static_cast<memory_vfs*>(p->pAppData)->baseVfs;
+			return b->xDlSym(b, h, s);
+		};
+		v.xDlClose = [](sqlite3_vfs* p, void* h) {
+			auto b = static_cast<memory_vfs*>(p->pAppData)->baseVfs;
+			b->xDlClose(b, h);
+		};
+		v.xRandomness = [](sqlite3_vfs* p, int size, char* out) {
+			auto b = static_cast<memory_vfs*>(p->pAppData)->baseVfs;
+			return b->xRandomness(b, size, out);
+		};
+		v.xSleep = [](sqlite3_vfs* p, int micros) {
+			auto b = static_cast<memory_vfs*>(p->pAppData)->baseVfs;
+			return b->xSleep(b, micros);
+		};
+		v.xCurrentTime = [](sqlite3_vfs* p, double* out) {
+			auto b = static_cast<memory_vfs*>(p->pAppData)->baseVfs;
+			return b->xCurrentTime(b, out);
+		};
+		v.xGetLastError = [](sqlite3_vfs* p, int size, char* out) {
+			auto b = static_cast<memory_vfs*>(p->pAppData)->baseVfs;
+			return b->xGetLastError(b, size, out);
+		};
+		if(v.iVersion >= 2) {
+			v.xCurrentTimeInt64 = [](sqlite3_vfs* p, sqlite3_int64* out) {
+				auto b = static_cast<memory_vfs*>(p->pAppData)->baseVfs;
+				return b->xCurrentTimeInt64(b, out);
+			};
+		}
+
+		auto code = ::sqlite3_vfs_register(&v, o.makeDefault ? 1 : 0);
+		if(code != SQLITE_OK) detail::throw_result_error(code, nullptr);
+	}
+	memory_vfs::~memory_vfs() NOEXCEPT_SPEC
+	{
+		::sqlite3_vfs_unregister(vfs.get());
+	}
+
+	utf8_string_in_t memory_vfs::name() const NOEXCEPT_SPEC
+	{
+		return vfsName.c_str();
+	}
+
+	std::shared_ptr<memory_vfs::image>
+	memory_vfs::find(utf8_string_in_t name) const
+	{
+		std::lock_guard<std::mutex> lock(imagesMutex);
+		auto found = images.find(name);
+		return found != images.end() ? found->second : nullptr;
+	}
+
+	memory_snapshot memory_vfs::snapshot(utf8_string_in_t name) const
+	{
+		auto source = find(name);
+		if(!source) detail::throw_result_error(SQLITE_CANTOPEN, nullptr);
+
+		auto pages = std::make_shared<detail::memory_pages>();
+		{
+			// A writer may have changed part of a transaction only.
+			std::lock_guard<std::mutex> lock(source->mutex);
+			if(source->writer != nullptr) {
+				detail::throw_result_error(SQLITE_BUSY, nullptr);
+			}
+			*pages = source->content;
+		}
+		memory_snapshot s;
+		s.pages = std::move(pages);
+		return s;
+	}
+	void memory_vfs::restore(utf8_string_in_t name,
+							 const memory_snapshot& snapshot)
+	{
+		if(!snapshot) detail::throw_result_error(SQLITE_MISUSE, nullptr);
+
+		auto created = std::make_shared<image>();
+		created->content = *snapshot.pages;
+		std::lock_guard<std::mutex> lock(imagesMutex);
+		auto& slot = images[name];
+		if(slot) {
+			// Connections cache pages, so an open file must not change
+			// beneath them.
+			std::lock_guard<std::mutex> imageLock(slot->mutex);
+			if(slot->opened > 0) {
+				detail::throw_result_error(SQLITE_BUSY, nullptr);
+			}
+		}
+		slot = std::move(created);
+	}
+	void memory_vfs::fork(utf8_string_in_t from, utf8_string_in_t to)
+	{
+		restore(to, snapshot(from));
+	}
+	bool memory_vfs::exists(utf8_string_in_t name) const
+	{
+		return find(name) != nullptr;
+	}
+	bool memory_vfs::remove(utf8_string_in_t name)
+	{
+		std::lock_guard<std::mutex> lock(imagesMutex);
+		return images.erase(name) > 0;
+	}
+
+	memory_vfs_stats memory_vfs::stats() const
+	{
+		std::vector<std::shared_ptr<image>> held;
+		{
+			std::lock_guard<std::mutex> lock(imagesMutex);
+			held.reserve(images.size());
+			for(auto& i : images) {
+				held.push_back(i.second);
+			}
+		}
+
+		memory_vfs_stats s;
+		s.files = held.size();
+		std::unordered_set<const page*> distinct;
+		for(auto& i : held) {
+			std::lock_guard<std::mutex> lock(i->mutex);
+			for(auto& p : i->content.pages) {
+				if(p) distinct.insert(p.get());
+			}
+		}
+		s.pages = distinct.size();
+		s.bytes = s.pages * page_bytes;
+		s.pagesCopied = copiedPages.load();
+		return s;
+	}
+
+	int memory_vfs::x_open(sqlite3_vfs* v, utf8_string_in_t name,
+						   sqlite3_file* handle, int flags, int* outFlags)
+	{
+		auto self = static_cast<memory_vfs*>(v->pAppData);
+		auto f = new(handle) file(self);
+		try {
+			if(name == nullptr) {
+				// A temporary file, known only to this connection.
+				f->data = std::make_shared<image>();
+			}
+			else {
+				std::lock_guard<std::mutex> lock(self->imagesMutex);
+				auto found = self->images.find(name);
+				if(found != self->images.end()) {
+					f->data = found->second;
+				}
+				else if(flags & SQLITE_OPEN_CREATE) {
+					f->data = std::make_shared<image>();
+					self->images.emplace(name, f->data);
+				}
+				f->name = name;
+			}
+		}
+		catch(...) {
+			f->~file();
+			handle->pMethods = nullptr;
+			return SQLITE_NOMEM;
+		}
+		if(!f->data) {
+			f->~file();
+			handle->pMethods = nullptr;
+			return SQLITE_CANTOPEN;
+		}
+
+		f->deleteOnClose = (flags & SQLITE_OPEN_DELETEONCLOSE) != 0;
+		{
+			std::lock_guard<std::mutex> lock(f->data->mutex);
+			++f->data->opened;
+		}
+		f->base.pMethods = self->methods.get();
+		if(outFlags != nullptr) *outFlags = flags;
+		return SQLITE_OK;
+	}
+	int memory_vfs::x_delete(sqlite3_vfs* v, utf8_string_in_t name, int)
+	{
+		auto self = static_cast<memory_vfs*>(v->pAppData);
+		std::lock_guard<std::mutex> lock(self->imagesMutex);
+		return self->images.erase(name) > 0 ? SQLITE_OK
+											: SQLITE_IOERR_DELETE_NOENT;
+	}
+	int memory_vfs::x_access(sqlite3_vfs* v, utf8_string_in_t name, int,
+							 int* result)
+	{
+		auto self = static_cast<memory_vfs*>(v->pAppData);
+		auto found = self->find(name);
+		if(!found) {
+			*result = 0;
+			return SQLITE_OK;
+		}
+		// An empty journal is as good as none.
+		std::lock_guard<std::mutex> lock(found->mutex);
+		*result = found->content.size > 0 ? 1 : 0;
+		return SQLITE_OK;
+	}
+	int memory_vfs::x_full_pathname(sqlite3_vfs*, utf8_string_in_t name,
+									int size, char* out)
+	{
+		auto length = std::strlen(name);
+		if(length >= static_cast<std::size_t>(size)) return SQLITE_CANTOPEN;
+		std::memcpy(out, name, length + 1);
+		return SQLITE_OK;
+	}
+
+	int memory_vfs::x_close(sqlite3_file* handle)
+	{
+		auto& f = file::of(handle);
+		{
+			std::lock_guard<std::mutex> lock(f.data->mutex);
+			--f.data->opened;
+		}
+		if(f.deleteOnClose && !f.name.empty()) {
+			std::lock_guard<std::mutex> lock(f.owner->imagesMutex);
+			auto found = f.owner->images.find(f.name);
+			if(found != f.owner->images.end() && found->second == f.data) {
+				f.owner->images.erase(found);
+			}
+		}
+		f.~file();
+		return SQLITE_OK;
+	}
+
+	int memory_vfs::x_read(sqlite3_file* handle, void* buffer, int amount,
+						   sqlite3_int64 offset)
+	{
+		auto& f = file::of(handle);
+		auto out = static_cast<char*>(buffer);
+		auto& data = *f.data;
+		std::lock_guard<std::mutex> lock(data.mutex);
+		auto available = std::max<sqlite3_int64_t>(
+			0, std::min<sqlite3_int64_t>(amount, data.content.size - offset));
+		for(sqlite3_int64_t done = 0; done < available;) {
+			auto position = offset + done;
+			auto i = static_cast<std::size_t>(position / page_bytes);
+			auto within = static_cast<std::size_t>(position % page_bytes);
+			auto n = std::min(page_bytes - within,
+							  static_cast<std::size_t>(available - done));
+			auto& p = data.content.pages[i];
+			if(p) {
+				std::memcpy(out + done, p->bytes + within, n);
+			}
+			else {
+				std::memset(out + done, 0, n);
+			}
+			done += static_cast<sqlite3_int64_t>(n);
+		}
+		if(available < amount) {
+			std::memset(out + available, 0,
+						static_cast<std::size_t>(amount - available));
+			return SQLITE_IOERR_SHORT_READ;
+		}
+		return SQLITE_OK;
+	}
+	int memory_vfs::x_write(sqlite3_file* handle, const void* buffer,
+							int amount, sqlite3_int64 offset)
+	{
+		auto& f = file::of(handle);
+		auto in = static_cast<const char*>(buffer);
+		auto& data = *f.data;
+		std::lock_guard<std::mutex> lock(data.mutex);
+		try {
+			auto end = offset + amount;
+			if(end > data.content.size) {
+				auto count = static_cast<std::size_t>(
+					(end + page_bytes - 1) / page_bytes);
+				data.content.pages.resize(
+					std::max(count, data.content.pages.size()));
+				data.content.size = end;
+			}
+			unsigned long long copied = 0;
+			for(sqlite3_int64_t done = 0; done < amount;) {
+				auto position = offset + done;
+				auto i = static_cast<std::size_t>(position / page_bytes);
+				auto within = static_cast<std::size_t>(position % page_bytes);
+				auto n = std::min(page_bytes - within,
+								  static_cast<std::size_t>(amount - done));
+				bool wasCopied;
+				std::memcpy(data.writable(i, wasCopied) + within, in + done, n);
+				if(wasCopied) ++copied;
+				done += static_cast<sqlite3_int64_t>(n);
+			}
+			if(copied != 0) f.owner->copiedPages += copied;
+		}
+		catch(...) {
+			return SQLITE_IOERR_NOMEM;
+		}
+		return SQLITE_OK;
+	}
+	int memory_vfs::x_truncate(sqlite3_file* handle, sqlite3_int64 size)
+	{
+		auto& data = *file::of(handle).data;
+		std::lock_guard<std::mutex> lock(data.mutex);
+		if(size >= data.content.size) return SQLITE_OK;
+		try {
+			data.resize(size);
+		}
+		catch(...) {
+			return SQLITE_IOERR_NOMEM;
+		}
+		return SQLITE_OK;
+	}
+	int memory_vfs::x_sync(sqlite3_file*, int)
+	{
+		return SQLITE_OK;
+	}
+	int memory_vfs::x_file_size(sqlite3_file* handle, sqlite3_int64* size)
+	{
+		auto& data = *file::of(handle).data;
+		std::lock_guard<std::mutex> lock(data.mutex);
+		*size = data.content.size;
+		return SQLITE_OK;
+	}
+
+	int memory_vfs::x_lock(sqlite3_file* handle, int level)
+	{
+		auto& f = file::of(handle);
+		auto& data = *f.data;
+		if(level <= f.lock) return SQLITE_OK;
+		std::lock_guard<std::mutex> lock(data.mutex);
+		if(f.lock == SQLITE_LOCK_NONE) {
+			// A pending writer keeps new readers out so it can finish.
+			if(data.pending) return SQLITE_BUSY;
+			++data.readers;
+			f.lock = SQLITE_LOCK_SHARED;
+		}
+		if(level >= SQLITE_LOCK_RESERVED && f.lock < SQLITE_LOCK_RESERVED) {
+			if(data.writer != nullptr) return SQLITE_BUSY;
+			data.writer = &f;
+			f.lock = SQLITE_LOCK_RESERVED;
+		}
+		if(level == SQLITE_LOCK_EXCLUSIVE) {
+			data.pending = true;
+			f.lock = SQLITE_LOCK_PENDING;
+			if(data.readers > 1) return SQLITE_BUSY;
+			f.lock = SQLITE_LOCK_EXCLUSIVE;
+		}
+		return SQLITE_OK;
+	}
+	int memory_vfs::x_unlock(sqlite3_file* handle, int level)
+	{
+		auto& f = file::of(handle);
+		auto& data = *f.data;
+		if(level >= f.lock) return SQLITE_OK;
+		std::lock_guard<std::mutex> lock(data.mutex);
+		if(f.lock >= SQLITE_LOCK_RESERVED && level < SQLITE_LOCK_RESERVED) {
+			data.writer = nullptr;
+			data.pending = false;
+		}
+		if(level == SQLITE_LOCK_NONE) --data.readers;
+		f.lock = level;
+		return SQLITE_OK;
+	}
+	int memory_vfs::x_check_reserved_lock(sqlite3_file* handle, int* result)
+	{
+		auto& data = *file::of(handle).data;
+		std::lock_guard<std::mutex> lock(data.mutex);
+		*result = data.writer != nullptr ? 1 : 0;
+		return SQLITE_OK;
+	}
+	int memory_vfs::x_file_control(sqlite3_file* handle, int op, void* arg)
+	{
+		auto& f = file::of(handle);
+		if(op == SQLITE_FCNTL_VFSNAME && arg != nullptr) {
+			*static_cast<char**>(arg) =
+				::sqlite3_mprintf("%s", f.owner->vfsName.c_str());
+			return SQLITE_OK;
+		}
+		return SQLITE_NOTFOUND;
+	}
+	int memory_vfs::x_sector_size(sqlite3_file*)
+	{
+		return static_cast<int>(page_bytes);
+	}
+	int memory_vfs::x_device_characteristics(sqlite3_file*)
+	{
+		return SQLITE_IOCAP_ATOMIC | SQLITE_IOCAP_POWERSAFE_OVERWRITE |
+			   SQLITE_IOCAP_SAFE_APPEND | SQLITE_IOCAP_SEQUENTIAL;
+	}
+}
@@ -0,0 +1,562 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	A Virtual File System that wraps another, normally "unix", and serves
+	reads of main database files from a read-only memory mapping, with
+	madvise hints and pre-faulting chosen per database through URI
+	parameters. Requires a POSIX system.
+*/
+
+#include "SQLiteMmapVfs.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Sqlt3
+{
+	namespace
+	{
+		// Mappings grow in chunks, so a growing database is not remapped
+		// on every transaction.
+		const sqlite3_int64_t map_chunk = sqlite3_int64_t(16) << 20;
+
+		void bump(std::atomic<unsigned long long>& a,
+				  unsigned long long n = 1) NOEXCEPT_SPEC
+		{
+			a.store(a.load(std::memory_order_relaxed) + n,
+					std::memory_order_relaxed);
+		}
+
+		int advice_flag(mmap_advice a) NOEXCEPT_SPEC
+		{
+			switch(a) {
+			case mmap_advice::sequential:
+				return MADV_SEQUENTIAL;
+			case mmap_advice::random:
+				return MADV_RANDOM;
+			case mmap_advice::willneed:
+				return MADV_WILLNEED;
+			default:
+				return MADV_NORMAL;
+			}
+		}
+		mmap_advice parse_advice(utf8_string_in_t text,
+								 mmap_advice fallback) NOEXCEPT_SPEC
+		{
+			if(text == nullptr) return fallback;
+			if(std::strcmp(text, "normal") == 0) return mmap_advice::normal;
+			if(std::strcmp(text, "sequential") == 0) {
+				return mmap_advice::sequential;
+			}
+			if(std::strcmp(text, "random") == 0) return mmap_advice::random;
+			if(std::strcmp(text, "willneed") == 0) return mmap_advice::willneed;
+			return fallback;
+		}
+
+		void process_faults(long long& minor, long long& major) NOEXCEPT_SPEC
+		{
+			struct rusage usage;
+			std::memset(&usage, 0, sizeof(usage));
+			::getrusage(RUSAGE_SELF, &usage);
+			minor = usage.ru_minflt;
+			major = usage.ru_majflt;
+		}
+
+	}
+
+	// Placed at the start of the memory SQLite allocates for each file,
+	// followed by the file of the wrapped VFS.
+	struct mmap_vfs::file
+	{
+		sqlite3_file base;
+		mmap_vfs* owner;
+		file* previous = nullptr;
+		file* next = nullptr;
+
+		std::pair<unsigned long long, unsigned long long> inode;
+		int fd = -1;
+		const char* map = nullptr;
+		sqlite3_int64_t capacity = 0;
+		sqlite3_int64_t validSize = 0;
+		sqlite3_int64_t limit = 0;
+		mmap_advice advice = mmap_advice::normal;
+
+		std::atomic<unsigned long long> mappedReads;
+		std::atomic<unsigned long long> mappedBytes;
+		std::atomic<unsigned long long> fallbackReads;
+
+		explicit file(mmap_vfs* o)
+			: owner(o), mappedReads(0), mappedBytes(0), fallbackReads(0)
+		{
+			base.pMethods = nullptr;
+		}
+
+		static const std::size_t header_size;
+
+		static file& of(sqlite3_file* f) NOEXCEPT_SPEC
+		{
+			return *reinterpret_cast<file*>(f);
+		}
+		sqlite3_file* real() NOEXCEPT_SPEC
+		{
+			return reinterpret_cast<sqlite3_file*>(
+				reinterpret_cast<char*>(this) + header_size);
+		}
+		const sqlite3_io_methods& io() NOEXCEPT_SPEC
+		{
+			return *real()->pMethods;
+		}
+		sqlite3_int64_t readable() const NOEXCEPT_SPEC
+		{
+			return std::min(capacity, validSize);
+		}
+	};
+	const std::size_t mmap_vfs::file::header_size =
+		(sizeof(mmap_vfs::file) + 15) / 16 * 16;
+
+	mmap_vfs::mmap_vfs(const mmap_vfs_options& o)
+		: options(o), vfsName(o.name != nullptr ? o.name : "mmap"),
+		  baseVfs(::sqlite3_vfs_find(o.base)), retiredMappedReads(0),
+		  retiredMappedBytes(0), retiredFallbackReads(0), remapCount(0),
+		  prefaultCount(0)
+	{
+		if(baseVfs == nullptr) {
+			detail::throw_result_error(SQLITE_ERROR, nullptr);
+		}
+		options.name = vfsName.c_str();
+		process_faults(initialMinorFaults, initialMajorFaults);
+
+		methods.reset(new sqlite3_io_methods());
+		auto& m = *methods;
+		m.iVersion = 2;
+		m.xClose = &x_close;
+		m.xRead = &x_read;
+		m.xWrite = &x_write;
+		m.xTruncate = &x_truncate;
+		m.xSync = &x_sync;
+		m.xFileSize = &x_file_size;
+		m.xLock = &x_lock;
+		m.xUnlock = &x_unlock;
+		m.xCheckReservedLock = &x_check_reserved_lock;
+		m.xFileControl = &x_file_control;
+		m.xSectorSize = &x_sector_size;
+		m.xDeviceCharacteristics = &x_device_characteristics;
+		m.xShmMap = &x_shm_map;
+		m.xShmLock = &x_shm_lock;
+		m.xShmBarrier = &x_shm_barrier;
+		m.xShmUnmap = &x_shm_unmap;
+
+		// Everything but opening files is passed straight to the wrapped
+		// VFS.
+		vfs.reset(new sqlite3_vfs());
+		auto& v = *vfs;
+		v.iVersion = std::min(baseVfs->iVersion, 2);
+		v.szOsFile = static_cast<int>(file::header_size) + baseVfs->szOsFile;
+		v.mxPathname = baseVfs->mxPathname;
+		v.zName = vfsName.c_str();
+		v.pAppData = this;
+		v.xOpen = &x_open;
+		v.xDelete = [](sqlite3_vfs* p, const char* n, int sync) {
+			auto b = static_cast<mmap_vfs*>(p->pAppData)->baseVfs;
+			return b->xDelete(b, n, sync);
+		};
+		v.xAccess = [](sqlite3_vfs* p, const char* n, int flags, int* out) {
+			auto b = static_cast<mmap_vfs*>(p->pAppData)->baseVfs;
+			return b->xAccess(b, n, flags, out);
+		};
+		v.xFullPathname = [](sqlite3_vfs* p, const char* n, int size,
+							 char* out) {
+			auto b = static_cast<mmap_vfs*>(p->pAppData)->baseVfs;
+			return b->xFullPathname(b, n, size, out);
+		};
+		v.xDlOpen = [](sqlite3_vfs* p, const char* n) {
+			auto b = static_cast<mmap_vfs*>(p->pAppData)->baseVfs;
+			return b->xDlOpen(b, n);
+		};
+		v.xDlError = [](sqlite3_vfs* p, int size, char* out) {
+			auto b = static_cast<mmap_vfs*>(p->pAppData)->baseVfs;
+			b->xDlError(b, size, out);
+		};
+		v.xDlSym = [](sqlite3_vfs* p, void* h, const char* s) {
+			auto b = static_cast<mmap_vfs*>(p->pAppData)->baseVfs;
+			return b->xDlSym(b, h, s);
+		};
+		v.xDlClose = [](sqlite3_vfs* p, void* h) {
+			auto b = static_cast<mmap_vfs*>(p->pAppData)->baseVfs;
+			b->xDlClose(b, h);
+		};
+		v.xRandomness = [](sqlite3_vfs* p, int size, char* out) {
+			auto b = static_cast<mmap_vfs*>(p->pAppData)->baseVfs;
+			return b->xRandomness(b, size, out);
+		};
+		v.xSleep = [](sqlite3_vfs* p, int micros) {
+			auto b = static_cast<mmap_vfs*>(p->pAppData)->baseVfs;
+			return b->xSleep(b, micros);
+		};
+		v.xCurrentTime = [](sqlite3_vfs* p, double* out) {
+			auto b = static_cast<mmap_vfs*>(p->pAppData)->baseVfs;
+			return b->xCurrentTime(b, out);
+		};
+		v.xGetLastError = [](sqlite3_vfs* p, int size, char* out) {
+			auto b = static_cast<mmap_vfs*>(p->pAppData)->baseVfs;
+			return b->xGetLastError(b, size, out);
+		};
+		if(v.iVersion >= 2) {
+			v.xCurrentTimeInt64 = [](sqlite3_vfs* p, sqlite3_int64* out) {
+				auto b = static_cast<mmap_vfs*>(p->pAppData)->baseVfs;
+				return b->xCurrentTimeInt64(b, out);
+			};
+		}
+
+		auto code = ::sqlite3_vfs_register(&v, o.makeDefault ? 1 : 0);
+		if(code != SQLITE_OK) detail::throw_result_error(code, nullptr);
+	}
+	mmap_vfs::~mmap_vfs() NOEXCEPT_SPEC
+	{
+		::sqlite3_vfs_unregister(vfs.get());
+		for(auto& d : descriptors) {
+			::close(d.second.fd);
+		}
+	}
+
+	utf8_string_in_t mmap_vfs::name() const NOEXCEPT_SPEC
+	{
+		return vfsName.c_str();
+	}
+
+	mmap_vfs_stats mmap_vfs::stats() const
+	{
+		mmap_vfs_stats s;
+		s.mappedReads = retiredMappedReads.load();
+		s.mappedBytes = retiredMappedBytes.load();
+		s.fallbackReads = retiredFallbackReads.load();
+		{
+			std::lock_guard<std::mutex> lock(filesMutex);
+			for(auto f = files; f != nullptr; f = f->next) {
+				s.mappedReads += f->mappedReads.load(std::memory_order_relaxed);
+				s.mappedBytes += f->mappedBytes.load(std::memory_order_relaxed);
+				s.fallbackReads +=
+					f->fallbackReads.load(std::memory_order_relaxed);
+			}
+		}
+		s.remaps = remapCount.load();
+		s.prefaultedPages = prefaultCount.load();
+		process_faults(s.minorFaults, s.majorFaults);
+		s.minorFaults -= initialMinorFaults;
+		s.majorFaults -= initialMajorFaults;
+		return s;
+	}
+
+	int mmap_vfs::acquire_descriptor(file& f,
+									 utf8_string_in_t path) NOEXCEPT_SPEC
+	{
+		struct stat info;
+		if(::stat(path, &info) != 0) return -1;
+		auto key = std::make_pair(static_cast<unsigned long long>(info.st_dev),
+								  static_cast<unsigned long long>(info.st_ino));
+		try {
+			std::lock_guard<std::mutex> lock(descriptorsMutex);
+			auto found = descriptors.find(key);
+			if(found == descriptors.end()) {
+				auto fd = ::open(path, O_RDONLY | O_CLOEXEC);
+				if(fd < 0) return -1;
+				struct stat opened;
+				if(::fstat(fd, &opened) != 0 || opened.st_dev != info.st_dev ||
+				   opened.st_ino != info.st_ino) {
+					// Replaced in between; closing the new descriptor is safe
+					// as it refers to another file.
+					::close(fd);
+					return -1;
+				}
+				shared_descriptor d;
+				d.fd = fd;
+				found = descriptors.emplace(key, d).first;
+			}
+			++found->second.users;
+			f.inode = key;
+			f.fd = found->second.fd;
+			return f.fd;
+		}
+		catch(...) {
+			return -1;
+		}
+	}
+	void mmap_vfs::release_descriptor(file& f) NOEXCEPT_SPEC
+	{
+		if(f.fd < 0) return;
+		// The descriptor stays open; see the remarks on the class.
+		std::lock_guard<std::mutex> lock(descriptorsMutex);
+		auto found = descriptors.find(f.inode);
+		if(found != descriptors.end()) --found->second.users;
+		f.fd = -1;
+	}
+
+	void mmap_vfs::remap(file& f, sqlite3_int64_t fileSize) NOEXCEPT_SPEC
+	{
+		f.validSize = fileSize;
+		if(f.fd < 0) return;
+		auto wanted = std::min(f.limit, (fileSize + map_chunk - 1) /
+											map_chunk * map_chunk);
+		// A file that shrinks keeps its mapping; reads stay within the
+		// size of the file.
+		if(wanted <= f.capacity) return;
+
+		if(f.map != nullptr) {
+			::munmap(const_cast<char*>(f.map),
+					 static_cast<std::size_t>(f.capacity));
+			f.map = nullptr;
+			f.capacity = 0;
+		}
+		auto p = ::mmap(nullptr, static_cast<std::size_t>(wanted), PROT_READ,
+						MAP_SHARED, f.fd, 0);
+		if(p == MAP_FAILED) return;
+		::madvise(p, static_cast<std::size_t>(wanted), advice_flag(f.advice));
+		f.map = static_cast<const char*>(p);
+		f.capacity = wanted;
+		++remapCount;
+	}
+	void mmap_vfs::prefault(file& f, utf8_string_in_t ranges) NOEXCEPT_SPEC
+	{
+		if(f.map == nullptr || ranges == nullptr) return;
+		auto page = static_cast<sqlite3_int64_t>(::sysconf(_SC_PAGESIZE));
+		auto touch = [&](sqlite3_int64_t first, sqlite3_int64_t last) {
+			last = std::min(last, f.readable());
+			first = first / page * page;
+			if(first >= last) return;
+			::madvise(const_cast<char*>(f.map) + first,
+					  static_cast<std::size_t>(last - first), MADV_WILLNEED);
+			auto sum = 0u;
+			auto touched = 0ull;
+			for(auto o = first; o < last; o += page) {
+				sum += static_cast<unsigned char>(
+					*static_cast<const volatile char*>(f.map + o));
+				++touched;
+			}
+			(void)sum;
+			prefaultCount += touched;
+		};
+
+		if(std::strcmp(ranges, "all") == 0) {
+			touch(0, f.readable());
+			return;
+		}
+		// Comma-separated ranges of the form first-last.
+		for(auto p = ranges; *p;) {
+			char* end = nullptr;
+			auto first = std::strtoll(p, &end, 10);
+			if(end == p || *end != '-') break;
+			p = end + 1;
+			auto last = std::strtoll(p, &end, 10);
+			if(end == p) break;
+			touch(first, last);
+			p = end;
+			if(*p == ',') ++p;
+		}
+	}
+
+	int mmap_vfs::x_open(sqlite3_vfs* v, utf8_string_in_t name,
+						 sqlite3_file* handle, int flags, int* outFlags)
+	{
+		auto self = static_cast<mmap_vfs*>(v->pAppData);
+		auto f = new(handle) file(self);
+		auto real = f->real();
+		real->pMethods = nullptr;
+		auto code = self->baseVfs->xOpen(self->baseVfs, name, real, flags,
+										 outFlags);
+		if(code != SQLITE_OK) {
+			if(real->pMethods != nullptr) real->pMethods->xClose(real);
+			f->~file();
+			handle->pMethods = nullptr;
+			return code;
+		}
+		f->base.pMethods = self->methods.get();
+		{
+			std::lock_guard<std::mutex> lock(self->filesMutex);
+			f->next = self->files;
+			if(self->files != nullptr) self->files->previous = f;
+			self->files = f;
+		}
+
+		if((flags & SQLITE_OPEN_MAIN_DB) == 0 || name == nullptr) {
+			return SQLITE_OK;
+		}
+		f->limit = ::sqlite3_uri_int64(name, "mmap_limit",
+									   self->options.maxMapSize);
+		f->advice = parse_advice(::sqlite3_uri_parameter(name, "madvise"),
+								 self->options.advice);
+		if(f->limit <= 0 || self->acquire_descriptor(*f, name) < 0) {
+			return SQLITE_OK;
+		}
+		sqlite3_int64 size = 0;
+		if(f->io().xFileSize(real, &size) == SQLITE_OK) {
+			self->remap(*f, size);
+			self->prefault(*f, ::sqlite3_uri_parameter(name, "prefault"));
+		}
+		return SQLITE_OK;
+	}
+	int mmap_vfs::x_close(sqlite3_file* handle)
+	{
+		auto& f = file::of(handle);
+		auto self = f.owner;
+		if(f.map != nullptr) {
+			::munmap(const_cast<char*>(f.map),
+					 static_cast<std::size_t>(f.capacity));
+		}
+		self->release_descriptor(f);
+		{
+			std::lock_guard<std::mutex> lock(self->filesMutex);
+			if(f.previous != nullptr) f.previous->next = f.next;
+			if(f.next != nullptr) f.next->previous = f.previous;
+			if(self->files == &f) self->files = f.next;
+		}
+		self->retiredMappedReads += f.mappedReads.load();
+		self->retiredMappedBytes += f.mappedBytes.load();
+		self->retiredFallbackReads += f.fallbackReads.load();
+
+		auto code = f.io().xClose(f.real());
+		f.~file();
+		return code;
+	}
+
+	int mmap_vfs::x_read(sqlite3_file* handle, void* buffer, int amount,
+						 sqlite3_int64 offset)
+	{
+		auto& f = file::of(handle);
+		if(f.map != nullptr && offset >= 0 &&
+		   offset + amount <= f.readable()) {
+			std::memcpy(buffer, f.map + offset,
+						static_cast<std::size_t>(amount));
+			bump(f.mappedReads);
+			bump(f.mappedBytes, static_cast<unsigned long long>(amount));
+			return SQLITE_OK;
+		}
+		bump(f.fallbackReads);
+		return f.io().xRead(f.real(), buffer, amount, offset);
+	}
+	int mmap_vfs::x_write(sqlite3_file* handle, const void* buffer, int amount,
+						  sqlite3_int64 offset)
+	{
+		// The mapping is shared, so it observes the write.
+		auto& f = file::of(handle);
+		auto code = f.io().xWrite(f.real(), buffer, amount, offset);
+		if(code == SQLITE_OK) {
+			f.validSize = std::max(f.validSize, offset + amount);
+		}
+		return code;
+	}
+	int mmap_vfs::x_truncate(sqlite3_file* handle, sqlite3_int64 size)
+	{
+		auto& f = file::of(handle);
+		auto code = f.io().xTruncate(f.real(), size);
+		if(code == SQLITE_OK) f.validSize = std::min(f.validSize, size);
+		return code;
+	}
+	int mmap_vfs::x_sync(sqlite3_file* handle, int flags)
+	{
+		auto& f = file::of(handle);
+		return f.io().xSync(f.real(), flags);
+	}
+	int mmap_vfs::x_file_size(sqlite3_file* handle, sqlite3_int64* size)
+	{
+		// SQLite reads the size at the start of each read transaction, so
+		// changes made by other connections are picked up here.
+		auto& f = file::of(handle);
+		auto code = f.io().xFileSize(f.real(), size);
+		if(code == SQLITE_OK && f.fd >= 0) f.owner->remap(f, *size);
+		return code;
+	}
+	int mmap_vfs::x_lock(sqlite3_file* handle, int level)
+	{
+		auto& f = file::of(handle);
+		return f.io().xLock(f.real(), level);
+	}
+	int mmap_vfs::x_unlock(sqlite3_file* handle, int level)
+	{
+		auto& f = file::of(handle);
+		return f.io().xUnlock(f.real(), level);
+	}
+	int mmap_vfs::x_check_reserved_lock(sqlite3_file* handle, int* result)
+	{
+		auto& f = file::of(handle);
+		return f.io().xCheckReservedLock(f.real(), result);
+	}
+	int mmap_vfs::x_file_control(sqlite3_file* handle, int op, void* arg)
+	{
+		auto& f = file::of(handle);
+		if(op == SQLITE_FCNTL_VFSNAME && arg != nullptr) {
+			auto code = f.io().xFileControl(f.real(), op, arg);
+			auto& name = *static_cast<char**>(arg);
+			auto wrapped = name;
+			name = ::sqlite3_mprintf("%s/%z", f.owner->vfsName.c_str(),
+									 wrapped);
+			return code == SQLITE_NOTFOUND ? SQLITE_OK : code;
+		}
+		return f.io().xFileControl(f.real(), op, arg);
+	}
+	int mmap_vfs::x_sector_size(sqlite3_file* handle)
+	{
+		auto& f = file::of(handle);
+		return f.io().xSectorSize(f.real());
+	}
+	int mmap_vfs::x_device_characteristics(sqlite3_file* handle)
+	{
+		auto& f = file::of(handle);
+		return f.io().xDeviceCharacteristics(f.real());
+	}
+	int mmap_vfs::x_shm_map(sqlite3_file* handle, int region, int size,
+							int extend, void volatile** memory)
+	{
+		auto& f = file::of(handle);
+		if(f.io().iVersion < 2) return SQLITE_IOERR;
+		return f.io().xShmMap(f.real(), region, size, extend, memory);
+	}
+	int mmap_vfs::x_shm_lock(sqlite3_file* handle, int offset, int n,
+							 int flags)
+	{
+		auto& f = file::of(handle);
+		if(f.io().iVersion < 2) return SQLITE_IOERR;
+		return f.io().xShmLock(f.real(), offset, n, flags);
+	}
+	void mmap_vfs::x_shm_barrier(sqlite3_file* handle)
+	{
+		auto& f = file::of(handle);
+		if(f.io().iVersion >= 2) f.io().xShmBarrier(f.real());
+	}
+	int mmap_vfs::x_shm_unmap(sqlite3_file* handle, int deleteFlag)
+	{
+		auto& f = file::of(handle);
+		if(f.io().iVersion < 2) return SQLITE_OK;
+		return f.io().xShmUnmap(f.real(), deleteFlag);
+	}
+}
+#endif// defined(__unix__) || defined(__APPLE__)
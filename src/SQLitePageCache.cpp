@@ -0,0 +1,560 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	A page cache module for SQLite3, installed through
+	SQLITE_CONFIG_PCACHE2, that replaces least-recently-used pages with the
+	CLOCK algorithm and allocates page memory from arenas local to the NUMA
+	node of the calling thread.
+*/
+
+#include "SQLitePageCache.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif// defined(__linux__)
+
+namespace Sqlt3
+{
+	namespace
+	{
+		struct free_block
+		{
+			free_block* next;
+		};
+
+		// A page: the header, followed by the page content and the extra
+		// bytes SQLite requested.
+		struct page_entry
+		{
+			sqlite3_pcache_page page;
+			page_entry* next;
+			unsigned key;
+			unsigned clockIndex;
+			unsigned short shard;
+			bool pinned;
+			bool referenced;
+		};
+		const std::size_t entry_size = (sizeof(page_entry) + 15) / 16 * 16;
+
+		std::mutex active_mutex;
+		detail::sharded_pcache* active = nullptr;
+
+		// Counters written only by the thread that owns them, but readable
+		// from any thread.
+		void bump(std::atomic<unsigned long long>& a) NOEXCEPT_SPEC
+		{
+			a.store(a.load(std::memory_order_relaxed) + 1,
+					std::memory_order_relaxed);
+		}
+
+		std::size_t online_nodes() NOEXCEPT_SPEC
+		{
+			// A list of ranges such as "0-1" or "0,2-3".
+			auto file = std::fopen("/sys/devices/system/node/online", "r");
+			if(file == nullptr) return 1;
+			char text[256] = {};
+			auto read = std::fgets(text, sizeof(text), file);
+			std::fclose(file);
+			if(read == nullptr) return 1;
+			unsigned long highest = 0;
+			for(auto p = text; *p;) {
+				char* end = nullptr;
+				auto n = std::strtoul(p, &end, 10);
+				if(end == p) {
+					++p;
+					continue;
+				}
+				highest = std::max(highest, n);
+				p = end;
+			}
+			return std::min<std::size_t>(highest + 1, 64);
+		}
+
+		struct location
+		{
+			unsigned cpu = 0;
+			unsigned node = 0;
+			unsigned uses = 0;
+		};
+		thread_local location here;
+
+		// Threads migrate between CPUs, so the location is looked up again
+		// every so often rather than once.
+		const location& current_location() NOEXCEPT_SPEC
+		{
+			if(here.uses++ % 256 == 0) {
+#if defined(__linux__) && defined(SYS_getcpu)
+				unsigned cpu = 0, node = 0;
+				if(::syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+					here.cpu = cpu;
+					here.node = node;
+				}
+#endif// defined(__linux__) && defined(SYS_getcpu)
+			}
+			return here;
+		}
+	}
+
+	double pcache_stats::hit_ratio() const NOEXCEPT_SPEC
+	{
+		auto fetches = hits + misses;
+		if(fetches == 0) return 1.0;
+		return static_cast<double>(hits) / static_cast<double>(fetches);
+	}
+
+	namespace detail
+	{
+		struct sharded_pcache::arena
+		{
+			struct size_list
+			{
+				std::size_t size;
+				free_block* head;
+			};
+
+			std::mutex mutex;
+			std::vector<size_list> lists;
+			std::vector<void*> slabs;
+			unsigned long long bytes = 0;
+			// Keeps the locks of neighbouring arenas on separate lines.
+			char padding[64];
+
+			~arena()
+			{
+				for(auto s : slabs) {
+					std::free(s);
+				}
+			}
+		};
+
+		struct sharded_pcache::cache
+		{
+			sharded_pcache* module;
+			cache* previous = nullptr;
+			cache* next = nullptr;
+
+			std::size_t pageSize;
+			std::size_t extraSize;
+			std::size_t blockSize;
+			bool purgeable;
+			std::size_t maxPages = 0;
+
+			// Chained hash table of the pages, sized to a power of two.
+			std::vector<page_entry*> buckets;
+			std::size_t pinnedCount = 0;
+			// Every page, swept by the hand of the clock.
+			std::vector<page_entry*> clock;
+			std::size_t hand = 0;
+
+			std::atomic<unsigned long long> hits;
+			std::atomic<unsigned long long> misses;
+			std::atomic<unsigned long long> evictions;
+			std::atomic<unsigned long long> pages;
+
+			cache(sharded_pcache* m, int p, int e, bool purge)
+				: module(m), pageSize(static_cast<std::size_t>(p)),
+				  extraSize(static_cast<std::size_t>(e)),
+				  blockSize((entry_size + pageSize + extraSize + 15) / 16 * 16),
+				  purgeable(purge), buckets(64, nullptr), hits(0), misses(0),
+				  evictions(0), pages(0)
+			{
+			}
+			~cache()
+			{
+				while(!clock.empty()) {
+					remove(clock.back());
+				}
+			}
+
+			std::size_t size() const NOEXCEPT_SPEC
+			{
+				return clock.size();
+			}
+			bool full() const NOEXCEPT_SPEC
+			{
+				return purgeable && maxPages > 0 && size() >= maxPages;
+			}
+
+			page_entry*& bucket(unsigned key) NOEXCEPT_SPEC
+			{
+				return buckets[key & (buckets.size() - 1)];
+			}
+			page_entry* find(unsigned key) NOEXCEPT_SPEC
+			{
+				auto e = bucket(key);
+				while(e != nullptr && e->key != key) e = e->next;
+				return e;
+			}
+			void link(page_entry* e) NOEXCEPT_SPEC
+			{
+				auto& b = bucket(e->key);
+				e->next = b;
+				b = e;
+			}
+			void unlink(page_entry* e) NOEXCEPT_SPEC
+			{
+				auto p = &bucket(e->key);
+				while(*p != e) p = &(*p)->next;
+				*p = e->next;
+			}
+			// Makes room for one more page; may throw std::bad_alloc.
+			void reserve()
+			{
+				clock.reserve(clock.size() + 1);
+				if(clock.size() + 1 <= buckets.size()) return;
+				std::vector<page_entry*> grown(buckets.size() * 2, nullptr);
+				buckets.swap(grown);
+				for(auto e : clock) {
+					link(e);
+				}
+			}
+
+			void remove(page_entry* e) NOEXCEPT_SPEC
+			{
+				unlink(e);
+				auto last = clock.back();
+				clock[e->clockIndex] = last;
+				last->clockIndex = e->clockIndex;
+				clock.pop_back();
+				if(hand >= clock.size()) hand = 0;
+				if(e->pinned) --pinnedCount;
+				pages.store(clock.size(), std::memory_order_relaxed);
+				module->deallocate(e, blockSize, e->shard);
+			}
+			// Finds an unpinned page that has not been used since the hand
+			// last passed it.
+			page_entry* victim() NOEXCEPT_SPEC
+			{
+				if(pinnedCount == clock.size()) return nullptr;
+				for(std::size_t n = 0; n <= 2 * clock.size(); ++n) {
+					auto e = clock[hand];
+					hand = (hand + 1) % clock.size();
+					if(e->pinned) continue;
+					if(!e->referenced) return e;
+					e->referenced = false;
+				}
+				return nullptr;
+			}
+			void trim() NOEXCEPT_SPEC
+			{
+				while(purgeable && size() > maxPages) {
+					auto e = victim();
+					if(e == nullptr) break;
+					bump(evictions);
+					remove(e);
+				}
+			}
+
+			sqlite3_pcache_page* fetch(unsigned key, int create)
+			{
+				auto e = find(key);
+				if(e != nullptr) {
+					bump(hits);
+					if(!e->pinned) {
+						e->pinned = true;
+						++pinnedCount;
+					}
+					e->referenced = true;
+					return &e->page;
+				}
+				bump(misses);
+				if(create == 0) return nullptr;
+
+				if(full()) {
+					e = victim();
+					if(e == nullptr && create == 1) return nullptr;
+				}
+				if(e != nullptr) {
+					// Recycle the memory and clock slot of the victim.
+					bump(evictions);
+					unlink(e);
+				}
+				else {
+					reserve();
+					unsigned short shard = 0;
+					auto block = module->allocate(blockSize, shard);
+					if(block == nullptr) return nullptr;
+					e = static_cast<page_entry*>(block);
+					e->shard = shard;
+					e->page.pBuf = static_cast<char*>(block) + entry_size;
+					e->page.pExtra =
+						static_cast<char*>(e->page.pBuf) + pageSize;
+					e->clockIndex = static_cast<unsigned>(clock.size());
+					clock.push_back(e);
+					pages.store(clock.size(), std::memory_order_relaxed);
+				}
+
+				e->key = key;
+				e->pinned = true;
+				e->referenced = true;
+				++pinnedCount;
+				// SQLite expects the start of the extra bytes of a new page
+				// to be zero.
+				if(extraSize >= sizeof(void*)) {
+					*static_cast<void**>(e->page.pExtra) = nullptr;
+				}
+				link(e);
+				return &e->page;
+			}
+			void unpin(page_entry* e, bool discard) NOEXCEPT_SPEC
+			{
+				if(e->pinned) {
+					e->pinned = false;
+					--pinnedCount;
+				}
+				auto over = purgeable && maxPages > 0 && size() > maxPages;
+				if(discard || over) remove(e);
+			}
+			void rekey(page_entry* e, unsigned key) NOEXCEPT_SPEC
+			{
+				// Any page already at the new key is guaranteed unpinned.
+				auto existing = find(key);
+				if(existing != nullptr) remove(existing);
+				unlink(e);
+				e->key = key;
+				link(e);
+			}
+			void truncate(unsigned limit) NOEXCEPT_SPEC
+			{
+				// Removal moves the last page into the slot being removed,
+				// which has then already been visited.
+				for(auto i = clock.size(); i-- > 0;) {
+					if(clock[i]->key >= limit) remove(clock[i]);
+				}
+			}
+			void shrink() NOEXCEPT_SPEC
+			{
+				for(auto i = clock.size(); i-- > 0;) {
+					if(!clock[i]->pinned) remove(clock[i]);
+				}
+			}
+		};
+
+		sharded_pcache::sharded_pcache(const sharded_pcache_options& o)
+			: nodeCount(o.nodes != 0 ? o.nodes : online_nodes()),
+			  shardsPerNode(std::max<std::size_t>(1, o.shardsPerNode)),
+			  slabBytes(o.slabBytes),
+			  arenas(new arena[nodeCount * shardsPerNode]), retiredHits(0),
+			  retiredMisses(0), retiredEvictions(0)
+		{
+			std::lock_guard<std::mutex> lock(active_mutex);
+			if(active != nullptr) throw_result_error(SQLITE_MISUSE, nullptr);
+			active = this;
+		}
+		sharded_pcache::~sharded_pcache() NOEXCEPT_SPEC
+		{
+			{
+				std::lock_guard<std::mutex> lock(active_mutex);
+				if(active == this) active = nullptr;
+			}
+			// Caches left open when SQLite was not shut down.
+			while(caches != nullptr) {
+				auto c = caches;
+				caches = c->next;
+				delete c;
+			}
+		}
+
+		sqlite3_pcache_methods2 sharded_pcache::methods() NOEXCEPT_SPEC
+		{
+			sqlite3_pcache_methods2 m;
+			m.iVersion = 1;
+			m.pArg = this;
+			m.xInit = &x_init;
+			m.xShutdown = &x_shutdown;
+			m.xCreate = &x_create;
+			m.xCachesize = &x_cachesize;
+			m.xPagecount = &x_pagecount;
+			m.xFetch = &x_fetch;
+			m.xUnpin = &x_unpin;
+			m.xRekey = &x_rekey;
+			m.xTruncate = &x_truncate;
+			m.xDestroy = &x_destroy;
+			m.xShrink = &x_shrink;
+			return m;
+		}
+
+		pcache_stats sharded_pcache::stats() const
+		{
+			pcache_stats s;
+			s.hits = retiredHits.load();
+			s.misses = retiredMisses.load();
+			s.evictions = retiredEvictions.load();
+			{
+				std::lock_guard<std::mutex> lock(cachesMutex);
+				for(auto c = caches; c != nullptr; c = c->next) {
+					s.hits += c->hits.load(std::memory_order_relaxed);
+					s.misses += c->misses.load(std::memory_order_relaxed);
+					s.evictions += c->evictions.load(std::memory_order_relaxed);
+					s.pages += c->pages.load(std::memory_order_relaxed);
+				}
+			}
+			s.nodeBytes.assign(nodeCount, 0);
+			for(std::size_t i = 0; i < nodeCount * shardsPerNode; ++i) {
+				auto& a = arenas[i];
+				std::lock_guard<std::mutex> lock(a.mutex);
+				s.nodeBytes[i / shardsPerNode] += a.bytes;
+			}
+			return s;
+		}
+
+		void* sharded_pcache::allocate(std::size_t size, unsigned short& shard)
+		{
+			auto& where = current_location();
+			shard = static_cast<unsigned short>(
+				(where.node % nodeCount) * shardsPerNode +
+				where.cpu % shardsPerNode);
+			auto& a = arenas[shard];
+			std::lock_guard<std::mutex> lock(a.mutex);
+			auto list = std::find_if(
+				a.lists.begin(), a.lists.end(),
+				[size](const arena::size_list& l) { return l.size == size; });
+			if(list == a.lists.end()) {
+				a.lists.push_back(arena::size_list{size, nullptr});
+				list = a.lists.end() - 1;
+			}
+
+			if(list->head == nullptr) {
+				// The slab is first written by this thread, so the kernel
+				// places it on this node.
+				auto count = std::max<std::size_t>(1, slabBytes / size);
+				auto slab = static_cast<char*>(std::malloc(count * size));
+				if(slab == nullptr) return nullptr;
+				try {
+					a.slabs.push_back(slab);
+				}
+				catch(...) {
+					std::free(slab);
+					throw;
+				}
+				a.bytes += count * size;
+				for(std::size_t i = count; i-- > 0;) {
+					auto b = reinterpret_cast<free_block*>(slab + i * size);
+					b->next = list->head;
+					list->head = b;
+				}
+			}
+			auto b = list->head;
+			list->head = b->next;
+			return b;
+		}
+		void sharded_pcache::deallocate(void* block, std::size_t size,
+										unsigned short shard) NOEXCEPT_SPEC
+		{
+			auto& a = arenas[shard];
+			std::lock_guard<std::mutex> lock(a.mutex);
+			for(auto& l : a.lists) {
+				if(l.size != size) continue;
+				auto b = static_cast<free_block*>(block);
+				b->next = l.head;
+				l.head = b;
+				return;
+			}
+		}
+
+		int sharded_pcache::x_init(void*)
+		{
+			return SQLITE_OK;
+		}
+		void sharded_pcache::x_shutdown(void*)
+		{
+		}
+		sqlite3_pcache* sharded_pcache::x_create(int pageSize, int extraSize,
+												 int purgeable)
+		{
+			auto m = active;
+			try {
+				auto c = new cache(m, pageSize, extraSize, purgeable != 0);
+				std::lock_guard<std::mutex> lock(m->cachesMutex);
+				c->next = m->caches;
+				if(m->caches != nullptr) m->caches->previous = c;
+				m->caches = c;
+				return reinterpret_cast<sqlite3_pcache*>(c);
+			}
+			catch(...) {
+				return nullptr;
+			}
+		}
+		void sharded_pcache::x_cachesize(sqlite3_pcache* p, int pages)
+		{
+			auto c = reinterpret_cast<cache*>(p);
+			c->maxPages = static_cast<std::size_t>(std::max(pages, 0));
+			c->trim();
+		}
+		int sharded_pcache::x_pagecount(sqlite3_pcache* p)
+		{
+			return static_cast<int>(reinterpret_cast<cache*>(p)->size());
+		}
+		sqlite3_pcache_page* sharded_pcache::x_fetch(sqlite3_pcache* p,
+													 unsigned key, int create)
+		{
+			try {
+				return reinterpret_cast<cache*>(p)->fetch(key, create);
+			}
+			catch(...) {
+				return nullptr;
+			}
+		}
+		void sharded_pcache::x_unpin(sqlite3_pcache* p, sqlite3_pcache_page* g,
+									 int discard)
+		{
+			reinterpret_cast<cache*>(p)->unpin(
+				reinterpret_cast<page_entry*>(g), discard != 0);
+		}
+		void sharded_pcache::x_rekey(sqlite3_pcache* p, sqlite3_pcache_page* g,
+									 unsigned, unsigned newKey)
+		{
+			reinterpret_cast<cache*>(p)->rekey(reinterpret_cast<page_entry*>(g),
+											   newKey);
+		}
+		void sharded_pcache::x_truncate(sqlite3_pcache* p, unsigned limit)
+		{
+			reinterpret_cast<cache*>(p)->truncate(limit);
+		}
+		void sharded_pcache::x_destroy(sqlite3_pcache* p)
+		{
+			auto c = reinterpret_cast<cache*>(p);
+			auto m = c->module;
+			{
+				std::lock_guard<std::mutex> lock(m->cachesMutex);
+				if(c->previous != nullptr) c->previous->next = c->next;
+				if(c->next != nullptr) c->next->previous = c->previous;
+				if(m->caches == c) m->caches = c->next;
+			}
+			m->retiredHits += c->hits.load(std::memory_order_relaxed);
+			m->retiredMisses += c->misses.load(std::memory_order_relaxed);
+			m->retiredEvictions += c->evictions.load(std::memory_order_relaxed);
+			delete c;
+		}
+		void sharded_pcache::x_shrink(sqlite3_pcache* p)
+		{
+			reinterpret_cast<cache*>(p)->shrink();
+		}
+	}
+}
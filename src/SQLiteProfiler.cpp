@@ -0,0 +1,543 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Aggregation of the execution time of each distinct SQL text run on one
+	or more connections, as reported by the profiling hooks of SQLite, into
+	log-linear histograms from which percentiles can be read.
+*/
+
+#include "SQLiteProfiler.hpp"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace Sqlt3
+{
+	namespace
+	{
+		// FNV-1a, to look up SQL text without copying it into a string.
+		// Only used for texts recorded through record and when merging, not
+		// for each traced statement.
+		struct text_hash
+		{
+			std::size_t operator()(utf8_string_in_t text) const NOEXCEPT_SPEC
+			{
+				auto h = 14695981039346656037ull;
+				for(; *text; ++text) {
+					h ^= static_cast<unsigned char>(*text);
+					h *= 1099511628211ull;
+				}
+				return static_cast<std::size_t>(h);
+			}
+		};
+		struct text_equal
+		{
+			bool operator()(utf8_string_in_t x,
+							utf8_string_in_t y) const NOEXCEPT_SPEC
+			{
+				return std::strcmp(x, y) == 0;
+			}
+		};
+
+		unsigned most_significant_bit(unsigned long long v) NOEXCEPT_SPEC
+		{
+#if defined(__GNUC__)
+			return 63u - static_cast<unsigned>(__builtin_clzll(v));
+#else
+			auto bit = 0u;
+			while(v >>= 1) ++bit;
+			return bit;
+#endif// defined(__GNUC__)
+		}
+
+		void record_max(std::atomic<unsigned long long>& max,
+						unsigned long long v) NOEXCEPT_SPEC
+		{
+			auto current = max.load(std::memory_order_relaxed);
+			while(v > current &&
+				  !max.compare_exchange_weak(current, v,
+											 std::memory_order_relaxed)) {
+			}
+		}
+
+		struct merged_profile
+		{
+			std::vector<unsigned long long> counts;
+			unsigned long long count = 0;
+			unsigned long long total = 0;
+			unsigned long long max = 0;
+
+			merged_profile()
+				: counts(detail::latency_histogram::bucket_count, 0)
+			{
+			}
+
+			void add(const detail::latency_histogram& h)
+			{
+				h.add_to(counts.data());
+				count += h.count();
+				total += h.total();
+				max = std::max(max, h.max());
+			}
+
+			std::chrono::nanoseconds percentile(double q) const
+			{
+				auto rank = static_cast<unsigned long long>(
+					q * static_cast<double>(count) + 0.999999);
+				rank = std::max(rank, 1ull);
+				auto seen = 0ull;
+				for(std::size_t b = 0; b < counts.size(); ++b) {
+					seen += counts[b];
+					if(seen >= rank) {
+						return std::chrono::nanoseconds(std::min(
+							max, detail::latency_histogram::value_of(b)));
+					}
+				}
+				return std::chrono::nanoseconds(max);
+			}
+		};
+	}
+
+	namespace detail
+	{
+		const std::size_t latency_histogram::sub_buckets;
+		const std::size_t latency_histogram::bucket_count;
+
+		latency_histogram::latency_histogram() NOEXCEPT_SPEC
+		{
+			reset();
+		}
+
+		void latency_histogram::record(unsigned long long nanos) NOEXCEPT_SPEC
+		{
+			buckets[bucket_of(nanos)].fetch_add(1, std::memory_order_relaxed);
+			recorded.fetch_add(1, std::memory_order_relaxed);
+			sum.fetch_add(nanos, std::memory_order_relaxed);
+			record_max(longest, nanos);
+		}
+		void latency_histogram::merge(const latency_histogram& other)
+			NOEXCEPT_SPEC
+		{
+			for(std::size_t b = 0; b < bucket_count; ++b) {
+				auto n = other.buckets[b].load(std::memory_order_relaxed);
+				if(n != 0) buckets[b].fetch_add(n, std::memory_order_relaxed);
+			}
+			recorded.fetch_add(other.count(), std::memory_order_relaxed);
+			sum.fetch_add(other.total(), std::memory_order_relaxed);
+			record_max(longest, other.max());
+		}
+		void latency_histogram::reset() NOEXCEPT_SPEC
+		{
+			for(auto& b : buckets) {
+				b.store(0, std::memory_order_relaxed);
+			}
+			recorded.store(0, std::memory_order_relaxed);
+			sum.store(0, std::memory_order_relaxed);
+			longest.store(0, std::memory_order_relaxed);
+		}
+		void latency_histogram::add_to(unsigned long long* counts) const
+			NOEXCEPT_SPEC
+		{
+			for(std::size_t b = 0; b < bucket_count; ++b) {
+				counts[b] += buckets[b].load(std::memory_order_relaxed);
+			}
+		}
+		unsigned long long latency_histogram::count() const NOEXCEPT_SPEC
+		{
+			return recorded.load(std::memory_order_relaxed);
+		}
+		unsigned long long latency_histogram::total() const NOEXCEPT_SPEC
+		{
+			return sum.load(std::memory_order_relaxed);
+		}
+		unsigned long long latency_histogram::max() const NOEXCEPT_SPEC
+		{
+			return longest.load(std::memory_order_relaxed);
+		}
+
+		std::size_t latency_histogram::bucket_of(unsigned long long nanos)
+			NOEXCEPT_SPEC
+		{
+			// Values below sub_buckets have a bucket each; above that, each
+			// power of two is split into sub_buckets linear buckets.
+			if(nanos < sub_buckets) return static_cast<std::size_t>(nanos);
+			auto bit = most_significant_bit(nanos);
+			auto sub = (nanos >> (bit - 4)) & (sub_buckets - 1);
+			auto b = (bit - 3) * sub_buckets + static_cast<std::size_t>(sub);
+			return std::min(b, bucket_count - 1);
+		}
+		unsigned long long latency_histogram::value_of(std::size_t b)
+			NOEXCEPT_SPEC
+		{
+			if(b < sub_buckets) return b;
+			auto bit = b / sub_buckets + 3;
+			auto sub = b % sub_buckets;
+			auto width = 1ull << (bit - 4);
+			return (sub_buckets + sub) * width + width / 2;
+		}
+	}
+
+	struct statement_profiler::thread_state
+	{
+		ALIAS_TYPE(std::chrono::steady_clock, clock);
+		struct entry
+		{
+			utf8_string_out_t sql;
+			detail::latency_histogram histogram;
+		};
+		// Keyed by the text of the entry itself.
+		ALIAS_TYPE(WRAP_TEMPLATE(std::unordered_map<
+								 utf8_string_in_t, std::unique_ptr<entry>,
+								 text_hash, text_equal>),
+				   text_map);
+
+		// Guards changes to the maps, which only the owning thread makes,
+		// against snapshot and reset. Histograms are recorded without it.
+		std::mutex mutex;
+		unsigned long long generation = 0;
+		std::unordered_map<sqlite3_stmt_t, std::unique_ptr<entry>> statements;
+		text_map texts;
+		detail::latency_histogram other;
+
+		// Statements started on this thread and when they started. There
+		// are rarely more than a few. Only used by the owning thread.
+		std::vector<std::pair<sqlite3_stmt_t, clock::time_point>> running;
+		// Statements started on this thread that finished on another,
+		// guarded by mutex.
+		std::vector<sqlite3_stmt_t> finishedElsewhere;
+		std::atomic<bool> anyFinishedElsewhere{false};
+
+		void clear() NOEXCEPT_SPEC
+		{
+			statements.clear();
+			texts.clear();
+			other.reset();
+		}
+		// Adds a histogram to the entry of its text, or to other once
+		// maxTexts texts are tracked.
+		void add(const utf8_string_out_t& sql,
+				 const detail::latency_histogram& histogram,
+				 std::size_t maxTexts)
+		{
+			auto found = texts.find(sql.c_str());
+			if(found == texts.end()) {
+				if(texts.size() >= maxTexts) {
+					other.merge(histogram);
+					return;
+				}
+				std::unique_ptr<entry> e(new entry);
+				e->sql = sql;
+				auto key = e->sql.c_str();
+				found = texts.emplace(key, std::move(e)).first;
+			}
+			found->second->histogram.merge(histogram);
+		}
+		void add(const thread_state& from, std::size_t maxTexts)
+		{
+			for(auto& e : from.statements) {
+				add(e.second->sql, e.second->histogram, maxTexts);
+			}
+			for(auto& e : from.texts) {
+				add(e.second->sql, e.second->histogram, maxTexts);
+			}
+			other.merge(from.other);
+		}
+		// Forgets the statements that other threads have finished.
+		void drain()
+		{
+			if(!anyFinishedElsewhere.load(std::memory_order_acquire)) return;
+			std::lock_guard<std::mutex> lock(mutex);
+			for(auto stmt : finishedElsewhere) {
+				running.erase(
+					std::remove_if(
+						running.begin(), running.end(),
+						[stmt](const std::pair<sqlite3_stmt_t,
+											   clock::time_point>& r) {
+							return r.first == stmt;
+						}),
+					running.end());
+			}
+			finishedElsewhere.clear();
+			anyFinishedElsewhere.store(false, std::memory_order_relaxed);
+		}
+	};
+
+	namespace
+	{
+		std::atomic<unsigned long long> next_profiler_id(0);
+	}
+
+	statement_profiler::statement_profiler(std::size_t m)
+		: maxStatements(m),
+		  id(next_profiler_id.fetch_add(1, std::memory_order_relaxed)),
+		  generation(0), exited(new thread_state)
+	{
+	}
+	statement_profiler::~statement_profiler() = default;
+
+	void statement_profiler::attach(sqlite3_t c) NOEXCEPT_SPEC
+	{
+		::sqlite3_trace_v2(c, SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE,
+						   &statement_profiler::trace, this);
+	}
+	void statement_profiler::detach(sqlite3_t c) NOEXCEPT_SPEC
+	{
+		::sqlite3_trace_v2(c, 0, nullptr, nullptr);
+	}
+
+	statement_profiler::thread_state& statement_profiler::local()
+	{
+		// The states of this thread, by the id of their profiler. Shared
+		// with the profiler, so they are still read after the thread exits.
+		static thread_local std::vector<
+			std::pair<unsigned long long, std::shared_ptr<thread_state>>>
+			states;
+
+		thread_state* state = nullptr;
+		for(auto& s : states) {
+			if(s.first == id) {
+				state = s.second.get();
+				break;
+			}
+		}
+		if(state == nullptr) {
+			// States only referenced here belong to destroyed profilers.
+			states.erase(
+				std::remove_if(
+					states.begin(), states.end(),
+					[](const std::pair<unsigned long long,
+									   std::shared_ptr<thread_state>>& s) {
+						return s.second.use_count() == 1;
+					}),
+				states.end());
+			auto created = std::make_shared<thread_state>();
+			{
+				std::lock_guard<std::mutex> lock(threadsMutex);
+				created->generation = generation.load();
+				threads.push_back(created);
+			}
+			states.emplace_back(id, created);
+			state = created.get();
+		}
+
+		auto current = generation.load(std::memory_order_acquire);
+		if(state->generation != current) {
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->clear();
+			state->generation = current;
+		}
+		return *state;
+	}
+
+	int statement_profiler::trace(unsigned event, void* p, void* s, void* x)
+	{
+		ALIAS_TYPE(thread_state::clock, clock);
+
+		auto profiler = static_cast<statement_profiler*>(p);
+		auto stmt = static_cast<sqlite3_stmt_t>(s);
+		auto now = clock::now();
+		// Exceptions must not propagate into SQLite; a lost sample is
+		// preferable.
+		try {
+			auto& state = profiler->local();
+			state.drain();
+			auto& running = state.running;
+			auto found = std::find_if(
+				running.begin(), running.end(),
+				[stmt](const std::pair<sqlite3_stmt_t, clock::time_point>& r) {
+					return r.first == stmt;
+				});
+			if(event == SQLITE_TRACE_STMT) {
+				// Also raised for each trigger the statement fires.
+				if(found == running.end()) running.emplace_back(stmt, now);
+				return 0;
+			}
+
+			auto reported = *static_cast<sqlite3_int64_t*>(x);
+			auto time = std::chrono::nanoseconds(reported);
+			if(found != running.end()) {
+				time = now - found->second;
+				*found = running.back();
+				running.pop_back();
+			}
+			else {
+				profiler->finished(state, stmt);
+			}
+			profiler->record(state, stmt, time);
+		}
+		catch(...) {
+		}
+		return 0;
+	}
+
+	void statement_profiler::finished(const thread_state& state,
+									  sqlite3_stmt_t stmt)
+	{
+		std::lock_guard<std::mutex> lock(threadsMutex);
+		for(auto& t : threads) {
+			if(t.get() == &state) continue;
+			std::lock_guard<std::mutex> stateLock(t->mutex);
+			auto& f = t->finishedElsewhere;
+			if(std::find(f.begin(), f.end(), stmt) == f.end()) {
+				f.push_back(stmt);
+			}
+			t->anyFinishedElsewhere.store(true, std::memory_order_release);
+		}
+	}
+
+	void statement_profiler::record(thread_state& state, sqlite3_stmt_t stmt,
+									std::chrono::nanoseconds time)
+	{
+		auto nanos = static_cast<unsigned long long>(
+			std::max<long long>(0, time.count()));
+		auto sql = ::sqlite3_sql(stmt);
+		if(sql == nullptr) sql = "";
+
+		auto found = state.statements.find(stmt);
+		if(found != state.statements.end() && found->second->sql == sql) {
+			found->second->histogram.record(nanos);
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(state.mutex);
+		if(found != state.statements.end()) {
+			// The statement was finalized and its address reused for
+			// another text.
+			auto& e = *found->second;
+			state.add(e.sql, e.histogram, maxStatements);
+			e.histogram.reset();
+			e.sql = sql;
+		}
+		else {
+			if(state.statements.size() >= maxStatements) {
+				// Finalized statements are not reported, so fold every
+				// statement into the entries of their texts and start over.
+				for(auto& e : state.statements) {
+					state.add(e.second->sql, e.second->histogram,
+							  maxStatements);
+				}
+				state.statements.clear();
+			}
+			std::unique_ptr<thread_state::entry> e(new thread_state::entry);
+			e->sql = sql;
+			found = state.statements.emplace(stmt, std::move(e)).first;
+		}
+		found->second->histogram.record(nanos);
+	}
+
+	void statement_profiler::record(utf8_string_in_t sql,
+									std::chrono::nanoseconds time)
+	{
+		auto nanos = static_cast<unsigned long long>(
+			std::max<long long>(0, time.count()));
+		auto& state = local();
+		std::lock_guard<std::mutex> lock(state.mutex);
+		auto found = state.texts.find(sql);
+		if(found != state.texts.end()) {
+			found->second->histogram.record(nanos);
+			return;
+		}
+		detail::latency_histogram single;
+		single.record(nanos);
+		state.add(sql, single, maxStatements);
+	}
+
+	void statement_profiler::collect_exited() const
+	{
+		// Called with threadsMutex held. A state referenced only here
+		// belongs to a thread that has exited.
+		auto current = generation.load();
+		for(auto i = threads.begin(); i != threads.end();) {
+			if(i->use_count() != 1) {
+				++i;
+				continue;
+			}
+			if((*i)->generation == current) {
+				exited->add(**i, maxStatements);
+			}
+			i = threads.erase(i);
+		}
+	}
+
+	std::vector<statement_profile> statement_profiler::snapshot() const
+	{
+		std::unordered_map<utf8_string_out_t, merged_profile> merged;
+		merged_profile other;
+		auto add = [&](const thread_state& s) {
+			for(auto& e : s.statements) {
+				merged[e.second->sql].add(e.second->histogram);
+			}
+			for(auto& e : s.texts) {
+				merged[e.second->sql].add(e.second->histogram);
+			}
+			other.add(s.other);
+		};
+		{
+			std::lock_guard<std::mutex> lock(threadsMutex);
+			collect_exited();
+			auto current = generation.load();
+			for(auto& t : threads) {
+				std::lock_guard<std::mutex> stateLock(t->mutex);
+				if(t->generation == current) add(*t);
+			}
+			add(*exited);
+		}
+
+		std::vector<statement_profile> profiles;
+		profiles.reserve(merged.size() + 1);
+		auto add_profile = [&](const utf8_string_out_t& sql,
+							   const merged_profile& m) {
+			statement_profile p;
+			p.sql = sql;
+			p.count = m.count;
+			p.total = std::chrono::nanoseconds(m.total);
+			p.max = std::chrono::nanoseconds(m.max);
+			p.p50 = m.percentile(0.5);
+			p.p99 = m.percentile(0.99);
+			p.p999 = m.percentile(0.999);
+			profiles.push_back(std::move(p));
+		};
+		for(auto& m : merged) {
+			add_profile(m.first, m.second);
+		}
+		if(other.count > 0) add_profile("(other)", other);
+
+		std::sort(profiles.begin(), profiles.end(),
+				  [](const statement_profile& x, const statement_profile& y) {
+					  return x.total > y.total;
+				  });
+		return profiles;
+	}
+	void statement_profiler::reset()
+	{
+		// Threads clear their own states when they next record, as only
+		// they change them.
+		std::lock_guard<std::mutex> lock(threadsMutex);
+		auto current = generation.fetch_add(1) + 1;
+		exited->clear();
+		exited->generation = current;
+		collect_exited();
+	}
+}
@@ -0,0 +1,146 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Collection of the measured and estimated row counts of every loop of a
+	prepared statement, reported by sqlite3_stmt_scanstatus, into a plan
+	tree in which badly estimated loops are flagged. Requires SQLite to be
+	compiled with SQLITE_ENABLE_STMT_SCANSTATUS.
+*/
+
+#include "SQLiteQueryPlan.hpp"
+
+#if defined(SQLITE_ENABLE_STMT_SCANSTATUS)
+#include <cstdio>
+
+namespace Sqlt3
+{
+	namespace
+	{
+		// Reads one value of a loop, returning false once the index is past
+		// the last loop.
+		template <typename T>
+		bool scan_status(sqlite3_stmt_t s, int i, int status, T& value)
+		{
+			return ::sqlite3_stmt_scanstatus(s, i, status, &value) == 0;
+		}
+
+		bool is_full_scan(const utf8_string_out_t& explain) NOEXCEPT_SPEC
+		{
+			// Index scans are reported as "SCAN t USING [COVERING] INDEX i".
+			return explain.compare(0, 5, "SCAN ") == 0 &&
+				   explain.find(" USING ") == utf8_string_out_t::npos;
+		}
+	}
+
+	double plan_loop::visits_per_loop() const NOEXCEPT_SPEC
+	{
+		if(loops <= 0) return 0.0;
+		return static_cast<double>(visits) / static_cast<double>(loops);
+	}
+
+	std::vector<plan_loop> query_plan::flagged() const
+	{
+		std::vector<plan_loop> result;
+		for(auto& s : selects) {
+			for(auto& l : s.loops) {
+				if(l.misestimated || l.fullScan) result.push_back(l);
+			}
+		}
+		return result;
+	}
+
+	utf8_string_out_t query_plan::str() const
+	{
+		utf8_string_out_t text = sql + "\n";
+		char line[128];
+		for(auto& s : selects) {
+			std::snprintf(line, sizeof(line), "SELECT %d\n", s.selectId);
+			text += line;
+			utf8_string_out_t indent = "  ";
+			for(auto& l : s.loops) {
+				std::snprintf(line, sizeof(line),
+							  " (loops=%lld visits=%lld est=%.1f actual=%.1f)",
+							  static_cast<long long>(l.loops),
+							  static_cast<long long>(l.visits), l.estimate,
+							  l.visits_per_loop());
+				text += indent + l.explain + line;
+				if(l.misestimated) text += " MISESTIMATE";
+				if(l.fullScan) text += " FULL SCAN";
+				text += "\n";
+				indent += "  ";
+			}
+		}
+		return text;
+	}
+
+	query_plan sqlite3_stmt_plan(sqlite3_stmt_t stmt, double factor,
+								 bool reset)
+	{
+		query_plan plan;
+		if(auto sql = ::sqlite3_sql(stmt)) plan.sql = sql;
+
+		sqlite3_int64_t loops = 0;
+		for(int i = 0; scan_status(stmt, i, SQLITE_SCANSTAT_NLOOP, loops);
+			++i) {
+			plan_loop loop;
+			loop.index = i;
+			loop.loops = loops;
+			int selectId = 0;
+			const char* name = nullptr;
+			const char* explain = nullptr;
+			scan_status(stmt, i, SQLITE_SCANSTAT_NVISIT, loop.visits);
+			scan_status(stmt, i, SQLITE_SCANSTAT_EST, loop.estimate);
+			scan_status(stmt, i, SQLITE_SCANSTAT_NAME, name);
+			scan_status(stmt, i, SQLITE_SCANSTAT_EXPLAIN, explain);
+			scan_status(stmt, i, SQLITE_SCANSTAT_SELECTID, selectId);
+			if(name) loop.name = name;
+			if(explain) loop.explain = explain;
+			loop.fullScan = is_full_scan(loop.explain);
+
+			// Loops that never ran or found nothing say little about the
+			// estimate.
+			if(loop.visits > 0 && loop.estimate > 0.0) {
+				auto ratio = loop.visits_per_loop() / loop.estimate;
+				loop.misestimated = ratio > factor || ratio * factor < 1.0;
+			}
+
+			auto select = plan.selects.begin();
+			while(select != plan.selects.end() &&
+				  select->selectId != selectId) {
+				++select;
+			}
+			if(select == plan.selects.end()) {
+				plan.selects.emplace_back();
+				plan.selects.back().selectId = selectId;
+				select = plan.selects.end() - 1;
+			}
+			select->loops.push_back(std::move(loop));
+		}
+
+		if(reset) ::sqlite3_stmt_scanstatus_reset(stmt);
+		return plan;
+	}
+}
+#endif// defined(SQLITE_ENABLE_STMT_SCANSTATUS)
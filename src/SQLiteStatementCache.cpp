@@ -0,0 +1,170 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	A per-connection cache of prepared statements, keyed on SQL text.
+	Statements handed out by the cache are reset and returned to it when
+	their handle is destroyed, rather than being finalized.
+*/
+
+#include "SQLiteStatementCache.hpp"
+#include <cstring>
+#include <iterator>
+
+namespace Sqlt3
+{
+	statement_cache::statement_cache(sqlite3_t c, std::size_t n, int bytes)
+		: connection(c), maxEntries(n), maxBytes(bytes)
+	{
+	}
+	statement_cache::~statement_cache() NOEXCEPT_SPEC
+	{
+		clear();
+	}
+
+	cached_statement statement_cache::prepare(utf8_string_in_t sql)
+	{
+		auto found = idleLookup.find(sql);
+		if(found != idleLookup.end()) {
+			auto pos = found->second;
+			idleLookup.erase(found);
+			busy.splice(busy.begin(), idle, pos);
+			busyLookup.emplace(pos->stmt.get(), pos);
+			++hitCount;
+
+			return cached_statement{pos->stmt.get(), this};
+		}
+
+		auto stmt = std::get<0>(sqlite3_prepare_v2(connection, sql));
+		auto raw = stmt.get();
+		if(raw == nullptr) return cached_statement{};
+		busy.push_front(entry{sql, std::move(stmt)});
+		busyLookup.emplace(raw, busy.begin());
+		++missCount;
+		trim();
+
+		return cached_statement{raw, this};
+	}
+	void statement_cache::clear() NOEXCEPT_SPEC
+	{
+		idleLookup.clear();
+		idle.clear();
+	}
+
+	std::size_t statement_cache::size() const NOEXCEPT_SPEC
+	{
+		return idle.size();
+	}
+	unsigned long long statement_cache::hits() const NOEXCEPT_SPEC
+	{
+		return hitCount;
+	}
+	unsigned long long statement_cache::misses() const NOEXCEPT_SPEC
+	{
+		return missCount;
+	}
+	unsigned long long statement_cache::evictions() const NOEXCEPT_SPEC
+	{
+		return evictionCount;
+	}
+
+	void statement_cache::give_back(sqlite3_stmt_t s) NOEXCEPT_SPEC
+	{
+		auto found = busyLookup.find(s);
+		if(found == busyLookup.end()) {
+			unique_statement(s).reset();
+			return;
+		}
+		auto pos = found->second;
+		busyLookup.erase(found);
+
+#if defined(USE_VIEW_CHECKS)
+		detail::invalidate_views(s);
+#endif// defined(USE_VIEW_CHECKS)
+		::sqlite3_reset(s);
+		::sqlite3_clear_bindings(s);
+
+		// The same SQL may have been checked out more than once at a time;
+		// only one idle copy is kept.
+		if(idleLookup.count(pos->sql.c_str()) != 0) {
+			busy.erase(pos);
+			return;
+		}
+		idle.splice(idle.begin(), busy, pos);
+		idleLookup.emplace(pos->sql.c_str(), pos);
+		trim();
+	}
+	void statement_cache::evict_lru() NOEXCEPT_SPEC
+	{
+		auto last = std::prev(idle.end());
+		idleLookup.erase(last->sql.c_str());
+		idle.erase(last);
+		++evictionCount;
+	}
+	void statement_cache::trim() NOEXCEPT_SPEC
+	{
+		while(idle.size() > maxEntries) {
+			evict_lru();
+		}
+		if(maxBytes < 0) return;
+
+		int current = 0, highwater = 0;
+		while(!idle.empty()) {
+			auto code =
+				::sqlite3_db_status(connection, SQLITE_DBSTATUS_STMT_USED,
+									&current, &highwater, 0);
+			if(code != SQLITE_OK || current <= maxBytes) break;
+			evict_lru();
+		}
+	}
+
+	namespace detail
+	{
+		void CachedStatementDeleter::operator()(pointer p) const NOEXCEPT_SPEC
+		{
+			if(cache == nullptr) {
+				unique_statement(p).reset();
+				return;
+			}
+			cache->give_back(p);
+		}
+
+		std::size_t sql_text_hash::operator()(utf8_string_in_t sql) const
+			NOEXCEPT_SPEC
+		{
+			// FNV-1a.
+			std::size_t h = 2166136261u;
+			for(; *sql; ++sql) {
+				h ^= static_cast<unsigned char>(*sql);
+				h *= 16777619u;
+			}
+			return h;
+		}
+		bool sql_text_equal::operator()(utf8_string_in_t x,
+										utf8_string_in_t y) const NOEXCEPT_SPEC
+		{
+			return std::strcmp(x, y) == 0;
+		}
+	}
+}
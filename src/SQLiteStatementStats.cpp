@@ -0,0 +1,334 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	Collection of the full scan, sort, automatic index and virtual machine
+	step counters of prepared statements on every reset, aggregated by the
+	fingerprint of their SQL text, with alerts for statements that begin to
+	scan whole tables or to build automatic indexes.
+*/
+
+#include "SQLiteStatementStats.hpp"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace Sqlt3
+{
+	namespace
+	{
+		bool is_identifier_char(char c) NOEXCEPT_SPEC
+		{
+			return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+				   (c >= '0' && c <= '9') || c == '_' || c == '$' ||
+				   (static_cast<unsigned char>(c) & 0x80) != 0;
+		}
+		bool is_digit(char c) NOEXCEPT_SPEC
+		{
+			return c >= '0' && c <= '9';
+		}
+		bool is_space(char c) NOEXCEPT_SPEC
+		{
+			return c == ' ' || c == '\t' || c == '\n' || c == '\r' ||
+				   c == '\f' || c == '\v';
+		}
+
+		// Skips a quoted token, where a doubled quote is an escaped quote.
+		utf8_string_in_t skip_quoted(utf8_string_in_t p, char close)
+			NOEXCEPT_SPEC
+		{
+			for(++p; *p; ++p) {
+				if(*p != close) continue;
+				if(p[1] != close || close == ']') return p + 1;
+				++p;
+			}
+			return p;
+		}
+		utf8_string_in_t skip_number(utf8_string_in_t p) NOEXCEPT_SPEC
+		{
+			if(p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+				p += 2;
+				while(is_identifier_char(*p)) ++p;
+				return p;
+			}
+			while(is_digit(*p) || *p == '.') ++p;
+			if(*p == 'e' || *p == 'E') {
+				++p;
+				if(*p == '+' || *p == '-') ++p;
+				while(is_digit(*p)) ++p;
+			}
+			return p;
+		}
+	}
+
+	statement_counters& statement_counters::
+		operator+=(const statement_counters& c) NOEXCEPT_SPEC
+	{
+		fullscanSteps += c.fullscanSteps;
+		sorts += c.sorts;
+		autoindexRows += c.autoindexRows;
+		vmSteps += c.vmSteps;
+		return *this;
+	}
+
+	statement_counters read_statement_counters(sqlite3_stmt_t s,
+											   bool reset) NOEXCEPT_SPEC
+	{
+		statement_counters c;
+		c.fullscanSteps = Sqlt3::sqlite3_stmt_status(
+			s, sqlite_stmtstatus_fullscan_step, reset);
+		c.sorts = Sqlt3::sqlite3_stmt_status(s, sqlite_stmtstatus_sort, reset);
+		c.autoindexRows =
+			Sqlt3::sqlite3_stmt_status(s, sqlite_stmtstatus_autoindex, reset);
+		c.vmSteps =
+			Sqlt3::sqlite3_stmt_status(s, sqlite_stmtstatus_vm_step, reset);
+		return c;
+	}
+
+	utf8_string_out_t sql_fingerprint(utf8_string_in_t sql)
+	{
+		utf8_string_out_t out;
+		auto token = [&out](utf8_string_in_t first, utf8_string_in_t last) {
+			if(!out.empty()) out += ' ';
+			out.append(first, last);
+		};
+		auto placeholder = [&out, &token]() {
+			// Lists of values, such as those of IN, collapse to one.
+			auto n = out.size();
+			if(n >= 3 && out.compare(n - 3, 3, "? ,") == 0) {
+				out.resize(n - 2);
+				return;
+			}
+			token("?", "?" + 1);
+		};
+
+		auto p = sql;
+		while(*p) {
+			auto c = *p;
+			auto first = p;
+			if(is_space(c)) {
+				++p;
+			}
+			else if(c == '-' && p[1] == '-') {
+				while(*p && *p != '\n') ++p;
+			}
+			else if(c == '/' && p[1] == '*') {
+				p += 2;
+				while(*p && !(p[0] == '*' && p[1] == '/')) ++p;
+				if(*p) p += 2;
+			}
+			else if(c == '\'') {
+				p = skip_quoted(p, '\'');
+				placeholder();
+			}
+			else if((c == 'x' || c == 'X') && p[1] == '\'') {
+				p = skip_quoted(p + 1, '\'');
+				placeholder();
+			}
+			else if(c == '"' || c == '`' || c == '[') {
+				p = skip_quoted(p, c == '[' ? ']' : c);
+				token(first, p);
+			}
+			else if(is_digit(c) || (c == '.' && is_digit(p[1]))) {
+				p = skip_number(p);
+				placeholder();
+			}
+			else if(c == '?' || c == ':' || c == '@' ||
+					(c == '$' && is_identifier_char(p[1]))) {
+				++p;
+				while(is_identifier_char(*p)) ++p;
+				placeholder();
+			}
+			else if(is_identifier_char(c)) {
+				while(is_identifier_char(*p)) ++p;
+				token(first, p);
+			}
+			else {
+				// Operators of more than one character, such as "<=", stay
+				// together.
+				++p;
+				while(*p && std::strchr("<>=!|", *p) != nullptr &&
+					  std::strchr("<>=!|", c) != nullptr) {
+					++p;
+				}
+				token(first, p);
+			}
+		}
+		return out;
+	}
+
+	statement_registry::statement_registry(statement_registry_options o)
+		: options(std::move(o))
+	{
+		other.fingerprint = "(other)";
+	}
+
+	void statement_registry::record(const utf8_string_out_t& fingerprint,
+									utf8_string_in_t sql,
+									const statement_counters& c)
+	{
+		auto add = [&c](statement_stats& s) {
+			++s.executions;
+			if(c.fullscanSteps > 0) ++s.fullscanExecutions;
+			if(c.sorts > 0) ++s.sortExecutions;
+			if(c.autoindexRows > 0) ++s.autoindexExecutions;
+			s.totals += c;
+		};
+
+		statement_alert alert;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto found = entries.find(fingerprint);
+			if(found == entries.end()) {
+				if(entries.size() >= options.maxStatements) {
+					add(other);
+					return;
+				}
+				found = entries.emplace(fingerprint, entry()).first;
+				found->second.stats.fingerprint = fingerprint;
+			}
+
+			auto& e = found->second;
+			auto report = e.stats.executions > 0 ||
+						  options.alertOnFirstExecution;
+			if(c.fullscanSteps > 0 && !e.fullscanSeen) {
+				e.fullscanSeen = true;
+				alert.fullscan = report;
+			}
+			if(c.autoindexRows > 0 && !e.autoindexSeen) {
+				e.autoindexSeen = true;
+				alert.autoindex = report;
+			}
+			alert.previousExecutions = e.stats.executions;
+			add(e.stats);
+		}
+
+		if((alert.fullscan || alert.autoindex) && options.alert) {
+			alert.fingerprint = fingerprint;
+			alert.sql = sql;
+			alert.counters = c;
+			options.alert(alert);
+		}
+	}
+
+	std::vector<statement_stats> statement_registry::snapshot() const
+	{
+		std::vector<statement_stats> stats;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stats.reserve(entries.size() + 1);
+			for(auto& e : entries) {
+				stats.push_back(e.second.stats);
+			}
+			if(other.executions > 0) stats.push_back(other);
+		}
+		std::sort(stats.begin(), stats.end(),
+				  [](const statement_stats& x, const statement_stats& y) {
+					  auto& a = x.totals;
+					  auto& b = y.totals;
+					  if(a.fullscanSteps != b.fullscanSteps) {
+						  return a.fullscanSteps > b.fullscanSteps;
+					  }
+					  return a.vmSteps > b.vmSteps;
+				  });
+		return stats;
+	}
+	void statement_registry::reset()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.clear();
+		other = statement_stats();
+		other.fingerprint = "(other)";
+	}
+
+	instrumented_statement::instrumented_statement(statement_registry& r,
+												   unique_statement s)
+		: stmt(std::move(s)), registry(&r)
+	{
+		auto sql = ::sqlite3_sql(stmt.get());
+		if(sql != nullptr) fingerprint = Sqlt3::sql_fingerprint(sql);
+	}
+	instrumented_statement::instrumented_statement(statement_registry& r,
+												   sqlite3_t c,
+												   utf8_string_in_t sql)
+		: instrumented_statement(
+			  r, std::move(std::get<0>(sqlite3_prepare_v2(c, sql))))
+	{
+	}
+	instrumented_statement::instrumented_statement(
+		instrumented_statement&& o) NOEXCEPT_SPEC
+		: stmt(std::move(o.stmt)),
+		  registry(o.registry),
+		  fingerprint(std::move(o.fingerprint))
+	{
+	}
+	instrumented_statement& instrumented_statement::
+		operator=(instrumented_statement&& o) NOEXCEPT_SPEC
+	{
+		if(this != &o) {
+			record();
+			stmt = std::move(o.stmt);
+			registry = o.registry;
+			fingerprint = std::move(o.fingerprint);
+		}
+		return *this;
+	}
+	instrumented_statement::~instrumented_statement() NOEXCEPT_SPEC
+	{
+		record();
+	}
+
+	sqlite3_stmt_t instrumented_statement::get() const NOEXCEPT_SPEC
+	{
+		return stmt.get();
+	}
+	const utf8_string_out_t& instrumented_statement::sql_fingerprint() const
+		NOEXCEPT_SPEC
+	{
+		return fingerprint;
+	}
+
+	step_result_t instrumented_statement::step()
+	{
+		return Sqlt3::sqlite3_step(stmt.get());
+	}
+	void instrumented_statement::reset()
+	{
+		record();
+		Sqlt3::sqlite3_reset(stmt.get());
+	}
+
+	void instrumented_statement::record() NOEXCEPT_SPEC
+	{
+		if(!stmt) return;
+		auto counters = read_statement_counters(stmt.get(), true);
+		// Every execution takes at least one step of the virtual machine.
+		if(counters.vmSteps == 0) return;
+		try {
+			registry->record(fingerprint, ::sqlite3_sql(stmt.get()), counters);
+		}
+		catch(...) {
+		}
+	}
+}
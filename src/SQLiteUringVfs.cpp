@@ -0,0 +1,816 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	A Virtual File System that wraps another, normally "unix", and submits
+	the page writes and syncs of databases through io_uring on Linux. Writes
+	to a main database file are queued and submitted together, and syncs
+	are queued behind them. Without kernel support every operation is passed
+	to the wrapped VFS.
+*/
+
+#include "SQLiteUringVfs.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAS_IO_URING
+#endif// __has_include(<linux/io_uring.h>)
+#endif// defined(__linux__) && defined(__has_include)
+
+#if defined(HAS_IO_URING)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif// defined(HAS_IO_URING)
+
+namespace Sqlt3
+{
+	namespace
+	{
+		// Merged writes are capped so that their lengths fit an iovec and
+		// a queue does not hold an unbounded copy of the data.
+		const std::size_t max_write = std::size_t(1) << 24;
+		const std::size_t max_queued_bytes = std::size_t(1) << 26;
+
+		void bump(std::atomic<unsigned long long>& a,
+				  unsigned long long n = 1) NOEXCEPT_SPEC
+		{
+			a.store(a.load(std::memory_order_relaxed) + n,
+					std::memory_order_relaxed);
+		}
+	}
+
+#if defined(HAS_IO_URING)
+	// A minimal io_uring instance, driven through the raw system calls so
+	// that liburing is not needed.
+	struct uring_vfs::ring
+	{
+		int fd = -1;
+		unsigned entries = 0;
+		void* sqMap = MAP_FAILED;
+		std::size_t sqMapSize = 0;
+		void* cqMap = MAP_FAILED;
+		std::size_t cqMapSize = 0;
+		io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+		std::size_t sqesSize = 0;
+
+		unsigned* sqTail = nullptr;
+		unsigned* sqMask = nullptr;
+		unsigned* sqArray = nullptr;
+		unsigned* cqHead = nullptr;
+		unsigned* cqTail = nullptr;
+		unsigned* cqMask = nullptr;
+		io_uring_cqe* cqes = nullptr;
+
+		ring() = default;
+		ring(const ring&) = delete;
+		ring& operator=(const ring&) = delete;
+		~ring()
+		{
+			if(sqes != MAP_FAILED) ::munmap(sqes, sqesSize);
+			if(cqMap != MAP_FAILED && cqMap != sqMap) {
+				::munmap(cqMap, cqMapSize);
+			}
+			if(sqMap != MAP_FAILED) ::munmap(sqMap, sqMapSize);
+			if(fd >= 0) ::close(fd);
+		}
+
+		bool open(unsigned depth) NOEXCEPT_SPEC
+		{
+			io_uring_params p;
+			std::memset(&p, 0, sizeof(p));
+			fd = static_cast<int>(::syscall(__NR_io_uring_setup, depth, &p));
+			if(fd < 0) return false;
+			entries = p.sq_entries;
+
+			sqMapSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+			cqMapSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+			auto single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+			if(single) sqMapSize = cqMapSize = std::max(sqMapSize, cqMapSize);
+			sqMap = ::mmap(nullptr, sqMapSize, PROT_READ | PROT_WRITE,
+						   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+			if(sqMap == MAP_FAILED) return false;
+			cqMap = single ? sqMap
+						   : ::mmap(nullptr, cqMapSize, PROT_READ | PROT_WRITE,
+									MAP_SHARED | MAP_POPULATE, fd,
+									IORING_OFF_CQ_RING);
+			if(cqMap == MAP_FAILED) return false;
+			sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+			sqes = static_cast<io_uring_sqe*>(
+				::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+					   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+			if(sqes == MAP_FAILED) return false;
+
+			auto sq = static_cast<char*>(sqMap);
+			auto cq = static_cast<char*>(cqMap);
+			sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+			sqMask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+			sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+			cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+			cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+			cqMask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+			cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+			return true;
+		}
+
+		// Fills the next entry of the submission queue; the kernel sees it
+		// once the tail is published by run.
+		io_uring_sqe& prepare(unsigned n) NOEXCEPT_SPEC
+		{
+			auto tail = *sqTail + n;
+			auto index = tail & *sqMask;
+			sqArray[index] = index;
+			auto& sqe = sqes[index];
+			std::memset(&sqe, 0, sizeof(sqe));
+			return sqe;
+		}
+		// Submits the n prepared entries and waits for all of them,
+		// storing the result of each by its user data.
+		bool run(unsigned n, int* results, unsigned long long& enters)
+			NOEXCEPT_SPEC
+		{
+			__atomic_store_n(sqTail, *sqTail + n, __ATOMIC_RELEASE);
+			unsigned submitted = 0, completed = 0;
+			while(completed < n) {
+				auto flags = IORING_ENTER_GETEVENTS;
+				auto r = ::syscall(__NR_io_uring_enter, fd, n - submitted,
+								   n - completed, flags, nullptr, 0);
+				++enters;
+				if(r < 0) {
+					if(errno == EINTR || errno == EAGAIN) continue;
+					return false;
+				}
+				submitted += static_cast<unsigned>(r);
+
+				auto head = *cqHead;
+				auto tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+				for(; head != tail; ++head) {
+					auto& cqe = cqes[head & *cqMask];
+					results[cqe.user_data] = cqe.res;
+					++completed;
+				}
+				__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+			}
+			return true;
+		}
+	};
+#else
+	struct uring_vfs::ring
+	{
+		bool open(unsigned) NOEXCEPT_SPEC
+		{
+			return false;
+		}
+	};
+#endif// defined(HAS_IO_URING)
+
+	// Placed at the start of the memory SQLite allocates for each file,
+	// followed by the file of the wrapped VFS.
+	struct uring_vfs::file
+	{
+		struct queued_write
+		{
+			sqlite3_int64_t offset;
+			std::size_t start;
+			std::size_t length;
+		};
+
+		sqlite3_file base;
+		uring_vfs* owner;
+		file* previous = nullptr;
+		file* next = nullptr;
+
+		std::pair<unsigned long long, unsigned long long> inode;
+		int fd = -1;
+		std::unique_ptr<ring> io;
+		bool deferWrites = false;
+		bool synced = false;
+		std::vector<queued_write> queue;
+		std::vector<char> data;
+		std::vector<int> results;
+
+		std::atomic<unsigned long long> writesQueued;
+		std::atomic<unsigned long long> writesSubmitted;
+		std::atomic<unsigned long long> syncs;
+		std::atomic<unsigned long long> submissions;
+
+		explicit file(uring_vfs* o)
+			: owner(o), writesQueued(0), writesSubmitted(0), syncs(0),
+			  submissions(0)
+		{
+			base.pMethods = nullptr;
+		}
+
+		static const std::size_t header_size;
+
+		static file& of(sqlite3_file* f) NOEXCEPT_SPEC
+		{
+			return *reinterpret_cast<file*>(f);
+		}
+		sqlite3_file* real() NOEXCEPT_SPEC
+		{
+			return reinterpret_cast<sqlite3_file*>(
+				reinterpret_cast<char*>(this) + header_size);
+		}
+		const sqlite3_io_methods& io_methods() NOEXCEPT_SPEC
+		{
+			return *real()->pMethods;
+		}
+
+		bool overlaps(sqlite3_int64_t offset, int amount) const NOEXCEPT_SPEC
+		{
+			for(auto& w : queue) {
+				if(offset < w.offset + static_cast<sqlite3_int64_t>(w.length) &&
+				   w.offset < offset + amount) {
+					return true;
+				}
+			}
+			return false;
+		}
+		int flush(bool sync, int syncFlags) NOEXCEPT_SPEC;
+		int flush() NOEXCEPT_SPEC
+		{
+			return queue.empty() ? SQLITE_OK : flush(false, 0);
+		}
+	};
+	const std::size_t uring_vfs::file::header_size =
+		(sizeof(uring_vfs::file) + 15) / 16 * 16;
+
+#if defined(HAS_IO_URING)
+	int uring_vfs::file::flush(bool sync, int syncFlags) NOEXCEPT_SPEC
+	{
+		auto count = static_cast<unsigned>(queue.size());
+		auto total = count + (sync ? 1u : 0u);
+		if(total == 0) return SQLITE_OK;
+
+		// The buffer of queued data does not move from here on.
+		iovec vectors[1];
+		std::unique_ptr<iovec[]> many;
+		auto iov = vectors;
+		if(count > 1) {
+			many.reset(new(std::nothrow) iovec[count]);
+			if(!many) return SQLITE_IOERR_NOMEM;
+			iov = many.get();
+		}
+		for(unsigned i = 0; i < count; ++i) {
+			auto& w = queue[i];
+			iov[i].iov_base = data.data() + w.start;
+			iov[i].iov_len = w.length;
+			auto& sqe = io->prepare(i);
+			sqe.opcode = IORING_OP_WRITEV;
+			sqe.fd = fd;
+			sqe.off = static_cast<unsigned long long>(w.offset);
+			sqe.addr = reinterpret_cast<unsigned long long>(&iov[i]);
+			sqe.len = 1;
+			sqe.user_data = i;
+		}
+		if(sync) {
+			// Drained, so the sync starts once every write has completed,
+			// while the writes themselves may run in parallel.
+			auto& sqe = io->prepare(count);
+			sqe.opcode = IORING_OP_FSYNC;
+			sqe.flags = IOSQE_IO_DRAIN;
+			sqe.fd = fd;
+			if(syncFlags & SQLITE_SYNC_DATAONLY) {
+				sqe.fsync_flags = IORING_FSYNC_DATASYNC;
+			}
+			sqe.user_data = count;
+		}
+
+		unsigned long long enters = 0;
+		auto ran = false;
+		try {
+			results.assign(total, 0);
+			ran = io->run(total, results.data(), enters);
+		}
+		catch(...) {
+		}
+		bump(submissions, enters);
+		bump(writesSubmitted, count);
+		if(sync) bump(syncs);
+
+		// Completes a write from the given number of bytes synchronously.
+		auto finish = [this](const queued_write& w, std::size_t written) {
+			while(written < w.length) {
+				auto n = ::pwrite(fd, data.data() + w.start + written,
+								  w.length - written,
+								  static_cast<off_t>(w.offset + written));
+				if(n < 0 && errno == EINTR) continue;
+				if(n <= 0) {
+					return n < 0 && errno == ENOSPC ? SQLITE_FULL
+													: SQLITE_IOERR_WRITE;
+				}
+				written += static_cast<std::size_t>(n);
+			}
+			return SQLITE_OK;
+		};
+
+		auto code = SQLITE_OK;
+		auto late = !ran;
+		if(!ran) {
+			// The ring is unusable; the file falls back to the wrapped VFS
+			// and the queue is written here.
+			io.reset();
+		}
+		for(unsigned i = 0; i < count && code == SQLITE_OK; ++i) {
+			auto done = ran ? results[i] : 0;
+			if(done < 0) {
+				code = done == -ENOSPC ? SQLITE_FULL : SQLITE_IOERR_WRITE;
+			}
+			else if(static_cast<std::size_t>(done) < queue[i].length) {
+				late = true;
+				code = finish(queue[i], static_cast<std::size_t>(done));
+			}
+		}
+		if(code == SQLITE_OK && sync) {
+			if(ran && results[count] < 0) code = SQLITE_IOERR_FSYNC;
+			// Writes completed after the sync need one of their own.
+			auto dataOnly = (syncFlags & SQLITE_SYNC_DATAONLY) != 0;
+			if(late && (dataOnly ? ::fdatasync(fd) : ::fsync(fd)) != 0) {
+				code = SQLITE_IOERR_FSYNC;
+			}
+		}
+		queue.clear();
+		data.clear();
+		return code;
+	}
+#else
+	int uring_vfs::file::flush(bool, int) NOEXCEPT_SPEC
+	{
+		return SQLITE_OK;
+	}
+#endif// defined(HAS_IO_URING)
+
+	uring_vfs::uring_vfs(const uring_vfs_options& o)
+		: options(o), vfsName(o.name != nullptr ? o.name : "uring"),
+		  baseVfs(::sqlite3_vfs_find(o.base)), available(false),
+		  retiredWritesQueued(0), retiredWritesSubmitted(0), retiredSyncs(0),
+		  retiredSubmissions(0), fallbackCount(0)
+	{
+		if(baseVfs == nullptr) {
+			detail::throw_result_error(SQLITE_ERROR, nullptr);
+		}
+		options.name = vfsName.c_str();
+		options.queueDepth = std::max(options.queueDepth, 2u);
+		{
+			// Kernels without io_uring, or sandboxes forbidding it, fail
+			// here.
+			ring probe;
+			available = probe.open(2);
+		}
+
+		methods.reset(new sqlite3_io_methods());
+		auto& m = *methods;
+		m.iVersion = 2;
+		m.xClose = &x_close;
+		m.xRead = &x_read;
+		m.xWrite = &x_write;
+		m.xTruncate = &x_truncate;
+		m.xSync = &x_sync;
+		m.xFileSize = &x_file_size;
+		m.xLock = &x_lock;
+		m.xUnlock = &x_unlock;
+		m.xCheckReservedLock = &x_check_reserved_lock;
+		m.xFileControl = &x_file_control;
+		m.xSectorSize = &x_sector_size;
+		m.xDeviceCharacteristics = &x_device_characteristics;
+		m.xShmMap = &x_shm_map;
+		m.xShmLock = &x_shm_lock;
+		m.xShmBarrier = &x_shm_barrier;
+		m.xShmUnmap = &x_shm_unmap;
+
+		// Everything but opening files is passed straight to the wrapped
+		// VFS.
+		vfs.reset(new sqlite3_vfs());
+		auto& v = *vfs;
+		v.iVersion = std::min(baseVfs->iVersion, 2);
+		v.szOsFile = static_cast<int>(file::header_size) + baseVfs->szOsFile;
+		v.mxPathname = baseVfs->mxPathname;
+		v.zName = vfsName.c_str();
+		v.pAppData = this;
+		v.xOpen = &x_open;
+		v.xDelete = [](sqlite3_vfs* p, const char* n, int sync) {
+			auto b = static_cast<uring_vfs*>(p->pAppData)->baseVfs;
+			return b->xDelete(b, n, sync);
+		};
+		v.xAccess = [](sqlite3_vfs* p, const char* n, int flags, int* out) {
+			auto b = static_cast<uring_vfs*>(p->pAppData)->baseVfs;
+			return b->xAccess(b, n, flags, out);
+		};
+		v.xFullPathname = [](sqlite3_vfs* p, const char* n, int size,
+							 char* out) {
+			auto b = static_cast<uring_vfs*>(p->pAppData)->baseVfs;
+			return b->xFullPathname(b, n, size, out);
+		};
+		v.xDlOpen = [](sqlite3_vfs* p, const char* n) {
+			auto b = static_cast<uring_vfs*>(p->pAppData)->baseVfs;
+			return b->xDlOpen(b, n);
+		};
+		v.xDlError = [](sqlite3_vfs* p, int size, char* out) {
+			auto b = static_cast<uring_vfs*>(p->pAppData)->baseVfs;
+			b->xDlError(b, size, out);
+		};
+		v.xDlSym = [](sqlite3_vfs* p, void* h, const char* s) {
+			auto b = static_cast<uring_vfs*>(p->pAppData)->baseVfs;
+			return b->xDlSym(b, h, s);
+		};
+		v.xDlClose = [](sqlite3_vfs* p, void* h) {
+			auto b = static_cast<uring_vfs*>(p->pAppData)->baseVfs;
+			b->xDlClose(b, h);
+		};
+		v.xRandomness = [](sqlite3_vfs* p, int size, char* out) {
+			auto b = static_cast<uring_vfs*>(p->pAppData)->baseVfs;
+			return b->xRandomness(b, size, out);
+		};
+		v.xSleep = [](sqlite3_vfs* p, int micros) {
+			auto b = static_cast<uring_vfs*>(p->pAppData)->baseVfs;
+			return b->xSleep(b, micros);
+		};
+		v.xCurrentTime = [](sqlite3_vfs* p, double* out) {
+			auto b = static_cast<uring_vfs*>(p->pAppData)->baseVfs;
+			return b->xCurrentTime(b, out);
+		};
+		v.xGetLastError = [](sqlite3_vfs* p, int size, char* out) {
+			auto b = static_cast<uring_vfs*>(p->pAppData)->baseVfs;
+			return b->xGetLastError(b, size, out);
+		};
+		if(v.iVersion >= 2) {
+			v.xCurrentTimeInt64 = [](sqlite3_vfs* p, sqlite3_int64* out) {
+				auto b = static_cast<uring_vfs*>(p->pAppData)->baseVfs;
+				return b->xCurrentTimeInt64(b, out);
+			};
+		}
+
+		auto code = ::sqlite3_vfs_register(&v, o.makeDefault ? 1 : 0);
+		if(code != SQLITE_OK) detail::throw_result_error(code, nullptr);
+	}
+	uring_vfs::~uring_vfs() NOEXCEPT_SPEC
+	{
+		::sqlite3_vfs_unregister(vfs.get());
+#if defined(HAS_IO_URING)
+		for(auto& d : descriptors) {
+			::close(d.second.fd);
+		}
+#endif// defined(HAS_IO_URING)
+	}
+
+	utf8_string_in_t uring_vfs::name() const NOEXCEPT_SPEC
+	{
+		return vfsName.c_str();
+	}
+	bool uring_vfs::supported() const NOEXCEPT_SPEC
+	{
+		return available;
+	}
+
+	uring_vfs_stats uring_vfs::stats() const
+	{
+		uring_vfs_stats s;
+		s.writesQueued = retiredWritesQueued.load();
+		s.writesSubmitted = retiredWritesSubmitted.load();
+		s.syncs = retiredSyncs.load();
+		s.submissions = retiredSubmissions.load();
+		{
+			std::lock_guard<std::mutex> lock(filesMutex);
+			for(auto f = files; f != nullptr; f = f->next) {
+				s.writesQueued +=
+					f->writesQueued.load(std::memory_order_relaxed);
+				s.writesSubmitted +=
+					f->writesSubmitted.load(std::memory_order_relaxed);
+				s.syncs += f->syncs.load(std::memory_order_relaxed);
+				s.submissions += f->submissions.load(std::memory_order_relaxed);
+			}
+		}
+		s.fallbackFiles = fallbackCount.load();
+		return s;
+	}
+
+	int uring_vfs::acquire_descriptor(file& f, utf8_string_in_t path,
+									  bool closeUnused) NOEXCEPT_SPEC
+	{
+#if defined(HAS_IO_URING)
+		struct stat info;
+		if(::stat(path, &info) != 0) return -1;
+		auto key = std::make_pair(static_cast<unsigned long long>(info.st_dev),
+								  static_cast<unsigned long long>(info.st_ino));
+		try {
+			std::lock_guard<std::mutex> lock(descriptorsMutex);
+			auto found = descriptors.find(key);
+			if(found == descriptors.end()) {
+				auto fd = ::open(path, O_RDWR | O_CLOEXEC);
+				if(fd < 0) return -1;
+				struct stat opened;
+				if(::fstat(fd, &opened) != 0 || opened.st_dev != info.st_dev ||
+				   opened.st_ino != info.st_ino) {
+					// Replaced in between; closing the new descriptor is safe
+					// as it refers to another file.
+					::close(fd);
+					return -1;
+				}
+				shared_descriptor d;
+				d.fd = fd;
+				d.closeUnused = closeUnused;
+				found = descriptors.emplace(key, d).first;
+			}
+			++found->second.users;
+			f.inode = key;
+			f.fd = found->second.fd;
+			return f.fd;
+		}
+		catch(...) {
+			return -1;
+		}
+#else
+		return -1;
+#endif// defined(HAS_IO_URING)
+	}
+	void uring_vfs::release_descriptor(file& f) NOEXCEPT_SPEC
+	{
+		if(f.fd < 0) return;
+		// Descriptors of main database files stay open; see the remarks on
+		// the class.
+		std::lock_guard<std::mutex> lock(descriptorsMutex);
+		auto found = descriptors.find(f.inode);
+		if(found != descriptors.end() && --found->second.users == 0 &&
+		   found->second.closeUnused) {
+#if defined(HAS_IO_URING)
+			::close(found->second.fd);
+#endif// defined(HAS_IO_URING)
+			descriptors.erase(found);
+		}
+		f.fd = -1;
+	}
+
+	int uring_vfs::x_open(sqlite3_vfs* v, utf8_string_in_t name,
+						  sqlite3_file* handle, int flags, int* outFlags)
+	{
+		auto self = static_cast<uring_vfs*>(v->pAppData);
+		auto f = new(handle) file(self);
+		auto real = f->real();
+		real->pMethods = nullptr;
+		auto code = self->baseVfs->xOpen(self->baseVfs, name, real, flags,
+										 outFlags);
+		if(code != SQLITE_OK) {
+			if(real->pMethods != nullptr) real->pMethods->xClose(real);
+			f->~file();
+			handle->pMethods = nullptr;
+			return code;
+		}
+		f->base.pMethods = self->methods.get();
+		{
+			std::lock_guard<std::mutex> lock(self->filesMutex);
+			f->next = self->files;
+			if(self->files != nullptr) self->files->previous = f;
+			self->files = f;
+		}
+
+		auto main = (flags & SQLITE_OPEN_MAIN_DB) != 0;
+		auto wal = (flags & SQLITE_OPEN_WAL) != 0;
+		if(!self->available || name == nullptr || (!main && !wal) ||
+		   (flags & SQLITE_OPEN_READONLY) != 0) {
+			return SQLITE_OK;
+		}
+		std::unique_ptr<ring> r(new(std::nothrow) ring());
+		if(!r || !r->open(self->options.queueDepth) ||
+		   self->acquire_descriptor(*f, name, wal) < 0) {
+			++self->fallbackCount;
+			return SQLITE_OK;
+		}
+		f->io = std::move(r);
+		f->deferWrites = main;
+		return SQLITE_OK;
+	}
+	int uring_vfs::x_close(sqlite3_file* handle)
+	{
+		auto& f = file::of(handle);
+		auto self = f.owner;
+		auto flushed = f.flush();
+		self->release_descriptor(f);
+		{
+			std::lock_guard<std::mutex> lock(self->filesMutex);
+			if(f.previous != nullptr) f.previous->next = f.next;
+			if(f.next != nullptr) f.next->previous = f.previous;
+			if(self->files == &f) self->files = f.next;
+		}
+		self->retiredWritesQueued += f.writesQueued.load();
+		self->retiredWritesSubmitted += f.writesSubmitted.load();
+		self->retiredSyncs += f.syncs.load();
+		self->retiredSubmissions += f.submissions.load();
+
+		auto code = f.io_methods().xClose(f.real());
+		f.~file();
+		return flushed != SQLITE_OK ? flushed : code;
+	}
+
+	int uring_vfs::x_read(sqlite3_file* handle, void* buffer, int amount,
+						  sqlite3_int64 offset)
+	{
+		// Only reads of queued data need the queue submitted first, which
+		// keeps a transaction spilling pages from its cache efficient.
+		auto& f = file::of(handle);
+		if(f.overlaps(offset, amount)) {
+			auto code = f.flush();
+			if(code != SQLITE_OK) return code;
+		}
+		return f.io_methods().xRead(f.real(), buffer, amount, offset);
+	}
+	int uring_vfs::x_write(sqlite3_file* handle, const void* buffer, int amount,
+						   sqlite3_int64 offset)
+	{
+		auto& f = file::of(handle);
+		if(!f.deferWrites || !f.io || amount <= 0) {
+			return f.io_methods().xWrite(f.real(), buffer, amount, offset);
+		}
+
+		auto length = static_cast<std::size_t>(amount);
+		auto& queue = f.queue;
+		// Queued writes are submitted together and may complete in any
+		// order, so a write overlapping one must not be queued beside it.
+		// Within a single queued write it replaces the queued bytes;
+		// otherwise the queue is submitted first.
+		for(auto& w : queue) {
+			if(offset >= w.offset &&
+			   offset + amount <=
+				   w.offset + static_cast<sqlite3_int64_t>(w.length)) {
+				std::memcpy(f.data.data() + w.start +
+								static_cast<std::size_t>(offset - w.offset),
+							buffer, length);
+				bump(f.writesQueued);
+				return SQLITE_OK;
+			}
+		}
+		if(f.overlaps(offset, amount)) {
+			auto code = f.flush();
+			if(code != SQLITE_OK) return code;
+			if(!f.io) {
+				return f.io_methods().xWrite(f.real(), buffer, amount, offset);
+			}
+		}
+		if(queue.size() + 1 >= f.io->entries ||
+		   f.data.size() + length > max_queued_bytes) {
+			auto code = f.flush();
+			if(code != SQLITE_OK) return code;
+			if(!f.io) {
+				return f.io_methods().xWrite(f.real(), buffer, amount, offset);
+			}
+		}
+		try {
+			auto bytes = static_cast<const char*>(buffer);
+			f.data.insert(f.data.end(), bytes, bytes + length);
+		}
+		catch(...) {
+			return SQLITE_IOERR_NOMEM;
+		}
+		// The data of the queue is contiguous, so a write that continues
+		// the last one extends it.
+		if(!queue.empty() && queue.back().offset +
+									 static_cast<sqlite3_int64_t>(
+										 queue.back().length) ==
+								 offset &&
+		   queue.back().length + length <= max_write) {
+			queue.back().length += length;
+		}
+		else {
+			file::queued_write w;
+			w.offset = offset;
+			w.start = f.data.size() - length;
+			w.length = length;
+			queue.push_back(w);
+		}
+		bump(f.writesQueued);
+		return SQLITE_OK;
+	}
+	int uring_vfs::x_truncate(sqlite3_file* handle, sqlite3_int64 size)
+	{
+		auto& f = file::of(handle);
+		auto code = f.flush();
+		if(code != SQLITE_OK) return code;
+		return f.io_methods().xTruncate(f.real(), size);
+	}
+	int uring_vfs::x_sync(sqlite3_file* handle, int flags)
+	{
+		auto& f = file::of(handle);
+		if(!f.io || !f.synced) {
+			auto code = f.flush();
+			if(code != SQLITE_OK) return code;
+			code = f.io_methods().xSync(f.real(), flags);
+			if(code == SQLITE_OK) f.synced = true;
+			return code;
+		}
+		return f.flush(true, flags);
+	}
+	int uring_vfs::x_file_size(sqlite3_file* handle, sqlite3_int64* size)
+	{
+		auto& f = file::of(handle);
+		auto code = f.flush();
+		if(code != SQLITE_OK) return code;
+		return f.io_methods().xFileSize(f.real(), size);
+	}
+	int uring_vfs::x_lock(sqlite3_file* handle, int level)
+	{
+		auto& f = file::of(handle);
+		auto code = f.flush();
+		if(code != SQLITE_OK) return code;
+		return f.io_methods().xLock(f.real(), level);
+	}
+	int uring_vfs::x_unlock(sqlite3_file* handle, int level)
+	{
+		// Other processes must see the writes once the lock is released.
+		auto& f = file::of(handle);
+		auto code = f.flush();
+		if(code != SQLITE_OK) return code;
+		return f.io_methods().xUnlock(f.real(), level);
+	}
+	int uring_vfs::x_check_reserved_lock(sqlite3_file* handle, int* result)
+	{
+		auto& f = file::of(handle);
+		return f.io_methods().xCheckReservedLock(f.real(), result);
+	}
+	int uring_vfs::x_file_control(sqlite3_file* handle, int op, void* arg)
+	{
+		auto& f = file::of(handle);
+		if(op == SQLITE_FCNTL_VFSNAME && arg != nullptr) {
+			auto code = f.io_methods().xFileControl(f.real(), op, arg);
+			auto& name = *static_cast<char**>(arg);
+			auto wrapped = name;
+			name = ::sqlite3_mprintf("%s/%z", f.owner->vfsName.c_str(),
+									 wrapped);
+			return code == SQLITE_NOTFOUND ? SQLITE_OK : code;
+		}
+		// Among others, the end of a checkpoint and size hints, which must
+		// follow the writes before them.
+		auto code = f.flush();
+		if(code != SQLITE_OK) return code;
+		return f.io_methods().xFileControl(f.real(), op, arg);
+	}
+	int uring_vfs::x_sector_size(sqlite3_file* handle)
+	{
+		auto& f = file::of(handle);
+		return f.io_methods().xSectorSize(f.real());
+	}
+	int uring_vfs::x_device_characteristics(sqlite3_file* handle)
+	{
+		auto& f = file::of(handle);
+		return f.io_methods().xDeviceCharacteristics(f.real());
+	}
+	int uring_vfs::x_shm_map(sqlite3_file* handle, int region, int size,
+							 int extend, void volatile** memory)
+	{
+		auto& f = file::of(handle);
+		if(f.io_methods().iVersion < 2) return SQLITE_IOERR;
+		auto code = f.flush();
+		if(code != SQLITE_OK) return code;
+		return f.io_methods().xShmMap(f.real(), region, size, extend, memory);
+	}
+	int uring_vfs::x_shm_lock(sqlite3_file* handle, int offset, int n,
+							  int flags)
+	{
+		auto& f = file::of(handle);
+		if(f.io_methods().iVersion < 2) return SQLITE_IOERR;
+		auto code = f.flush();
+		if(code != SQLITE_OK) return code;
+		return f.io_methods().xShmLock(f.real(), offset, n, flags);
+	}
+	void uring_vfs::x_shm_barrier(sqlite3_file* handle)
+	{
+		auto& f = file::of(handle);
+		if(f.io_methods().iVersion >= 2) f.io_methods().xShmBarrier(f.real());
+	}
+	int uring_vfs::x_shm_unmap(sqlite3_file* handle, int deleteFlag)
+	{
+		auto& f = file::of(handle);
+		if(f.io_methods().iVersion < 2) return SQLITE_OK;
+		f.flush();
+		return f.io_methods().xShmUnmap(f.real(), deleteFlag);
+	}
+}
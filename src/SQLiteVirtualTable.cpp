@@ -0,0 +1,400 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	The virtual table module through which sources of rows are exposed to
+	SQLite, and the choice of index for their key constraints.
+*/
+
+#include "SQLiteVirtualTable.hpp"
+#include <cctype>
+#include <cmath>
+#include <new>
+
+namespace Sqlt3
+{
+	namespace
+	{
+		// Bits of idxNum, naming the arguments passed to xFilter in order.
+		const int index_equal = 1;
+		const int index_lower = 2;
+		const int index_upper = 4;
+		const int index_lower_inclusive = 8;
+		const int index_upper_inclusive = 16;
+
+		struct table
+		{
+			sqlite3_vtab base;
+			std::shared_ptr<const virtual_table_source> source;
+			// Whether the key column is declared with the BINARY collation,
+			// the order in which ordered sources visit text keys.
+			bool binaryKey;
+		};
+
+		struct cursor
+		{
+			sqlite3_vtab_cursor base;
+			std::unique_ptr<virtual_table_cursor> rows;
+		};
+
+		// Whether the first column of a list of column definitions has no
+		// COLLATE clause or a BINARY one.
+		bool binary_key_collation(const utf8_string_out_t& columns)
+		{
+			auto isWord = [](char c) {
+				return std::isalnum(static_cast<unsigned char>(c)) ||
+					   c == '_';
+			};
+			auto depth = 0;
+			auto collate = false;
+			for(std::size_t i = 0; i < columns.size();) {
+				auto c = columns[i];
+				if(c == '(') ++depth;
+				if(c == ')') --depth;
+				if(c == ',' && depth == 0) break;
+				if(!isWord(c)) {
+					++i;
+					continue;
+				}
+				auto end = i;
+				while(end < columns.size() && isWord(columns[end])) ++end;
+				auto word = columns.substr(i, end - i);
+				if(collate) {
+					return ::sqlite3_stricmp(word.c_str(), "BINARY") == 0;
+				}
+				collate = ::sqlite3_stricmp(word.c_str(), "COLLATE") == 0;
+				i = end;
+			}
+			return true;
+		}
+
+		const virtual_table_source& source_of(sqlite3_vtab* vtab) NOEXCEPT_SPEC
+		{
+			return *reinterpret_cast<table*>(vtab)->source;
+		}
+		virtual_table_cursor& rows_of(sqlite3_vtab_cursor* c) NOEXCEPT_SPEC
+		{
+			return *reinterpret_cast<cursor*>(c)->rows;
+		}
+
+		// Exceptions must not propagate into SQLite; each is turned into
+		// the result code and message of the callback.
+		int report_error(sqlite3_vtab* vtab) NOEXCEPT_SPEC
+		{
+			auto message = [vtab](utf8_string_in_t text) {
+				::sqlite3_free(vtab->zErrMsg);
+				vtab->zErrMsg = ::sqlite3_mprintf("%s", text);
+			};
+			try {
+				throw;
+			}
+			catch(const sqlite3_error& e) {
+				message(e.description());
+				return e.code();
+			}
+			catch(const std::bad_alloc&) {
+				return SQLITE_NOMEM;
+			}
+			catch(const std::exception& e) {
+				message(e.what());
+			}
+			catch(...) {
+				message("unknown exception");
+			}
+			return SQLITE_ERROR;
+		}
+
+		int x_connect(sqlite3_t db, void* aux, int, const char* const*,
+					  sqlite3_vtab** out, char** error)
+		{
+			std::unique_ptr<table> t;
+			try {
+				auto& source =
+					*static_cast<std::shared_ptr<const virtual_table_source>*>(
+						aux);
+				auto sql = "CREATE TABLE x(" + source->columns() + ")";
+				auto result = ::sqlite3_declare_vtab(db, sql.c_str());
+				if(result != SQLITE_OK) return result;
+				t.reset(new table());
+				t->source = source;
+				t->binaryKey = binary_key_collation(source->columns());
+			}
+			catch(const std::bad_alloc&) {
+				return SQLITE_NOMEM;
+			}
+			catch(const std::exception& e) {
+				*error = ::sqlite3_mprintf("%s", e.what());
+				return SQLITE_ERROR;
+			}
+#if defined(SQLITE_VTAB_INNOCUOUS)
+			::sqlite3_vtab_config(db, SQLITE_VTAB_INNOCUOUS);
+#endif// defined(SQLITE_VTAB_INNOCUOUS)
+			*out = &t.release()->base;
+			return SQLITE_OK;
+		}
+		int x_disconnect(sqlite3_vtab* vtab)
+		{
+			delete reinterpret_cast<table*>(vtab);
+			return SQLITE_OK;
+		}
+
+		int x_best_index(sqlite3_vtab* vtab, sqlite3_index_info* info)
+		{
+			try {
+				auto& source = source_of(vtab);
+				auto binaryKey = reinterpret_cast<table*>(vtab)->binaryKey;
+				auto access = source.access();
+				auto rows = static_cast<double>(source.row_count());
+				auto search = std::log2(rows + 1) + 1;
+
+				int equal = -1, lower = -1, upper = -1, idxNum = 0;
+				for(int i = 0; i < info->nConstraint; ++i) {
+					auto& c = info->aConstraint[i];
+					if(!c.usable || c.iColumn != 0) continue;
+					// Keys are found and ordered by binary comparison, which
+					// would skip rows that match under another collation.
+					if(::sqlite3_stricmp(::sqlite3_vtab_collation(info, i),
+										 "BINARY") != 0) {
+						continue;
+					}
+					switch(c.op) {
+					case SQLITE_INDEX_CONSTRAINT_EQ:
+						if(access != key_access::scan) equal = i;
+						break;
+					case SQLITE_INDEX_CONSTRAINT_GT:
+					case SQLITE_INDEX_CONSTRAINT_GE:
+						if(access == key_access::ordered) lower = i;
+						break;
+					case SQLITE_INDEX_CONSTRAINT_LT:
+					case SQLITE_INDEX_CONSTRAINT_LE:
+						if(access == key_access::ordered) upper = i;
+						break;
+					}
+				}
+
+				// Constraints are not omitted: SQLite compares each row
+				// visited, so a cursor need only return a superset.
+				auto argument = 0;
+				auto use = [&](int i, int bit) {
+					info->aConstraintUsage[i].argvIndex = ++argument;
+					idxNum |= bit;
+				};
+				if(equal >= 0) {
+					use(equal, index_equal);
+					info->estimatedRows = 1;
+					if(access == key_access::equality) {
+						info->estimatedCost = 1;
+					}
+					else {
+						info->estimatedCost = search;
+					}
+					if(source.unique_keys()) {
+						info->idxFlags |= SQLITE_INDEX_SCAN_UNIQUE;
+					}
+					else if(access == key_access::ordered) {
+						info->estimatedRows = 4;
+						info->estimatedCost = search + 4;
+					}
+				}
+				else if(lower >= 0 || upper >= 0) {
+					auto kept = rows;
+					if(lower >= 0) {
+						use(lower, index_lower);
+						if(info->aConstraint[lower].op ==
+						   SQLITE_INDEX_CONSTRAINT_GE) {
+							idxNum |= index_lower_inclusive;
+						}
+						kept /= 4;
+					}
+					if(upper >= 0) {
+						use(upper, index_upper);
+						if(info->aConstraint[upper].op ==
+						   SQLITE_INDEX_CONSTRAINT_LE) {
+							idxNum |= index_upper_inclusive;
+						}
+						kept /= 4;
+					}
+					info->estimatedRows =
+						static_cast<sqlite3_int64>(kept) + 1;
+					info->estimatedCost = search + kept;
+				}
+				else {
+					info->estimatedRows = static_cast<sqlite3_int64>(rows);
+					info->estimatedCost = rows + 1;
+				}
+				info->idxNum = idxNum;
+
+				// Rows of an ordered source are visited by ascending key,
+				// which SQLite passes in ORDER BY only when the collation of
+				// the term is that of the column.
+				if(access == key_access::ordered && binaryKey &&
+				   info->nOrderBy == 1 &&
+				   info->aOrderBy[0].iColumn == 0 && !info->aOrderBy[0].desc) {
+					info->orderByConsumed = 1;
+				}
+				return SQLITE_OK;
+			}
+			catch(...) {
+				return report_error(vtab);
+			}
+		}
+
+		int x_open(sqlite3_vtab* vtab, sqlite3_vtab_cursor** out)
+		{
+			try {
+				std::unique_ptr<cursor> c(new cursor());
+				c->rows = source_of(vtab).open();
+				*out = &c.release()->base;
+				return SQLITE_OK;
+			}
+			catch(...) {
+				return report_error(vtab);
+			}
+		}
+		int x_close(sqlite3_vtab_cursor* c)
+		{
+			delete reinterpret_cast<cursor*>(c);
+			return SQLITE_OK;
+		}
+
+		int x_filter(sqlite3_vtab_cursor* c, int idxNum, const char*, int,
+					 sqlite3_value_t* argv)
+		{
+			try {
+				key_constraint k;
+				if(idxNum & index_equal) k.equal = *argv++;
+				if(idxNum & index_lower) {
+					k.lower = *argv++;
+					k.lowerInclusive = (idxNum & index_lower_inclusive) != 0;
+				}
+				if(idxNum & index_upper) {
+					k.upper = *argv++;
+					k.upperInclusive = (idxNum & index_upper_inclusive) != 0;
+				}
+				rows_of(c).filter(k);
+				return SQLITE_OK;
+			}
+			catch(...) {
+				return report_error(c->pVtab);
+			}
+		}
+		int x_next(sqlite3_vtab_cursor* c)
+		{
+			try {
+				rows_of(c).next();
+				return SQLITE_OK;
+			}
+			catch(...) {
+				return report_error(c->pVtab);
+			}
+		}
+		int x_eof(sqlite3_vtab_cursor* c)
+		{
+			return rows_of(c).eof() ? 1 : 0;
+		}
+		int x_column(sqlite3_vtab_cursor* c, sqlite3_context* context,
+					 int column)
+		{
+			try {
+				rows_of(c).column(context, column);
+			}
+			catch(...) {
+				detail::report_function_error(context);
+			}
+			return SQLITE_OK;
+		}
+		int x_rowid(sqlite3_vtab_cursor* c, sqlite3_int64* rowid)
+		{
+			try {
+				*rowid = rows_of(c).rowid();
+				return SQLITE_OK;
+			}
+			catch(...) {
+				return report_error(c->pVtab);
+			}
+		}
+
+		sqlite3_module make_module() NOEXCEPT_SPEC
+		{
+			sqlite3_module m = {};
+			m.iVersion = 1;
+			// Without xCreate the table is eponymous only: it exists in
+			// every schema under the name of the module.
+			m.xCreate = nullptr;
+			m.xConnect = &x_connect;
+			m.xBestIndex = &x_best_index;
+			m.xDisconnect = &x_disconnect;
+			m.xDestroy = &x_disconnect;
+			m.xOpen = &x_open;
+			m.xClose = &x_close;
+			m.xFilter = &x_filter;
+			m.xNext = &x_next;
+			m.xEof = &x_eof;
+			m.xColumn = &x_column;
+			m.xRowid = &x_rowid;
+			return m;
+		}
+		const sqlite3_module read_only_module = make_module();
+
+		void destroy_source(void* p)
+		{
+			delete static_cast<std::shared_ptr<const virtual_table_source>*>(
+				p);
+		}
+	}
+
+	virtual_table_cursor::~virtual_table_cursor()
+	{
+	}
+	virtual_table_source::~virtual_table_source()
+	{
+	}
+
+	namespace detail
+	{
+		utf8_string_out_t join_columns(
+			const utf8_string_out_t& key,
+			const std::vector<utf8_string_out_t>& others)
+		{
+			auto joined = key;
+			for(auto& o : others) {
+				joined += ", ";
+				joined += o;
+			}
+			return joined;
+		}
+	}
+
+	void sqlite3_create_module_v2(
+		sqlite3_t c, utf8_string_in_t name,
+		std::shared_ptr<const virtual_table_source> source)
+	{
+		auto aux =
+			new std::shared_ptr<const virtual_table_source>(std::move(source));
+		// The destructor is called even when registration fails.
+		auto result = ::sqlite3_create_module_v2(c, name, &read_only_module,
+												 aux, &destroy_source);
+		if(result != SQLITE_OK) detail::throw_result_error(result, c);
+	}
+}
@@ -31,37 +31,45 @@ Purpose:
 */
 
 #include "SQLiteWrapped.hpp"
+#include <cstdio>
+#include <cstring>
+#include <mutex>
 #include <stdexcept>
 #include <type_traits>
+#include <unordered_map>
 
 namespace Sqlt3
 {
 	ALIAS_TYPE(WRAP_TEMPLATE(std::char_traits<char>), utf8_traits);
 	ALIAS_TYPE(WRAP_TEMPLATE(std::char_traits<char16_t>), utf16_traits);
 
-	std::string error_string_without_details(int code)
-	{
-		std::string err{"SQLite error("};
-		err += std::to_string(code) + ")";
-		return err;
-	}
 	inline bool result_is_error(int code)
 	{
 		return !(code == SQLITE_OK || code == SQLITE_ROW ||
 				 code == SQLITE_DONE);
 	}
+	inline detail::result_t<step_result_t>
+		step_result(int code, sqlite3_t c) NOEXCEPT_SPEC
+	{
+		ALIAS_TYPE(detail::result_t<step_result_t>, result_t);
+		if(result_is_error(code)) return result_t(code, c);
+		return result_t(code, static_cast<step_result_t>(code));
+	}
 
 	template <typename... Args>
 	inline void throw_error(int code, const Args&...)
 	{
-		throw std::runtime_error(error_string_without_details(code) + ": " +
-								 ::sqlite3_errstr(code));
+		throw sqlite3_error(code);
 	}
 	template <typename... Args>
 	inline void throw_error(int code, sqlite3_t db, const Args&...)
 	{
-		throw std::runtime_error(error_string_without_details(code) + ": " +
-								 ::sqlite3_errmsg(db));
+		throw sqlite3_error(code, db);
+	}
+	template <typename... Args>
+	inline void throw_error(int code, sqlite3_stmt_t s, const Args&...)
+	{
+		throw sqlite3_error(code, ::sqlite3_db_handle(s));
 	}
 
 	template <typename F, typename... Args>
@@ -80,6 +88,60 @@ namespace Sqlt3
 		return std::forward<F>(f)(std::forward<Args>(args)...);
 	}
 
+	// Defined whether or not USE_VIEW_CHECKS is, so that the library and
+	// its users may be built with different settings.
+	namespace detail
+	{
+		ALIAS_TYPE(WRAP_TEMPLATE(std::unordered_map<sqlite3_stmt_t,
+													unsigned long long>),
+				   generation_map);
+
+		std::mutex& generation_mutex()
+		{
+			static std::mutex m;
+			return m;
+		}
+		generation_map& generations()
+		{
+			static generation_map g;
+			return g;
+		}
+		unsigned long long& generation_counter()
+		{
+			static unsigned long long counter = 0;
+			return counter;
+		}
+		void forget_generation(sqlite3_stmt_t s) NOEXCEPT_SPEC
+		{
+			std::lock_guard<std::mutex> lock(generation_mutex());
+			generations().erase(s);
+		}
+
+		unsigned long long statement_generation(sqlite3_stmt_t s)
+			NOEXCEPT_SPEC
+		{
+			std::lock_guard<std::mutex> lock(generation_mutex());
+			// Only statements a view was taken of are tracked, so that
+			// stepping others costs a lookup rather than an insertion.
+			try {
+				auto& g = generations()[s];
+				if(g == 0) g = ++generation_counter();
+				return g;
+			}
+			catch(...) {
+				return 0;
+			}
+		}
+		void invalidate_views(sqlite3_stmt_t s) NOEXCEPT_SPEC
+		{
+			std::lock_guard<std::mutex> lock(generation_mutex());
+			auto found = generations().find(s);
+			if(found != generations().end()) {
+				found->second = ++generation_counter();
+			}
+		}
+	}
+
 	template <typename F, typename S, typename... Args>
 	unique_connection open_connection(F&& openOp, S&& file, Args&&... args)
 	{
@@ -123,6 +185,15 @@ namespace Sqlt3
 		return static_cast<step_result_t>(
 			invoke_with_result_error(::sqlite3_backup_step, b, n));
 	}
+	detail::result_t<step_result_t>
+		sqlite3_backup_step(sqlite3_backup_t b, int n,
+							const std::nothrow_t&) NOEXCEPT_SPEC
+	{
+		// The error of a backup step is left on the destination connection,
+		// which the backup handle does not expose.
+		return step_result(invoke_with_result(::sqlite3_backup_step, b, n),
+						   nullptr);
+	}
 
 	void sqlite3_bind(sqlite3_stmt_t s, int i, const void* blob, int bytes,
 					  sqlite3_destructor_type_t destructor)
@@ -153,6 +224,14 @@ namespace Sqlt3
 	{
 		invoke_with_result_error(::sqlite3_bind_value, s, i, v);
 	}
+	void sqlite3_bind(sqlite3_stmt_t s, int i, blob_view_t blob,
+					  sqlite3_destructor_type_t destructor)
+	{
+		auto data = detail::bind_data(blob.data(), blob.size(), destructor);
+		invoke_with_result_error(::sqlite3_bind_blob64, s, i, data,
+								 static_cast<sqlite3_uint64_t>(blob.size()),
+								 destructor);
+	}
 	void sqlite3_bind(sqlite3_stmt_t s, int i)
 	{
 		invoke_with_result_error(::sqlite3_bind_null, s, i);
@@ -198,10 +277,72 @@ namespace Sqlt3
 									 sizeof(utf16_traits::char_type),
 								 sqlite_transient);
 	}
+	void sqlite3_bind_text(sqlite3_stmt_t s, int i, utf8_string_view_t str,
+						   sqlite3_destructor_type_t destructor)
+	{
+		ALIAS_TYPE(WRAP_TEMPLATE(std::underlying_type<text_encoding_t>::type),
+				   encode_t);
+		auto data = detail::bind_data(str.data(), str.size(), destructor);
+		invoke_with_result_error(
+			::sqlite3_bind_text64, s, i, static_cast<const char*>(data),
+			static_cast<sqlite3_uint64_t>(str.size() *
+										  sizeof(utf8_traits::char_type)),
+			destructor, static_cast<encode_t>(sqlite_utf8));
+	}
+	void sqlite3_bind_text(sqlite3_stmt_t s, int i, utf16_string_view_t str,
+						   sqlite3_destructor_type_t destructor)
+	{
+		ALIAS_TYPE(WRAP_TEMPLATE(std::underlying_type<text_encoding_t>::type),
+				   encode_t);
+		// SQLITE_UTF16 is interpreted as native byte order.
+		auto data = detail::bind_data(str.data(), str.size(), destructor);
+		invoke_with_result_error(
+			::sqlite3_bind_text64, s, i, static_cast<const char*>(data),
+			static_cast<sqlite3_uint64_t>(str.size() *
+										  sizeof(utf16_traits::char_type)),
+			destructor, static_cast<encode_t>(sqlite_utf16));
+	}
 	void sqlite3_bind_zeroblob(sqlite3_stmt_t s, int i, int n)
 	{
 		invoke_with_result_error(::sqlite3_bind_zeroblob, s, i, n);
 	}
+	void sqlite3_bind_zeroblob64(sqlite3_stmt_t s, int i, sqlite3_uint64_t n)
+	{
+		invoke_with_result_error(::sqlite3_bind_zeroblob64, s, i, n);
+	}
+
+	int sqlite3_blob_bytes(sqlite3_blob_t b) NOEXCEPT_SPEC
+	{
+		return invoke_with_result(::sqlite3_blob_bytes, b);
+	}
+	void sqlite3_blob_close(unique_blob&& b)
+	{
+		// The handle is freed whatever the result.
+		invoke_with_result_error(::sqlite3_blob_close, b.release());
+	}
+	unique_blob sqlite3_blob_open(sqlite3_t c, utf8_string_in_t db,
+								  utf8_string_in_t table,
+								  utf8_string_in_t column, sqlite3_int64_t row,
+								  bool writable)
+	{
+		auto blob = sqlite3_blob_t(nullptr);
+		invoke_with_result_error(::sqlite3_blob_open, c, db, table, column,
+								 row, writable ? 1 : 0, &blob);
+		return unique_blob{blob};
+	}
+	void sqlite3_blob_read(sqlite3_blob_t b, void* buffer, int n, int offset)
+	{
+		invoke_with_result_error(::sqlite3_blob_read, b, buffer, n, offset);
+	}
+	void sqlite3_blob_reopen(sqlite3_blob_t b, sqlite3_int64_t row)
+	{
+		invoke_with_result_error(::sqlite3_blob_reopen, b, row);
+	}
+	void sqlite3_blob_write(sqlite3_blob_t b, const void* buffer, int n,
+							int offset)
+	{
+		invoke_with_result_error(::sqlite3_blob_write, b, buffer, n, offset);
+	}
 
 	void sqlite3_busy_handler(sqlite3_t c, int (*callback)(void*, int), void* d)
 	{
@@ -236,6 +377,14 @@ namespace Sqlt3
 	{
 		return invoke_with_result(::sqlite3_column_blob, s, i);
 	}
+	blob_view_t sqlite3_column_blob_view(sqlite3_stmt_t s, int i) NOEXCEPT_SPEC
+	{
+		auto result = invoke_with_result(::sqlite3_column_blob, s, i);
+		auto bytes = invoke_with_result(::sqlite3_column_bytes, s, i);
+
+		return blob_view_t{result, static_cast<std::size_t>(bytes),
+						   detail::view_origin_t{s}};
+	}
 	int sqlite3_column_bytes(sqlite3_stmt_t s, int i) NOEXCEPT_SPEC
 	{
 		return invoke_with_result(::sqlite3_column_bytes, s, i);
@@ -259,7 +408,7 @@ namespace Sqlt3
 	}
 	sqlite3_int64_t sqlite3_column_int64(sqlite3_stmt_t s, int i) NOEXCEPT_SPEC
 	{
-		return invoke_with_result(::sqlite3_column_int, s, i);
+		return invoke_with_result(::sqlite3_column_int64, s, i);
 	}
 	utf8_string_out_t sqlite3_column_name(sqlite3_stmt_t s, int i)
 	{
@@ -335,15 +484,41 @@ namespace Sqlt3
 	{
 		auto result = invoke_with_result(::sqlite3_column_text, s, i);
 		if(result == nullptr) return utf8_string_out_t();
+		auto bytes = invoke_with_result(::sqlite3_column_bytes, s, i);
 
-		return reinterpret_cast<utf8_string_out_t::const_pointer>(result);
+		return utf8_string_out_t(
+			reinterpret_cast<utf8_string_out_t::const_pointer>(result),
+			bytes / sizeof(utf8_traits::char_type));
 	}
 	utf16_string_out_t sqlite3_column_text16(sqlite3_stmt_t s, int i)
 	{
 		auto result = invoke_with_result(::sqlite3_column_text16, s, i);
 		if(result == nullptr) return utf16_string_out_t();
+		auto bytes = invoke_with_result(::sqlite3_column_bytes16, s, i);
 
-		return static_cast<utf16_string_out_t::const_pointer>(result);
+		return utf16_string_out_t(
+			static_cast<utf16_string_out_t::const_pointer>(result),
+			bytes / sizeof(utf16_traits::char_type));
+	}
+	utf8_string_view_t sqlite3_column_text_view(sqlite3_stmt_t s,
+												int i) NOEXCEPT_SPEC
+	{
+		auto result = invoke_with_result(::sqlite3_column_text, s, i);
+		auto bytes = invoke_with_result(::sqlite3_column_bytes, s, i);
+
+		return utf8_string_view_t{
+			reinterpret_cast<utf8_string_view_t::const_pointer>(result),
+			bytes / sizeof(utf8_traits::char_type), detail::view_origin_t{s}};
+	}
+	utf16_string_view_t sqlite3_column_text16_view(sqlite3_stmt_t s,
+												   int i) NOEXCEPT_SPEC
+	{
+		auto result = invoke_with_result(::sqlite3_column_text16, s, i);
+		auto bytes = invoke_with_result(::sqlite3_column_bytes16, s, i);
+
+		return utf16_string_view_t{
+			static_cast<utf16_string_view_t::const_pointer>(result),
+			bytes / sizeof(utf16_traits::char_type), detail::view_origin_t{s}};
 	}
 	type_t sqlite3_column_type(sqlite3_stmt_t s, int i) NOEXCEPT_SPEC
 	{
@@ -395,18 +570,25 @@ namespace Sqlt3
 	void sqlite3_exec(sqlite3_t c, utf8_string_in_t sql,
 					  int (*callback)(void*, int, char**, char**), void* d)
 	{
-		char* errorOut = nullptr;
-		auto code =
-			invoke_with_result(::sqlite3_exec, c, sql, callback, d, &errorOut);
-		if(result_is_error(code)) {
-			auto err = error_string_without_details(code) + ": " + errorOut;
-			sqlite3_free(errorOut);
-			throw std::runtime_error(err);
-		}
+		// The message of the connection is the same as the one
+		// sqlite3_exec would copy out, without the allocation.
+		invoke_with_result_error(::sqlite3_exec, c, sql, callback, d, nullptr);
+	}
+	detail::result_t<void>
+		sqlite3_exec(sqlite3_t c, utf8_string_in_t sql,
+					 int (*callback)(void*, int, char**, char**), void* d,
+					 const std::nothrow_t&) NOEXCEPT_SPEC
+	{
+		return detail::result_t<void>(
+			invoke_with_result(::sqlite3_exec, c, sql, callback, d, nullptr),
+			c);
 	}
 
 	void sqlite3_finalize(unique_statement&& s)
 	{
+#if defined(USE_VIEW_CHECKS)
+		detail::forget_generation(s.get());
+#endif// defined(USE_VIEW_CHECKS)
 		invoke_with_result_error(::sqlite3_finalize, s.release());
 	}
 
@@ -472,6 +654,23 @@ namespace Sqlt3
 
 		return std::make_tuple(unique_statement{stmt}, sql + (pos - sql));
 	}
+	detail::result_t<std::tuple<unique_statement, utf8_string_in_t>>
+		sqlite3_prepare_v2(sqlite3_t c, utf8_string_in_t sql,
+						   const std::nothrow_t&) NOEXCEPT_SPEC
+	{
+		ALIAS_TYPE(WRAP_TEMPLATE(detail::result_t<
+									 std::tuple<unique_statement,
+												utf8_string_in_t>>),
+				   result_t);
+		auto stmt = sqlite3_stmt_t(nullptr);
+		decltype(sql) pos = nullptr;
+		auto bytes = static_cast<int>(utf8_traits::length(sql) *
+									  sizeof(utf8_traits::char_type));
+		auto code = invoke_with_result(::sqlite3_prepare_v2, c, sql, bytes,
+									   &stmt, &pos);
+		if(result_is_error(code)) return result_t(code, c);
+		return result_t(code, std::make_tuple(unique_statement{stmt}, pos));
+	}
 	std::tuple<unique_statement, utf16_string_in_t>
 		sqlite3_prepare(sqlite3_t c, utf16_string_in_t sql)
 	{
@@ -516,8 +715,20 @@ namespace Sqlt3
 
 	void sqlite3_reset(sqlite3_stmt_t s)
 	{
+#if defined(USE_VIEW_CHECKS)
+		detail::invalidate_views(s);
+#endif// defined(USE_VIEW_CHECKS)
 		invoke_with_result_error(::sqlite3_reset, s);
 	}
+	detail::result_t<void> sqlite3_reset(sqlite3_stmt_t s,
+										 const std::nothrow_t&) NOEXCEPT_SPEC
+	{
+#if defined(USE_VIEW_CHECKS)
+		detail::invalidate_views(s);
+#endif// defined(USE_VIEW_CHECKS)
+		return detail::result_t<void>(invoke_with_result(::sqlite3_reset, s),
+									  ::sqlite3_db_handle(s));
+	}
 
 	void* sqlite3_rollback_hook(sqlite3_t c, void (*callback)(void*),
 								void* d) NOEXCEPT_SPEC
@@ -555,9 +766,21 @@ namespace Sqlt3
 
 	step_result_t sqlite3_step(sqlite3_stmt_t s)
 	{
+#if defined(USE_VIEW_CHECKS)
+		detail::invalidate_views(s);
+#endif// defined(USE_VIEW_CHECKS)
 		return static_cast<step_result_t>(
 			invoke_with_result_error(::sqlite3_step, s));
 	}
+	detail::result_t<step_result_t>
+		sqlite3_step(sqlite3_stmt_t s, const std::nothrow_t&) NOEXCEPT_SPEC
+	{
+#if defined(USE_VIEW_CHECKS)
+		detail::invalidate_views(s);
+#endif// defined(USE_VIEW_CHECKS)
+		return step_result(invoke_with_result(::sqlite3_step, s),
+						   ::sqlite3_db_handle(s));
+	}
 
 	bool sqlite3_stmt_busy(sqlite3_stmt_t s) NOEXCEPT_SPEC
 	{
@@ -629,8 +852,92 @@ namespace Sqlt3
 		return invoke_with_result(::sqlite3_threadsafe) != 0;
 	}
 
+	sqlite3_error::sqlite3_error(int code)
+		: std::runtime_error(""), resultCode(code), extendedCode(code)
+	{
+		format(::sqlite3_errstr(code));
+	}
+	sqlite3_error::sqlite3_error(int code, sqlite3_t c)
+		: sqlite3_error(code, c ? ::sqlite3_errmsg(c) : ::sqlite3_errstr(code))
+	{
+		if(c == nullptr) return;
+		// The connection may have moved on from the failed call.
+		auto extended = ::sqlite3_extended_errcode(c);
+		if((extended & 0xff) == (code & 0xff)) extendedCode = extended;
+	}
+	sqlite3_error::sqlite3_error(int code, utf8_string_in_t m)
+		: std::runtime_error(""), resultCode(code), extendedCode(code)
+	{
+		format(m);
+	}
+	sqlite3_error::sqlite3_error(int code, int extended, utf8_string_in_t m)
+		: sqlite3_error(code, m)
+	{
+		if((extended & 0xff) == (code & 0xff)) extendedCode = extended;
+	}
+
+	void sqlite3_error::format(utf8_string_in_t description) NOEXCEPT_SPEC
+	{
+		auto prefix = std::snprintf(text, sizeof(text), "SQLite error(%d): ",
+									resultCode);
+		descriptionOffset = prefix < 0 ? 0 : static_cast<std::size_t>(prefix);
+		if(descriptionOffset >= sizeof(text)) descriptionOffset = 0;
+		auto last = sizeof(text) - 1;
+		if(description == nullptr) description = "";
+		std::strncpy(text + descriptionOffset, description,
+					 last - descriptionOffset);
+		text[last] = '\0';
+	}
+
+	int sqlite3_error::code() const NOEXCEPT_SPEC
+	{
+		return resultCode;
+	}
+	int sqlite3_error::primary_code() const NOEXCEPT_SPEC
+	{
+		return resultCode & 0xff;
+	}
+	int sqlite3_error::extended_code() const NOEXCEPT_SPEC
+	{
+		return extendedCode;
+	}
+	const char* sqlite3_error::description() const NOEXCEPT_SPEC
+	{
+		return text + descriptionOffset;
+	}
+	const char* sqlite3_error::what() const noexcept
+	{
+		return text;
+	}
+
 	namespace detail
 	{
+		void throw_result_error(int code, sqlite3_t c)
+		{
+			if(c == nullptr) throw_error(code);
+			throw_error(code, c);
+		}
+
+		result_base_t::result_base_t(int code,
+									 sqlite3_t c) NOEXCEPT_SPEC
+			: resultCode(code),
+			  extendedCode(code)
+		{
+			message[0] = '\0';
+			if(c == nullptr || ok()) return;
+			auto extended = ::sqlite3_extended_errcode(c);
+			if((extended & 0xff) == (code & 0xff)) extendedCode = extended;
+			std::strncpy(message, ::sqlite3_errmsg(c), sizeof(message) - 1);
+			message[sizeof(message) - 1] = '\0';
+		}
+
+		void result_base_t::check() const
+		{
+			if(ok()) return;
+			if(message[0] == '\0') throw sqlite3_error(resultCode);
+			throw sqlite3_error(resultCode, extendedCode, message);
+		}
+
 		initialize_t::initialize_t(initialize_t&& x) NOEXCEPT_SPEC
 		{
 			x.moved = true;
@@ -652,12 +959,19 @@ namespace Sqlt3
 		{
 			::sqlite3_backup_finish(p);
 		}
+		void BlobDeleter::operator()(pointer p) const NOEXCEPT_SPEC
+		{
+			::sqlite3_blob_close(p);
+		}
 		void ConnectionDeleter::operator()(pointer p) const NOEXCEPT_SPEC
 		{
 			::sqlite3_close(p);
 		}
 		void StatementDeleter::operator()(pointer p) const NOEXCEPT_SPEC
 		{
+#if defined(USE_VIEW_CHECKS)
+			forget_generation(p);
+#endif// defined(USE_VIEW_CHECKS)
 			::sqlite3_finalize(p);
 		}
 	}
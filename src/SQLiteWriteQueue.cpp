@@ -0,0 +1,243 @@
+/*
+Licence:
+	The MIT License (MIT)
+
+	Copyright (c) 2015 Jared Mulconry
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to
+	deal in the Software without restriction, including without limitation the
+	rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+	sell copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+	IN THE SOFTWARE.
+
+Purpose:
+	A queue of write jobs executed in order by a dedicated thread that owns
+	the only writing connection to a database. Queued jobs are grouped into
+	shared transactions so that they are committed together.
+*/
+
+#include "SQLiteWriteQueue.hpp"
+#include <memory>
+
+namespace Sqlt3
+{
+	namespace
+	{
+		int execute_sql(sqlite3_t connection, utf8_string_in_t sql) NOEXCEPT_SPEC
+		{
+			return ::sqlite3_exec(connection, sql, nullptr, nullptr, nullptr);
+		}
+		std::exception_ptr result_error(int code,
+										sqlite3_t connection) NOEXCEPT_SPEC
+		{
+			try {
+				detail::throw_result_error(code, connection);
+			}
+			catch(...) {
+				return std::current_exception();
+			}
+			return nullptr;
+		}
+	}
+
+	struct write_queue::node
+	{
+		node* next = nullptr;
+		job_t job;
+		callback_t callback;
+		std::promise<void> promise;
+		std::exception_ptr error;
+
+		void complete() NOEXCEPT_SPEC
+		{
+			if(callback) {
+				callback(error);
+			}
+			else if(error) {
+				promise.set_exception(error);
+			}
+			else {
+				promise.set_value();
+			}
+		}
+	};
+
+	write_queue::write_queue(unique_connection c,
+							 const write_queue_options& o)
+		: connection(std::move(c)), options(o), head(nullptr),
+		  sleeping(false), jobCount(0), failureCount(0), transactionCount(0)
+	{
+		if(!connection) {
+			detail::throw_result_error(SQLITE_MISUSE, nullptr);
+		}
+		if(options.jobsPerTransaction == 0) {
+			options.jobsPerTransaction = 1;
+		}
+		Sqlt3::sqlite3_busy_timeout(connection.get(), options.busyTimeout);
+		writer = std::thread(&write_queue::run, this);
+	}
+	write_queue::~write_queue() NOEXCEPT_SPEC
+	{
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		writer.join();
+	}
+
+	std::future<void> write_queue::submit(job_t job)
+	{
+		std::unique_ptr<node> n(new node);
+		n->job = std::move(job);
+		auto result = n->promise.get_future();
+		push(n.release());
+		return result;
+	}
+	void write_queue::submit(job_t job, callback_t done)
+	{
+		std::unique_ptr<node> n(new node);
+		n->job = std::move(job);
+		n->callback = std::move(done);
+		push(n.release());
+	}
+
+	unsigned long long write_queue::jobs() const NOEXCEPT_SPEC
+	{
+		return jobCount.load();
+	}
+	unsigned long long write_queue::failures() const NOEXCEPT_SPEC
+	{
+		return failureCount.load();
+	}
+	unsigned long long write_queue::transactions() const NOEXCEPT_SPEC
+	{
+		return transactionCount.load();
+	}
+
+	void write_queue::push(node* n)
+	{
+		auto top = head.load(std::memory_order_relaxed);
+		do {
+			n->next = top;
+		} while(!head.compare_exchange_weak(top, n));
+		// The writer publishes that it is going to sleep before checking for
+		// work, so either it sees this node or this sees it sleeping.
+		if(sleeping.load()) {
+			std::lock_guard<std::mutex> lock(wakeMutex);
+			wake.notify_one();
+		}
+	}
+
+	void write_queue::run() NOEXCEPT_SPEC
+	{
+		for(;;) {
+			auto list = head.exchange(nullptr);
+			if(!list) {
+				std::unique_lock<std::mutex> lock(wakeMutex);
+				sleeping.store(true);
+				if(stopping && !head.load()) return;
+				wake.wait(lock, [this] { return stopping || head.load(); });
+				sleeping.store(false);
+				continue;
+			}
+
+			// The stack holds the newest job first.
+			node* queue = nullptr;
+			while(list) {
+				auto next = list->next;
+				list->next = queue;
+				queue = list;
+				list = next;
+			}
+
+			while(queue) {
+				auto last = queue;
+				for(std::size_t n = 1;
+					n < options.jobsPerTransaction && last->next; ++n) {
+					last = last->next;
+				}
+				auto batch = queue;
+				queue = last->next;
+				last->next = nullptr;
+				execute(batch);
+			}
+		}
+	}
+
+	void write_queue::execute(node* batch) NOEXCEPT_SPEC
+	{
+		auto db = connection.get();
+		// The first job of the open transaction, or nullptr if none is open.
+		node* first = nullptr;
+		for(auto n = batch; n; n = n->next) {
+			if(!first) {
+				auto code = execute_sql(db, "BEGIN IMMEDIATE");
+				if(code != SQLITE_OK) {
+					n->error = result_error(code, db);
+					continue;
+				}
+				first = n;
+				++transactionCount;
+			}
+
+			auto code = execute_sql(db, "SAVEPOINT job");
+			if(code != SQLITE_OK) {
+				n->error = result_error(code, db);
+			}
+			else {
+				try {
+					n->job(db);
+					execute_sql(db, "RELEASE job");
+				}
+				catch(...) {
+					n->error = std::current_exception();
+					execute_sql(db, "ROLLBACK TO job");
+					execute_sql(db, "RELEASE job");
+				}
+			}
+
+			// Some errors roll back the whole transaction, taking the jobs
+			// before this one with it.
+			if(::sqlite3_get_autocommit(db)) {
+				auto error = n->error ? n->error
+									  : result_error(SQLITE_ABORT, nullptr);
+				for(auto m = first; m != n->next; m = m->next) {
+					if(!m->error) m->error = error;
+				}
+				first = nullptr;
+			}
+		}
+
+		if(first) {
+			auto code = execute_sql(db, "COMMIT");
+			if(code != SQLITE_OK) {
+				auto error = result_error(code, db);
+				execute_sql(db, "ROLLBACK");
+				for(auto m = first; m; m = m->next) {
+					if(!m->error) m->error = error;
+				}
+			}
+		}
+
+		while(batch) {
+			std::unique_ptr<node> n(batch);
+			batch = n->next;
+			if(n->error) ++failureCount;
+			++jobCount;
+			n->complete();
+		}
+	}
+}